@@ -1,34 +1,276 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdbool.h>
 #include "assert.h"
 #include <math.h>
 #include "/comp/40/build/include/compress40.h"
+#include "pool.h"
+#include "batch.h"
+#include "server.h"
+#include "codec.h"
 
 static void (*compress_or_decompress)(FILE *input) = compress40;
 
+/* set by -t, -e, -P, -B, -L, and -Q: how compressed images are written */
+static struct codec_options options = CODEC_DEFAULTS;
+
+/* set by -r: the x, y, width and height of the rectangle to decompress */
+static int region[4];
+
+/* set by -j for a single image: the threads of the pipelined codec */
+static int pipeline_threads;
+
+static void compress_with_options(FILE *input)
+{
+        compress40_with(input, stdout, &options);
+}
+
+static void compress_and_verify(FILE *input)
+{
+        double error = compress40_verify(input, stdout, &options);
+        fprintf(stderr, "%.4f\n", error);
+}
+
+static void compress_pipelined(FILE *input)
+{
+        compress40_pipelined(input, stdout, &options, pipeline_threads);
+}
+
+static void decompress_pipelined(FILE *input)
+{
+        decompress40_pipelined(input, stdout, pipeline_threads);
+}
+
+static void decompress_region(FILE *input)
+{
+        decompress40_region(input, stdout, region[0], region[1], region[2],
+                            region[3]);
+}
+
+static void decompress_preview(FILE *input)
+{
+        decompress40_preview(input, stdout);
+}
+
+static void usage(const char *progname)
+{
+        fprintf(stderr, "Usage: %s -d [-r x,y,width,height | -j threads] "
+                "[filename]\n"
+                "       %s -p [filename]\n"
+                "       %s -c [-t tile_size] [-e raw|huffman|rle] "
+                "[-P left|above|median] [-B 4|8]\n"
+                "                 [-L a,b,c,d,pb,pr] [-Q bcd_max] "
+                "[-v | -j threads] [filename]\n"
+                "                 (-P needs -e huffman or -e rle)\n"
+                "       %s -c|-d -b outdir [-j threads] [filename...]\n"
+                "       %s -s socket [-j threads]\n",
+                progname, progname, progname, progname, progname);
+        exit(1);
+}
+
 int main(int argc, char *argv[])
 {
         int i;
+        char *batch_dir = NULL;   /* set by -b: batch mode output directory */
+        char *socket_path = NULL; /* set by -s: server mode socket */
+        int threads = 0;          /* set by -j: worker threads */
+        bool threaded = false;    /* set by -j: threads were asked for */
+        bool cropping = false;    /* set by -r: decompress a rectangle */
+        bool previewing = false;  /* set by -p: half-resolution preview */
+        bool verifying = false;   /* set by -v: print the RMSD of -c */
+        bool layout_set = false;  /* set by -L or -Q: a non-default layout */
+        double bcd_max = 0.3;     /* set by -Q: the largest b, c, or d kept */
 
         for (i = 1; i < argc; i++) {
                 if (strcmp(argv[i], "-c") == 0) {
                         compress_or_decompress = compress40;
                 } else if (strcmp(argv[i], "-d") == 0) {
                         compress_or_decompress = decompress40;
+                } else if (strcmp(argv[i], "-b") == 0) {
+                        if (++i == argc) {
+                                usage(argv[0]);
+                        }
+                        batch_dir = argv[i];
+                } else if (strcmp(argv[i], "-s") == 0) {
+                        if (++i == argc) {
+                                usage(argv[0]);
+                        }
+                        socket_path = argv[i];
+                } else if (strcmp(argv[i], "-j") == 0) {
+                        if (++i == argc) {
+                                usage(argv[0]);
+                        }
+                        threads = atoi(argv[i]);
+                        threaded = true;
+                } else if (strcmp(argv[i], "-r") == 0) {
+                        if (++i == argc ||
+                            sscanf(argv[i], "%d,%d,%d,%d", &region[0],
+                                   &region[1], &region[2], &region[3]) != 4) {
+                                usage(argv[0]);
+                        }
+                        cropping = true;
+                } else if (strcmp(argv[i], "-t") == 0) {
+                        if (++i == argc || atoi(argv[i]) <= 0) {
+                                usage(argv[0]);
+                        }
+                        options.tile_size = atoi(argv[i]);
+                } else if (strcmp(argv[i], "-e") == 0) {
+                        if (++i == argc) {
+                                usage(argv[0]);
+                        } else if (strcmp(argv[i], "raw") == 0) {
+                                options.coding = CODING_RAW;
+                        } else if (strcmp(argv[i], "huffman") == 0) {
+                                options.coding = CODING_HUFFMAN;
+                        } else if (strcmp(argv[i], "rle") == 0) {
+                                options.coding = CODING_RLE;
+                        } else {
+                                usage(argv[0]);
+                        }
+                } else if (strcmp(argv[i], "-P") == 0) {
+                        if (++i == argc) {
+                                usage(argv[0]);
+                        } else if (strcmp(argv[i], "left") == 0) {
+                                options.predict = PREDICT_LEFT;
+                        } else if (strcmp(argv[i], "above") == 0) {
+                                options.predict = PREDICT_ABOVE;
+                        } else if (strcmp(argv[i], "median") == 0) {
+                                options.predict = PREDICT_MEDIAN;
+                        } else {
+                                usage(argv[0]);
+                        }
+                } else if (strcmp(argv[i], "-B") == 0) {
+                        if (++i == argc || (strcmp(argv[i], "4") != 0 &&
+                                            strcmp(argv[i], "8") != 0)) {
+                                usage(argv[0]);
+                        }
+                        options.block_size = atoi(argv[i]);
+                } else if (strcmp(argv[i], "-L") == 0) {
+                        unsigned *width = options.layout.width;
+                        if (++i == argc ||
+                            sscanf(argv[i], "%u,%u,%u,%u,%u,%u", &width[0],
+                                   &width[1], &width[2], &width[3], 
+                                   &width[4], &width[5]) != 6) {
+                                usage(argv[0]);
+                        }
+                        layout_set = true;
+                } else if (strcmp(argv[i], "-Q") == 0) {
+                        if (++i == argc || (bcd_max = atof(argv[i])) <= 0) {
+                                usage(argv[0]);
+                        }
+                        layout_set = true;
+                } else if (strcmp(argv[i], "-p") == 0) {
+                        previewing = true;
+                } else if (strcmp(argv[i], "-v") == 0) {
+                        verifying = true;
                 } else if (*argv[i] == '-') {
                         fprintf(stderr, "%s: unknown option '%s'\n",
                                 argv[0], argv[i]);
                         exit(1);
-                } else if (argc - i > 2) {
-                        fprintf(stderr, "Usage: %s -d [filename]\n"
-                                "       %s -c [filename]\n",
-                                argv[0], argv[0]);
-                        exit(1);
+                } else if (batch_dir == NULL && argc - i > 2) {
+                        usage(argv[0]);
                 } else {
                         break;
                 }
         }
+
+        /* -r only makes sense for a single decompression */
+        if (cropping) {
+                if (compress_or_decompress != decompress40 ||
+                    batch_dir != NULL || socket_path != NULL) {
+                        usage(argv[0]);
+                }
+                compress_or_decompress = decompress_region;
+        }
+
+        /* so does -p, which can't be combined with -r */
+        if (previewing) {
+                if (cropping || batch_dir != NULL || socket_path != NULL) {
+                        usage(argv[0]);
+                }
+                compress_or_decompress = decompress_preview;
+        }
+
+        /* 
+         * b, c, and d are scaled so bcd_max just fits the narrowest of 
+         * them; -L 9,5,5,5,4,4 -Q 0.3 is the default layout
+         */
+        if (layout_set) {
+                struct word_layout *layout = &options.layout;
+                unsigned narrowest = layout->width[1];
+                for (int f = 2; f <= 3; f++) {
+                        if (layout->width[f] < narrowest) {
+                                narrowest = layout->width[f];
+                        }
+                }
+                if (narrowest < 2 || narrowest > 16) {
+                        usage(argv[0]);
+                }
+                layout->bcd_max = bcd_max;
+                layout->bcd_scale = ((1u << (narrowest - 1)) - 1) / bcd_max;
+        }
+
+        /* 
+         * larger blocks and wide layouts can't be predicted or Huffman 
+         * coded, and raw words aren't predicted
+         */
+        if (!codec_options_valid(&options)) {
+                usage(argv[0]);
+        }
+
+        /* compression options apply to single images and batches */
+        if (compress_or_decompress == compress40) {
+                compress_or_decompress = compress_with_options;
+        }
+
+        /* -v only makes sense for a single compression */
+        if (verifying) {
+                if (compress_or_decompress != compress_with_options ||
+                    batch_dir != NULL || socket_path != NULL) {
+                        usage(argv[0]);
+                }
+                compress_or_decompress = compress_and_verify;
+        }
+
+        /* 
+         * -j for a single image pipelines it; -r, -p, and -v work on the 
+         * whole image at once
+         */
+        if (threaded && batch_dir == NULL && socket_path == NULL) {
+                if (compress_or_decompress == compress_with_options) {
+                        compress_or_decompress = compress_pipelined;
+                } else if (compress_or_decompress == decompress40) {
+                        compress_or_decompress = decompress_pipelined;
+                } else {
+                        usage(argv[0]);
+                }
+                pipeline_threads = threads;
+        }
+
+        /* server mode: serve requests until stopped by a signal */
+        if (socket_path != NULL) {
+                return run_server(socket_path, threads) == 0 ? EXIT_SUCCESS
+                                                             : EXIT_FAILURE;
+        }
+
+        /* batch mode: files from the command line, or a manifest on stdin */
+        if (batch_dir != NULL) {
+                bool compress = (compress_or_decompress == 
+                                 compress_with_options);
+                int failures;
+                if (i < argc) {
+                        failures = run_batch(&argv[i], argc - i, batch_dir,
+                                             compress, &options, threads);
+                } else {
+                        int nfiles;
+                        char **files = read_manifest(stdin, &nfiles);
+                        failures = run_batch(files, nfiles, batch_dir,
+                                             compress, &options, threads);
+                        free_manifest(&files, nfiles);
+                }
+                return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+
         assert(argc - i <= 1);    /* at most one file on command line */
         if (i < argc) {
                 FILE *fp = fopen(argv[i], "r");
@@ -39,5 +281,10 @@ int main(int argc, char *argv[])
                 compress_or_decompress(stdin);
         }
 
+        /* report how the codec's buffer pool was used, if asked to */
+        if (getenv("COMP40_POOL_STATS") != NULL) {
+                Pool_print_stats(Pool_current(), stderr);
+        }
+
         return EXIT_SUCCESS; 
 }
@@ -0,0 +1,232 @@
+/**************************************************************
+ *
+ *                     a2pool.c
+ *
+ *     Assignment: Arith 
+ *     Authors:  Marielle Cibella (mcibel01), Erica Huang (ehuang02)
+ *     Date:     4/14/25
+ *
+ *     Summary:
+ * 
+ *     a2pool.c implements uarray2_methods_pool, an A2Methods_T for 2D 
+ *     arrays stored flat in row-major order. The array header and all of 
+ *     its elements come from one allocation out of the calling thread's 
+ *     current pool, instead of one allocation per row as in uarray2.c.
+ *     
+ *
+ **************************************************************/
+
+#include <stdlib.h>
+
+#include "assert.h"
+#include <a2plain.h>
+#include "a2pool.h"
+#include "pool.h"
+
+/* 
+ * struct flat_array is a 2D array of width * height cells of 'size' bytes,
+ * where cell (i, j) lives at elems + (j * width + i) * size
+ */
+typedef struct flat_array {
+        int width, height;
+        int size;
+        char *elems;
+} *flat_array;
+
+typedef A2Methods_UArray2 A2;   /* private abbreviation */
+
+/*********************************************/
+/* Define a private version of each function */
+/* in A2Methods_T that we implement          */
+/*********************************************/
+
+static A2 new(int width, int height, int size)
+{
+        assert(width >= 0);
+        assert(height >= 0);
+        assert(size > 0);
+
+        Pool_T pool = Pool_current();
+        assert(pool != NULL);
+
+        /* the header and the elements share one pool allocation */
+        long header = (sizeof(struct flat_array) + 15) / 16 * 16;
+        long nbytes = header + (long)width * height * size;
+        flat_array array = Pool_alloc(pool, nbytes);
+        assert(array != NULL);
+
+        array->width = width;
+        array->height = height;
+        array->size = size;
+        array->elems = (char *)array + header;
+
+        return array;
+}
+
+static A2 new_with_blocksize(int width, int height, int size, int blocksize)
+{
+        (void)blocksize;
+        return new(width, height, size);
+}
+
+static void a2free(A2 *array2p)
+{
+        /* the memory goes back to the pool when the pool is reset */
+        assert(array2p != NULL);
+        assert(*array2p != NULL);
+        *array2p = NULL;
+}
+
+static int width(A2 array2)
+{
+        assert(array2 != NULL);
+        return ((flat_array)array2)->width;
+}
+
+static int height(A2 array2)
+{
+        assert(array2 != NULL);
+        return ((flat_array)array2)->height;
+}
+
+static int size(A2 array2)
+{
+        assert(array2 != NULL);
+        return ((flat_array)array2)->size;
+}
+
+static int blocksize(A2 array2)
+{
+        (void)array2;
+        return 1;
+}
+
+static A2Methods_Object *at(A2 array2, int i, int j)
+{
+        flat_array array = array2;
+        assert(array != NULL);
+        assert(i >= 0 && i < array->width);
+        assert(j >= 0 && j < array->height);
+
+        return array->elems + ((long)j * array->width + i) * array->size;
+}
+
+static void map_row_major(A2 array2, A2Methods_applyfun apply, void *cl)
+{
+        flat_array array = array2;
+        assert(array != NULL);
+
+        int w = array->width;
+        int h = array->height;
+        int size = array->size;
+        char *elem = array->elems;
+
+        /* the cells are visited in the order they sit in memory */
+        for (int j = 0; j < h; j++) {
+                for (int i = 0; i < w; i++) {
+                        apply(i, j, array2, elem, cl);
+                        elem += size;
+                }
+        }
+}
+
+static void map_col_major(A2 array2, A2Methods_applyfun apply, void *cl)
+{
+        flat_array array = array2;
+        assert(array != NULL);
+
+        int w = array->width;
+        int h = array->height;
+        long size = array->size;
+        long row_bytes = (long)w * size;
+
+        for (int i = 0; i < w; i++) {
+                char *elem = array->elems + i * size;
+                for (int j = 0; j < h; j++) {
+                        apply(i, j, array2, elem, cl);
+                        elem += row_bytes;
+                }
+        }
+}
+
+struct small_closure {
+        A2Methods_smallapplyfun *apply;
+        void *cl;
+};
+
+static void apply_small(int i, int j, A2 array2, void *elem, void *vcl)
+{
+        struct small_closure *cl = vcl;
+        (void)i;
+        (void)j;
+        (void)array2;
+        cl->apply(elem, cl->cl);
+}
+
+static void small_map_row_major(A2 a2, A2Methods_smallapplyfun apply, 
+                                void *cl)
+{
+        struct small_closure mycl = { apply, cl };
+        map_row_major(a2, apply_small, &mycl);
+}
+
+static void small_map_col_major(A2 a2, A2Methods_smallapplyfun apply, 
+                                void *cl)
+{
+        struct small_closure mycl = { apply, cl };
+        map_col_major(a2, apply_small, &mycl);
+}
+
+/*
+ * now create the private struct containing pointers to the functions
+ */
+
+static struct A2Methods_T uarray2_methods_pool_struct = {
+        new,
+        new_with_blocksize,
+        a2free,
+        width,
+        height,
+        size,
+        blocksize,
+        at,
+        map_row_major,
+        map_col_major,
+        NULL,                   /* map_block_major */
+        map_row_major,          /* map_default */
+        small_map_row_major,
+        small_map_col_major,
+        NULL,                   /* small_map_block_major */
+        small_map_row_major,    /* small_map_default */
+};
+
+/* 
+ * finally the payoff: here is the exported pointer to the struct
+ */
+
+A2Methods_T uarray2_methods_pool = &uarray2_methods_pool_struct;
+
+/********** uarray2_rows_contiguous ********
+ *
+ * Purpose: Tells whether every row of an array made by a methods suite is
+ *          stored as one run of cells, in column order
+ *
+ * Parameters:
+ *      - methods: the methods suite
+ *
+ * Return: true for this suite and for uarray2_methods_plain (a UArray per
+ *         row), false for any other, such as the blocked arrays
+ *
+ * Expects: none
+ *
+ * CRE: none
+ *
+ * Notes:
+ *      - Cell (i, j) of such an array is then at(array, 0, j) + i * size,
+ *        so a row can be handed to a kernel as a plain C array
+ */
+bool uarray2_rows_contiguous(A2Methods_T methods)
+{
+        return methods == uarray2_methods_pool || 
+               methods == uarray2_methods_plain;
+}
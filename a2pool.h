@@ -0,0 +1,32 @@
+/**************************************************************
+ *
+ *                     a2pool.h
+ *
+ *     Assignment: Arith 
+ *     Authors:  Marielle Cibella (mcibel01), Erica Huang (ehuang02)
+ *     Date:     4/14/25
+ *
+ *     Summary:
+ * 
+ *     Exports an A2Methods_T whose 2D arrays are stored flat, in row-major 
+ *     order, in memory taken from the calling thread's current pool 
+ *     (see pool.h). Freeing one of these arrays gives nothing back; the 
+ *     memory is reclaimed when the pool is reset.
+ *
+ *     uarray2_rows_contiguous() tells kernels that work a row at a time 
+ *     whether a methods suite keeps each row's cells next to each other.
+ *     
+ *
+ **************************************************************/
+
+#ifndef A2POOL
+#define A2POOL
+
+#include <stdbool.h>
+#include <a2methods.h>
+
+extern A2Methods_T uarray2_methods_pool;
+
+bool uarray2_rows_contiguous(A2Methods_T methods);
+
+#endif
@@ -0,0 +1,467 @@
+/**************************************************************
+ *
+ *                     batch.c
+ *
+ *     Assignment: Arith
+ *     Authors:  Marielle Cibella (mcibel01), Erica Huang (ehuang02)
+ *     Date:     4/16/25
+ *
+ *     Summary:
+ *
+ *     batch.c implements 40image's batch mode. Worker threads claim files
+ *     one at a time from a shared list and run compress40_with() or
+ *     decompress40_stream() on each, writing one output file per input to
+ *     a target directory. Every worker installs its own buffer pool and
+ *     output buffer once and reuses them for all of its files, so after
+ *     the first few images no per-image buffers are allocated at all.
+ *     An output is written under a temporary name and renamed into place
+ *     only once it is complete, so a file that fails leaves nothing
+ *     behind, and the rest of the batch carries on.
+ *
+ *
+ **************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "assert.h"
+#include "except.h"
+#include "mem.h"
+#include "batch.h"
+#include "codec.h"
+#include "pool.h"
+#include "trace.h"
+
+/*
+ * struct batch_closure is shared by all the workers of a batch. Workers
+ * claim the next file by atomically incrementing next, and count files
+ * that could not be processed in failures.
+ */
+typedef struct batch_closure {
+        char **files;
+        int nfiles;
+        const char *outdir;
+        bool compress;
+        const struct codec_options *options;
+        int next;
+        int failures;
+} batch_closure;
+
+/* size of the stdio buffer each worker reuses for its output files */
+static const long OUTPUT_BUFFER_SIZE = 1 << 20;
+
+/* helper functions */
+static void *batch_worker(void *cl);
+static bool process_file(batch_closure *batch, int index, char *buffer);
+static bool run_codec(batch_closure *batch, const char *file, FILE *input,
+                      FILE *output);
+static char *make_output_path(const char *outdir, const char *file,
+                              bool compress);
+static char *make_temporary_path(const char *path, int index);
+
+
+/********** run_batch ********
+ *
+ * Purpose: Compresses or decompresses a list of files, writing one output
+ *          file per input into outdir
+ *
+ * Parameters:
+ *      - files: the names of the files to process
+ *      - nfiles: the number of files
+ *      - outdir: the directory the output files are written to
+ *      - compress: true to compress the files, false to decompress them
+ *      - options: how compressed files are written
+ *      - nthreads: the number of worker threads, or 0 or less to use one
+ *                  per online processor
+ *
+ * Return: the number of files that could not be processed
+ *
+ * Expects:
+ *      - outdir exists and is writable
+ *      - the inputs are PPM images when compressing and compressed images
+ *        when decompressing
+ *
+ * CRE: files is null, outdir is null, options is null, nfiles is 
+ *      negative, or a thread can't be created
+ *
+ * Notes:
+ *      - An output is named after its input with the extension replaced by
+ *        ".c40" (compressing) or ".ppm" (decompressing), so inputs with the
+ *        same name in different directories overwrite each other
+ *      - A file that can't be opened or isn't a valid image is reported
+ *        on stderr, counted, and skipped; no output is left for it, and
+ *        an existing output of the same name is untouched
+ */
+int run_batch(char **files, int nfiles, const char *outdir, bool compress,
+              const struct codec_options *options, int nthreads)
+{
+        assert(files != NULL);
+        assert(outdir != NULL);
+        assert(options != NULL);
+        assert(nfiles >= 0);
+
+        batch_closure batch = { files, nfiles, outdir, compress, options, 
+                                0, 0 };
+
+        /* one worker per processor, but never more workers than files */
+        if (nthreads <= 0) {
+                nthreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+        }
+        if (nthreads > nfiles) {
+                nthreads = nfiles;
+        }
+        if (nthreads <= 1) {
+                batch_worker(&batch);
+                return batch.failures;
+        }
+
+        pthread_t *threads = ALLOC(nthreads * (long)sizeof(pthread_t));
+        assert(threads != NULL);
+        for (int i = 0; i < nthreads; i++) {
+                int rc = pthread_create(&threads[i], NULL, batch_worker,
+                                        &batch);
+                assert(rc == 0);
+        }
+        for (int i = 0; i < nthreads; i++) {
+                pthread_join(threads[i], NULL);
+        }
+        FREE(threads);
+
+        return batch.failures;
+}
+
+/********** read_manifest ********
+ *
+ * Purpose: Reads a list of file names, one per line
+ *
+ * Parameters:
+ *      - input: the stream to read the names from (stdin for 40image)
+ *      - nfiles: where to store the number of names read
+ *
+ * Return: a newly allocated array of newly allocated names
+ *
+ * Expects: none
+ *
+ * CRE: input is null, nfiles is null, or memory can't be allocated
+ *
+ * Notes:
+ *      - Blank lines are skipped and trailing carriage returns removed
+ *      - The caller frees the array with free_manifest()
+ */
+char **read_manifest(FILE *input, int *nfiles)
+{
+        assert(input != NULL);
+        assert(nfiles != NULL);
+
+        int capacity = 16;
+        int count = 0;
+        char **files = ALLOC(capacity * (long)sizeof(char *));
+
+        char *line = NULL;
+        size_t line_size = 0;
+        ssize_t length;
+        while ((length = getline(&line, &line_size, input)) != -1) {
+                /* strip the line ending */
+                while (length > 0 && (line[length - 1] == '\n' ||
+                                      line[length - 1] == '\r')) {
+                        line[--length] = '\0';
+                }
+                if (length == 0) {
+                        continue;
+                }
+
+                if (count == capacity) {
+                        capacity *= 2;
+                        RESIZE(files, capacity * (long)sizeof(char *));
+                }
+                files[count] = ALLOC(length + 1);
+                memcpy(files[count], line, length + 1);
+                count++;
+        }
+        free(line);
+
+        *nfiles = count;
+        return files;
+}
+
+/********** free_manifest ********
+ *
+ * Purpose: Frees a list of file names made by read_manifest()
+ *
+ * Parameters:
+ *      - files: a pointer to the array of names
+ *      - nfiles: the number of names in the array
+ *
+ * Return: none
+ *
+ * Expects: none
+ *
+ * CRE: files is null, or *files is null
+ */
+void free_manifest(char ***files, int nfiles)
+{
+        assert(files != NULL);
+        assert(*files != NULL);
+
+        for (int i = 0; i < nfiles; i++) {
+                FREE((*files)[i]);
+        }
+        FREE(*files);
+}
+
+
+/**************************/
+/*    Helper functions    */
+/**************************/
+
+
+/********** batch_worker ********
+ *
+ * Purpose: Thread body for batch mode: processes files until none are left
+ *
+ * Parameters:
+ *      - cl: the batch_closure shared by every worker
+ *
+ * Return: NULL
+ *
+ * Expects: none
+ *
+ * CRE: cl is null, or memory can't be allocated
+ *
+ * Notes:
+ *      - The worker's pool and output buffer are made once and reused for
+ *        every file it processes
+ */
+static void *batch_worker(void *cl)
+{
+        batch_closure *batch = cl;
+        assert(batch != NULL);
+
+        /* this worker's codec buffers and output buffer, kept warm */
+        Pool_T pool = Pool_new(0);
+        Pool_use(pool);
+        Trace_thread_name("batch worker");
+        char *buffer = ALLOC(OUTPUT_BUFFER_SIZE);
+        assert(buffer != NULL);
+
+        int index;
+        while ((index = __sync_fetch_and_add(&batch->next, 1)) <
+               batch->nfiles) {
+                Trace_begin("file", "batch");
+                if (!process_file(batch, index, buffer)) {
+                        __sync_fetch_and_add(&batch->failures, 1);
+                }
+                Trace_end("file", "batch");
+        }
+
+        Pool_use(NULL);
+        Pool_free(&pool);
+        FREE(buffer);
+        return NULL;
+}
+
+/********** process_file ********
+ *
+ * Purpose: Compresses or decompresses a single file of a batch
+ *
+ * Parameters:
+ *      - batch: the batch the file belongs to
+ *      - index: the file's index in the batch's list
+ *      - buffer: an OUTPUT_BUFFER_SIZE byte buffer for the output stream
+ *
+ * Return: true if the output was written, false otherwise
+ *
+ * Expects: index is less than the batch's number of files
+ *
+ * CRE: batch or buffer is null
+ *
+ * Notes:
+ *      - Problems opening, reading, or writing files are reported on
+ *        stderr
+ *      - The output goes to a temporary file beside it (see
+ *        make_temporary_path()), renamed over the real name on success
+ *        and removed on failure
+ */
+static bool process_file(batch_closure *batch, int index, char *buffer)
+{
+        assert(batch != NULL);
+        assert(buffer != NULL);
+        const char *file = batch->files[index];
+
+        Trace_begin("open files", "io");
+        FILE *input = fopen(file, "rb");
+        if (input == NULL) {
+                Trace_end("open files", "io");
+                fprintf(stderr, "40image: cannot open '%s'\n", file);
+                return false;
+        }
+
+        char *path = make_output_path(batch->outdir, file, batch->compress);
+        char *temporary = make_temporary_path(path, index);
+        FILE *output = fopen(temporary, "wb");
+        Trace_end("open files", "io");
+        if (output == NULL) {
+                fprintf(stderr, "40image: cannot create '%s'\n", temporary);
+                fclose(input);
+                FREE(temporary);
+                FREE(path);
+                return false;
+        }
+        setvbuf(output, buffer, _IOFBF, OUTPUT_BUFFER_SIZE);
+
+        bool ok = run_codec(batch, file, input, output);
+
+        Trace_begin("close files", "io");
+        if (ferror(output) || fclose(output) != 0) {
+                if (ok) {
+                        fprintf(stderr, "40image: error writing '%s'\n",
+                                path);
+                }
+                ok = false;
+        }
+        fclose(input);
+        if (ok && rename(temporary, path) != 0) {
+                fprintf(stderr, "40image: cannot create '%s'\n", path);
+                ok = false;
+        }
+        if (!ok) {
+                remove(temporary);
+        }
+        Trace_end("close files", "io");
+        FREE(temporary);
+        FREE(path);
+
+        return ok;
+}
+
+/********** run_codec ********
+ *
+ * Purpose: Runs the batch's codec on one file, catching any failure
+ *
+ * Parameters:
+ *      - batch: the batch the file belongs to
+ *      - file: the name of the input file, for messages
+ *      - input: the open input file
+ *      - output: the open output file
+ *
+ * Return: true if the codec finished, false if it raised an exception
+ *
+ * Expects: none
+ *
+ * CRE: batch, file, input, or output is null
+ *
+ * Notes:
+ *      - A malformed image fails an assertion or raises Pnm_Badformat 
+ *        (see read_checked_ppm()); the exception's reason is reported on
+ *        stderr
+ *      - CII's exception stack is per thread, so workers can each have
+ *        a handler in place at once
+ */
+static bool run_codec(batch_closure *batch, const char *file, FILE *input,
+                      FILE *output)
+{
+        assert(batch != NULL);
+        assert(file != NULL);
+        assert(input != NULL);
+        assert(output != NULL);
+
+        const char *volatile failure = NULL;
+        TRY
+                if (batch->compress) {
+                        compress40_with(input, output, batch->options);
+                } else {
+                        decompress40_stream(input, output);
+                }
+        ELSE
+                failure = Except_frame.exception->reason;
+        END_TRY;
+
+        if (failure != NULL) {
+                fprintf(stderr, "40image: cannot %s '%s': %s\n",
+                        batch->compress ? "compress" : "decompress", file,
+                        failure);
+                return false;
+        }
+        return true;
+}
+
+/********** make_output_path ********
+ *
+ * Purpose: Builds the name of the output file for an input file
+ *
+ * Parameters:
+ *      - outdir: the directory outputs are written to
+ *      - file: the name of the input file
+ *      - compress: true if the input is being compressed
+ *
+ * Return: a newly allocated path: outdir, then the input's name without
+ *         its directory or extension, then ".c40" or ".ppm"
+ *
+ * Expects: none
+ *
+ * CRE: outdir is null, file is null, or memory can't be allocated
+ *
+ * Notes:
+ *      - The caller frees the path with FREE()
+ */
+static char *make_output_path(const char *outdir, const char *file,
+                              bool compress)
+{
+        assert(outdir != NULL);
+        assert(file != NULL);
+
+        /* drop the directory part of the input's name */
+        const char *base = strrchr(file, '/');
+        base = (base == NULL) ? file : base + 1;
+
+        /* drop the extension (but not a leading dot) */
+        size_t base_length = strlen(base);
+        const char *dot = strrchr(base, '.');
+        if (dot != NULL && dot != base) {
+                base_length = dot - base;
+        }
+
+        const char *extension = compress ? ".c40" : ".ppm";
+        long length = strlen(outdir) + 1 + base_length + strlen(extension);
+        char *path = ALLOC(length + 1);
+        assert(path != NULL);
+        sprintf(path, "%s/%.*s%s", outdir, (int)base_length, base, extension);
+
+        return path;
+}
+
+/********** make_temporary_path ********
+ *
+ * Purpose: Builds the name an output file is written under until it is
+ *          complete
+ *
+ * Parameters:
+ *      - path: the output file's real name
+ *      - index: the input's index in the batch's list
+ *
+ * Return: a newly allocated path: path, then ".", the process id, "-",
+ *         index, and ".tmp"
+ *
+ * Expects: none
+ *
+ * CRE: path is null, or memory can't be allocated
+ *
+ * Notes:
+ *      - The name is in the same directory as path, so rename() can move
+ *        it into place, and is unique to this file of this batch even
+ *        when two inputs share an output name
+ *      - The caller frees the path with FREE()
+ */
+static char *make_temporary_path(const char *path, int index)
+{
+        assert(path != NULL);
+
+        long length = snprintf(NULL, 0, "%s.%ld-%d.tmp", path,
+                               (long)getpid(), index);
+        char *temporary = ALLOC(length + 1);
+        assert(temporary != NULL);
+        sprintf(temporary, "%s.%ld-%d.tmp", path, (long)getpid(), index);
+
+        return temporary;
+}
@@ -0,0 +1,31 @@
+/**************************************************************
+ *
+ *                     batch.h
+ *
+ *     Assignment: Arith
+ *     Authors:  Marielle Cibella (mcibel01), Erica Huang (ehuang02)
+ *     Date:     4/16/25
+ *
+ *     Summary:
+ *
+ *     This header file declares 40image's batch mode, which compresses or
+ *     decompresses many files in one process. Files are spread across a
+ *     pool of worker threads, each of which keeps its codec buffers and
+ *     output buffer warm from one file to the next.
+ *
+ *
+ **************************************************************/
+
+#ifndef BATCH
+#define BATCH
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "codec.h"
+
+int run_batch(char **files, int nfiles, const char *outdir, bool compress,
+              const struct codec_options *options, int nthreads);
+char **read_manifest(FILE *input, int *nfiles);
+void free_manifest(char ***files, int nfiles);
+
+#endif
@@ -0,0 +1,683 @@
+/**************************************************************
+ *
+ *                     bench.c
+ *
+ *     Assignment: Arith
+ *     Authors:  Marielle Cibella (mcibel01), Erica Huang (ehuang02)
+ *     Date:     4/24/25
+ *
+ *     Summary:
+ *
+ *     bench.c times each stage of the codec on its own, so a change to
+ *     one stage can be measured against the code before it. For each
+ *     image size it builds a synthetic image and every intermediate array
+ *     once, then runs each stage (Bitpack get and new, rgb_to_ypbpr(),
+ *     ypbpr_to_rgb(), make_word_array(), pack_word(), unpack_word(),
+ *     decompress_words(), print_compressed(), and
+ *     read_compressed_to_words()) a few times to warm up and then many
+ *     times more, timing each run. It prints the median and 99th
+ *     percentile cycles per pixel, the median nanoseconds per pixel, and
+ *     the GB/s of the stage's input at the median. The stages draw their
+ *     arrays from a pool (pool.h) that is reset between runs, as the
+ *     codec's do, so the times don't include malloc().
+ *
+ *     Usage: bench [-r runs] [-w warmup] [widthxheight...]
+ *
+ *
+ **************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "assert.h"
+#include "mem.h"
+#include <a2methods.h>
+#include <pnm.h>
+#include "a2pool.h"
+#include "pool.h"
+#include "bitpack.h"
+#include "ry_conversion.h"
+#include "word.h"
+#include "read_write.h"
+
+/* the sizes benchmarked when none are given */
+static const unsigned DEFAULT_SIZES[][2] = {
+        { 64, 64 }, { 256, 256 }, { 1024, 1024 }
+};
+#define NUM_DEFAULT_SIZES 3
+
+/* what a stage reads, for its GB/s */
+enum bench_input {
+        INPUT_RGB,          /* Pnm_rgb pixels */
+        INPUT_YPBPR,        /* Y_Pb_Pr pixels */
+        INPUT_WORD_STRUCTS, /* word structs, one per 2x2 block */
+        INPUT_WORDS         /* 32-bit words, packed or written out */
+};
+
+/*
+ * struct bench_image is one size of synthetic image and every array the
+ * stages read, all built once before any stage is timed. words is the
+ * packed words as a plain run, for the Bitpack stages, and out a run as
+ * long for them to write. compressed is the image as print_compressed()
+ * writes it, and scratch room for print_compressed() to write it again.
+ */
+typedef struct bench_image {
+        unsigned width, height;
+        A2Methods_T methods;
+
+        Pnm_ppm ppm;
+        A2Methods_UArray2 ypbpr_pixels;
+        A2Methods_UArray2 word_structs;
+        A2Methods_UArray2 word_bits;
+
+        uint32_t *words;
+        uint32_t *out;
+        long nwords;
+
+        char *compressed;
+        size_t compressed_size;
+        char *scratch;
+} bench_image;
+
+/* struct bench_stage is one stage: its name, what it reads, and a run */
+typedef struct bench_stage {
+        const char *name;
+        enum bench_input input;
+        void (*run)(bench_image *image);
+} bench_stage;
+
+/* keeps the Bitpack get stage's sums from being optimized away */
+static volatile uint64_t sink;
+
+/* helper functions */
+static void make_image(bench_image *image, unsigned width, unsigned height);
+static void free_image(bench_image *image);
+static void bench_stage_at(const bench_stage *stage, bench_image *image,
+                           Pool_T pool, int runs, int warmup);
+static double input_bytes(enum bench_input input, const bench_image *image);
+static int compare_doubles(const void *a, const void *b);
+static double now_ns(void);
+static uint64_t read_cycles(void);
+static void run_bitpack_get(bench_image *image);
+static void run_bitpack_new(bench_image *image);
+static void run_rgb_to_ypbpr(bench_image *image);
+static void run_ypbpr_to_rgb(bench_image *image);
+static void run_make_word_array(bench_image *image);
+static void run_pack_word(bench_image *image);
+static void run_unpack_word(bench_image *image);
+static void run_decompress_words(bench_image *image);
+static void run_print_compressed(bench_image *image);
+static void run_read_compressed(bench_image *image);
+static void usage(const char *progname);
+
+static const bench_stage STAGES[] = {
+        { "Bitpack_get", INPUT_WORDS, run_bitpack_get },
+        { "Bitpack_new", INPUT_WORDS, run_bitpack_new },
+        { "rgb_to_ypbpr", INPUT_RGB, run_rgb_to_ypbpr },
+        { "ypbpr_to_rgb", INPUT_YPBPR, run_ypbpr_to_rgb },
+        { "make_word_array", INPUT_YPBPR, run_make_word_array },
+        { "pack_word", INPUT_WORD_STRUCTS, run_pack_word },
+        { "unpack_word", INPUT_WORDS, run_unpack_word },
+        { "decompress_words", INPUT_WORD_STRUCTS, run_decompress_words },
+        { "print_compressed", INPUT_WORDS, run_print_compressed },
+        { "read_compressed_to_words", INPUT_WORDS, run_read_compressed }
+};
+#define NUM_STAGES (sizeof(STAGES) / sizeof(STAGES[0]))
+
+/********** main ********
+ *
+ * Purpose: Benchmarks every stage at each size asked for
+ *
+ * Parameters:
+ *     - argc: the number of command-line arguments
+ *     - argv: bench [-r runs] [-w warmup] [widthxheight...]
+ *
+ * Return: EXIT_SUCCESS, or EXIT_FAILURE for bad arguments
+ *
+ * Expects: none
+ *
+ * Notes:
+ *     - 21 timed runs after 3 warmup runs by default, at 64x64, 256x256,
+ *       and 1024x1024. Sizes are trimmed to even, as the codec trims
+ */
+int main(int argc, char *argv[])
+{
+        int runs = 21;
+        int warmup = 3;
+
+        int i = 1;
+        for (; i < argc && argv[i][0] == '-'; i++) {
+                if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+                        runs = atoi(argv[++i]);
+                } else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc) {
+                        warmup = atoi(argv[++i]);
+                } else {
+                        usage(argv[0]);
+                }
+        }
+        if (runs <= 0 || warmup < 0) {
+                usage(argv[0]);
+        }
+
+        int nsizes = argc - i;
+        unsigned (*sizes)[2] = malloc((nsizes + NUM_DEFAULT_SIZES) *
+                                      sizeof(*sizes));
+        assert(sizes != NULL);
+        for (int s = 0; s < nsizes; s++) {
+                if (sscanf(argv[i + s], "%ux%u", &sizes[s][0],
+                           &sizes[s][1]) != 2 || sizes[s][0] < 2 ||
+                    sizes[s][1] < 2) {
+                        usage(argv[0]);
+                }
+        }
+        if (nsizes == 0) {
+                memcpy(sizes, DEFAULT_SIZES, sizeof(DEFAULT_SIZES));
+                nsizes = NUM_DEFAULT_SIZES;
+        }
+
+        printf("%-26s %11s %11s %11s %10s %8s\n", "stage", "size",
+               "cyc/px", "p99 cyc/px", "ns/px", "GB/s");
+
+        Pool_T inputs = Pool_new(0);
+        Pool_T stages = Pool_new(0);
+        for (int s = 0; s < nsizes; s++) {
+                bench_image image;
+                Pool_use(inputs);
+                Pool_reset(inputs);
+                make_image(&image, sizes[s][0] & ~1u, sizes[s][1] & ~1u);
+
+                Pool_use(stages);
+                for (unsigned st = 0; st < NUM_STAGES; st++) {
+                        bench_stage_at(&STAGES[st], &image, stages, runs,
+                                       warmup);
+                }
+                free_image(&image);
+        }
+        Pool_use(NULL);
+        Pool_free(&inputs);
+        Pool_free(&stages);
+        free(sizes);
+
+        return EXIT_SUCCESS;
+}
+
+/**************************/
+/*    Helper functions    */
+/**************************/
+
+
+/********** make_image ********
+ *
+ * Purpose: Builds a synthetic image and every array the stages read
+ *
+ * Parameters:
+ *     - image: where to build it
+ *     - width, height: the image's size, both even
+ *
+ * Return: none
+ *
+ * Expects:
+ *     - the pool the arrays go in is the current pool
+ *
+ * CRE: image is null, or memory can't be allocated
+ *
+ * Notes:
+ *     - The image is smooth gradients with a little noise from a fixed
+ *       generator, so the quantized fields take a spread of values and
+ *       every size is the same picture
+ */
+static void make_image(bench_image *image, unsigned width, unsigned height)
+{
+        assert(image != NULL);
+
+        image->width = width;
+        image->height = height;
+        image->methods = uarray2_methods_pool;
+        A2Methods_T methods = image->methods;
+
+        NEW(image->ppm);
+        image->ppm->width = width;
+        image->ppm->height = height;
+        image->ppm->denominator = 255;
+        image->ppm->methods = methods;
+        image->ppm->pixels = methods->new(width, height,
+                                          sizeof(struct Pnm_rgb));
+        uint32_t seed = 40;
+        for (unsigned row = 0; row < height; row++) {
+                for (unsigned col = 0; col < width; col++) {
+                        seed = seed * 1664525 + 1013904223;
+                        unsigned noise = seed >> 28;
+                        Pnm_rgb rgb = methods->at(image->ppm->pixels, col,
+                                                  row);
+                        rgb->red = (col * 239 / width + noise) % 256;
+                        rgb->green = (row * 239 / height + noise) % 256;
+                        rgb->blue = ((col + row) * 119 / (width + height) +
+                                     noise * 3) % 256;
+                }
+        }
+
+        image->ypbpr_pixels = rgb_to_ypbpr(image->ppm);
+        image->word_structs = make_word_array(image->ypbpr_pixels, methods);
+        image->word_bits = pack_word(image->word_structs, methods);
+
+        image->nwords = (long)width / 2 * (height / 2);
+        image->words = ALLOC(image->nwords * sizeof(uint32_t));
+        image->out = ALLOC(image->nwords * sizeof(uint32_t));
+        for (long w = 0; w < image->nwords; w++) {
+                uint32_t *word = methods->at(image->word_bits,
+                                             w % (width / 2),
+                                             w / (width / 2));
+                image->words[w] = *word;
+        }
+
+        /* a format 2 header is well under 64 bytes */
+        size_t room = image->nwords * sizeof(uint32_t) + 64;
+        image->compressed = ALLOC(room);
+        image->scratch = ALLOC(room);
+        FILE *file = fmemopen(image->compressed, room, "wb");
+        assert(file != NULL);
+        print_compressed(image->word_bits, methods, file);
+        image->compressed_size = ftell(file);
+        fclose(file);
+}
+
+/********** free_image ********
+ *
+ * Purpose: Frees what make_image() allocated outside the pool
+ *
+ * Parameters:
+ *     - image: the image
+ *
+ * Return: none
+ *
+ * Expects: none
+ *
+ * CRE: image is null
+ */
+static void free_image(bench_image *image)
+{
+        assert(image != NULL);
+        FREE(image->ppm);
+        FREE(image->words);
+        FREE(image->out);
+        FREE(image->compressed);
+        FREE(image->scratch);
+}
+
+/********** bench_stage_at ********
+ *
+ * Purpose: Times one stage on one image and prints a line of results
+ *
+ * Parameters:
+ *     - stage: the stage
+ *     - image: the image, from make_image()
+ *     - pool: the pool the stage's arrays come from, reset before each run
+ *     - runs: the runs to time
+ *     - warmup: the runs before those, not timed
+ *
+ * Return: none
+ *
+ * Expects:
+ *     - pool is the current pool
+ *
+ * CRE: stage, image, or pool is null, or memory can't be allocated
+ *
+ * Notes:
+ *     - Cycles come from the time-stamp counter on x86, which counts at a
+ *       fixed rate rather than the core's clock; elsewhere they are
+ *       printed as 0. The 99th percentile is of the sorted runs, so with
+ *       fewer than 100 runs it is the slowest
+ */
+static void bench_stage_at(const bench_stage *stage, bench_image *image,
+                           Pool_T pool, int runs, int warmup)
+{
+        assert(stage != NULL && image != NULL && pool != NULL);
+
+        double *ns = ALLOC(runs * sizeof(double));
+        double *cycles = ALLOC(runs * sizeof(double));
+        for (int r = -warmup; r < runs; r++) {
+                Pool_reset(pool);
+                double start = now_ns();
+                uint64_t first = read_cycles();
+                stage->run(image);
+                uint64_t last = read_cycles();
+                double end = now_ns();
+                if (r >= 0) {
+                        ns[r] = end - start;
+                        cycles[r] = last - first;
+                }
+        }
+        qsort(ns, runs, sizeof(double), compare_doubles);
+        qsort(cycles, runs, sizeof(double), compare_doubles);
+
+        int p99 = (runs * 99 + 99) / 100 - 1;
+        double pixels = (double)image->width * image->height;
+        char size[32];
+        snprintf(size, sizeof(size), "%ux%u", image->width, image->height);
+        printf("%-26s %11s %11.2f %11.2f %10.2f %8.3f\n", stage->name, size,
+               cycles[runs / 2] / pixels, cycles[p99] / pixels,
+               ns[runs / 2] / pixels,
+               input_bytes(stage->input, image) / ns[runs / 2]);
+
+        FREE(ns);
+        FREE(cycles);
+}
+
+/********** input_bytes ********
+ *
+ * Purpose: Gives the bytes of a stage's input
+ *
+ * Parameters:
+ *     - input: what the stage reads
+ *     - image: the image
+ *
+ * Return: the bytes, so bytes / ns is GB/s
+ *
+ * Expects: none
+ */
+static double input_bytes(enum bench_input input, const bench_image *image)
+{
+        double pixels = (double)image->width * image->height;
+        switch (input) {
+        case INPUT_RGB:
+                return pixels * sizeof(struct Pnm_rgb);
+        case INPUT_YPBPR:
+                return pixels * Y_Pb_Pr_size();
+        case INPUT_WORD_STRUCTS:
+                return image->nwords * (double)word_size();
+        case INPUT_WORDS:
+                return image->nwords * (double)sizeof(uint32_t);
+        }
+        return 0;
+}
+
+/********** compare_doubles ********
+ *
+ * Purpose: Orders doubles for qsort()
+ *
+ * Parameters:
+ *     - a, b: the doubles
+ *
+ * Return: negative, zero, or positive as *a is less than, equal to, or
+ *         more than *b
+ *
+ * Expects: none
+ */
+static int compare_doubles(const void *a, const void *b)
+{
+        double x = *(const double *)a;
+        double y = *(const double *)b;
+        return (x > y) - (x < y);
+}
+
+/********** now_ns ********
+ *
+ * Purpose: Reads the monotonic clock
+ *
+ * Parameters: none
+ *
+ * Return: the time in nanoseconds
+ *
+ * Expects: none
+ */
+static double now_ns(void)
+{
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        return now.tv_sec * 1e9 + now.tv_nsec;
+}
+
+/********** read_cycles ********
+ *
+ * Purpose: Reads the time-stamp counter
+ *
+ * Parameters: none
+ *
+ * Return: the counter on x86, or 0 elsewhere
+ *
+ * Expects: none
+ */
+static uint64_t read_cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+        return __builtin_ia32_rdtsc();
+#else
+        return 0;
+#endif
+}
+
+/********** run_bitpack_get ********
+ *
+ * Purpose: Reads all six fields of every word with Bitpack_getu() and
+ *          Bitpack_gets(), as unpack_single_word() does
+ *
+ * Parameters:
+ *     - image: the image
+ *
+ * Return: none
+ *
+ * Expects: none
+ */
+static void run_bitpack_get(bench_image *image)
+{
+        unsigned lsb[WORD_FIELDS];
+        const unsigned *width = default_layout.width;
+        layout_lsbs(&default_layout, lsb);
+
+        uint64_t sum = 0;
+        for (long w = 0; w < image->nwords; w++) {
+                uint64_t word = image->words[w];
+                sum += Bitpack_getu(word, width[0], lsb[0]);
+                sum += Bitpack_gets(word, width[1], lsb[1]);
+                sum += Bitpack_gets(word, width[2], lsb[2]);
+                sum += Bitpack_gets(word, width[3], lsb[3]);
+                sum += Bitpack_getu(word, width[4], lsb[4]);
+                sum += Bitpack_getu(word, width[5], lsb[5]);
+        }
+        sink = sum;
+}
+
+/********** run_bitpack_new ********
+ *
+ * Purpose: Builds every word again from its six fields with Bitpack_newu()
+ *          and Bitpack_news(), as pack_single_word() does
+ *
+ * Parameters:
+ *     - image: the image
+ *
+ * Return: none
+ *
+ * Expects: none
+ *
+ * Notes:
+ *     - The fields are cut from the packed words with shifts, so the
+ *       time is all Bitpack_newu() and Bitpack_news()
+ */
+static void run_bitpack_new(bench_image *image)
+{
+        unsigned lsb[WORD_FIELDS];
+        const unsigned *width = default_layout.width;
+        layout_lsbs(&default_layout, lsb);
+
+        for (long w = 0; w < image->nwords; w++) {
+                uint32_t packed = image->words[w];
+                int64_t field[WORD_FIELDS];
+                for (int f = 0; f < WORD_FIELDS; f++) {
+                        field[f] = (packed >> lsb[f]) &
+                                   ((1u << width[f]) - 1);
+                }
+                for (int f = 1; f <= 3; f++) {
+                        field[f] -= (field[f] >> (width[f] - 1)) << width[f];
+                }
+
+                uint64_t word = 0;
+                word = Bitpack_newu(word, width[0], lsb[0], field[0]);
+                word = Bitpack_news(word, width[1], lsb[1], field[1]);
+                word = Bitpack_news(word, width[2], lsb[2], field[2]);
+                word = Bitpack_news(word, width[3], lsb[3], field[3]);
+                word = Bitpack_newu(word, width[4], lsb[4], field[4]);
+                word = Bitpack_newu(word, width[5], lsb[5], field[5]);
+                image->out[w] = word;
+        }
+}
+
+/********** run_rgb_to_ypbpr ********
+ *
+ * Purpose: Runs rgb_to_ypbpr() on the image
+ *
+ * Parameters:
+ *     - image: the image
+ *
+ * Return: none
+ *
+ * Expects: none
+ */
+static void run_rgb_to_ypbpr(bench_image *image)
+{
+        rgb_to_ypbpr(image->ppm);
+}
+
+/********** run_ypbpr_to_rgb ********
+ *
+ * Purpose: Runs ypbpr_to_rgb() on the image's Y/Pb/Pr pixels
+ *
+ * Parameters:
+ *     - image: the image
+ *
+ * Return: none
+ *
+ * Expects: none
+ */
+static void run_ypbpr_to_rgb(bench_image *image)
+{
+        ypbpr_to_rgb(image->ypbpr_pixels, image->methods, 255);
+}
+
+/********** run_make_word_array ********
+ *
+ * Purpose: Runs make_word_array() on the image's Y/Pb/Pr pixels
+ *
+ * Parameters:
+ *     - image: the image
+ *
+ * Return: none
+ *
+ * Expects: none
+ */
+static void run_make_word_array(bench_image *image)
+{
+        make_word_array(image->ypbpr_pixels, image->methods);
+}
+
+/********** run_pack_word ********
+ *
+ * Purpose: Runs pack_word() on the image's word structs
+ *
+ * Parameters:
+ *     - image: the image
+ *
+ * Return: none
+ *
+ * Expects: none
+ */
+static void run_pack_word(bench_image *image)
+{
+        pack_word(image->word_structs, image->methods);
+}
+
+/********** run_unpack_word ********
+ *
+ * Purpose: Runs unpack_word() on the image's packed words
+ *
+ * Parameters:
+ *     - image: the image
+ *
+ * Return: none
+ *
+ * Expects: none
+ */
+static void run_unpack_word(bench_image *image)
+{
+        unpack_word(image->word_bits, image->methods);
+}
+
+/********** run_decompress_words ********
+ *
+ * Purpose: Runs decompress_words() on the image's word structs
+ *
+ * Parameters:
+ *     - image: the image
+ *
+ * Return: none
+ *
+ * Expects: none
+ */
+static void run_decompress_words(bench_image *image)
+{
+        decompress_words(image->word_structs, image->methods);
+}
+
+/********** run_print_compressed ********
+ *
+ * Purpose: Runs print_compressed() on the image's packed words, into
+ *          memory
+ *
+ * Parameters:
+ *     - image: the image
+ *
+ * Return: none
+ *
+ * Expects: none
+ *
+ * CRE: the memory stream can't be opened
+ */
+static void run_print_compressed(bench_image *image)
+{
+        FILE *file = fmemopen(image->scratch, image->compressed_size, "wb");
+        assert(file != NULL);
+        print_compressed(image->word_bits, image->methods, file);
+        fclose(file);
+}
+
+/********** run_read_compressed ********
+ *
+ * Purpose: Runs read_compressed_to_words() on the compressed image, from
+ *          memory
+ *
+ * Parameters:
+ *     - image: the image
+ *
+ * Return: none
+ *
+ * Expects: none
+ *
+ * CRE: the memory stream can't be opened
+ */
+static void run_read_compressed(bench_image *image)
+{
+        FILE *file = fmemopen(image->compressed, image->compressed_size,
+                              "rb");
+        assert(file != NULL);
+        read_compressed_to_words(file, image->methods);
+        fclose(file);
+}
+
+/********** usage ********
+ *
+ * Purpose: Prints how to run bench and exits
+ *
+ * Parameters:
+ *     - progname: the name bench was run as
+ *
+ * Return: none (exits with EXIT_FAILURE)
+ *
+ * Expects: none
+ */
+static void usage(const char *progname)
+{
+        fprintf(stderr, "Usage: %s [-r runs] [-w warmup] "
+                "[widthxheight...]\n", progname);
+        exit(EXIT_FAILURE);
+}
@@ -0,0 +1,720 @@
+/**************************************************************
+ *
+ *                     block.c
+ *
+ *     Assignment: Arith
+ *     Authors:  Marielle Cibella (mcibel01), Erica Huang (ehuang02)
+ *     Date:     4/22/25
+ *
+ *     Summary:
+ *
+ *     block.c implements the 4x4 and 8x8 block transforms declared in
+ *     block.h. Each block's Y values go through an orthonormal
+ *     two-dimensional DCT, and its Pb and Pr values are averaged, as the
+ *     2x2 transform does. The DC coefficient is kept as the block's mean
+ *     Y in 9 bits, like a. The other coefficients are visited in zigzag
+ *     order (lowest frequencies first), each quantized by its own step
+ *     and given its own number of bits; the highest frequencies get none
+ *     and are dropped. A 4x4 block takes 64 bits (4 bits a pixel) and an
+ *     8x8 block 128 bits (2 bits a pixel), against 8 bits a pixel for 2x2
+ *     blocks.
+ *
+ *     The codeword of a block holds, most significant bit first: the
+ *     mean Y (9 bits), Pb_avg and Pr_avg (4 bits each, as in word.c),
+ *     then the kept coefficients in zigzag order as signed integers.
+ *
+ *     The transforms are written with GCC vector extensions: a block is
+ *     rows of LANES-wide float vectors, and each pass of the DCT adds
+ *     whole rows scaled by one basis value, so the compiler can use SIMD
+ *     registers for both the forward and inverse transforms. The two
+ *     matrix multiplies are optimized whatever the build's -O level
+ *     (CPU_OPTIMIZE in cpu.h) but not compiled per instruction set:
+ *     their vectors are 128 bits wide, so higher levels ran no faster.
+ *
+ *
+ **************************************************************/
+
+#include <math.h>
+#include <string.h>
+#include "assert.h"
+#include "arith40.h"
+#include "block.h"
+#include "cpu.h"
+
+/* the largest block, and the floats in one vector */
+#define MAX_BLOCK 8
+#define LANES 4
+
+/* bits of the mean Y and of each chroma average */
+#define MEAN_WIDTH 9
+#define CHROMA_WIDTH 4
+
+/* largest quantized mean Y (as for a in word.c) */
+#define MEAN_MAX 511
+
+typedef float lanes __attribute__((vector_size(LANES * sizeof(float))));
+
+/*
+ * struct block is an n x n block of values: row i holds values
+ * i * n .. i * n + n - 1 in its first n / LANES vectors
+ */
+typedef struct block {
+        lanes row[MAX_BLOCK][MAX_BLOCK / LANES];
+} block;
+
+/*
+ * bits given to each coefficient after the DC one, in zigzag order;
+ * coefficients past the end of the table are dropped. With the mean and
+ * chroma they fill 64 bits for 4x4 blocks and 128 bits for 8x8 blocks
+ */
+static const unsigned coefficient_width_4[] = {
+        6, 6, 5, 5, 5, 4, 4, 4, 4, 4
+};
+static const unsigned coefficient_width_8[] = {
+        7, 7, 6, 6, 6, 5, 5, 5, 5, 5,
+        4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+        2, 2, 2, 2, 2, 2, 2
+};
+
+/*
+ * quantization step of the lowest-frequency coefficients; a coefficient
+ * at row u and column v of the transform gets
+ * STEP_BASE * (1 + (u + v) / 2), since the eye notices errors in fine
+ * detail less
+ */
+static const float STEP_BASE = 0.02;
+
+/*
+ * struct block_code is everything needed to code blocks of one size: the
+ * DCT basis (basis[u][x] is frequency u at position x) and its transpose,
+ * both as floats and as rows of vectors, and, for each coefficient in
+ * zigzag order, its place in the block, its bits, and its step
+ */
+typedef struct block_code {
+        unsigned size;
+        unsigned words;
+        float basis[MAX_BLOCK][MAX_BLOCK];
+        float basis_t[MAX_BLOCK][MAX_BLOCK];
+        block basis_rows;
+        block basis_t_rows;
+        unsigned ncoefficients;
+        unsigned place[MAX_BLOCK * MAX_BLOCK];
+        unsigned width[MAX_BLOCK * MAX_BLOCK];
+        float step[MAX_BLOCK * MAX_BLOCK];
+} block_code;
+
+/* helper functions */
+static void make_block_code(unsigned block_size, block_code *code);
+static void zigzag(unsigned n, unsigned *place);
+static void multiply_left(const float left[][MAX_BLOCK], const block *in,
+                          block *out, unsigned n);
+static void multiply_right(const block *in, const block *right, block *out,
+                           unsigned n);
+static void encode_block(const block_code *code,
+                         A2Methods_UArray2 ypbpr_pixels, A2Methods_T methods,
+                         unsigned col, unsigned row, uint32_t *codeword);
+static void decode_block(const block_code *code, const uint32_t *codeword,
+                         A2Methods_UArray2 ypbpr_pixels, A2Methods_T methods,
+                         unsigned col, unsigned row);
+static void put_field(uint32_t *codeword, unsigned *pos, unsigned width,
+                      uint32_t value);
+static uint32_t get_field(const uint32_t *codeword, unsigned *pos,
+                          unsigned width);
+static inline float value_at(const block *b, unsigned n, unsigned i);
+static inline void set_value(block *b, unsigned n, unsigned i, float value);
+
+
+/********** block_words ********
+ *
+ * Purpose: Gives the number of 32-bit words one block's codeword takes
+ *
+ * Parameters:
+ *      - block_size: the width and height of a block, in pixels
+ *
+ * Return: 1 for 2x2 blocks (the packed words of word.c), 2 for 4x4
+ *         blocks, and 4 for 8x8 blocks
+ *
+ * Expects: none
+ *
+ * CRE: block_size is not 2, 4, or 8
+ */
+unsigned block_words(unsigned block_size)
+{
+        assert(block_size == 2 || block_size == 4 || block_size == 8);
+        return block_size / 2;
+}
+
+/********** blocks_to_words ********
+ *
+ * Purpose: Transforms and packs every block of an image of Y/Pb/Pr pixels
+ *
+ * Parameters:
+ *      - ypbpr_pixels: the pixels
+ *      - methods: the methods for every 2D array
+ *      - block_size: the width and height of a block, 4 or 8
+ *
+ * Return: a new 2D array of 32-bit words: a row of words for each row of
+ *         blocks, with block_words(block_size) words for each block
+ *
+ * Expects:
+ *      - the image's width and height are multiples of block_size
+ *
+ * CRE: ypbpr_pixels or methods is null, block_size is not 4 or 8, the
+ *      image isn't a whole number of blocks, or the words can't be
+ *      allocated
+ *
+ * Notes:
+ *      - Information is lost here to quantization and to the dropped
+ *        coefficients
+ */
+A2Methods_UArray2 blocks_to_words(A2Methods_UArray2 ypbpr_pixels,
+                                  A2Methods_T methods, unsigned block_size)
+{
+        assert(ypbpr_pixels != NULL);
+        assert(methods != NULL);
+        assert(block_size == 4 || block_size == 8);
+
+        unsigned width = methods->width(ypbpr_pixels);
+        unsigned height = methods->height(ypbpr_pixels);
+        assert(width % block_size == 0 && height % block_size == 0);
+
+        block_code code;
+        make_block_code(block_size, &code);
+
+        unsigned blocks_wide = width / block_size;
+        unsigned blocks_high = height / block_size;
+        A2Methods_UArray2 word_bits = methods->new(blocks_wide * code.words,
+                                                   blocks_high,
+                                                   sizeof(uint32_t));
+        assert(word_bits != NULL);
+
+        for (unsigned by = 0; by < blocks_high; by++) {
+                for (unsigned bx = 0; bx < blocks_wide; bx++) {
+                        uint32_t codeword[MAX_BLOCK * MAX_BLOCK / 16];
+                        encode_block(&code, ypbpr_pixels, methods,
+                                     bx * block_size, by * block_size,
+                                     codeword);
+                        for (unsigned k = 0; k < code.words; k++) {
+                                uint32_t *word = methods->at(word_bits,
+                                        bx * code.words + k, by);
+                                *word = codeword[k];
+                        }
+                }
+        }
+        return word_bits;
+}
+
+/********** words_to_blocks ********
+ *
+ * Purpose: Unpacks and inverse transforms every block of a word array
+ *          written by blocks_to_words()
+ *
+ * Parameters:
+ *      - word_bits: the words
+ *      - methods: the methods for every 2D array
+ *      - block_size: the width and height of a block, 4 or 8
+ *
+ * Return: a new 2D array of Y/Pb/Pr pixels, block_size pixels for every
+ *         block in each direction
+ *
+ * Expects: none
+ *
+ * CRE: word_bits or methods is null, block_size is not 4 or 8, a row
+ *      isn't a whole number of blocks, or the pixels can't be allocated
+ */
+A2Methods_UArray2 words_to_blocks(A2Methods_UArray2 word_bits,
+                                  A2Methods_T methods, unsigned block_size)
+{
+        assert(word_bits != NULL);
+        assert(methods != NULL);
+        assert(block_size == 4 || block_size == 8);
+
+        block_code code;
+        make_block_code(block_size, &code);
+
+        unsigned width = methods->width(word_bits);
+        unsigned blocks_high = methods->height(word_bits);
+        assert(width % code.words == 0);
+        unsigned blocks_wide = width / code.words;
+
+        A2Methods_UArray2 ypbpr_pixels = methods->new(
+                blocks_wide * block_size, blocks_high * block_size,
+                Y_Pb_Pr_size());
+        assert(ypbpr_pixels != NULL);
+
+        for (unsigned by = 0; by < blocks_high; by++) {
+                for (unsigned bx = 0; bx < blocks_wide; bx++) {
+                        uint32_t codeword[MAX_BLOCK * MAX_BLOCK / 16];
+                        for (unsigned k = 0; k < code.words; k++) {
+                                uint32_t *word = methods->at(word_bits,
+                                        bx * code.words + k, by);
+                                codeword[k] = *word;
+                        }
+                        decode_block(&code, codeword, ypbpr_pixels, methods,
+                                     bx * block_size, by * block_size);
+                }
+        }
+        return ypbpr_pixels;
+}
+
+/********** preview_blocks ********
+ *
+ * Purpose: Makes a preview with one Y/Pb/Pr pixel per block, from only
+ *          each block's mean Y and chroma averages
+ *
+ * Parameters:
+ *      - word_bits: the words, as blocks_to_words() wrote them
+ *      - methods: the methods for every 2D array
+ *      - block_size: the width and height of a block, 4 or 8
+ *
+ * Return: a new 2D array of Y/Pb/Pr pixels, one per block
+ *
+ * Expects: none
+ *
+ * CRE: word_bits or methods is null, block_size is not 4 or 8, a row
+ *      isn't a whole number of blocks, or the pixels can't be allocated
+ *
+ * Notes:
+ *      - Like preview_words() for 2x2 blocks, no transform is run; the
+ *        preview is 1 / block_size of the image's width and height
+ */
+A2Methods_UArray2 preview_blocks(A2Methods_UArray2 word_bits,
+                                 A2Methods_T methods, unsigned block_size)
+{
+        assert(word_bits != NULL);
+        assert(methods != NULL);
+
+        unsigned words = block_words(block_size);
+        assert(block_size != 2);
+        unsigned width = methods->width(word_bits);
+        unsigned height = methods->height(word_bits);
+        assert(width % words == 0);
+
+        A2Methods_UArray2 ypbpr_pixels = methods->new(width / words, height,
+                                                      Y_Pb_Pr_size());
+        assert(ypbpr_pixels != NULL);
+
+        for (unsigned by = 0; by < height; by++) {
+                for (unsigned bx = 0; bx < width / words; bx++) {
+                        uint32_t *codeword = methods->at(word_bits,
+                                                         bx * words, by);
+                        unsigned pos = 0;
+                        uint32_t mean = get_field(codeword, &pos,
+                                                  MEAN_WIDTH);
+                        uint32_t pb = get_field(codeword, &pos,
+                                                CHROMA_WIDTH);
+                        uint32_t pr = get_field(codeword, &pos,
+                                                CHROMA_WIDTH);
+
+                        Y_Pb_Pr ypbpr = methods->at(ypbpr_pixels, bx, by);
+                        setY(ypbpr, (float)mean / MEAN_MAX);
+                        setPb(ypbpr, Arith40_chroma_of_index(pb));
+                        setPr(ypbpr, Arith40_chroma_of_index(pr));
+                }
+        }
+        return ypbpr_pixels;
+}
+
+
+/**************************/
+/*    Helper functions    */
+/**************************/
+
+
+/********** make_block_code ********
+ *
+ * Purpose: Fills in a struct block_code for one block size
+ *
+ * Parameters:
+ *      - block_size: the width and height of a block, 4 or 8
+ *      - code: the struct to fill in
+ *
+ * Return: none
+ *
+ * Expects: none
+ *
+ * CRE: code is null, or the bits don't fill the codeword exactly
+ *
+ * Notes:
+ *      - Built once for each image rather than kept in a static table, so
+ *        worker threads (see batch.h) never race to build it
+ */
+static void make_block_code(unsigned block_size, block_code *code)
+{
+        assert(code != NULL);
+        unsigned n = block_size;
+        memset(code, 0, sizeof(*code));
+        code->size = n;
+        code->words = block_words(n);
+
+        /* the orthonormal DCT-II basis */
+        for (unsigned u = 0; u < n; u++) {
+                float scale = u == 0 ? sqrtf(1.0 / n) : sqrtf(2.0 / n);
+                for (unsigned x = 0; x < n; x++) {
+                        float value = scale * cosf((2 * x + 1) * u * M_PI /
+                                                   (2 * n));
+                        code->basis[u][x] = value;
+                        code->basis_t[x][u] = value;
+                        set_value(&code->basis_rows, n, u * n + x, value);
+                        set_value(&code->basis_t_rows, n, x * n + u, value);
+                }
+        }
+
+        /* the coefficients kept, in zigzag order */
+        const unsigned *widths = n == 4 ? coefficient_width_4 :
+                                          coefficient_width_8;
+        unsigned nwidths = n == 4 ? sizeof(coefficient_width_4) /
+                                    sizeof(unsigned) :
+                                    sizeof(coefficient_width_8) /
+                                    sizeof(unsigned);
+        zigzag(n, code->place);
+        code->ncoefficients = nwidths + 1;
+
+        unsigned bits = MEAN_WIDTH + 2 * CHROMA_WIDTH;
+        for (unsigned k = 1; k <= nwidths; k++) {
+                unsigned u = code->place[k] / n;
+                unsigned v = code->place[k] % n;
+                code->width[k] = widths[k - 1];
+                code->step[k] = STEP_BASE * (1 + (u + v) / 2.0);
+                bits += widths[k - 1];
+        }
+        assert(bits == 32 * code->words);
+}
+
+/********** zigzag ********
+ *
+ * Purpose: Lists the places of an n x n block in zigzag order, lowest
+ *          frequencies first, as JPEG does
+ *
+ * Parameters:
+ *      - n: the block's width and height
+ *      - place: where to store the places (row * n + column), n * n of
+ *               them
+ *
+ * Return: none
+ *
+ * Expects: none
+ *
+ * CRE: none
+ */
+static void zigzag(unsigned n, unsigned *place)
+{
+        unsigned k = 0;
+        for (unsigned diagonal = 0; diagonal < 2 * n - 1; diagonal++) {
+                for (unsigned i = 0; i <= diagonal; i++) {
+                        /* alternate direction on each diagonal */
+                        unsigned u = diagonal % 2 == 0 ? diagonal - i : i;
+                        unsigned v = diagonal - u;
+                        if (u < n && v < n) {
+                                place[k++] = u * n + v;
+                        }
+                }
+        }
+}
+
+/********** multiply_left ********
+ *
+ * Purpose: Multiplies a block by a matrix on its left
+ *
+ * Parameters:
+ *      - left: the matrix
+ *      - in: the block
+ *      - out: where to store left * in
+ *      - n: the block's width and height
+ *
+ * Return: none
+ *
+ * Expects: out is not in
+ *
+ * CRE: none (this is the transform's inner loop)
+ *
+ * Notes:
+ *      - Row i of the result is the rows of in, each scaled by one value
+ *        of row i of left, added up a vector at a time
+ */
+CPU_OPTIMIZE static void multiply_left(const float left[][MAX_BLOCK],
+                                       const block *in, block *out,
+                                       unsigned n)
+{
+        for (unsigned i = 0; i < n; i++) {
+                for (unsigned v = 0; v < n / LANES; v++) {
+                        lanes sum = { 0, 0, 0, 0 };
+                        for (unsigned j = 0; j < n; j++) {
+                                sum += left[i][j] * in->row[j][v];
+                        }
+                        out->row[i][v] = sum;
+                }
+        }
+}
+
+/********** multiply_right ********
+ *
+ * Purpose: Multiplies a block by a matrix on its right
+ *
+ * Parameters:
+ *      - in: the block
+ *      - right: the matrix, as a block
+ *      - out: where to store in * right
+ *      - n: the block's width and height
+ *
+ * Return: none
+ *
+ * Expects: out is not in
+ *
+ * CRE: none (this is the transform's inner loop)
+ *
+ * Notes:
+ *      - Row i of the result is the rows of right, each scaled by one
+ *        value of row i of in, added up a vector at a time
+ */
+CPU_OPTIMIZE static void multiply_right(const block *in, const block *right,
+                                        block *out, unsigned n)
+{
+        for (unsigned i = 0; i < n; i++) {
+                for (unsigned v = 0; v < n / LANES; v++) {
+                        lanes sum = { 0, 0, 0, 0 };
+                        for (unsigned j = 0; j < n; j++) {
+                                sum += in->row[i][j / LANES][j % LANES] *
+                                       right->row[j][v];
+                        }
+                        out->row[i][v] = sum;
+                }
+        }
+}
+
+/********** encode_block ********
+ *
+ * Purpose: Transforms, quantizes, and packs one block
+ *
+ * Parameters:
+ *      - code: how blocks of this size are coded
+ *      - ypbpr_pixels: the image's pixels
+ *      - methods: the methods for ypbpr_pixels
+ *      - col, row: the block's top left pixel
+ *      - codeword: where to store the block's code->words words
+ *
+ * Return: none
+ *
+ * Expects: the block is inside the image
+ *
+ * CRE: none
+ *
+ * Notes:
+ *      - The forward DCT is basis * Y * basis transposed
+ */
+static void encode_block(const block_code *code,
+                         A2Methods_UArray2 ypbpr_pixels, A2Methods_T methods,
+                         unsigned col, unsigned row, uint32_t *codeword)
+{
+        unsigned n = code->size;
+        block pixels, half, coefficients;
+        float pb_sum = 0;
+        float pr_sum = 0;
+        for (unsigned y = 0; y < n; y++) {
+                for (unsigned x = 0; x < n; x++) {
+                        Y_Pb_Pr ypbpr = methods->at(ypbpr_pixels, col + x,
+                                                    row + y);
+                        set_value(&pixels, n, y * n + x, getY(ypbpr));
+                        pb_sum += getPb(ypbpr);
+                        pr_sum += getPr(ypbpr);
+                }
+        }
+
+        multiply_left(code->basis, &pixels, &half, n);
+        multiply_right(&half, &code->basis_t_rows, &coefficients, n);
+
+        for (unsigned k = 0; k < code->words; k++) {
+                codeword[k] = 0;
+        }
+        unsigned pos = 0;
+
+        /* the DC coefficient is n times the mean */
+        long mean = lroundf(value_at(&coefficients, n, 0) / n * MEAN_MAX);
+        mean = mean < 0 ? 0 : mean > MEAN_MAX ? MEAN_MAX : mean;
+        put_field(codeword, &pos, MEAN_WIDTH, mean);
+        put_field(codeword, &pos, CHROMA_WIDTH,
+                  Arith40_index_of_chroma(pb_sum / (n * n)));
+        put_field(codeword, &pos, CHROMA_WIDTH,
+                  Arith40_index_of_chroma(pr_sum / (n * n)));
+
+        for (unsigned k = 1; k < code->ncoefficients; k++) {
+                long limit = (1L << (code->width[k] - 1)) - 1;
+                long q = lroundf(value_at(&coefficients, n, code->place[k]) /
+                                 code->step[k]);
+                q = q < -limit ? -limit : q > limit ? limit : q;
+                put_field(codeword, &pos, code->width[k], (uint32_t)q);
+        }
+}
+
+/********** decode_block ********
+ *
+ * Purpose: Unpacks and inverse transforms one block
+ *
+ * Parameters:
+ *      - code: how blocks of this size are coded
+ *      - codeword: the block's code->words words
+ *      - ypbpr_pixels: the image's pixels
+ *      - methods: the methods for ypbpr_pixels
+ *      - col, row: the block's top left pixel
+ *
+ * Return: none
+ *
+ * Expects: the block is inside the image
+ *
+ * CRE: none
+ *
+ * Notes:
+ *      - The inverse DCT is basis transposed * coefficients * basis
+ */
+static void decode_block(const block_code *code, const uint32_t *codeword,
+                         A2Methods_UArray2 ypbpr_pixels, A2Methods_T methods,
+                         unsigned col, unsigned row)
+{
+        unsigned n = code->size;
+        block coefficients, half, pixels;
+        memset(&coefficients, 0, sizeof(coefficients));
+
+        unsigned pos = 0;
+        uint32_t mean = get_field(codeword, &pos, MEAN_WIDTH);
+        float pb = Arith40_chroma_of_index(get_field(codeword, &pos,
+                                                     CHROMA_WIDTH));
+        float pr = Arith40_chroma_of_index(get_field(codeword, &pos,
+                                                     CHROMA_WIDTH));
+        set_value(&coefficients, n, 0, (float)mean / MEAN_MAX * n);
+
+        for (unsigned k = 1; k < code->ncoefficients; k++) {
+                unsigned width = code->width[k];
+                int32_t q = get_field(codeword, &pos, width);
+                if (q >= 1 << (width - 1)) {
+                        q -= 1 << width;
+                }
+                set_value(&coefficients, n, code->place[k],
+                          q * code->step[k]);
+        }
+
+        multiply_left(code->basis_t, &coefficients, &half, n);
+        multiply_right(&half, &code->basis_rows, &pixels, n);
+
+        /* every pixel shares the block's chroma, so only Y is converted */
+        Y_Pb_Pr first = methods->at(ypbpr_pixels, col, row);
+        setPb(first, pb);
+        setPr(first, pr);
+        int size = Y_Pb_Pr_size();
+        for (unsigned y = 0; y < n; y++) {
+                for (unsigned x = 0; x < n; x++) {
+                        Y_Pb_Pr ypbpr = methods->at(ypbpr_pixels, col + x,
+                                                    row + y);
+                        if (ypbpr != first) {
+                                memcpy(ypbpr, first, size);
+                        }
+                        setY(ypbpr, value_at(&pixels, n, y * n + x));
+                }
+        }
+}
+
+/********** put_field ********
+ *
+ * Purpose: Appends a field to a codeword, most significant bit first
+ *
+ * Parameters:
+ *      - codeword: the codeword's words, zeroed before the first field
+ *      - pos: the bits already used; advanced past the field
+ *      - width: the field's width, at most 31 bits
+ *      - value: the field (only its low width bits are used)
+ *
+ * Return: none
+ *
+ * Expects: the field fits in the codeword
+ *
+ * CRE: none
+ *
+ * Notes:
+ *      - A field may run from one word into the next
+ */
+static void put_field(uint32_t *codeword, unsigned *pos, unsigned width,
+                      uint32_t value)
+{
+        while (width > 0) {
+                unsigned room = 32 - *pos % 32;
+                unsigned take = width < room ? width : room;
+                uint32_t bits = (value >> (width - take)) &
+                                ((1u << take) - 1);
+                codeword[*pos / 32] |= bits << (room - take);
+                *pos += take;
+                width -= take;
+        }
+}
+
+/********** get_field ********
+ *
+ * Purpose: Reads the next field of a codeword
+ *
+ * Parameters:
+ *      - codeword: the codeword's words
+ *      - pos: the bits already read; advanced past the field
+ *      - width: the field's width, at most 31 bits
+ *
+ * Return: the field, unsigned
+ *
+ * Expects: the field is in the codeword
+ *
+ * CRE: none
+ */
+static uint32_t get_field(const uint32_t *codeword, unsigned *pos,
+                          unsigned width)
+{
+        uint32_t value = 0;
+        while (width > 0) {
+                unsigned room = 32 - *pos % 32;
+                unsigned take = width < room ? width : room;
+                uint32_t bits = (codeword[*pos / 32] >> (room - take)) &
+                                ((1u << take) - 1);
+                value = value << take | bits;
+                *pos += take;
+                width -= take;
+        }
+        return value;
+}
+
+/********** value_at ********
+ *
+ * Purpose: Gives one value of a block
+ *
+ * Parameters:
+ *      - b: the block
+ *      - n: the block's width and height
+ *      - i: the value's place, row * n + column
+ *
+ * Return: the value
+ *
+ * Expects: i < n * n
+ *
+ * CRE: none
+ */
+static inline float value_at(const block *b, unsigned n, unsigned i)
+{
+        unsigned column = i % n;
+        return b->row[i / n][column / LANES][column % LANES];
+}
+
+/********** set_value ********
+ *
+ * Purpose: Sets one value of a block
+ *
+ * Parameters:
+ *      - b: the block
+ *      - n: the block's width and height
+ *      - i: the value's place, row * n + column
+ *      - value: the new value
+ *
+ * Return: none
+ *
+ * Expects: i < n * n
+ *
+ * CRE: none
+ */
+static inline void set_value(block *b, unsigned n, unsigned i, float value)
+{
+        unsigned column = i % n;
+        b->row[i / n][column / LANES][column % LANES] = value;
+}
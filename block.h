@@ -0,0 +1,36 @@
+/**************************************************************
+ *
+ *                     block.h
+ *
+ *     Assignment: Arith
+ *     Authors:  Marielle Cibella (mcibel01), Erica Huang (ehuang02)
+ *     Date:     4/22/25
+ *
+ *     Summary:
+ *
+ *     This header file declares the larger block transforms: 4x4 and 8x8
+ *     blocks of pixels coded with a two-dimensional DCT instead of the
+ *     2x2 transform in word.c. Each block becomes a fixed number of
+ *     32-bit words (see block_words()), which are stored next to each
+ *     other in a row of the word array, so the rest of the compressed
+ *     format (tiles, codings, region reads) handles them like any other
+ *     words.
+ *
+ *
+ **************************************************************/
+
+#ifndef BLOCK
+#define BLOCK
+
+#include <a2methods.h>
+#include "ry_conversion.h"
+
+unsigned block_words(unsigned block_size);
+A2Methods_UArray2 blocks_to_words(A2Methods_UArray2 ypbpr_pixels,
+                                  A2Methods_T methods, unsigned block_size);
+A2Methods_UArray2 words_to_blocks(A2Methods_UArray2 word_bits,
+                                  A2Methods_T methods, unsigned block_size);
+A2Methods_UArray2 preview_blocks(A2Methods_UArray2 word_bits,
+                                 A2Methods_T methods, unsigned block_size);
+
+#endif
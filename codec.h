@@ -0,0 +1,108 @@
+/**************************************************************
+ *
+ *                     codec.h
+ *
+ *     Assignment: Arith 
+ *     Authors:  Marielle Cibella (mcibel01), Erica Huang (ehuang02)
+ *     Date:     4/16/25
+ *
+ *     Summary:
+ * 
+ *     This header file declares the stream versions of compress40() and 
+ *     decompress40() from compress40.h. They write to any open stream 
+ *     instead of standard output, which lets one process handle many 
+ *     images (see batch.h). compress40_with() takes options for the 
+ *     format it writes (see struct codec_options), and 
+ *     compress40_verify() also gives the RMSD of the result, decoded in 
+ *     memory. decompress40_region()
+ *     decodes just one rectangle of a compressed image, and 
+ *     decompress40_preview() a half-resolution preview of it. The 
+ *     decompressors accept every format the compressor can write.
+ *     compress40_pipelined() and decompress40_pipelined() give the same 
+ *     output as compress40_with() and decompress40_stream(), overlapping
+ *     reading, coding, and writing on several threads (see pipeline.h).
+ *     
+ *
+ **************************************************************/
+
+#ifndef CODEC
+#define CODEC
+
+#include <stdio.h>
+#include <stdbool.h>
+
+/* how the tiles of a tiled image are coded */
+enum codec_coding { 
+        CODING_RAW,       /* 4 bytes per word, as in format 2 */
+        CODING_HUFFMAN,   /* a canonical Huffman code per field (entropy.h) */
+        CODING_RLE        /* runs of equal words stored once (entropy.h) */
+};
+
+/* which neighbours predict a word's a, Pb_avg, and Pr_avg (see word.h) */
+enum codec_predict {
+        PREDICT_NONE,     /* the fields are stored as they are */
+        PREDICT_LEFT,     /* from the word to the left */
+        PREDICT_ABOVE,    /* from the word above */
+        PREDICT_MEDIAN    /* the median of left, above, and their gradient */
+};
+
+/*
+ * struct word_layout is how the word of a 2x2 block is laid out: the bits
+ * of each field, in order a, b, c, d, Pb_avg, Pr_avg (packed from the most
+ * significant end), and how b, c, and d are quantized: clamped to 
+ * [-bcd_max, bcd_max] and multiplied by bcd_scale. A layout of up to 32 
+ * bits is one word; up to 64 bits, two (see layout_words() in word.h)
+ */
+#define WORD_FIELDS 6
+struct word_layout {
+        unsigned width[WORD_FIELDS];
+        float bcd_max;
+        float bcd_scale;
+};
+
+/* the layout of "COMP40 Compressed image format 2" */
+#define WORD_LAYOUT_DEFAULTS { { 9, 5, 5, 5, 4, 4 }, 0.3, 50 }
+
+/*
+ * struct codec_options says how compress40_with() writes an image. 
+ * tile_size is the width and height of a tile, in 2x2 blocks, for the 
+ * tiled "COMP40 Compressed image format 3", and coding is how the tiles 
+ * are coded, after predict replaces each word's a, Pb_avg, and Pr_avg with
+ * their differences from its neighbours'. block_size is the width and 
+ * height of a transform block in pixels: 2 for the packed words of 
+ * word.h, or 4 or 8 for the larger transforms of block.h (which can't be
+ * predicted or Huffman coded, since they aren't laid out as those words
+ * are). layout is the layout of the words of 2x2 blocks; only layouts of
+ * one word can be predicted or Huffman coded. Prediction needs coding to
+ * be CODING_HUFFMAN or CODING_RLE. Format 2 is written when 
+ * tile_size is 0, coding is CODING_RAW, predict is PREDICT_NONE, 
+ * block_size is 2, and layout is the default; anything else makes one 
+ * tile of the whole image.
+ */
+struct codec_options {
+        unsigned tile_size;
+        enum codec_coding coding;
+        enum codec_predict predict;
+        unsigned block_size;
+        struct word_layout layout;
+};
+
+/* the options compress40() and compress40_stream() use */
+#define CODEC_DEFAULTS { 0, CODING_RAW, PREDICT_NONE, 2, \
+                         WORD_LAYOUT_DEFAULTS }
+
+void compress40_stream(FILE *input, FILE *output);
+void compress40_with(FILE *input, FILE *output, 
+                     const struct codec_options *options);
+void compress40_pipelined(FILE *input, FILE *output, 
+                          const struct codec_options *options, int nthreads);
+double compress40_verify(FILE *input, FILE *output, 
+                         const struct codec_options *options);
+bool codec_options_valid(const struct codec_options *options);
+void decompress40_stream(FILE *input, FILE *output);
+void decompress40_pipelined(FILE *input, FILE *output, int nthreads);
+void decompress40_region(FILE *input, FILE *output, int x, int y, 
+                         int width, int height);
+void decompress40_preview(FILE *input, FILE *output);
+
+#endif
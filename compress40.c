@@ -23,12 +23,46 @@
 #include "uarray2b.h"
 #include "uarray2.h"
 #include <string.h>
+#include <math.h>
+#include <sys/stat.h>
 #include "read_write.h"
 #include "ry_conversion.h"
 #include "word.h"
+#include "block.h"
+#include "entropy.h"
+#include "pool.h"
+#include "a2pool.h"
+#include "codec.h"
+#include "timing.h"
+#include "pipeline.h"
 
 const int DENOM = 225; 
 
+/* 
+ * Bytes of slack per pipeline array for its header and the pool's 
+ * alignment padding when reserving pool space for an image
+ */
+static const long ARRAY_OVERHEAD = 64;
+
+/* helper functions */
+static double compress_image(FILE *input, FILE *output, 
+                             const struct codec_options *options, 
+                             bool verify, int nthreads);
+static void decompress_image(FILE *input, FILE *output, int nthreads);
+static bool writes_format_2(const struct codec_options *options);
+static double pixels_rmsd(Pnm_ppm ppm, A2Methods_UArray2 pixels, 
+                          unsigned width, unsigned height, 
+                          A2Methods_T methods, unsigned denominator);
+static A2Methods_UArray2 decode_words(A2Methods_UArray2 word_bits, 
+                                      A2Methods_T methods, 
+                                      unsigned block_size,
+                                      const struct word_layout *layout,
+                                      Timing_T timing);
+static long image_pixels(const comp40_header *header);
+static long stream_remaining(FILE *stream);
+static long stream_offset(FILE *stream);
+static long bytes_between(long from, long to);
+
 /********** compress40 ********
  * 
  * Purpose: Compresses a given PPM image and writes the compressed output to 
@@ -43,7 +77,470 @@ const int DENOM = 225;
  *      - input is a valid open file pointer (not NULL)
  *      - The image follows the standard PPM format
  *
- * CRE: input is null, methods are null, ppm is null, the pixels of ppm is null,
+ * CRE: see compress40_stream()
+ */
+extern void compress40(FILE *input)
+{
+        compress40_stream(input, stdout);
+}
+
+/********** decompress40 ********
+ * 
+ * Purpose: decompresses the given compressed image and writes to 
+ *          standard output 
+ *
+ * Parameters:
+ *      input: the compressed file to decompress
+ * 
+ * Return: void
+ *
+ * Expects: 
+ *      - input is a valid, open file pointer (not NULL)
+ *      - The input file follows the "COMP40 Compressed image format 2" or
+ *        "COMP40 Compressed image format 3" format
+ *
+ * CRE: see decompress40_stream()
+ */
+extern void decompress40(FILE *input)
+{
+        decompress40_stream(input, stdout);
+}
+
+/********** compress40_stream ********
+ * 
+ * Purpose: Compresses a given PPM image and writes the compressed output to 
+ *          a stream in "COMP40 Compressed image format 2"
+ *
+ * Parameters:
+ *      - input: A file pointer to the .ppm file to be compressed
+ *      - output: the stream the compressed image is written to
+ *
+ * Return: none
+ *
+ * Expects: see compress40_with()
+ *
+ * CRE: see compress40_with()
+ */
+void compress40_stream(FILE *input, FILE *output)
+{
+        struct codec_options options = CODEC_DEFAULTS;
+        compress40_with(input, output, &options);
+}
+
+/********** compress40_with ********
+ * 
+ * Purpose: Compresses a given PPM image and writes the compressed output to 
+ *          a stream in binary format, in the format options ask for
+ *
+ * Parameters:
+ *      - input: A file pointer to the .ppm file to be compressed
+ *      - output: the stream the compressed image is written to
+ *      - options: how to write the compressed image (see codec.h)
+ *
+ * Return: none
+ *
+ * Expects: see compress_image()
+ *
+ * CRE: see compress_image()
+ */
+void compress40_with(FILE *input, FILE *output, 
+                     const struct codec_options *options)
+{
+        compress_image(input, output, options, false, 0);
+}
+
+/********** compress40_pipelined ********
+ * 
+ * Purpose: Compresses a given PPM image as compress40_with() does, reading,
+ *          encoding, and writing it a band of rows at a time on separate 
+ *          threads
+ *
+ * Parameters:
+ *      - input: A file pointer to the .ppm file to be compressed
+ *      - output: the stream the compressed image is written to
+ *      - options: how to write the compressed image (see codec.h)
+ *      - nthreads: the number of encoding threads, or 0 or less to use one 
+ *                  per online processor
+ *
+ * Return: none
+ *
+ * Expects: see compress_image()
+ *
+ * CRE: see compress_image() and pipeline_compress() (pipeline.h)
+ *
+ * Notes: 
+ *      - Only format 2 is written a band at a time; options that make the
+ *              tiled format 3 compress the whole image as 
+ *              compress40_with() does
+ *      - The output is identical to compress40_with()'s either way
+ */
+void compress40_pipelined(FILE *input, FILE *output, 
+                          const struct codec_options *options, int nthreads)
+{
+        compress_image(input, output, options, false, 
+                       nthreads > 0 ? nthreads : -1);
+}
+
+/********** compress40_verify ********
+ * 
+ * Purpose: Compresses a given PPM image as compress40_with() does, and 
+ *          measures how far the compressed image is from it
+ *
+ * Parameters:
+ *      - input: A file pointer to the .ppm file to be compressed
+ *      - output: the stream the compressed image is written to
+ *      - options: how to write the compressed image (see codec.h)
+ *
+ * Return: the RMSD between the image (trimmed to an even size for 2x2 
+ *         blocks) and what decompressing the compressed image gives, as 
+ *         ppmdiff would print it
+ *
+ * Expects: see compress_image()
+ *
+ * CRE: see compress_image()
+ *
+ * Notes: 
+ *      - The words are decoded in memory, right after they are written, 
+ *              so no decompressed PPM is written or read back. The tile
+ *              codings are lossless, so decoding the words before they 
+ *              are coded gives the same pixels as decompressing the output
+ */
+double compress40_verify(FILE *input, FILE *output, 
+                         const struct codec_options *options)
+{
+        return compress_image(input, output, options, true, 0);
+}
+
+/********** codec_options_valid ********
+ * 
+ * Purpose: Says whether compress40_with() can write an image with the 
+ *          given options
+ *
+ * Parameters:
+ *      options: the options
+ * 
+ * Return: true if the options can be written, false otherwise
+ *
+ * Expects: none
+ *
+ * CRE: options is null
+ *
+ * Notes: 
+ *      - Blocks larger than 2x2 can't be predicted or Huffman coded, or
+ *              have a layout other than the default
+ *      - A layout must pass check_layout() (word.c), a predicted one must
+ *              fit one word, and a Huffman coded one huffman_supports()
+ *              (entropy.c)
+ *      - Prediction needs Huffman or run-length coding: stored raw, its
+ *              differences take as many bits as the fields did and the 
+ *              image only gets larger
+ *      - Lets a caller such as 40image reject bad options before reading
+ *              any input, rather than fail a CRE partway through
+ */
+bool codec_options_valid(const struct codec_options *options)
+{
+        assert(options != NULL);
+        const struct word_layout *layout = &options->layout;
+
+        if (options->block_size != 2) {
+                return (options->block_size == 4 || 
+                        options->block_size == 8) &&
+                       options->coding != CODING_HUFFMAN && 
+                       options->predict == PREDICT_NONE &&
+                       layout_is_default(layout);
+        }
+
+        for (int f = 0; f < WORD_FIELDS; f++) {
+                unsigned fewest = f >= 1 && f <= 3 ? 2 : 1;
+                if (layout->width[f] < fewest || layout->width[f] > 16) {
+                        return false;
+                }
+        }
+        if (layout_bits(layout) > 64 || !(layout->bcd_max > 0) || 
+            !(layout->bcd_scale > 0)) {
+                return false;
+        }
+        if (options->coding == CODING_HUFFMAN && !huffman_supports(layout)) {
+                return false;
+        }
+        if (options->predict != PREDICT_NONE && 
+            options->coding == CODING_RAW) {
+                return false;
+        }
+        return options->predict == PREDICT_NONE || layout_words(layout) == 1;
+}
+
+/********** decompress40_stream ********
+ * 
+ * Purpose: decompresses the given compressed image and writes it to a 
+ *          stream
+ *
+ * Parameters:
+ *      input: the compressed file to decompress
+ *      output: the stream the decompressed image is written to
+ * 
+ * Return: void
+ *
+ * Expects: see decompress_image()
+ *
+ * CRE: see decompress_image()
+ */
+void decompress40_stream(FILE *input, FILE *output)
+{
+        decompress_image(input, output, 0);
+}
+
+/********** decompress40_pipelined ********
+ * 
+ * Purpose: decompresses the given compressed image as decompress40_stream()
+ *          does, reading, decoding, and writing it a band of rows at a 
+ *          time on separate threads
+ *
+ * Parameters:
+ *      input: the compressed file to decompress
+ *      output: the stream the decompressed image is written to
+ *      nthreads: the number of decoding threads, or 0 or less to use one 
+ *                per online processor
+ * 
+ * Return: void
+ *
+ * Expects: see decompress_image()
+ *
+ * CRE: see decompress_image() and pipeline_decompress() (pipeline.h)
+ *
+ * Notes: 
+ *      - Only format 2 is read a band at a time; a tiled format 3 image is
+ *              decompressed whole, as decompress40_stream() does
+ *      - The output is identical to decompress40_stream()'s either way
+ */
+void decompress40_pipelined(FILE *input, FILE *output, int nthreads)
+{
+        decompress_image(input, output, nthreads > 0 ? nthreads : -1);
+}
+
+/********** decompress40_region ********
+ * 
+ * Purpose: decompresses one rectangle of the given compressed image and 
+ *          writes it to a stream as a PPM
+ *
+ * Parameters:
+ *      input: the compressed file to decompress
+ *      output: the stream the cropped image is written to
+ *      x, y: the column and row of the rectangle's top left pixel
+ *      width, height: the size of the rectangle, in pixels
+ * 
+ * Return: void
+ *
+ * Expects: 
+ *      - input is a valid, open file pointer (not NULL)
+ *      - output is open for writing
+ *      - The input file follows the "COMP40 Compressed image format 2" or
+ *        "COMP40 Compressed image format 3" format
+ *
+ * CRE: input is null, output is null, the rectangle doesn't overlap the 
+ *      image, or the file ends early. More in the used functions
+ *
+ * Notes: 
+ *      - The rectangle is clipped to the image
+ *      - Only the words of the blocks covering the rectangle are read 
+ *              and decoded (see read_compressed_region()), so the cost
+ *              follows the size of the rectangle rather than the image
+ *      - Output is identical to cropping the output of decompress40_stream
+ */
+void decompress40_region(FILE *input, FILE *output, int x, int y, 
+                         int width, int height)
+{
+        assert(input != NULL);
+        assert(output != NULL);
+
+        /* step 0 - draw this image's buffers from the pipeline pool */
+        Pool_T pool = Pool_current();
+        assert(pool != NULL);
+        Pool_reset(pool);
+
+        A2Methods_T methods = uarray2_methods_pool; 
+        assert(methods != NULL);
+
+        /*step 1 - clip the rectangle to the image*/
+        comp40_header header;
+        read_compressed_header(input, &header);
+        long n = header.block_size;
+        long block_width = words_per_block(&header);
+
+        long right = (long)x + width;
+        long bottom = (long)y + height;
+        if (right > header.image_width) {
+                right = header.image_width;
+        }
+        if (bottom > header.image_height) {
+                bottom = header.image_height;
+        }
+        if (x < 0) {
+                x = 0;
+        }
+        if (y < 0) {
+                y = 0;
+        }
+        assert(right > x && bottom > y);
+        width = right - x;
+        height = bottom - y;
+
+        /*step 2 - read the words of the blocks covering the rectangle*/
+        unsigned col = x / n;
+        unsigned row = y / n;
+        unsigned ncols = (right + n - 1) / n - col;
+        unsigned nrows = (bottom + n - 1) / n - row;
+
+        long blocks = (long)ncols * nrows;
+        Pool_reserve(pool, blocks * block_width * 
+                           (sizeof(uint32_t) + word_size()) + 
+                           n * n * blocks * (Y_Pb_Pr_size() + 
+                                             sizeof(struct Pnm_rgb)) + 
+                           (long)width * height * sizeof(struct Pnm_rgb) +
+                           5 * ARRAY_OVERHEAD);
+
+        A2Methods_UArray2 word_bits = read_compressed_region(input, &header,
+                                                             col * 
+                                                             block_width, 
+                                                             row, ncols * 
+                                                             block_width,
+                                                             nrows, methods);
+        assert(word_bits != NULL);
+        struct word_layout layout = header.layout;
+        free_compressed_header(&header);
+
+        /*steps 3 to 5 - words back to RGB pixels*/
+        A2Methods_UArray2 pixels = decode_words(word_bits, methods, n, 
+                                                &layout, NULL);
+        assert(pixels != NULL);
+
+        /*step 6 - crop the covering blocks to the rectangle and print*/
+        A2Methods_UArray2 cropped = crop_pixels(pixels, methods, x - n * col,
+                                                y - n * row, width, height);
+        assert(cropped != NULL);
+        print_decompressed(cropped, methods, DENOM, output);
+
+        /*step 7 - cleanup (gives nothing back until the pool is reset)*/
+        methods->free(&word_bits);
+        methods->free(&pixels);
+        /*"cropped" freed in print_decompressed*/
+}
+
+
+/********** decompress40_preview ********
+ * 
+ * Purpose: decompresses the given compressed image at half resolution and 
+ *          writes it to a stream as a PPM
+ *
+ * Parameters:
+ *      input: the compressed file to decompress
+ *      output: the stream the preview is written to
+ * 
+ * Return: void
+ *
+ * Expects: 
+ *      - input is a valid, open file pointer (not NULL)
+ *      - output is open for writing
+ *      - The input file follows the "COMP40 Compressed image format 2" or
+ *        "COMP40 Compressed image format 3" format
+ *
+ * CRE: input is null, output is null, word_bits is null, ypbpr_pixels is 
+ *      null, or pixels is null
+ *
+ * Notes: 
+ *      - The preview has one pixel per word, the average of its 2x2 block 
+ *              (see preview_words()), so it is half the full image's width
+ *              and height and skips the inverse DCT and the 2x2 expansion.
+ *              Images of larger blocks get one pixel per block (see 
+ *              preview_blocks())
+ */
+void decompress40_preview(FILE *input, FILE *output)
+{
+        assert(input != NULL);
+        assert(output != NULL);
+
+        /* step 0 - draw this image's buffers from the pipeline pool */
+        Pool_T pool = Pool_current();
+        assert(pool != NULL);
+        Pool_reset(pool);
+
+        A2Methods_T methods = uarray2_methods_pool; 
+        assert(methods != NULL);
+
+        /*step 1 - create 2D array of 32-bit words from input*/
+        comp40_header header;
+        read_compressed_header(input, &header);
+
+        long words = (long)header.width * header.height;
+        Pool_reserve(pool, words * (sizeof(uint32_t) + Y_Pb_Pr_size() + 
+                                    sizeof(struct Pnm_rgb)) + 
+                           3 * ARRAY_OVERHEAD);
+
+        A2Methods_UArray2 word_bits = read_compressed_words(input, &header, 
+                                                            methods);
+        assert(word_bits != NULL);
+        unsigned block_size = header.block_size;
+        struct word_layout layout = header.layout;
+        free_compressed_header(&header);
+
+        /*step 2 - one Y/Pb/Pr pixel per block*/
+        A2Methods_UArray2 ypbpr_pixels;
+        if (block_size != 2) {
+                ypbpr_pixels = preview_blocks(word_bits, methods, 
+                                              block_size);
+        } else if (layout_is_default(&layout)) {
+                ypbpr_pixels = preview_words(word_bits, methods);
+        } else {
+                ypbpr_pixels = preview_words_with(word_bits, methods, 
+                                                  &layout);
+        }
+        assert(ypbpr_pixels != NULL);
+
+        /*step 3 - Y/Pb/Pr value to RGB values*/
+        A2Methods_UArray2 pixels = ypbpr_to_rgb(ypbpr_pixels, 
+                                                methods, DENOM);
+        assert(pixels != NULL);
+
+        /*step 4 - print preview image*/
+        print_decompressed(pixels, methods, DENOM, output);
+
+        /*step 5 - cleanup (gives nothing back until the pool is reset)*/
+        methods->free(&word_bits);
+        methods->free(&ypbpr_pixels);
+        /*"pixels" freed in print_decompressed*/
+}
+
+/**************************/
+/*    Helper functions    */
+/**************************/
+
+
+/********** compress_image ********
+ * 
+ * Purpose: Compresses a given PPM image and writes the compressed output to 
+ *          a stream in binary format, in the format options ask for
+ *
+ * Parameters:
+ *      - input: A file pointer to the .ppm file to be compressed
+ *      - output: the stream the compressed image is written to
+ *      - options: how to write the compressed image (see codec.h)
+ *      - verify: whether to decode the words again and compare them with
+ *                the image
+ *      - nthreads: 0 to compress the whole image on the calling thread, 
+ *                  otherwise the number of threads to encode a format 2 
+ *                  image with, or -1 for one per online processor 
+ *                  (see pipeline.h). Can't be combined with verify
+ *
+ * Return: with verify, the RMSD of the decoded image (see pixels_rmsd()),
+ *         and 0 otherwise
+ *
+ * Expects:
+ *      - input is a valid open file pointer (not NULL)
+ *      - output is open for writing
+ *      - The image follows the standard PPM format
+ *
+ * CRE: input is null, output is null, options is null, methods are null, 
+ *      ppm is null, the pixels of ppm is null,
  *      ypbpr_pixels is null, word_structs is null, and word_bits is null.
  *      More assert statements in the used functions
  *
@@ -51,105 +548,531 @@ const int DENOM = 225;
  *      - Utilizes functions from read_write.h, ry_conversion.h, word.h
  *      - information is lost here, more specification in the headers of 
  *              functions used
- *      - memory is allocted and freed for each of the A2Methods_UArray2s
- *              defined in this function. Memory is allocated and freed for the
- *              ppm defined in this function.
+ *      - every A2Methods_UArray2 defined in this function comes from the
+ *              calling thread's pool (pool.h), which is reset at the start 
+ *              of each call and keeps its memory for the next image. Memory
+ *              is allocated and freed for the ppm struct itself.
+ *      - a pipelined image's steps overlap, so they are timed as one
  */
-extern void compress40(FILE *input)
+static double compress_image(FILE *input, FILE *output, 
+                             const struct codec_options *options, 
+                             bool verify, int nthreads)
 {
         assert(input != NULL);
+        assert(output != NULL);
+        assert(options != NULL);
+        assert(!verify || nthreads == 0);
+        Timing_T timing = Timing_start("compress");
+
+        /* step 0 - draw this image's buffers from the pipeline pool */
+        Pool_T pool = Pool_current();
+        assert(pool != NULL);
+        Pool_reset(pool);
 
-        A2Methods_T methods = uarray2_methods_plain; 
+        A2Methods_T methods = uarray2_methods_pool; 
         assert(methods != NULL);
+        Timing_step(timing, "0 reset pool", 0, 0);
+
+        /* or steps 1 to 5 a band at a time, when writing format 2 */
+        long input_bytes = stream_remaining(input);
+        if (nthreads != 0 && writes_format_2(options)) {
+                long output_start = stream_offset(output);
+                unsigned width, height;
+                pipeline_compress(input, output, nthreads, &width, &height);
+                Timing_step(timing, "1-5 pipelined", input_bytes, 
+                            bytes_between(output_start, 
+                                          stream_offset(output)));
+                Timing_finish(&timing, width, height);
+                return 0.0;
+        }
 
         /* step 1 - create ppm from input*/
-        Pnm_ppm ppm = read_and_trim_ppm(input); 
+        unsigned block_size = options->block_size;
+        const struct word_layout *layout = &options->layout;
+        bool fast_layout = layout_is_default(layout);
+        assert(codec_options_valid(options));
+        Pnm_ppm ppm = block_size == 2 ? read_and_trim_ppm(input, methods) : 
+                                        read_checked_ppm(input, methods);
         assert(ppm != NULL); 
         assert(ppm->pixels != NULL);
 
+        /* 
+         * larger blocks pad the image out to a whole number of them; the 
+         * header keeps its real size for the decoder to crop back to
+         */
+        unsigned width = ppm->width;
+        unsigned height = ppm->height;
+        if (width % block_size != 0 || height % block_size != 0) {
+                update_ppm_padded(&ppm, methods, 
+                                  (width + block_size - 1) / block_size * 
+                                  block_size,
+                                  (height + block_size - 1) / block_size * 
+                                  block_size);
+        }
+
+        /* reserve room for the rest of the pipeline now the size is known */
+        long pixels = (long)ppm->width * ppm->height;
+        Pool_reserve(pool, pixels * Y_Pb_Pr_size() + 
+                           pixels / 4 * (word_size() + sizeof(uint32_t) *
+                                         layout_words(layout)) + 
+                           3 * ARRAY_OVERHEAD);
+        long rgb_bytes = pixels * (long)sizeof(struct Pnm_rgb);
+        long ypbpr_bytes = pixels * Y_Pb_Pr_size();
+        Timing_step(timing, "1 read ppm", input_bytes, rgb_bytes);
+
         /* step 2 - RGB to Y/Pb/Pr values*/ 
         /*info is lost here due to floats*/
         A2Methods_UArray2 ypbpr_pixels = rgb_to_ypbpr(ppm); 
         assert(ypbpr_pixels != NULL);
+        Timing_step(timing, "2 rgb to ypbpr", rgb_bytes, ypbpr_bytes);
         
-        /*step 3 - turn into 2D array of word structs*/
+        /*steps 3 and 4 - 2x2 blocks to word structs, then 32-bit words*/
         /*info is lost here due to averaging and compressing information*/
-        A2Methods_UArray2 word_structs = make_word_array(ypbpr_pixels, methods);
-        assert(word_structs != NULL);
-        
-        /*step 4 - create a 2D array of 32-bit words*/
-        A2Methods_UArray2 word_bits = pack_word(word_structs, methods);
+        A2Methods_UArray2 word_structs = NULL;
+        A2Methods_UArray2 word_bits;
+        long struct_bytes = pixels / 4 * word_size();
+        if (block_size == 2 && fast_layout) {
+                word_structs = make_word_array(ypbpr_pixels, methods);
+                assert(word_structs != NULL);
+                Timing_step(timing, "3 make word array", ypbpr_bytes, 
+                            struct_bytes);
+                word_bits = pack_word(word_structs, methods);
+        } else if (block_size == 2) {
+                /*or any other layout, without the word structs*/
+                word_bits = pack_words_with(ypbpr_pixels, methods, layout);
+        } else {
+                /*or larger blocks straight to their words (block.h)*/
+                word_bits = blocks_to_words(ypbpr_pixels, methods, 
+                                            block_size);
+        }
         assert(word_bits != NULL);
+        long word_bytes = (long)methods->width(word_bits) * 
+                          methods->height(word_bits) * sizeof(uint32_t);
+        if (word_structs != NULL) {
+                Timing_step(timing, "4 pack words", struct_bytes, 
+                            word_bytes);
+        } else {
+                Timing_step(timing, block_size == 2 ? "3-4 pack words" : 
+                                                      "3-4 blocks to words",
+                            ypbpr_bytes, word_bytes);
+        }
 
         /*step 5 - print compressed image*/
-        print_compressed(word_bits, methods);
+        long output_start = stream_offset(output);
+        if (!writes_format_2(options)) {
+                /* a tile is tile_size blocks each way */
+                unsigned tile_width = options->tile_size * 
+                                      (block_size == 2 ? 
+                                       layout_words(layout) : 
+                                       block_words(block_size));
+                unsigned tile_height = options->tile_size;
+                if (tile_width == 0) {
+                        /* one tile; an empty image still needs a size */
+                        tile_width = methods->width(word_bits);
+                        tile_height = methods->height(word_bits);
+                        if (tile_width == 0) {
+                                tile_width = 1;
+                        }
+                        if (tile_height == 0) {
+                                tile_height = 1;
+                        }
+                }
+                print_compressed_tiled(word_bits, methods, tile_width, 
+                                       tile_height, options->coding, 
+                                       options->predict, block_size, 
+                                       width, height, layout, output);
+        } else {
+                print_compressed(word_bits, methods, output);
+        }
+        Timing_step(timing, "5 print compressed", word_bytes, 
+                    bytes_between(output_start, stream_offset(output)));
+
+        /*with verify, decode the words again and compare*/
+        double error = 0.0;
+        if (verify) {
+                A2Methods_UArray2 decoded = decode_words(word_bits, methods,
+                                                         block_size, layout,
+                                                         NULL);
+                error = pixels_rmsd(ppm, decoded, width, height, methods,
+                                    DENOM);
+                methods->free(&decoded);
+                Timing_step(timing, "verify", word_bytes, rgb_bytes);
+        }
         
-        /*step 6 - cleanup*/
+        /*step 6 - cleanup (gives nothing back until the pool is reset)*/
         Pnm_ppmfree(&ppm);
         methods->free(&ypbpr_pixels);
-        methods->free(&word_structs);
+        if (word_structs != NULL) {
+                methods->free(&word_structs);
+        }
         methods->free(&word_bits);
+        Timing_step(timing, "6 cleanup", 0, 0);
+        Timing_finish(&timing, width, height);
+        return error;
 }
 
-/********** decompress40 ********
+/********** decompress_image ********
  * 
- * Purpose: decompresses the given compressed image and writes to 
- *          standard output 
+ * Purpose: decompresses the given compressed image and writes it to a 
+ *          stream
  *
  * Parameters:
  *      input: the compressed file to decompress
+ *      output: the stream the decompressed image is written to
+ *      nthreads: 0 to decompress the whole image on the calling thread, 
+ *                otherwise the number of threads to decode a format 2 
+ *                image with, or -1 for one per online processor 
+ *                (see pipeline.h)
  * 
  * Return: void
  *
  * Expects: 
  *      - input is a valid, open file pointer (not NULL)
- *      - A decompressed version of input written to standard output
- *      - The input file follows the "COMP40 Compressed image format 2" format
+ *      - output is open for writing
+ *      - The input file follows the "COMP40 Compressed image format 2" or
+ *        "COMP40 Compressed image format 3" format
  *
- * CRE: input is null, methods is null, word_bits is null, word_structs is null,
- *      ypbpr_pixels is null, and pixels is null
+ * CRE: input is null, output is null, methods is null, word_bits is null, 
+ *      word_structs is null, ypbpr_pixels is null, and pixels is null
  *
  * Notes: 
  *      - utilizes functions from read_write.h, ry_conversion.h, word.h
- *      - memory is allocted and freed for each of the A2Methods_UArray2s
- *              defined in this function. Memory is allocated and freed for the
- *              ppm defined in this function.
+ *      - every A2Methods_UArray2 defined in this function comes from the
+ *              calling thread's pool (pool.h), which is reset at the start 
+ *              of each call and sized from the compressed image's header. 
+ *              Memory is allocated and freed for the ppm struct itself.
+ *      - with COMP40_STATS set, each step is timed and reported (timing.h);
+ *              a pipelined image's steps overlap, so they are timed as one
  */
-extern void decompress40(FILE *input)
+static void decompress_image(FILE *input, FILE *output, int nthreads)
 {
         assert(input != NULL);
-        /* for rn testing of step 1 bc we havent made code to read in *input*/
+        assert(output != NULL);
+        Timing_T timing = Timing_start("decompress");
+
+        /* step 0 - draw this image's buffers from the pipeline pool */
+        Pool_T pool = Pool_current();
+        assert(pool != NULL);
+        Pool_reset(pool);
 
-        A2Methods_T methods = uarray2_methods_plain; 
+        A2Methods_T methods = uarray2_methods_pool; 
         assert(methods != NULL);
+        Timing_step(timing, "0 reset pool", 0, 0);
 
         /*step 1 - create 2D array of 32-bit words from input*/
-        A2Methods_UArray2 word_bits = read_compressed_to_words(input);
+        long input_bytes = stream_remaining(input);
+        comp40_header header;
+        read_compressed_header(input, &header);
+
+        /*or steps 1 to 6 a band at a time, for a format 2 image*/
+        if (nthreads != 0 && header.format == 2) {
+                long output_start = stream_offset(output);
+                pipeline_decompress(input, &header, output, DENOM, 
+                                    nthreads);
+                Timing_step(timing, "1-6 pipelined", input_bytes, 
+                            bytes_between(output_start, 
+                                          stream_offset(output)));
+                Timing_finish(&timing, 2 * header.width, 
+                              2 * header.height);
+                free_compressed_header(&header);
+                return;
+        }
+
+        /* padded blocks are cropped off into one more array */
+        unsigned width = header.image_width;
+        unsigned height = header.image_height;
+        long npixels = (long)width * height;
+        bool padded = npixels != image_pixels(&header);
+        long words = (long)header.width * header.height;
+        Pool_reserve(pool, words * (sizeof(uint32_t) + word_size()) + 
+                           image_pixels(&header) * 
+                           (Y_Pb_Pr_size() + sizeof(struct Pnm_rgb)) + 
+                           (padded ? npixels * sizeof(struct Pnm_rgb) + 
+                                     ARRAY_OVERHEAD : 0) +
+                           4 * ARRAY_OVERHEAD);
+
+        A2Methods_UArray2 word_bits = read_compressed_words(input, &header, 
+                                                            methods);
         assert(word_bits != NULL);
+        unsigned block_size = header.block_size;
+        struct word_layout layout = header.layout;
+        free_compressed_header(&header);
+        Timing_step(timing, "1 read compressed", input_bytes, 
+                    words * (long)sizeof(uint32_t));
 
-        /*step 3 - turn into 2D array of word structs*/
-        A2Methods_UArray2 word_structs = unpack_word(word_bits, methods);
-        assert(word_structs != NULL);
+        /*steps 3 to 5 - words back to RGB pixels*/
+        A2Methods_UArray2 pixels = decode_words(word_bits, methods, 
+                                                block_size, &layout, timing);
+        assert(pixels != NULL);
+        if (padded) {
+                A2Methods_UArray2 blocks = pixels;
+                pixels = crop_pixels(blocks, methods, 0, 0, width, height);
+                methods->free(&blocks);
+        }
+        
+        /*step 6 - print decompressed image*/
+        long output_start = stream_offset(output);
+        print_decompressed(pixels, methods, DENOM, output);
+        Timing_step(timing, "6 print ppm", 
+                    npixels * (long)sizeof(struct Pnm_rgb),
+                    bytes_between(output_start, stream_offset(output)));
 
-        /*step 4 - unpack words into Y/Pb/Pr pixels*/
-        A2Methods_UArray2 ypbpr_pixels = decompress_words(word_structs, 
-                                                                methods);
+        /*step 7 - cleanup (gives nothing back until the pool is reset)*/
+        methods->free(&word_bits);
+        /*"pixels" freed in print_decompressed*/
+        Timing_step(timing, "7 cleanup", 0, 0);
+        Timing_finish(&timing, width, height);
+}
+
+/********** decode_words ********
+ * 
+ * Purpose: Turns a 2D array of packed words back into RGB pixels
+ *
+ * Parameters:
+ *      word_bits: the 2D array of 32-bit words to decode
+ *      methods: the methods used for every 2D array
+ *      block_size: the width and height of a block, in pixels (block.h)
+ *      layout: the layout of the words of 2x2 blocks (codec.h)
+ *      timing: times steps 3 to 5 (timing.h), or NULL
+ * 
+ * Return: a new 2D array of Pnm_rgb pixels, block_size pixels for each 
+ *         block in each direction
+ *
+ * Expects: none
+ *
+ * CRE: word_bits is null, methods is null, word_structs is null, or 
+ *      ypbpr_pixels is null
+ *
+ * Notes: 
+ *      - the intermediate arrays are freed before returning
+ *      - the default layout takes the specialized path through word 
+ *              structs; any other takes unpack_words_with()
+ */
+static A2Methods_UArray2 decode_words(A2Methods_UArray2 word_bits, 
+                                      A2Methods_T methods, 
+                                      unsigned block_size,
+                                      const struct word_layout *layout,
+                                      Timing_T timing)
+{
+        assert(word_bits != NULL);
+        assert(methods != NULL);
+
+        long word_bytes = (long)methods->width(word_bits) * 
+                          methods->height(word_bits) * sizeof(uint32_t);
+
+        /*larger blocks go straight from words to Y/Pb/Pr pixels*/
+        A2Methods_UArray2 word_structs = NULL;
+        A2Methods_UArray2 ypbpr_pixels;
+        if (block_size != 2) {
+                ypbpr_pixels = words_to_blocks(word_bits, methods, 
+                                               block_size);
+        } else if (!layout_is_default(layout)) {
+                ypbpr_pixels = unpack_words_with(word_bits, methods, 
+                                                 layout);
+        } else {
+                /*step 3 - turn into 2D array of word structs*/
+                word_structs = unpack_word(word_bits, methods);
+                assert(word_structs != NULL);
+                long struct_bytes = (long)methods->width(word_structs) * 
+                                    methods->height(word_structs) * 
+                                    word_size();
+                Timing_step(timing, "3 unpack words", word_bytes, 
+                            struct_bytes);
+
+                /*step 4 - unpack words into Y/Pb/Pr pixels*/
+                ypbpr_pixels = decompress_words(word_structs, methods);
+                word_bytes = struct_bytes;
+        }
         assert(ypbpr_pixels != NULL);
+        long npixels = (long)methods->width(ypbpr_pixels) * 
+                            methods->height(ypbpr_pixels);
+        Timing_step(timing, word_structs != NULL ? "4 words to ypbpr" : 
+                            block_size == 2 ? "3-4 words to ypbpr" : 
+                                              "3-4 blocks to ypbpr",
+                    word_bytes, npixels * Y_Pb_Pr_size());
         
         /*step 5 - Y/Pb/Pr value to RGB values*/
         A2Methods_UArray2 pixels = ypbpr_to_rgb(ypbpr_pixels, 
                                                 methods, DENOM);
         assert(pixels != NULL);
-        
-        /*step 6 - print decompressed image*/
-        print_decompressed(pixels, methods, DENOM);
+        Timing_step(timing, "5 ypbpr to rgb", npixels * Y_Pb_Pr_size(),
+                    npixels * (long)sizeof(struct Pnm_rgb));
 
-        /*step 7 - cleanup*/
-        methods->free(&word_bits);
-        methods->free(&word_structs);
+        if (word_structs != NULL) {
+                methods->free(&word_structs);
+        }
         methods->free(&ypbpr_pixels);
-        /*"pixels" freed in print_decompressed*/
+
+        return pixels;
 }
 
+/********** writes_format_2 ********
+ * 
+ * Purpose: Says whether compressing with the given options writes 
+ *          "COMP40 Compressed image format 2"
+ *
+ * Parameters:
+ *      options: the options
+ * 
+ * Return: true for no tiles, raw coding, no prediction, 2x2 blocks, and 
+ *         the default layout; false if the tiled format 3 is written
+ *
+ * Expects: none
+ *
+ * CRE: options is null
+ */
+static bool writes_format_2(const struct codec_options *options)
+{
+        assert(options != NULL);
+        return options->tile_size == 0 && options->coding == CODING_RAW &&
+               options->predict == PREDICT_NONE && 
+               options->block_size == 2 && 
+               layout_is_default(&options->layout);
+}
 
+/********** image_pixels ********
+ * 
+ * Purpose: Gives the number of pixels a compressed image decodes to
+ *
+ * Parameters:
+ *      header: the image's header
+ * 
+ * Return: the number of pixels
+ *
+ * Expects: none
+ *
+ * CRE: header is null
+ */
+static long image_pixels(const comp40_header *header)
+{
+        assert(header != NULL);
+        long n = header->block_size;
+        return (long)header->width / words_per_block(header) * n * 
+               header->height * n;
+}
 
+/********** pixels_rmsd ********
+ * 
+ * Purpose: Computes the Root Mean Square Difference between an image and
+ *          its decoded pixels
+ *
+ * Parameters:
+ *      ppm: the image
+ *      pixels: a 2D array of Pnm_rgb pixels the size of the image
+ *      width, height: the size of the part of both to compare, from the
+ *                     top left
+ *      methods: the methods used for pixels
+ *      denominator: the denominator of pixels
+ * 
+ * Return: the RMSD, as ppmdiff computes it: the root of the mean squared 
+ *         difference of each red, green, and blue value as a fraction of
+ *         its denominator; 0 if the part compared has no pixels
+ *
+ * Expects: none
+ *
+ * CRE: ppm is null, pixels is null, methods is null, the sizes differ, or
+ *      the part compared is larger than the image
+ *
+ * Notes: 
+ *      - Only the image itself is compared, not the padding of an image
+ *              of larger blocks (see update_ppm_padded())
+ */
+static double pixels_rmsd(Pnm_ppm ppm, A2Methods_UArray2 pixels, 
+                          unsigned width, unsigned height, 
+                          A2Methods_T methods, unsigned denominator)
+{
+        assert(ppm != NULL);
+        assert(pixels != NULL);
+        assert(methods != NULL);
+        assert(methods->width(pixels) == (int)ppm->width);
+        assert(methods->height(pixels) == (int)ppm->height);
+        assert(width <= ppm->width && height <= ppm->height);
+
+        double scale1 = 1.0 / ppm->denominator;
+        double scale2 = 1.0 / denominator;
+        double total = 0.0;
+        for (unsigned row = 0; row < height; row++) {
+                for (unsigned col = 0; col < width; col++) {
+                        Pnm_rgb original = ppm->methods->at(ppm->pixels, 
+                                                            col, row);
+                        Pnm_rgb decoded = methods->at(pixels, col, row);
+                        double red = original->red * scale1 - 
+                                     decoded->red * scale2;
+                        double green = original->green * scale1 - 
+                                       decoded->green * scale2;
+                        double blue = original->blue * scale1 - 
+                                      decoded->blue * scale2;
+                        total += red * red + green * green + blue * blue;
+                }
+        }
+        if (width == 0 || height == 0) {
+                return 0.0;
+        }
+        return sqrt(total / (3.0 * width * height));
+}
+
+/********** stream_remaining ********
+ * 
+ * Purpose: Gives the bytes left in an input stream, for the bytes a timed
+ *          step read
+ *
+ * Parameters:
+ *      stream: the stream
+ * 
+ * Return: the bytes from the stream's position to its end, or -1 if it 
+ *         isn't a regular file
+ *
+ * Expects: none
+ *
+ * Notes: 
+ *      - The whole rest of the stream is one image, and the readers may 
+ *              use pread() or mmap() and leave the stream's position 
+ *              where it was, so the size is taken before reading
+ */
+static long stream_remaining(FILE *stream)
+{
+        struct stat info;
+        long offset = stream_offset(stream);
+        if (offset < 0 || fstat(fileno(stream), &info) != 0) {
+                return -1;
+        }
+        return info.st_size - offset;
+}
+
+/********** stream_offset ********
+ * 
+ * Purpose: Gives how far into a stream the next read or write is, for 
+ *          the bytes a timed step read or wrote
+ *
+ * Parameters:
+ *      stream: the stream
+ * 
+ * Return: the offset, or -1 if the stream isn't a regular file (the 
+ *         offsets of pipes and devices say nothing)
+ *
+ * Expects: none
+ */
+static long stream_offset(FILE *stream)
+{
+        struct stat info;
+        if (fstat(fileno(stream), &info) != 0 || !S_ISREG(info.st_mode)) {
+                return -1;
+        }
+        return ftell(stream);
+}
+
+/********** bytes_between ********
+ * 
+ * Purpose: Gives the bytes between two stream offsets
+ *
+ * Parameters:
+ *      from, to: offsets from stream_offset()
+ * 
+ * Return: to - from, or -1 if either is unknown
+ *
+ * Expects: none
+ */
+static long bytes_between(long from, long to)
+{
+        return from < 0 || to < 0 ? -1 : to - from;
+}
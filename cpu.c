@@ -0,0 +1,205 @@
+/**************************************************************
+ *
+ *                     cpu.c
+ *
+ *     Assignment: Arith
+ *     Authors:  Marielle Cibella (mcibel01), Erica Huang (ehuang02)
+ *     Date:     4/26/25
+ *
+ *     Summary:
+ *
+ *     cpu.c implements the choice of instruction set declared in cpu.h.
+ *     The processor is asked once, through GCC's __builtin_cpu_supports()
+ *     (cpuid, and xgetbv for whether the kernel saves the wider
+ *     registers), and the answer, lowered by COMP40_CPU if it is set, is
+ *     kept for every later call. Off x86 the only level is generic.
+ *
+ *
+ **************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "assert.h"
+#include "cpu.h"
+
+static const char *const level_names[CPU_LEVELS] = {
+        "generic", "sse4.2", "avx2", "avx512"
+};
+
+/* the best level the processor supports, and the level in use */
+static pthread_once_t cpu_once = PTHREAD_ONCE_INIT;
+static enum cpu_level supported = CPU_GENERIC;
+static enum cpu_level chosen = CPU_GENERIC;
+
+/* helper functions */
+static void cpu_init(void);
+static enum cpu_level detect(void);
+
+/********** Cpu_level ********
+ *
+ * Purpose: Gives the level the kernels run at
+ *
+ * Parameters: none
+ *
+ * Return: the level
+ *
+ * Expects: none
+ *
+ * CRE: none
+ *
+ * Notes:
+ *      - The first call asks the processor and reads COMP40_CPU; a level
+ *        there above what the processor supports is reported on stderr
+ *        and lowered, and an unknown one is reported and ignored
+ */
+enum cpu_level Cpu_level(void)
+{
+        pthread_once(&cpu_once, cpu_init);
+        return __atomic_load_n(&chosen, __ATOMIC_RELAXED);
+}
+
+/********** Cpu_supported ********
+ *
+ * Purpose: Gives the best level the processor supports
+ *
+ * Parameters: none
+ *
+ * Return: the level, whatever COMP40_CPU says
+ *
+ * Expects: none
+ *
+ * CRE: none
+ */
+enum cpu_level Cpu_supported(void)
+{
+        pthread_once(&cpu_once, cpu_init);
+        return supported;
+}
+
+/********** Cpu_set_level ********
+ *
+ * Purpose: Changes the level the kernels run at
+ *
+ * Parameters:
+ *      - level: the level wanted
+ *
+ * Return: the level now in use: level, or the best supported if that is
+ *         lower
+ *
+ * Expects:
+ *      - no kernel is running on another thread, if the results of one
+ *        image are to come from one level
+ *
+ * CRE: level is not a level
+ *
+ * Notes:
+ *      - For tests that compare the levels; programs otherwise keep the
+ *        level chosen at startup
+ */
+enum cpu_level Cpu_set_level(enum cpu_level level)
+{
+        assert(level < CPU_LEVELS);
+        pthread_once(&cpu_once, cpu_init);
+        if (level > supported) {
+                level = supported;
+        }
+        __atomic_store_n(&chosen, level, __ATOMIC_RELAXED);
+        return level;
+}
+
+/********** Cpu_level_name ********
+ *
+ * Purpose: Gives a level's name, as COMP40_CPU takes it
+ *
+ * Parameters:
+ *      - level: the level
+ *
+ * Return: the name, such as "avx2"
+ *
+ * Expects: none
+ *
+ * CRE: level is not a level
+ */
+const char *Cpu_level_name(enum cpu_level level)
+{
+        assert(level < CPU_LEVELS);
+        return level_names[level];
+}
+
+
+/**************************/
+/*    Helper functions    */
+/**************************/
+
+
+/********** cpu_init ********
+ *
+ * Purpose: Picks the level from the processor and COMP40_CPU
+ *
+ * Parameters: none
+ *
+ * Return: none
+ *
+ * Expects:
+ *      - called once, through pthread_once()
+ *
+ * CRE: none
+ */
+static void cpu_init(void)
+{
+        supported = detect();
+        chosen = supported;
+
+        const char *forced = getenv("COMP40_CPU");
+        if (forced == NULL || *forced == '\0') {
+                return;
+        }
+        for (int level = 0; level < CPU_LEVELS; level++) {
+                if (strcmp(forced, level_names[level]) != 0) {
+                        continue;
+                }
+                if (level > (int)supported) {
+                        fprintf(stderr, "COMP40_CPU: %s isn't supported "
+                                "here, using %s\n", forced,
+                                level_names[supported]);
+                } else {
+                        chosen = level;
+                }
+                return;
+        }
+        fprintf(stderr, "COMP40_CPU: unknown level '%s' (generic, sse4.2, "
+                "avx2, or avx512)\n", forced);
+}
+
+/********** detect ********
+ *
+ * Purpose: Asks the processor for the best level it supports
+ *
+ * Parameters: none
+ *
+ * Return: the level
+ *
+ * Expects: none
+ *
+ * CRE: none
+ */
+static enum cpu_level detect(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f") &&
+            __builtin_cpu_supports("avx512vl") &&
+            __builtin_cpu_supports("avx512bw")) {
+                return CPU_AVX512;
+        }
+        if (__builtin_cpu_supports("avx2")) {
+                return CPU_AVX2;
+        }
+        if (__builtin_cpu_supports("sse4.2")) {
+                return CPU_SSE42;
+        }
+#endif
+        return CPU_GENERIC;
+}
@@ -0,0 +1,95 @@
+/**************************************************************
+ *
+ *                     cpu.h
+ *
+ *     Assignment: Arith
+ *     Authors:  Marielle Cibella (mcibel01), Erica Huang (ehuang02)
+ *     Date:     4/26/25
+ *
+ *     Summary:
+ *
+ *     This header file declares the runtime choice of instruction set for
+ *     the codec's inner loops. The hot kernels (the RGB to Y/Pb/Pr row
+ *     conversion, the big-endian word rows of the compressed formats,
+ *     and ppmdiff's sums) are each compiled once per level below from the
+ *     same source, optimized and vectorized even in a -O0 build, and the
+ *     best level the processor supports is picked by cpuid the first time
+ *     one is called. Setting COMP40_CPU to generic, sse4.2, avx2, or
+ *     avx512 forces a lower level, for testing or comparison.
+ *
+ *     Every level gives bit-identical results: the variants differ only
+ *     in the instructions the compiler may use, and floating-point
+ *     contraction (fused multiply-add) is turned off in each, so
+ *     compressed images don't depend on the host that made them.
+ *
+ *     A kernel is written once as a static inline function, always
+ *     inlined, and CPU_VARIANTS(name, (parameters), (arguments)) makes
+ *     name_variants[], one function per level calling name_kernel();
+ *     CPU_DISPATCH(name) is the variant for the chosen level. A file that
+ *     dispatches before its variants are made declares them first with
+ *     CPU_DECLARE_VARIANTS(name, (parameters)).
+ *
+ *
+ **************************************************************/
+
+#ifndef CPU
+#define CPU
+
+/* the instruction sets kernels are compiled for, lowest first */
+enum cpu_level {
+        CPU_GENERIC,      /* the build's baseline (x86-64: SSE2) */
+        CPU_SSE42,        /* SSE4.2 */
+        CPU_AVX2,         /* AVX2, without FMA */
+        CPU_AVX512,       /* AVX-512 F, VL, and BW */
+        CPU_LEVELS
+};
+
+enum cpu_level Cpu_level(void);
+enum cpu_level Cpu_supported(void);
+enum cpu_level Cpu_set_level(enum cpu_level level);
+const char *Cpu_level_name(enum cpu_level level);
+
+/* a kernel body, or a helper one calls, inlined into each variant */
+#define CPU_KERNEL static inline __attribute__((always_inline))
+
+/*
+ * every variant, generic included, is optimized and vectorized whatever
+ * the build's -O level, or all of them would be the same scalar code
+ */
+#define CPU_OPTIMIZE __attribute__((optimize("O3", "tree-vectorize", \
+                                             "fp-contract=off")))
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CPU_TARGET(isa) __attribute__((target(isa))) CPU_OPTIMIZE
+#else
+#define CPU_TARGET(isa) CPU_OPTIMIZE
+#endif
+
+#define CPU_VARIANTS(name, parameters, arguments)                         \
+        CPU_OPTIMIZE static void name##_generic parameters                \
+        {                                                                 \
+                name##_kernel arguments;                                  \
+        }                                                                 \
+        CPU_TARGET("sse4.2") static void name##_sse42 parameters          \
+        {                                                                 \
+                name##_kernel arguments;                                  \
+        }                                                                 \
+        CPU_TARGET("avx2,no-fma") static void name##_avx2 parameters      \
+        {                                                                 \
+                name##_kernel arguments;                                  \
+        }                                                                 \
+        CPU_TARGET("avx512f,avx512vl,avx512bw")                           \
+        static void name##_avx512 parameters                              \
+        {                                                                 \
+                name##_kernel arguments;                                  \
+        }                                                                 \
+        static void (*const name##_variants[CPU_LEVELS]) parameters = {   \
+                name##_generic, name##_sse42, name##_avx2, name##_avx512  \
+        }
+
+#define CPU_DECLARE_VARIANTS(name, parameters)                            \
+        static void (*const name##_variants[CPU_LEVELS]) parameters
+
+#define CPU_DISPATCH(name) (name##_variants[Cpu_level()])
+
+#endif
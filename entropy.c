@@ -0,0 +1,1022 @@
+/**************************************************************
+ *
+ *                     entropy.c
+ *
+ *     Assignment: Arith
+ *     Authors:  Marielle Cibella (mcibel01), Erica Huang (ehuang02)
+ *     Date:     4/20/25
+ *
+ *     Summary:
+ *
+ *     entropy.c implements the Huffman coder declared in entropy.h. A
+ *     tile coded with it starts with a tag byte. A HUFFMAN_TILE tag is
+ *     followed by the code lengths of each field's canonical Huffman 
+ *     code, one 4-bit length per possible value of the field, and then
+ *     the codes of every word's fields, most significant bit first, in 
+ *     the order a, b, c, d, Pb_avg, Pr_avg. A tile the code wouldn't
+ *     shrink (a small one, where the lengths dominate) is a RAW_TILE tag
+ *     followed by its words, 4 bytes each, big-endian.
+ *
+ *     Each field's codes are at most a few bits longer than the field 
+ *     (see field_limit()), so the decoder finds each field with a single 
+ *     lookup in a table indexed by the next that many bits of the stream,
+ *     and the encoder writes each field with one shift and or. All six 
+ *     tables together fit in a level 1 cache.
+ *
+ *     The run-length coder is for flat regions (screenshots, diagrams), 
+ *     where whole runs of blocks pack to the same word. A tile coded 
+ *     with it is a series of packets, each starting with a byte n: 
+ *     n < RUN_PACKET is a literal of the n + 1 words that follow, and 
+ *     n >= RUN_PACKET a run of n - RUN_PACKET + 1 copies of the one word
+ *     that follows. Words are 4 bytes each, big-endian.
+ *
+ *
+ **************************************************************/
+
+#include <string.h>
+#include "assert.h"
+#include "entropy.h"
+#include "word.h"
+
+/* 
+ * longest code the coder makes, and the size of the largest decoding 
+ * table. A field's codes are also kept to LIMIT_SLACK bits more than the 
+ * field, which costs almost nothing in size and keeps small fields' 
+ * tables small
+ */
+#define MAX_CODE_LENGTH 12
+#define LOOKUP_SIZE (1 << MAX_CODE_LENGTH)
+#define LIMIT_SLACK 3
+
+/* the tag byte that starts each tile */
+#define RAW_TILE 0
+#define HUFFMAN_TILE 1
+
+/* the first packet byte of a run, and the longest packet, in words */
+#define RUN_PACKET 128
+#define MAX_PACKET 128
+
+/* most values a field can take (a is 9 bits in the default layout) */
+#define MAX_FIELD_BITS 9
+#define MAX_SYMBOLS (1 << MAX_FIELD_BITS)
+
+/*
+ * struct huffman_code is one field's code: the length and bits of the
+ * code for each value of the field (length 0 for values never used), and
+ * both together as the encoder uses them, code << 4 | length
+ */
+typedef struct huffman_code {
+        uint8_t length[MAX_SYMBOLS];
+        uint16_t code[MAX_SYMBOLS];
+        uint32_t entry[MAX_SYMBOLS];
+} huffman_code;
+
+/*
+ * struct leaf is a value of a field and how often it occurs, for sorting
+ * the values before building a code
+ */
+typedef struct leaf {
+        uint64_t weight;
+        int symbol;
+} leaf;
+
+/* helper functions */
+static int field_symbols(const struct word_layout *layout, int field);
+static int field_limit(const struct word_layout *layout, int field);
+static int word_bits_limit(const struct word_layout *layout);
+static void build_lengths(const uint32_t *freq, int nsyms, int limit, 
+                          uint8_t *lengths);
+static bool tree_lengths(leaf *leaves, int n, int limit, uint8_t *lengths);
+static int compare_leaves(const void *a, const void *b);
+static void assign_codes(const uint8_t *lengths, int nsyms, uint16_t *codes);
+static bool build_table(const uint8_t *lengths, int nsyms, int limit, 
+                        uint16_t *table);
+static inline unsigned char *put_bits(unsigned char *p, uint64_t bits, 
+                                      int *nbits);
+static inline const unsigned char *get_bits(const unsigned char *p, 
+                                            const unsigned char *end,
+                                            uint64_t *bits, int *nbits);
+static long run_length(const uint32_t *words, long nwords, long i);
+static unsigned char *put_word(unsigned char *p, uint32_t word);
+static uint32_t get_word(const unsigned char *p);
+
+
+/********** huffman_bound ********
+ *
+ * Purpose: Gives the most bytes huffman_encode() can write for a tile
+ *
+ * Parameters:
+ *      - nwords: the number of words in the tile
+ *      - layout: the layout of the words
+ *
+ * Return: the size of buffer huffman_encode() needs
+ *
+ * Expects: none
+ *
+ * CRE: nwords is negative, or huffman_supports() rejects layout
+ */
+long huffman_bound(long nwords, const struct word_layout *layout)
+{
+        assert(nwords >= 0);
+        assert(huffman_supports(layout));
+
+        long table_bytes = 0;
+        for (int f = 0; f < WORD_FIELDS; f++) {
+                table_bytes += field_symbols(layout, f) / 2;
+        }
+        return 1 + table_bytes + 
+               (nwords * word_bits_limit(layout) + 7) / 8 + 8;
+}
+
+/********** huffman_least ********
+ *
+ * Purpose: Gives the fewest bytes a Huffman coded tile can take
+ *
+ * Parameters:
+ *      - nwords: the number of words in the tile
+ *
+ * Return: a lower bound on the size of any tile huffman_decode() accepts
+ *
+ * Expects: none
+ *
+ * CRE: nwords is negative
+ *
+ * Notes:
+ *      - Every code is at least a bit long, so each word takes a bit per
+ *        field; a tile stored raw takes 4 bytes a word, which is more
+ */
+long huffman_least(long nwords)
+{
+        assert(nwords >= 0);
+        return nwords * WORD_FIELDS / 8;
+}
+
+/********** huffman_supports ********
+ *
+ * Purpose: Says whether words of a layout can be Huffman coded
+ *
+ * Parameters:
+ *      - layout: the layout of the words
+ *
+ * Return: true if the layout is one word and no field has more than 
+ *         MAX_SYMBOLS values
+ *
+ * Expects: none
+ *
+ * CRE: layout is null
+ */
+bool huffman_supports(const struct word_layout *layout)
+{
+        assert(layout != NULL);
+        if (layout_words(layout) != 1) {
+                return false;
+        }
+        for (int f = 0; f < WORD_FIELDS; f++) {
+                if (layout->width[f] > MAX_FIELD_BITS) {
+                        return false;
+                }
+        }
+        return true;
+}
+
+/********** huffman_encode ********
+ *
+ * Purpose: Codes the words of one tile with a Huffman code per field
+ *
+ * Parameters:
+ *      - words: the tile's words
+ *      - nwords: the number of words
+ *      - out: where to write the coded tile, at least
+ *             huffman_bound(nwords, layout) bytes
+ *      - layout: the layout of the words
+ *
+ * Return: the number of bytes written
+ *
+ * Expects: none
+ *
+ * CRE: words or out is null, nwords is negative, or huffman_supports()
+ *      rejects layout
+ *
+ * Notes:
+ *      - Each field's code is built from how often each of its values
+ *        occurs in this tile, so tiles can be decoded on their own
+ *      - Never writes more than one byte more than the raw words
+ */
+long huffman_encode(const uint32_t *words, long nwords, unsigned char *out,
+                    const struct word_layout *layout)
+{
+        assert(words != NULL);
+        assert(out != NULL);
+        assert(nwords >= 0);
+        assert(huffman_supports(layout));
+
+        /* step 1 - count each field's values */
+        uint32_t freq[WORD_FIELDS][MAX_SYMBOLS];
+        memset(freq, 0, sizeof(freq));
+
+        unsigned lsb[WORD_FIELDS];
+        uint32_t mask[WORD_FIELDS];
+        layout_lsbs(layout, lsb);
+        for (int f = 0; f < WORD_FIELDS; f++) {
+                mask[f] = field_symbols(layout, f) - 1;
+        }
+        for (long i = 0; i < nwords; i++) {
+                for (int f = 0; f < WORD_FIELDS; f++) {
+                        freq[f][(words[i] >> lsb[f]) & mask[f]]++;
+                }
+        }
+
+        /* step 2 - build each field's code and write its lengths */
+        huffman_code codes[WORD_FIELDS];
+        unsigned char *p = out;
+        *p++ = HUFFMAN_TILE;
+        for (int f = 0; f < WORD_FIELDS; f++) {
+                int nsyms = field_symbols(layout, f);
+                build_lengths(freq[f], nsyms, field_limit(layout, f), 
+                              codes[f].length);
+                assign_codes(codes[f].length, nsyms, codes[f].code);
+                for (int s = 0; s < nsyms; s++) {
+                        codes[f].entry[s] = (uint32_t)codes[f].code[s] << 4 |
+                                            codes[f].length[s];
+                }
+                for (int s = 0; s < nsyms; s += 2) {
+                        *p++ = codes[f].length[s] << 4 |
+                               codes[f].length[s + 1];
+                }
+        }
+
+        /* 
+         * step 3 - write the codes. bits holds the nbits not yet written,
+         * at its bottom. A word's codes take at most word_bits_limit() 
+         * bits, so after each word the whole bytes are stored with one 
+         * 8-byte write (see put_bits()) and fewer than 8 bits are kept
+         */
+        uint64_t bits = 0;
+        int nbits = 0;
+        for (long i = 0; i < nwords; i++) {
+                uint32_t word = words[i];
+                for (int f = 0; f < WORD_FIELDS; f++) {
+                        uint32_t entry = codes[f].entry[(word >> lsb[f]) & 
+                                                        mask[f]];
+                        int length = entry & 0xf;
+                        bits = bits << length | entry >> 4;
+                        nbits += length;
+                }
+                p = put_bits(p, bits, &nbits);
+        }
+
+        /* the last partial byte is padded with zeros */
+        if (nbits > 0) {
+                *p++ = bits << (8 - nbits);
+        }
+
+        /* step 4 - fall back to the raw words if they're smaller */
+        if (p - out > 1 + nwords * 4) {
+                p = out;
+                *p++ = RAW_TILE;
+                for (long i = 0; i < nwords; i++) {
+                        p = put_word(p, words[i]);
+                }
+        }
+
+        return p - out;
+}
+
+/********** huffman_decode ********
+ *
+ * Purpose: Decodes a tile written by huffman_encode()
+ *
+ * Parameters:
+ *      - bytes: the coded tile
+ *      - length: the number of bytes in the coded tile
+ *      - words: where to store the tile's words
+ *      - nwords: the number of words in the tile
+ *      - layout: the layout of the words
+ *
+ * Return: true if the tile decoded, false if its bytes aren't a valid
+ *         coded tile of nwords words
+ *
+ * Expects: none
+ *
+ * CRE: bytes or words is null, nwords or length is negative, or 
+ *      huffman_supports() rejects layout
+ *
+ * Notes:
+ *      - Bad code lengths, codes that aren't in a field's code, and
+ *        streams that run out early are all reported as false rather than
+ *        CREs, so the caller can treat the tile as corrupt
+ */
+bool huffman_decode(const unsigned char *bytes, long length, uint32_t *words,
+                    long nwords, const struct word_layout *layout)
+{
+        assert(bytes != NULL);
+        assert(words != NULL);
+        assert(nwords >= 0);
+        assert(length >= 0);
+        assert(huffman_supports(layout));
+
+        const unsigned char *p = bytes;
+        const unsigned char *end = bytes + length;
+
+        /* step 0 - a tile that was left raw */
+        if (length < 1) {
+                return false;
+        }
+        if (*p == RAW_TILE) {
+                if (length != 1 + nwords * 4) {
+                        return false;
+                }
+                for (long i = 0; i < nwords; i++) {
+                        words[i] = get_word(bytes + 1 + 4 * i);
+                }
+                return true;
+        }
+        if (*p++ != HUFFMAN_TILE) {
+                return false;
+        }
+
+        /* step 1 - read each field's code lengths and build its table */
+        uint16_t table[WORD_FIELDS][LOOKUP_SIZE];
+        for (int f = 0; f < WORD_FIELDS; f++) {
+                int nsyms = field_symbols(layout, f);
+                if (end - p < nsyms / 2) {
+                        return false;
+                }
+                uint8_t lengths[MAX_SYMBOLS];
+                for (int s = 0; s < nsyms; s += 2) {
+                        lengths[s] = *p >> 4;
+                        lengths[s + 1] = *p & 0xf;
+                        p++;
+                }
+                if (!build_table(lengths, nsyms, field_limit(layout, f), 
+                                 table[f])) {
+                        return false;
+                }
+        }
+
+        unsigned lsb[WORD_FIELDS];
+        int shift[WORD_FIELDS];
+        layout_lsbs(layout, lsb);
+        for (int f = 0; f < WORD_FIELDS; f++) {
+                shift[f] = 64 - field_limit(layout, f);
+        }
+
+        /* 
+         * step 2 - decode the fields. bits holds the next nbits of the 
+         * stream at its top, and is refilled (see get_bits()) before any
+         * word whose codes might not all be in it. An unknown code has 
+         * length 0, which is checked once per word
+         */
+        const unsigned char *start = p;
+        int word_bits = word_bits_limit(layout);
+        uint64_t bits = 0;
+        int nbits = 0;
+        for (long i = 0; i < nwords; i++) {
+                if (nbits < word_bits) {
+                        p = get_bits(p, end, &bits, &nbits);
+                }
+                uint32_t word = 0;
+                int unknown = 0;
+                for (int f = 0; f < WORD_FIELDS; f++) {
+                        uint16_t entry = table[f][bits >> shift[f]];
+                        int code_length = entry & 0xf;
+                        unknown |= code_length == 0;
+                        bits <<= code_length;
+                        nbits -= code_length;
+                        word |= (uint32_t)(entry >> 4) << lsb[f];
+                }
+                if (unknown) {
+                        return false;
+                }
+                words[i] = word;
+        }
+
+        /* every bit used must have come from the tile */
+        long used = (p - start) * 8L - nbits;
+        return used <= (end - start) * 8L;
+}
+
+
+/********** rle_bound ********
+ *
+ * Purpose: Gives the most bytes rle_encode() can write for a tile
+ *
+ * Parameters:
+ *      - nwords: the number of words in the tile
+ *
+ * Return: the size of buffer rle_encode() needs
+ *
+ * Expects: none
+ *
+ * CRE: none
+ *
+ * Notes:
+ *      - The worst case is a tile without runs: 4 bytes a word plus one 
+ *        packet byte for every MAX_PACKET words
+ */
+long rle_bound(long nwords)
+{
+        return nwords * 4 + (nwords + MAX_PACKET - 1) / MAX_PACKET;
+}
+
+/********** rle_least ********
+ *
+ * Purpose: Gives the fewest bytes an RLE coded tile can take
+ *
+ * Parameters:
+ *      - nwords: the number of words in the tile
+ *
+ * Return: a lower bound on the size of any tile rle_decode() accepts
+ *
+ * Expects: none
+ *
+ * CRE: nwords is negative
+ *
+ * Notes:
+ *      - The best case is a tile of runs: a packet byte and a word for
+ *        every MAX_PACKET words
+ */
+long rle_least(long nwords)
+{
+        assert(nwords >= 0);
+        return (nwords + MAX_PACKET - 1) / MAX_PACKET * 5;
+}
+
+/********** rle_encode ********
+ *
+ * Purpose: Codes the words of one tile as runs and literals
+ *
+ * Parameters:
+ *      - words: the tile's words
+ *      - nwords: the number of words
+ *      - out: where to write the tile's bytes
+ *
+ * Return: the number of bytes written
+ *
+ * Expects: out has room for rle_bound(nwords) bytes
+ *
+ * CRE: words or out is null
+ *
+ * Notes:
+ *      - Two equal words already make a run: 5 bytes instead of 8
+ */
+long rle_encode(const uint32_t *words, long nwords, unsigned char *out)
+{
+        assert(words != NULL);
+        assert(out != NULL);
+
+        unsigned char *p = out;
+        long i = 0;
+        while (i < nwords) {
+                long run = run_length(words, nwords, i);
+                if (run > 1) {
+                        *p++ = RUN_PACKET + run - 1;
+                        p = put_word(p, words[i]);
+                        i += run;
+                        continue;
+                }
+
+                /* a literal lasts until the next run */
+                long start = i;
+                while (i < nwords && i - start < MAX_PACKET && 
+                       run_length(words, nwords, i) == 1) {
+                        i++;
+                }
+                *p++ = i - start - 1;
+                for (long j = start; j < i; j++) {
+                        p = put_word(p, words[j]);
+                }
+        }
+        return p - out;
+}
+
+/********** rle_decode ********
+ *
+ * Purpose: Turns the bytes of a run-length coded tile back into its words
+ *
+ * Parameters:
+ *      - bytes: the tile's bytes
+ *      - length: the number of bytes
+ *      - words: where to store the words
+ *      - nwords: the number of words the tile holds
+ *
+ * Return: true if the bytes were a valid tile of nwords words, false 
+ *         otherwise
+ *
+ * Expects: none
+ *
+ * CRE: bytes or words is null
+ *
+ * Notes:
+ *      - A run's word is converted once and then copied with memcpy(), 
+ *        doubling the copied part each time
+ */
+bool rle_decode(const unsigned char *bytes, long length, uint32_t *words,
+                long nwords)
+{
+        assert(bytes != NULL);
+        assert(words != NULL);
+
+        const unsigned char *p = bytes;
+        const unsigned char *end = bytes + length;
+        long i = 0;
+        while (p < end) {
+                int packet = *p++;
+                long count = packet < RUN_PACKET ? packet + 1 : 
+                                                   packet - RUN_PACKET + 1;
+                long size = packet < RUN_PACKET ? 4 * count : 4;
+                if (count > nwords - i || size > end - p) {
+                        return false;
+                }
+
+                if (packet < RUN_PACKET) {
+                        for (long j = 0; j < count; j++) {
+                                words[i + j] = get_word(p + 4 * j);
+                        }
+                } else {
+                        words[i] = get_word(p);
+                        for (long done = 1; done < count; done *= 2) {
+                                long copy = done < count - done ? done :
+                                                                  count - done;
+                                memcpy(words + i + done, words + i, 
+                                       copy * sizeof(uint32_t));
+                        }
+                }
+                p += size;
+                i += count;
+        }
+        return i == nwords;
+}
+
+
+/**************************/
+/*    Helper functions    */
+/**************************/
+
+
+/********** field_symbols ********
+ *
+ * Purpose: Gives the number of values a field of a packed word can take
+ *
+ * Parameters:
+ *      - layout: the layout of the words
+ *      - field: the field's index
+ *
+ * Return: 2 to the power of the field's width
+ *
+ * Expects: none
+ *
+ * CRE: the field has more than MAX_SYMBOLS values
+ */
+static int field_symbols(const struct word_layout *layout, int field)
+{
+        int nsyms = 1 << layout->width[field];
+        assert(nsyms <= MAX_SYMBOLS);
+        return nsyms;
+}
+
+/********** field_limit ********
+ *
+ * Purpose: Gives the longest code allowed for a field
+ *
+ * Parameters:
+ *      - layout: the layout of the words
+ *      - field: the field's index
+ *
+ * Return: the field's width plus LIMIT_SLACK, but at most MAX_CODE_LENGTH
+ *
+ * Expects: none
+ *
+ * CRE: none
+ */
+static int field_limit(const struct word_layout *layout, int field)
+{
+        int limit = layout->width[field] + LIMIT_SLACK;
+        return limit < MAX_CODE_LENGTH ? limit : MAX_CODE_LENGTH;
+}
+
+/********** word_bits_limit ********
+ *
+ * Purpose: Gives the most bits the codes of one word can take
+ *
+ * Parameters:
+ *      - layout: the layout of the words
+ *
+ * Return: the sum of every field's field_limit()
+ *
+ * Expects: none
+ *
+ * CRE: the sum is more than 56, the fewest bits get_bits() guarantees
+ *      (and with at most 7 bits waiting, the most put_bits() can take)
+ */
+static int word_bits_limit(const struct word_layout *layout)
+{
+        int total = 0;
+        for (int f = 0; f < WORD_FIELDS; f++) {
+                total += field_limit(layout, f);
+        }
+        assert(total <= 56);
+        return total;
+}
+
+/********** build_lengths ********
+ *
+ * Purpose: Finds the code length of each value of a field, for a Huffman
+ *          code no longer than limit bits
+ *
+ * Parameters:
+ *      - freq: how often each value occurs
+ *      - nsyms: the number of values
+ *      - limit: the longest code allowed; 2 to the limit is at least nsyms
+ *      - lengths: where to store each value's code length
+ *
+ * Return: none
+ *
+ * Expects: none
+ *
+ * CRE: freq or lengths is null
+ *
+ * Notes:
+ *      - If the best code is too long, the counts are halved (keeping
+ *        every used value's count at least 1) and the code rebuilt. That
+ *        ends once the counts are flat enough, at worst with a balanced
+ *        code of log2(nsyms) bits
+ *      - A field with one value gets a 1-bit code so it still takes
+ *        space in the stream and can be decoded
+ */
+static void build_lengths(const uint32_t *freq, int nsyms, int limit, 
+                          uint8_t *lengths)
+{
+        assert(freq != NULL);
+        assert(lengths != NULL);
+
+        leaf leaves[MAX_SYMBOLS];
+        uint64_t scale = 0;
+
+        while (true) {
+                int n = 0;
+                for (int s = 0; s < nsyms; s++) {
+                        lengths[s] = 0;
+                        if (freq[s] > 0) {
+                                /* round up so used values stay used */
+                                uint64_t w = ((uint64_t)freq[s] +
+                                              ((1ULL << scale) - 1)) >> scale;
+                                leaves[n].weight = w;
+                                leaves[n].symbol = s;
+                                n++;
+                        }
+                }
+                if (n == 0) {
+                        return;
+                }
+                if (n == 1) {
+                        lengths[leaves[0].symbol] = 1;
+                        return;
+                }
+
+                qsort(leaves, n, sizeof(leaf), compare_leaves);
+                if (tree_lengths(leaves, n, limit, lengths)) {
+                        return;
+                }
+                scale++;
+        }
+}
+
+/********** tree_lengths ********
+ *
+ * Purpose: Builds a Huffman tree over sorted leaves and records each
+ *          leaf's depth as its value's code length
+ *
+ * Parameters:
+ *      - leaves: the used values, in order of increasing weight
+ *      - n: the number of leaves, at least 2
+ *      - limit: the longest code allowed
+ *      - lengths: where to store each value's code length
+ *
+ * Return: true if no code is longer than limit, false (with lengths 
+ *         unchanged) otherwise
+ *
+ * Expects: none
+ *
+ * CRE: leaves or lengths is null
+ *
+ * Notes:
+ *      - Uses the two-queue method: merged nodes are made in order of
+ *        increasing weight, so the two lightest nodes are always at the
+ *        front of the leaf queue or the merged-node queue
+ */
+static bool tree_lengths(leaf *leaves, int n, int limit, uint8_t *lengths)
+{
+        assert(leaves != NULL);
+        assert(lengths != NULL);
+
+        /* nodes 0 to n-1 are leaves; n to 2n-2 are merged nodes */
+        uint64_t weight[2 * MAX_SYMBOLS];
+        int parent[2 * MAX_SYMBOLS];
+        int depth[2 * MAX_SYMBOLS];
+        for (int i = 0; i < n; i++) {
+                weight[i] = leaves[i].weight;
+        }
+
+        int next_leaf = 0;
+        int next_merged = n;
+        for (int k = n; k < 2 * n - 1; k++) {
+                int pick[2];
+                for (int j = 0; j < 2; j++) {
+                        if (next_leaf < n && (next_merged >= k ||
+                            weight[next_leaf] <= weight[next_merged])) {
+                                pick[j] = next_leaf++;
+                        } else {
+                                pick[j] = next_merged++;
+                        }
+                }
+                weight[k] = weight[pick[0]] + weight[pick[1]];
+                parent[pick[0]] = k;
+                parent[pick[1]] = k;
+        }
+
+        /* parents come after their children, so work from the root down */
+        depth[2 * n - 2] = 0;
+        for (int i = 2 * n - 3; i >= 0; i--) {
+                depth[i] = depth[parent[i]] + 1;
+                if (i < n && depth[i] > limit) {
+                        return false;
+                }
+        }
+
+        for (int i = 0; i < n; i++) {
+                lengths[leaves[i].symbol] = depth[i];
+        }
+        return true;
+}
+
+/********** compare_leaves ********
+ *
+ * Purpose: qsort() comparison putting leaves in order of increasing
+ *          weight, ties broken by value so codes don't depend on qsort
+ *
+ * Parameters:
+ *      - a, b: pointers to the leaves to compare
+ *
+ * Return: negative, zero, or positive as a comes before, with, or after b
+ *
+ * Expects: none
+ *
+ * CRE: none
+ */
+static int compare_leaves(const void *a, const void *b)
+{
+        const leaf *x = a;
+        const leaf *y = b;
+        if (x->weight != y->weight) {
+                return x->weight < y->weight ? -1 : 1;
+        }
+        return x->symbol - y->symbol;
+}
+
+/********** assign_codes ********
+ *
+ * Purpose: Gives each value the bits of its canonical Huffman code
+ *
+ * Parameters:
+ *      - lengths: each value's code length (0 if unused)
+ *      - nsyms: the number of values
+ *      - codes: where to store each value's code
+ *
+ * Return: none
+ *
+ * Expects: the lengths are no longer than MAX_CODE_LENGTH
+ *
+ * CRE: lengths or codes is null
+ *
+ * Notes:
+ *      - Codes of each length are consecutive, in order of value, and
+ *        shorter codes come first, so the lengths alone fix the code
+ */
+static void assign_codes(const uint8_t *lengths, int nsyms, uint16_t *codes)
+{
+        assert(lengths != NULL);
+        assert(codes != NULL);
+
+        int count[MAX_CODE_LENGTH + 1] = { 0 };
+        for (int s = 0; s < nsyms; s++) {
+                count[lengths[s]]++;
+        }
+        count[0] = 0;
+
+        uint16_t next[MAX_CODE_LENGTH + 1];
+        uint16_t code = 0;
+        next[0] = 0;
+        for (int len = 1; len <= MAX_CODE_LENGTH; len++) {
+                code = (code + count[len - 1]) << 1;
+                next[len] = code;
+        }
+
+        for (int s = 0; s < nsyms; s++) {
+                if (lengths[s] > 0) {
+                        codes[s] = next[lengths[s]]++;
+                }
+        }
+}
+
+/********** build_table ********
+ *
+ * Purpose: Builds the decoding table of a field's code from its lengths
+ *
+ * Parameters:
+ *      - lengths: each value's code length (0 if unused)
+ *      - nsyms: the number of values
+ *      - limit: the longest code allowed for the field
+ *      - table: the table to fill in, with room for 2 to the limit entries
+ *
+ * Return: true if the lengths describe a valid code, false otherwise
+ *
+ * Expects: none
+ *
+ * CRE: lengths or table is null
+ *
+ * Notes:
+ *      - An entry is indexed by the next limit bits of the
+ *        stream and holds the value those bits start with (shifted left
+ *        4) and its code length, or 0 if no code starts that way
+ */
+static bool build_table(const uint8_t *lengths, int nsyms, int limit, 
+                        uint16_t *table)
+{
+        assert(lengths != NULL);
+        assert(table != NULL);
+
+        /* the codes must fit in the table without overlapping */
+        long space = 0;
+        for (int s = 0; s < nsyms; s++) {
+                if (lengths[s] > limit) {
+                        return false;
+                }
+                if (lengths[s] > 0) {
+                        space += 1L << (limit - lengths[s]);
+                }
+        }
+        if (space > 1L << limit) {
+                return false;
+        }
+
+        uint16_t codes[MAX_SYMBOLS];
+        assign_codes(lengths, nsyms, codes);
+
+        memset(table, 0, (1L << limit) * sizeof(uint16_t));
+        for (int s = 0; s < nsyms; s++) {
+                int len = lengths[s];
+                if (len == 0) {
+                        continue;
+                }
+                long first = (long)codes[s] << (limit - len);
+                long span = 1L << (limit - len);
+                for (long i = first; i < first + span; i++) {
+                        table[i] = s << 4 | len;
+                }
+        }
+        return true;
+}
+
+/********** put_bits ********
+ *
+ * Purpose: Writes the whole bytes of the bits waiting to be written
+ *
+ * Parameters:
+ *      - p: where the next byte of the stream goes
+ *      - bits: the waiting bits, at the bottom of the word
+ *      - nbits: the number of waiting bits, between 1 and 63; updated to
+ *               the number still waiting (less than 8)
+ *
+ * Return: where the next byte of the stream goes
+ *
+ * Expects: 8 bytes can be written at p
+ *
+ * CRE: none
+ *
+ * Notes:
+ *      - Always stores 8 bytes, most significant first, and then steps
+ *        over only the whole ones, which avoids a loop and a branch per
+ *        byte. The bytes past the whole ones are rewritten next time
+ */
+static inline unsigned char *put_bits(unsigned char *p, uint64_t bits, 
+                                      int *nbits)
+{
+        uint64_t top = __builtin_bswap64(bits << (64 - *nbits));
+        memcpy(p, &top, sizeof(top));
+        p += *nbits >> 3;
+        *nbits &= 7;
+        return p;
+}
+
+/********** get_bits ********
+ *
+ * Purpose: Refills the bit buffer of the decoder
+ *
+ * Parameters:
+ *      - p: the next byte of the stream not yet in the buffer
+ *      - end: the end of the stream
+ *      - bits: the buffer, with its bits at the top
+ *      - nbits: the number of bits in the buffer; updated to at least 56
+ *
+ * Return: the next byte of the stream not yet in the buffer
+ *
+ * Expects: none
+ *
+ * CRE: none
+ *
+ * Notes:
+ *      - With 8 bytes left, loads all 8 at once and keeps as many whole 
+ *        bytes as fit. The bits of a partly kept byte are the same ones
+ *        the next refill loads, so or-ing them in again is harmless
+ *      - Near the end, goes a byte at a time and feeds zeros past the end
+ *        (and p past end), which the caller checks for
+ */
+static inline const unsigned char *get_bits(const unsigned char *p, 
+                                            const unsigned char *end,
+                                            uint64_t *bits, int *nbits)
+{
+        if (end - p >= 8) {
+                uint64_t next;
+                memcpy(&next, p, sizeof(next));
+                *bits |= __builtin_bswap64(next) >> *nbits;
+                p += (63 - *nbits) >> 3;
+                *nbits |= 56;
+                return p;
+        }
+
+        while (*nbits <= 56) {
+                uint64_t byte = p < end ? *p : 0;
+                *bits |= byte << (56 - *nbits);
+                p++;
+                *nbits += 8;
+        }
+        return p;
+}
+
+/********** run_length ********
+ *
+ * Purpose: Counts the copies of a word that start a stretch of a tile
+ *
+ * Parameters:
+ *      - words: the tile's words
+ *      - nwords: the number of words
+ *      - i: where the stretch starts
+ *
+ * Return: how many words from i on equal words[i], at most MAX_PACKET
+ *
+ * Expects: i < nwords
+ *
+ * CRE: none
+ */
+static long run_length(const uint32_t *words, long nwords, long i)
+{
+        long run = 1;
+        while (i + run < nwords && run < MAX_PACKET && 
+               words[i + run] == words[i]) {
+                run++;
+        }
+        return run;
+}
+
+/********** put_word ********
+ *
+ * Purpose: Writes a word as 4 big-endian bytes
+ *
+ * Parameters:
+ *      - p: where to write
+ *      - word: the word
+ *
+ * Return: the byte after the word
+ *
+ * Expects: p has room for 4 bytes
+ *
+ * CRE: none
+ */
+static unsigned char *put_word(unsigned char *p, uint32_t word)
+{
+        p[0] = word >> 24;
+        p[1] = word >> 16;
+        p[2] = word >> 8;
+        p[3] = word;
+        return p + 4;
+}
+
+/********** get_word ********
+ *
+ * Purpose: Reads a word from 4 big-endian bytes
+ *
+ * Parameters:
+ *      - p: the bytes
+ *
+ * Return: the word
+ *
+ * Expects: p points at 4 readable bytes
+ *
+ * CRE: none
+ */
+static uint32_t get_word(const unsigned char *p)
+{
+        return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | 
+               (uint32_t)p[2] << 8 | p[3];
+}
@@ -0,0 +1,46 @@
+/**************************************************************
+ *
+ *                     entropy.h
+ *
+ *     Assignment: Arith
+ *     Authors:  Marielle Cibella (mcibel01), Erica Huang (ehuang02)
+ *     Date:     4/20/25
+ *
+ *     Summary:
+ *
+ *     This header file declares the entropy coders for the tiles of a
+ *     tiled compressed image (see print_compressed_tiled() in
+ *     read_write.c). The Huffman coder codes each field of the packed
+ *     words (a, b, c, d, Pb_avg, Pr_avg) with its own canonical Huffman
+ *     code, so a tile of mostly-zero b, c, and d values and repeated
+ *     chroma indices takes far fewer than 32 bits per word. Any layout
+ *     of one word (see struct word_layout in codec.h) whose fields have
+ *     at most 9 bits can be Huffman coded. The 
+ *     run-length coder stores each run of equal words (a flat region) 
+ *     as one word and a count.
+ *
+ *
+ **************************************************************/
+
+#ifndef ENTROPY
+#define ENTROPY
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "codec.h"
+
+bool huffman_supports(const struct word_layout *layout);
+long huffman_bound(long nwords, const struct word_layout *layout);
+long huffman_least(long nwords);
+long huffman_encode(const uint32_t *words, long nwords, unsigned char *out,
+                    const struct word_layout *layout);
+bool huffman_decode(const unsigned char *bytes, long length, uint32_t *words,
+                    long nwords, const struct word_layout *layout);
+
+long rle_bound(long nwords);
+long rle_least(long nwords);
+long rle_encode(const uint32_t *words, long nwords, unsigned char *out);
+bool rle_decode(const unsigned char *bytes, long length, uint32_t *words,
+                long nwords);
+
+#endif
@@ -0,0 +1,1624 @@
+/**************************************************************
+ *
+ *                     equivalence.c
+ *
+ *     Assignment: Arith
+ *     Authors:  Marielle Cibella (mcibel01), Erica Huang (ehuang02)
+ *     Date:     4/25/25
+ *
+ *     Summary:
+ *
+ *     equivalence.c checks each faster path of the codec against the
+ *     staged code it stands in for, on randomized images: odd sizes
+ *     (which the codec trims, or pads for larger blocks), saturated and
+ *     checkerboard colors, flat
+ *     and smooth regions, and maxvals of 1, 255, 65535, and anything in
+ *     between. The paths checked are:
+ *
+ *          - the fixed-point Y/Pb/Pr pixels of rgb_to_ypbpr() against
+ *            the formula in doubles, to within half a fixed-point step
+ *          - the staged pipeline on flat pool arrays (a2pool.h) against
+ *            the same pipeline on UArray2s (a2plain.h): identical words
+ *            and identical decoded pixels
+ *          - pack_words_with() on the default layout against
+ *            make_word_array() and pack_word(): identical words
+ *          - unpack_words_with() on the default layout against
+ *            unpack_word() and decompress_words(): decoded pixels within
+ *            UNPACK_BOUND of each other
+ *          - tiled, Huffman, run-length, and predicted streams, untiled
+ *            ones included, against the plain format 2 stream: 
+ *            identical decompressed images
+ *          - every instruction set level of cpu.h the processor supports
+ *            against the generic kernels: identical compressed and
+ *            decompressed streams, for 2x2, 4x4, and 8x8 blocks
+ *          - the pipelined codec (pipeline.h), on one thread and several,
+ *            against the whole-image codec: identical compressed and
+ *            decompressed streams
+ *          - 4x4 and 8x8 blocks padded out past the image's edges: the
+ *            decompressed image keeps the input's size, and a region
+ *            decoded on its own (decompress40_region()) is identical to
+ *            the same crop of the whole image
+ *          - the RMSD compress40_verify() gives against the RMSD of the
+ *            decompressed image: within VERIFY_BOUND, and 0 for an image
+ *            that trims to no pixels
+ *
+ *     Image i is made from seed + i alone, so any image can be made
+ *     again. Images 1 pixel wide or tall (THIN_SIZES), which trim to no
+ *     blocks, are checked first. When a check fails, the image is cropped to the 2x2 block
+ *     and then the 16x16 tile holding the first mismatch, and the
+ *     smallest crop that still fails is written as a PPM, so the failure
+ *     can be replayed with 40image or a debugger.
+ *
+ *     Usage: equivalence [-n images] [-s seed] [-o dir]
+ *
+ *
+ **************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdarg.h>
+#include <string.h>
+#include <math.h>
+#include "assert.h"
+#include "mem.h"
+#include <a2methods.h>
+#include <a2plain.h>
+#include <pnm.h>
+#include "a2pool.h"
+#include "pool.h"
+#include "codec.h"
+#include "ry_conversion.h"
+#include "word.h"
+#include "read_write.h"
+#include "cpu.h"
+
+/* the denominator decoded pixels are scaled to, as 40image writes them */
+#define DECODE_DENOMINATOR 225
+
+/* how far rgb_to_ypbpr() may be from the formula: half a 1/16384 step */
+#define YPBPR_BOUND (0.5 / 16384 + 1e-6)
+
+/* how far, in levels of DECODE_DENOMINATOR, the unpackers may differ */
+#define UNPACK_BOUND 1
+
+/* how far compress40_verify()'s RMSD may be from the decompressed one's */
+#define VERIFY_BOUND 1e-9
+
+/* the largest side of a random image */
+#define MAX_SIDE 67
+
+/* the side of the second, larger crop tried for a reproducer */
+#define REPRODUCER_TILE 16
+
+/* the kinds of random image */
+enum content {
+        NOISE,          /* every sample random */
+        SATURATED,      /* every sample 0 or maxval */
+        CHECKER,        /* black and white pixels alternating */
+        FLAT,           /* one random color */
+        GRADIENT,       /* smooth ramps of each channel */
+        NUM_CONTENTS
+};
+
+/* a test image: its size, maxval, and 3 samples per pixel, row-major */
+typedef struct test_image {
+        unsigned width, height, maxval;
+        unsigned *samples;
+} test_image;
+
+/*
+ * what a check found: whether the paths agreed, the largest difference
+ * seen (in the check's own unit), and for a mismatch, the pixel of the
+ * first one (-1 if not known) and what differed there
+ */
+typedef struct outcome {
+        bool equal;
+        double worst;
+        int col, row;
+        char detail[160];
+} outcome;
+
+/* a check: its name, the bound its differences are held to, and a run */
+typedef struct check {
+        const char *name;
+        double bound;
+        void (*run)(const char *ppm, size_t length, outcome *result);
+} check;
+
+/* helper functions */
+static void make_image(test_image *image, uint64_t seed, unsigned width,
+                       unsigned height);
+static void crop_image(const test_image *image, test_image *crop,
+                       unsigned col, unsigned row, unsigned width,
+                       unsigned height);
+static char *image_ppm(const test_image *image, size_t *length);
+static uint64_t next_random(uint64_t *state);
+static bool run_check(const check *c, const test_image *image,
+                      outcome *result);
+static void write_reproducer(const check *c, const test_image *image,
+                             const outcome *result, uint64_t seed,
+                             const char *dir);
+static Pnm_ppm read_ppm(const char *ppm, size_t length, A2Methods_T methods);
+static void mismatch(outcome *result, int col, int row, const char *format,
+                     ...);
+static void note_difference(outcome *result, double difference);
+static void compare_words(A2Methods_UArray2 expected,
+                          A2Methods_T expected_methods,
+                          A2Methods_UArray2 actual,
+                          A2Methods_T actual_methods, outcome *result);
+static void compare_pixels(A2Methods_UArray2 expected,
+                           A2Methods_T expected_methods,
+                           A2Methods_UArray2 actual,
+                           A2Methods_T actual_methods, unsigned bound,
+                           outcome *result);
+static char *run_codec(const char *input, size_t length,
+                       const struct codec_options *options, bool compress,
+                       int nthreads, size_t *output_length);
+static bool compare_streams(const char *expected, size_t expected_length,
+                            const char *actual, size_t actual_length,
+                            bool ppm, outcome *result, const char *format,
+                            ...);
+static void check_ypbpr(const char *ppm, size_t length, outcome *result);
+static void check_pool_arrays(const char *ppm, size_t length,
+                              outcome *result);
+static void check_generic_pack(const char *ppm, size_t length,
+                               outcome *result);
+static void check_generic_unpack(const char *ppm, size_t length,
+                                 outcome *result);
+static void check_coded_streams(const char *ppm, size_t length,
+                                outcome *result);
+static void check_cpu_levels(const char *ppm, size_t length,
+                             outcome *result);
+static void check_pipelined(const char *ppm, size_t length,
+                            outcome *result);
+static void check_padded_blocks(const char *ppm, size_t length,
+                                outcome *result);
+static char *decode_region(const char *compressed, size_t length, 
+                           unsigned col, unsigned row, unsigned width,
+                           unsigned height, size_t *output_length);
+static char *crop_ppm(const char *ppm, unsigned col, unsigned row, 
+                      unsigned width, unsigned height, 
+                      size_t *output_length);
+static void check_verify(const char *ppm, size_t length, outcome *result);
+static double image_rmsd(Pnm_ppm original, Pnm_ppm decoded);
+static void usage(const char *progname);
+
+static const check CHECKS[] = {
+        { "fixed-point ypbpr", YPBPR_BOUND, check_ypbpr },
+        { "pool vs plain arrays", 0, check_pool_arrays },
+        { "generic word packer", 0, check_generic_pack },
+        { "generic word unpacker", UNPACK_BOUND, check_generic_unpack },
+        { "tiled and coded streams", 0, check_coded_streams },
+        { "cpu levels", 0, check_cpu_levels },
+        { "pipelined streams", 0, check_pipelined },
+        { "padded blocks", 0, check_padded_blocks },
+        { "verify rmsd", VERIFY_BOUND, check_verify }
+};
+#define NUM_CHECKS (sizeof(CHECKS) / sizeof(CHECKS[0]))
+
+/* the streams check_coded_streams() compares with plain format 2 */
+static const struct codec_options CODED_OPTIONS[] = {
+        { 16, CODING_RAW, PREDICT_NONE, 2, WORD_LAYOUT_DEFAULTS },
+        { 16, CODING_HUFFMAN, PREDICT_NONE, 2, WORD_LAYOUT_DEFAULTS },
+        { 8, CODING_RLE, PREDICT_NONE, 2, WORD_LAYOUT_DEFAULTS },
+        { 16, CODING_HUFFMAN, PREDICT_LEFT, 2, WORD_LAYOUT_DEFAULTS },
+        { 16, CODING_HUFFMAN, PREDICT_ABOVE, 2, WORD_LAYOUT_DEFAULTS },
+        { 4, CODING_HUFFMAN, PREDICT_MEDIAN, 2, WORD_LAYOUT_DEFAULTS },
+        { 0, CODING_HUFFMAN, PREDICT_LEFT, 2, WORD_LAYOUT_DEFAULTS },
+        { 0, CODING_RLE, PREDICT_NONE, 2, WORD_LAYOUT_DEFAULTS }
+};
+#define NUM_CODED_OPTIONS (sizeof(CODED_OPTIONS) / sizeof(CODED_OPTIONS[0]))
+
+/* the streams check_cpu_levels() makes at each level */
+static const struct codec_options LEVEL_OPTIONS[] = {
+        { 0, CODING_RAW, PREDICT_NONE, 2, WORD_LAYOUT_DEFAULTS },
+        { 16, CODING_RAW, PREDICT_NONE, 2, WORD_LAYOUT_DEFAULTS },
+        { 0, CODING_RAW, PREDICT_NONE, 4, WORD_LAYOUT_DEFAULTS },
+        { 0, CODING_RAW, PREDICT_NONE, 8, WORD_LAYOUT_DEFAULTS }
+};
+#define NUM_LEVEL_OPTIONS (sizeof(LEVEL_OPTIONS) / sizeof(LEVEL_OPTIONS[0]))
+
+/* the streams check_padded_blocks() decodes whole and a region at a time */
+static const struct codec_options PADDED_OPTIONS[] = {
+        { 0, CODING_RAW, PREDICT_NONE, 4, WORD_LAYOUT_DEFAULTS },
+        { 0, CODING_RAW, PREDICT_NONE, 8, WORD_LAYOUT_DEFAULTS },
+        { 2, CODING_RLE, PREDICT_NONE, 8, WORD_LAYOUT_DEFAULTS }
+};
+#define NUM_PADDED_OPTIONS \
+        (sizeof(PADDED_OPTIONS) / sizeof(PADDED_OPTIONS[0]))
+
+/* 
+ * the threads check_pipelined() runs the pipelined codec with: one 
+ * worker, whose ring of bands is small enough to wrap on a tall image, 
+ * and several
+ */
+static const int PIPELINE_THREADS[] = { 1, 3 };
+#define NUM_PIPELINE_THREADS \
+        (sizeof(PIPELINE_THREADS) / sizeof(PIPELINE_THREADS[0]))
+
+/* 
+ * the sizes of the thin images checked before the random ones: 1 pixel 
+ * wide or tall, which trim to no blocks at all
+ */
+static const unsigned THIN_SIZES[][2] = {
+        { 1, 1 }, { 1, 2 }, { 1, 50 }, { 2, 1 }, { 50, 1 }, { 3, 1 }
+};
+#define NUM_THIN_SIZES (sizeof(THIN_SIZES) / sizeof(THIN_SIZES[0]))
+
+/********** main ********
+ *
+ * Purpose: Runs every check on each random image
+ *
+ * Parameters:
+ *     - argc: the number of command-line arguments
+ *     - argv: equivalence [-n images] [-s seed] [-o dir]
+ *
+ * Return: EXIT_SUCCESS if every check passed on every image, otherwise
+ *         EXIT_FAILURE
+ *
+ * Expects: none
+ *
+ * CRE: memory can't be allocated
+ *
+ * Notes:
+ *     - 200 images from seed 1 by default, with reproducers written to
+ *       the current directory. Each check's first failure gets a
+ *       reproducer; later ones are only counted
+ *     - The NUM_THIN_SIZES images of THIN_SIZES come first, made from 
+ *       the seeds after the random images' (seed + nimages on)
+ */
+int main(int argc, char *argv[])
+{
+        int nimages = 200;
+        uint64_t seed = 1;
+        const char *dir = ".";
+
+        for (int i = 1; i < argc; i++) {
+                if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+                        nimages = atoi(argv[++i]);
+                } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+                        seed = strtoull(argv[++i], NULL, 10);
+                } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+                        dir = argv[++i];
+                } else {
+                        usage(argv[0]);
+                }
+        }
+        if (nimages <= 0) {
+                usage(argv[0]);
+        }
+
+        Pool_T pool = Pool_new(0);
+        Pool_use(pool);
+
+        int failures[NUM_CHECKS] = { 0 };
+        double worst[NUM_CHECKS] = { 0 };
+        for (int i = -(int)NUM_THIN_SIZES; i < nimages; i++) {
+                test_image image;
+                uint64_t image_seed = seed + i;
+                if (i < 0) {
+                        int thin = i + NUM_THIN_SIZES;
+                        image_seed = seed + nimages + thin;
+                        make_image(&image, image_seed, THIN_SIZES[thin][0],
+                                   THIN_SIZES[thin][1]);
+                } else {
+                        make_image(&image, image_seed, 0, 0);
+                }
+                for (unsigned c = 0; c < NUM_CHECKS; c++) {
+                        outcome result;
+                        bool passed = run_check(&CHECKS[c], &image, &result);
+                        if (result.worst > worst[c]) {
+                                worst[c] = result.worst;
+                        }
+                        if (!passed && failures[c]++ == 0) {
+                                write_reproducer(&CHECKS[c], &image, &result,
+                                                 image_seed, dir);
+                        }
+                }
+                free(image.samples);
+        }
+
+        printf("%d images from seed %llu, after %d thin ones\n", nimages,
+               (unsigned long long)seed, (int)NUM_THIN_SIZES);
+        printf("%-26s %10s %12s %12s\n", "check", "mismatches", "worst",
+               "bound");
+        int total = 0;
+        for (unsigned c = 0; c < NUM_CHECKS; c++) {
+                printf("%-26s %10d %12.4g %12.4g\n", CHECKS[c].name,
+                       failures[c], worst[c], CHECKS[c].bound);
+                total += failures[c];
+        }
+
+        Pool_use(NULL);
+        Pool_free(&pool);
+        return total == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/**************************/
+/*    Helper functions    */
+/**************************/
+
+
+/********** make_image ********
+ *
+ * Purpose: Makes the random image for a seed
+ *
+ * Parameters:
+ *     - image: where to make it
+ *     - seed: the seed
+ *     - width, height: the image's size, or 0 for a random one
+ *
+ * Return: none
+ *
+ * Expects: none
+ *
+ * CRE: image is null, or memory can't be allocated
+ *
+ * Notes:
+ *     - Sides are 1 to MAX_SIDE, so odd and degenerate sizes come up
+ *       often. The maxval is 1, 255, 65535, or random, a quarter of the
+ *       time each
+ *     - The caller frees image->samples with free()
+ */
+static void make_image(test_image *image, uint64_t seed, unsigned width,
+                       unsigned height)
+{
+        assert(image != NULL);
+        uint64_t state = seed * 0x9e3779b97f4a7c15ull + 1;
+
+        image->width = 1 + next_random(&state) % MAX_SIDE;
+        image->height = 1 + next_random(&state) % MAX_SIDE;
+        if (width != 0 && height != 0) {
+                image->width = width;
+                image->height = height;
+        }
+        switch (next_random(&state) % 4) {
+        case 0:  image->maxval = 1;     break;
+        case 1:  image->maxval = 255;   break;
+        case 2:  image->maxval = 65535; break;
+        default: image->maxval = 1 + next_random(&state) % 65535;
+        }
+        enum content content = next_random(&state) % NUM_CONTENTS;
+
+        unsigned max = image->maxval;
+        unsigned flat[3];
+        for (int k = 0; k < 3; k++) {
+                flat[k] = next_random(&state) % (max + 1);
+        }
+
+        long nsamples = 3L * image->width * image->height;
+        image->samples = malloc(nsamples * sizeof(unsigned));
+        assert(image->samples != NULL);
+        unsigned *sample = image->samples;
+        for (unsigned row = 0; row < image->height; row++) {
+                for (unsigned col = 0; col < image->width; col++) {
+                        for (int k = 0; k < 3; k++) {
+                                uint64_t r = next_random(&state);
+                                switch (content) {
+                                case NOISE:
+                                        *sample = r % (max + 1);
+                                        break;
+                                case SATURATED:
+                                        *sample = (r & 1) ? max : 0;
+                                        break;
+                                case CHECKER:
+                                        *sample = (col + row) % 2 ? max : 0;
+                                        break;
+                                case FLAT:
+                                        *sample = flat[k];
+                                        break;
+                                default:
+                                        *sample = (uint64_t)max *
+                                                  (k == 0 ? col :
+                                                   k == 1 ? row :
+                                                   col + row) /
+                                                  (k == 2 ? image->width +
+                                                   image->height :
+                                                   k == 0 ? image->width :
+                                                   image->height);
+                                }
+                                sample++;
+                        }
+                }
+        }
+}
+
+/********** crop_image ********
+ *
+ * Purpose: Copies a rectangle of an image into a new image
+ *
+ * Parameters:
+ *     - image: the image
+ *     - crop: where to make the copy
+ *     - col, row: the rectangle's top-left pixel
+ *     - width, height: the rectangle's size, clipped to the image
+ *
+ * Return: none
+ *
+ * Expects:
+ *     - (col, row) is in the image
+ *
+ * CRE: image or crop is null, or memory can't be allocated
+ */
+static void crop_image(const test_image *image, test_image *crop,
+                       unsigned col, unsigned row, unsigned width,
+                       unsigned height)
+{
+        assert(image != NULL && crop != NULL);
+        assert(col < image->width && row < image->height);
+
+        crop->width = width < image->width - col ? width :
+                                                   image->width - col;
+        crop->height = height < image->height - row ? height :
+                                                      image->height - row;
+        crop->maxval = image->maxval;
+        crop->samples = malloc(3L * crop->width * crop->height *
+                               sizeof(unsigned));
+        assert(crop->samples != NULL);
+        for (unsigned r = 0; r < crop->height; r++) {
+                memcpy(&crop->samples[3L * r * crop->width],
+                       &image->samples[3L * ((row + r) * image->width +
+                                             col)],
+                       3L * crop->width * sizeof(unsigned));
+        }
+}
+
+/********** image_ppm ********
+ *
+ * Purpose: Writes an image as a binary PPM in memory
+ *
+ * Parameters:
+ *     - image: the image
+ *     - length: where to store the PPM's length in bytes
+ *
+ * Return: the PPM, which the caller frees with free()
+ *
+ * Expects: none
+ *
+ * CRE: image or length is null, or memory can't be allocated
+ *
+ * Notes:
+ *     - Samples take 2 bytes, most significant first, when the maxval is
+ *       over 255, as the PPM format says
+ */
+static char *image_ppm(const test_image *image, size_t *length)
+{
+        assert(image != NULL && length != NULL);
+
+        char *ppm = NULL;
+        FILE *output = open_memstream(&ppm, length);
+        assert(output != NULL);
+        fprintf(output, "P6\n%u %u\n%u\n", image->width, image->height,
+                image->maxval);
+        long nsamples = 3L * image->width * image->height;
+        for (long i = 0; i < nsamples; i++) {
+                if (image->maxval > 255) {
+                        putc(image->samples[i] >> 8, output);
+                }
+                putc(image->samples[i] & 0xff, output);
+        }
+        fclose(output);
+        return ppm;
+}
+
+/********** next_random ********
+ *
+ * Purpose: Steps a xorshift64* generator
+ *
+ * Parameters:
+ *     - state: the generator's state, never 0
+ *
+ * Return: the next 64 random bits
+ *
+ * Expects: none
+ *
+ * CRE: state is null
+ */
+static uint64_t next_random(uint64_t *state)
+{
+        assert(state != NULL);
+        *state ^= *state >> 12;
+        *state ^= *state << 25;
+        *state ^= *state >> 27;
+        return *state * 0x2545f4914f6cdd1dull;
+}
+
+/********** run_check ********
+ *
+ * Purpose: Runs a check on an image
+ *
+ * Parameters:
+ *     - c: the check
+ *     - image: the image
+ *     - result: where to store what the check found
+ *
+ * Return: true if the paths agreed to within the check's bound
+ *
+ * Expects: none
+ *
+ * CRE: any argument is null, or memory can't be allocated
+ */
+static bool run_check(const check *c, const test_image *image,
+                      outcome *result)
+{
+        assert(c != NULL && image != NULL && result != NULL);
+        result->equal = true;
+        result->worst = 0;
+        result->col = result->row = -1;
+        result->detail[0] = '\0';
+
+        size_t length;
+        char *ppm = image_ppm(image, &length);
+        Pool_reset(Pool_current());
+        c->run(ppm, length, result);
+        free(ppm);
+        return result->equal;
+}
+
+/********** write_reproducer ********
+ *
+ * Purpose: Reports a failed check and writes the smallest crop of its
+ *          image that still fails
+ *
+ * Parameters:
+ *     - c: the check
+ *     - image: the image it failed on
+ *     - result: what it found
+ *     - seed: the image's seed
+ *     - dir: the directory to write the crop in
+ *
+ * Return: none
+ *
+ * Expects: none
+ *
+ * CRE: any argument is null, or memory can't be allocated
+ *
+ * Notes:
+ *     - The crops tried are the 2x2 block and then the REPRODUCER_TILE
+ *       square holding the first mismatch, both aligned as the codec
+ *       aligns them; if neither fails, or the mismatch has no pixel, the
+ *       whole image is written
+ *     - The file is dir/equivalence-<check>-<seed>.ppm; one that can't
+ *       be written is reported and skipped
+ */
+static void write_reproducer(const check *c, const test_image *image,
+                             const outcome *result, uint64_t seed,
+                             const char *dir)
+{
+        assert(c != NULL && image != NULL && result != NULL);
+        assert(dir != NULL);
+        fprintf(stderr, "equivalence: %s: seed %llu (%ux%u, maxval %u): "
+                "%s\n", c->name, (unsigned long long)seed, image->width,
+                image->height, image->maxval, result->detail);
+
+        test_image smallest = *image;
+        if (result->col >= 0 && result->row >= 0) {
+                static const unsigned sides[] = { 2, REPRODUCER_TILE };
+                for (int s = 0; s < 2; s++) {
+                        unsigned side = sides[s];
+                        test_image crop;
+                        outcome again;
+                        crop_image(image, &crop, result->col / side * side,
+                                   result->row / side * side, side, side);
+                        if (!run_check(c, &crop, &again)) {
+                                smallest = crop;
+                                break;
+                        }
+                        free(crop.samples);
+                }
+        }
+
+        char path[1024];
+        snprintf(path, sizeof(path), "%s/equivalence-", dir);
+        for (const char *n = c->name; *n != '\0' &&
+             strlen(path) < sizeof(path) - 32; n++) {
+                size_t end = strlen(path);
+                path[end] = (*n == ' ') ? '-' : *n;
+                path[end + 1] = '\0';
+        }
+        snprintf(path + strlen(path), sizeof(path) - strlen(path),
+                 "-%llu.ppm", (unsigned long long)seed);
+
+        size_t length;
+        char *ppm = image_ppm(&smallest, &length);
+        FILE *file = fopen(path, "wb");
+        if (file == NULL || fwrite(ppm, 1, length, file) != length) {
+                fprintf(stderr, "equivalence: cannot write '%s'\n", path);
+        } else {
+                fprintf(stderr, "equivalence:   reproducer %s (%ux%u)\n",
+                        path, smallest.width, smallest.height);
+        }
+        if (file != NULL) {
+                fclose(file);
+        }
+        free(ppm);
+        if (smallest.samples != image->samples) {
+                free(smallest.samples);
+        }
+}
+
+/********** read_ppm ********
+ *
+ * Purpose: Reads a PPM held in memory, trimmed to even sides as the
+ *          codec trims it
+ *
+ * Parameters:
+ *     - ppm, length: the PPM
+ *     - methods: the methods for its pixel array
+ *
+ * Return: the image, which the caller frees with Pnm_ppmfree()
+ *
+ * Expects: none
+ *
+ * CRE: ppm or methods is null, or memory can't be allocated
+ */
+static Pnm_ppm read_ppm(const char *ppm, size_t length, A2Methods_T methods)
+{
+        assert(ppm != NULL && methods != NULL);
+        FILE *input = fmemopen((void *)ppm, length, "rb");
+        assert(input != NULL);
+        Pnm_ppm image = read_and_trim_ppm(input, methods);
+        fclose(input);
+        return image;
+}
+
+/********** mismatch ********
+ *
+ * Purpose: Records that a check's paths disagreed, if they hadn't yet
+ *
+ * Parameters:
+ *     - result: what the check has found
+ *     - col, row: the pixel they disagreed at, or -1
+ *     - format, ...: what differed, as for printf()
+ *
+ * Return: none
+ *
+ * Expects: none
+ *
+ * CRE: result or format is null
+ *
+ * Notes:
+ *     - Only the first mismatch is kept
+ */
+static void mismatch(outcome *result, int col, int row, const char *format,
+                     ...)
+{
+        assert(result != NULL && format != NULL);
+        if (!result->equal) {
+                return;
+        }
+        result->equal = false;
+        result->col = col;
+        result->row = row;
+
+        va_list args;
+        va_start(args, format);
+        vsnprintf(result->detail, sizeof(result->detail), format, args);
+        va_end(args);
+}
+
+/********** note_difference ********
+ *
+ * Purpose: Keeps the largest difference a check has seen
+ *
+ * Parameters:
+ *     - result: what the check has found
+ *     - difference: a difference it has just seen
+ *
+ * Return: none
+ *
+ * Expects: none
+ *
+ * CRE: result is null
+ */
+static void note_difference(outcome *result, double difference)
+{
+        assert(result != NULL);
+        if (difference > result->worst) {
+                result->worst = difference;
+        }
+}
+
+/********** compare_words ********
+ *
+ * Purpose: Checks two arrays of 32-bit words are identical
+ *
+ * Parameters:
+ *     - expected, expected_methods: one array and its methods
+ *     - actual, actual_methods: the other and its methods
+ *     - result: where mismatches are recorded
+ *
+ * Return: none
+ *
+ * Expects:
+ *     - the arrays hold one word per 2x2 block
+ *
+ * CRE: any argument is null
+ *
+ * Notes:
+ *     - The difference noted is the number of bits that differ
+ */
+static void compare_words(A2Methods_UArray2 expected,
+                          A2Methods_T expected_methods,
+                          A2Methods_UArray2 actual,
+                          A2Methods_T actual_methods, outcome *result)
+{
+        assert(expected != NULL && expected_methods != NULL);
+        assert(actual != NULL && actual_methods != NULL);
+        assert(result != NULL);
+
+        int width = expected_methods->width(expected);
+        int height = expected_methods->height(expected);
+        if (actual_methods->width(actual) != width ||
+            actual_methods->height(actual) != height) {
+                mismatch(result, -1, -1, "%dx%d words, expected %dx%d",
+                         actual_methods->width(actual),
+                         actual_methods->height(actual), width, height);
+                return;
+        }
+        for (int row = 0; row < height; row++) {
+                for (int col = 0; col < width; col++) {
+                        uint32_t e = *(uint32_t *)expected_methods->at(
+                                                        expected, col, row);
+                        uint32_t a = *(uint32_t *)actual_methods->at(
+                                                        actual, col, row);
+                        note_difference(result, __builtin_popcount(e ^ a));
+                        if (e != a) {
+                                mismatch(result, 2 * col, 2 * row,
+                                         "word (%d, %d) is 0x%08x, "
+                                         "expected 0x%08x", col, row, a, e);
+                        }
+                }
+        }
+}
+
+/********** compare_pixels ********
+ *
+ * Purpose: Checks two arrays of Pnm_rgb pixels are within a bound of
+ *          each other
+ *
+ * Parameters:
+ *     - expected, expected_methods: one array and its methods
+ *     - actual, actual_methods: the other and its methods
+ *     - bound: how far apart any sample may be
+ *     - result: where mismatches are recorded
+ *
+ * Return: none
+ *
+ * Expects: none
+ *
+ * CRE: any pointer is null
+ *
+ * Notes:
+ *     - The difference noted is the largest sample difference
+ */
+static void compare_pixels(A2Methods_UArray2 expected,
+                           A2Methods_T expected_methods,
+                           A2Methods_UArray2 actual,
+                           A2Methods_T actual_methods, unsigned bound,
+                           outcome *result)
+{
+        assert(expected != NULL && expected_methods != NULL);
+        assert(actual != NULL && actual_methods != NULL);
+        assert(result != NULL);
+
+        int width = expected_methods->width(expected);
+        int height = expected_methods->height(expected);
+        if (actual_methods->width(actual) != width ||
+            actual_methods->height(actual) != height) {
+                mismatch(result, -1, -1, "%dx%d pixels, expected %dx%d",
+                         actual_methods->width(actual),
+                         actual_methods->height(actual), width, height);
+                return;
+        }
+        for (int row = 0; row < height; row++) {
+                for (int col = 0; col < width; col++) {
+                        Pnm_rgb e = expected_methods->at(expected, col, row);
+                        Pnm_rgb a = actual_methods->at(actual, col, row);
+                        unsigned es[3] = { e->red, e->green, e->blue };
+                        unsigned as[3] = { a->red, a->green, a->blue };
+                        for (int k = 0; k < 3; k++) {
+                                unsigned d = es[k] > as[k] ? es[k] - as[k] :
+                                                             as[k] - es[k];
+                                note_difference(result, d);
+                                if (d > bound) {
+                                        mismatch(result, col, row,
+                                                 "pixel (%d, %d) is "
+                                                 "%u %u %u, expected "
+                                                 "%u %u %u", col, row,
+                                                 as[0], as[1], as[2],
+                                                 es[0], es[1], es[2]);
+                                }
+                        }
+                }
+        }
+}
+
+/********** run_codec ********
+ *
+ * Purpose: Compresses or decompresses a stream held in memory
+ *
+ * Parameters:
+ *     - input, length: the stream
+ *     - options: the compression options (ignored for decompression)
+ *     - compress: true to compress, false to decompress
+ *     - nthreads: 0 for the whole-image codec, or the threads of the 
+ *                 pipelined one
+ *     - output_length: where to store the output's length
+ *
+ * Return: the output, which the caller frees with free()
+ *
+ * Expects: none
+ *
+ * CRE: input, options, or output_length is null, or memory can't be
+ *      allocated
+ *
+ * Notes:
+ *     - Resets the current pool, as the codec does
+ */
+static char *run_codec(const char *input, size_t length,
+                       const struct codec_options *options, bool compress,
+                       int nthreads, size_t *output_length)
+{
+        assert(input != NULL && options != NULL);
+        assert(output_length != NULL);
+
+        FILE *in = fmemopen((void *)input, length, "rb");
+        assert(in != NULL);
+        char *output = NULL;
+        FILE *out = open_memstream(&output, output_length);
+        assert(out != NULL);
+        if (compress && nthreads == 0) {
+                compress40_with(in, out, options);
+        } else if (compress) {
+                compress40_pipelined(in, out, options, nthreads);
+        } else if (nthreads == 0) {
+                decompress40_stream(in, out);
+        } else {
+                decompress40_pipelined(in, out, nthreads);
+        }
+        fclose(out);
+        fclose(in);
+        return output;
+}
+
+/********** compare_streams ********
+ *
+ * Purpose: Checks two streams held in memory are identical
+ *
+ * Parameters:
+ *     - expected, expected_length: one stream
+ *     - actual, actual_length: the other
+ *     - ppm: whether they are decompressed PPMs, so a differing byte can
+ *            be placed at a pixel
+ *     - result: where a mismatch is recorded
+ *     - format, ...: what made actual, as for printf(), for the report
+ *
+ * Return: true if they are identical
+ *
+ * Expects:
+ *     - PPMs have the same header, as the codec's decompressed images
+ *       of one image do
+ *
+ * CRE: any pointer is null
+ */
+static bool compare_streams(const char *expected, size_t expected_length,
+                            const char *actual, size_t actual_length,
+                            bool ppm, outcome *result, const char *format,
+                            ...)
+{
+        assert(expected != NULL && actual != NULL);
+        assert(result != NULL && format != NULL);
+
+        size_t same = 0;
+        while (same < actual_length && same < expected_length &&
+               actual[same] == expected[same]) {
+                same++;
+        }
+        if (same == actual_length && same == expected_length) {
+                return true;
+        }
+
+        char what[96];
+        va_list args;
+        va_start(args, format);
+        vsnprintf(what, sizeof(what), format, args);
+        va_end(args);
+
+        /* a header of "P6 width height maxval" and one whitespace byte */
+        long pixel = -1;
+        unsigned width = 0, height = 0;
+        int header = 0;
+        if (ppm && sscanf(expected, "P6 %u %u %*u%n", &width, &height,
+                          &header) == 2 && width > 0) {
+                pixel = ((long)same - header - 1) / 3;
+                if (pixel >= (long)width * height) {
+                        pixel = -1;
+                }
+        }
+        mismatch(result, pixel >= 0 ? pixel % width : -1,
+                 pixel >= 0 ? pixel / width : -1,
+                 "%s differs at byte %zu", what, same);
+        return false;
+}
+
+/********** check_ypbpr ********
+ *
+ * Purpose: Checks rgb_to_ypbpr()'s fixed-point pixels against the
+ *          conversion formula in doubles
+ *
+ * Parameters:
+ *     - ppm, length: the image, as a PPM
+ *     - result: where mismatches are recorded
+ *
+ * Return: none
+ *
+ * Expects: none
+ *
+ * CRE: any argument is null, or memory can't be allocated
+ */
+static void check_ypbpr(const char *ppm, size_t length, outcome *result)
+{
+        assert(ppm != NULL && result != NULL);
+        A2Methods_T methods = uarray2_methods_pool;
+        Pnm_ppm image = read_ppm(ppm, length, methods);
+        A2Methods_UArray2 ypbpr_pixels = rgb_to_ypbpr(image);
+
+        double denominator = image->denominator;
+        for (unsigned row = 0; row < image->height; row++) {
+                for (unsigned col = 0; col < image->width; col++) {
+                        Pnm_rgb rgb = methods->at(image->pixels, col, row);
+                        Y_Pb_Pr ypbpr = methods->at(ypbpr_pixels, col, row);
+                        double r = rgb->red / denominator;
+                        double g = rgb->green / denominator;
+                        double b = rgb->blue / denominator;
+                        double expected[3] = {
+                                0.299 * r + 0.587 * g + 0.114 * b,
+                                -0.168736 * r - 0.331264 * g + 0.5 * b,
+                                0.5 * r - 0.418688 * g - 0.081312 * b
+                        };
+                        double actual[3] = {
+                                getY(ypbpr), getPb(ypbpr), getPr(ypbpr)
+                        };
+                        for (int k = 0; k < 3; k++) {
+                                double d = fabs(actual[k] - expected[k]);
+                                note_difference(result, d);
+                                if (d > YPBPR_BOUND) {
+                                        mismatch(result, col, row,
+                                                 "pixel (%u, %u) channel "
+                                                 "%d is %.7f, expected "
+                                                 "%.7f", col, row, k,
+                                                 actual[k], expected[k]);
+                                }
+                        }
+                }
+        }
+
+        methods->free(&ypbpr_pixels);
+        Pnm_ppmfree(&image);
+}
+
+/********** check_pool_arrays ********
+ *
+ * Purpose: Checks the staged pipeline gives the same words and decoded
+ *          pixels on flat pool arrays as on UArray2s
+ *
+ * Parameters:
+ *     - ppm, length: the image, as a PPM
+ *     - result: where mismatches are recorded
+ *
+ * Return: none
+ *
+ * Expects: none
+ *
+ * CRE: any argument is null, or memory can't be allocated
+ */
+static void check_pool_arrays(const char *ppm, size_t length,
+                              outcome *result)
+{
+        assert(ppm != NULL && result != NULL);
+        A2Methods_T both[2] = { uarray2_methods_plain, uarray2_methods_pool };
+        Pnm_ppm image[2];
+        A2Methods_UArray2 words[2], pixels[2];
+
+        for (int m = 0; m < 2; m++) {
+                A2Methods_T methods = both[m];
+                image[m] = read_ppm(ppm, length, methods);
+                A2Methods_UArray2 ypbpr_pixels = rgb_to_ypbpr(image[m]);
+                A2Methods_UArray2 word_structs =
+                        make_word_array(ypbpr_pixels, methods);
+                words[m] = pack_word(word_structs, methods);
+                methods->free(&word_structs);
+                methods->free(&ypbpr_pixels);
+
+                word_structs = unpack_word(words[m], methods);
+                ypbpr_pixels = decompress_words(word_structs, methods);
+                pixels[m] = ypbpr_to_rgb(ypbpr_pixels, methods,
+                                         DECODE_DENOMINATOR);
+                methods->free(&word_structs);
+                methods->free(&ypbpr_pixels);
+        }
+
+        compare_words(words[0], both[0], words[1], both[1], result);
+        compare_pixels(pixels[0], both[0], pixels[1], both[1], 0, result);
+
+        for (int m = 0; m < 2; m++) {
+                both[m]->free(&words[m]);
+                both[m]->free(&pixels[m]);
+                Pnm_ppmfree(&image[m]);
+        }
+}
+
+/********** check_generic_pack ********
+ *
+ * Purpose: Checks pack_words_with() on the default layout packs the same
+ *          words as make_word_array() and pack_word()
+ *
+ * Parameters:
+ *     - ppm, length: the image, as a PPM
+ *     - result: where mismatches are recorded
+ *
+ * Return: none
+ *
+ * Expects: none
+ *
+ * CRE: any argument is null, or memory can't be allocated
+ */
+static void check_generic_pack(const char *ppm, size_t length,
+                               outcome *result)
+{
+        assert(ppm != NULL && result != NULL);
+        A2Methods_T methods = uarray2_methods_pool;
+        Pnm_ppm image = read_ppm(ppm, length, methods);
+        A2Methods_UArray2 ypbpr_pixels = rgb_to_ypbpr(image);
+
+        A2Methods_UArray2 word_structs = make_word_array(ypbpr_pixels,
+                                                         methods);
+        A2Methods_UArray2 expected = pack_word(word_structs, methods);
+        A2Methods_UArray2 actual = pack_words_with(ypbpr_pixels, methods,
+                                                   &default_layout);
+        compare_words(expected, methods, actual, methods, result);
+
+        methods->free(&actual);
+        methods->free(&expected);
+        methods->free(&word_structs);
+        methods->free(&ypbpr_pixels);
+        Pnm_ppmfree(&image);
+}
+
+/********** check_generic_unpack ********
+ *
+ * Purpose: Checks unpack_words_with() on the default layout decodes to
+ *          within UNPACK_BOUND of unpack_word() and decompress_words()
+ *
+ * Parameters:
+ *     - ppm, length: the image, as a PPM
+ *     - result: where mismatches are recorded
+ *
+ * Return: none
+ *
+ * Expects: none
+ *
+ * CRE: any argument is null, or memory can't be allocated
+ *
+ * Notes:
+ *     - The two dequantize in different orders of float operations, so
+ *       exactness isn't promised
+ */
+static void check_generic_unpack(const char *ppm, size_t length,
+                                 outcome *result)
+{
+        assert(ppm != NULL && result != NULL);
+        A2Methods_T methods = uarray2_methods_pool;
+        Pnm_ppm image = read_ppm(ppm, length, methods);
+        A2Methods_UArray2 ypbpr_pixels = rgb_to_ypbpr(image);
+        A2Methods_UArray2 word_structs = make_word_array(ypbpr_pixels,
+                                                         methods);
+        A2Methods_UArray2 words = pack_word(word_structs, methods);
+        methods->free(&word_structs);
+        methods->free(&ypbpr_pixels);
+
+        word_structs = unpack_word(words, methods);
+        ypbpr_pixels = decompress_words(word_structs, methods);
+        A2Methods_UArray2 expected = ypbpr_to_rgb(ypbpr_pixels, methods,
+                                                  DECODE_DENOMINATOR);
+        methods->free(&ypbpr_pixels);
+        ypbpr_pixels = unpack_words_with(words, methods, &default_layout);
+        A2Methods_UArray2 actual = ypbpr_to_rgb(ypbpr_pixels, methods,
+                                                DECODE_DENOMINATOR);
+        compare_pixels(expected, methods, actual, methods, UNPACK_BOUND,
+                       result);
+
+        methods->free(&actual);
+        methods->free(&expected);
+        methods->free(&ypbpr_pixels);
+        methods->free(&word_structs);
+        methods->free(&words);
+        Pnm_ppmfree(&image);
+}
+
+/********** check_coded_streams ********
+ *
+ * Purpose: Checks every stream in CODED_OPTIONS decompresses to the same
+ *          image as plain format 2
+ *
+ * Parameters:
+ *     - ppm, length: the image, as a PPM
+ *     - result: where mismatches are recorded
+ *
+ * Return: none
+ *
+ * Expects: none
+ *
+ * CRE: any argument is null, or memory can't be allocated
+ *
+ * Notes:
+ *     - The tiling, entropy coding, and prediction are all lossless, so
+ *       the decompressed PPMs must match byte for byte. The difference
+ *       noted is the number of streams that didn't
+ */
+static void check_coded_streams(const char *ppm, size_t length,
+                                outcome *result)
+{
+        assert(ppm != NULL && result != NULL);
+        const struct codec_options plain = CODEC_DEFAULTS;
+
+        size_t compressed_length, expected_length;
+        char *compressed = run_codec(ppm, length, &plain, true, 0,
+                                     &compressed_length);
+        char *expected = run_codec(compressed, compressed_length, &plain,
+                                   false, 0, &expected_length);
+        free(compressed);
+
+        int failed = 0;
+        for (unsigned s = 0; s < NUM_CODED_OPTIONS; s++) {
+                const struct codec_options *options = &CODED_OPTIONS[s];
+                size_t actual_length;
+                compressed = run_codec(ppm, length, options, true, 0,
+                                       &compressed_length);
+                char *actual = run_codec(compressed, compressed_length,
+                                         options, false, 0, &actual_length);
+                free(compressed);
+
+                if (!compare_streams(expected, expected_length, actual,
+                                     actual_length, true, result,
+                                     "tile %u, coding %d, predict %d",
+                                     options->tile_size, options->coding,
+                                     options->predict)) {
+                        failed++;
+                }
+                free(actual);
+        }
+        note_difference(result, failed);
+        free(expected);
+}
+
+/********** check_cpu_levels ********
+ *
+ * Purpose: Checks every instruction set level the processor supports
+ *          compresses and decompresses exactly as the generic kernels do
+ *
+ * Parameters:
+ *     - ppm, length: the image, as a PPM
+ *     - result: where mismatches are recorded
+ *
+ * Return: none
+ *
+ * Expects: none
+ *
+ * CRE: any argument is null, or memory can't be allocated
+ *
+ * Notes:
+ *     - Each stream of LEVEL_OPTIONS is made at the generic level and
+ *       then at each higher one (Cpu_set_level()), which covers the
+ *       color conversion and word byte-swapping kernels. The level in
+ *       use beforehand is restored
+ *     - The difference noted is the number of streams that differed
+ */
+static void check_cpu_levels(const char *ppm, size_t length,
+                             outcome *result)
+{
+        assert(ppm != NULL && result != NULL);
+        enum cpu_level saved = Cpu_level();
+        enum cpu_level best = Cpu_supported();
+
+        int failed = 0;
+        for (unsigned s = 0; s < NUM_LEVEL_OPTIONS; s++) {
+                const struct codec_options *options = &LEVEL_OPTIONS[s];
+                size_t compressed_length, decompressed_length;
+                Cpu_set_level(CPU_GENERIC);
+                char *compressed = run_codec(ppm, length, options, true, 0,
+                                             &compressed_length);
+                char *decompressed = run_codec(compressed,
+                                               compressed_length, options,
+                                               false, 0, &decompressed_length);
+
+                for (int level = CPU_GENERIC + 1; level <= (int)best;
+                     level++) {
+                        Cpu_set_level(level);
+                        size_t actual_length;
+                        char *actual = run_codec(ppm, length, options, true, 0,
+                                                 &actual_length);
+                        bool same = compare_streams(compressed,
+                                        compressed_length, actual,
+                                        actual_length, false, result,
+                                        "%s, block %u, tile %u, compressed",
+                                        Cpu_level_name(level),
+                                        options->block_size,
+                                        options->tile_size);
+                        free(actual);
+
+                        actual = run_codec(compressed, compressed_length,
+                                           options, false, 0, &actual_length);
+                        same &= compare_streams(decompressed,
+                                        decompressed_length, actual,
+                                        actual_length, true, result,
+                                        "%s, block %u, tile %u, "
+                                        "decompressed",
+                                        Cpu_level_name(level),
+                                        options->block_size,
+                                        options->tile_size);
+                        free(actual);
+                        failed += !same;
+                }
+                free(decompressed);
+                free(compressed);
+        }
+        Cpu_set_level(saved);
+        note_difference(result, failed);
+}
+
+/********** check_pipelined ********
+ *
+ * Purpose: Checks the pipelined codec writes what the whole-image codec
+ *          writes
+ *
+ * Parameters:
+ *     - ppm, length: the image, as a PPM
+ *     - result: where mismatches are recorded
+ *
+ * Return: none
+ *
+ * Expects: none
+ *
+ * CRE: any argument is null, or memory can't be allocated
+ *
+ * Notes:
+ *     - The image is compressed to format 2, a band at a time, and the 
+ *       whole-image codec's format 2 stream is decompressed a band at a 
+ *       time, with each count of PIPELINE_THREADS. A tiled stream is 
+ *       made too, which the pipelined codec hands to the whole-image one
+ *     - The difference noted is the number of streams that differed
+ */
+static void check_pipelined(const char *ppm, size_t length,
+                            outcome *result)
+{
+        assert(ppm != NULL && result != NULL);
+        const struct codec_options plain = CODEC_DEFAULTS;
+        const struct codec_options *tiled = &CODED_OPTIONS[0];
+
+        size_t compressed_length, decompressed_length, tiled_length;
+        char *compressed = run_codec(ppm, length, &plain, true, 0,
+                                     &compressed_length);
+        char *decompressed = run_codec(compressed, compressed_length,
+                                       &plain, false, 0,
+                                       &decompressed_length);
+        char *tiled_stream = run_codec(ppm, length, tiled, true, 0,
+                                       &tiled_length);
+
+        int failed = 0;
+        for (unsigned t = 0; t < NUM_PIPELINE_THREADS; t++) {
+                int nthreads = PIPELINE_THREADS[t];
+                size_t actual_length;
+                char *actual = run_codec(ppm, length, &plain, true,
+                                         nthreads, &actual_length);
+                bool same = compare_streams(compressed, compressed_length,
+                                            actual, actual_length, false,
+                                            result, "%d threads, "
+                                            "compressed", nthreads);
+                free(actual);
+
+                actual = run_codec(compressed, compressed_length, &plain,
+                                   false, nthreads, &actual_length);
+                same &= compare_streams(decompressed, decompressed_length,
+                                        actual, actual_length, true,
+                                        result, "%d threads, "
+                                        "decompressed", nthreads);
+                free(actual);
+
+                actual = run_codec(ppm, length, tiled, true, nthreads,
+                                   &actual_length);
+                same &= compare_streams(tiled_stream, tiled_length, actual,
+                                        actual_length, false, result,
+                                        "%d threads, tiled", nthreads);
+                free(actual);
+                failed += !same;
+        }
+        free(tiled_stream);
+        free(decompressed);
+        free(compressed);
+        note_difference(result, failed);
+}
+
+/********** check_padded_blocks ********
+ *
+ * Purpose: Checks images of 4x4 and 8x8 blocks come back at their own
+ *          size, and that their regions decode as the whole image does
+ *
+ * Parameters:
+ *     - ppm, length: the image, as a PPM
+ *     - result: where mismatches are recorded
+ *
+ * Return: none
+ *
+ * Expects: none
+ *
+ * CRE: any argument is null, or memory can't be allocated
+ *
+ * Notes:
+ *     - Each stream of PADDED_OPTIONS is decompressed whole, and then the
+ *       region from the middle of the image to past its bottom right 
+ *       corner, which takes in the padded blocks and is clipped to the 
+ *       image
+ *     - The difference noted is the number of streams that differed
+ */
+static void check_padded_blocks(const char *ppm, size_t length,
+                                outcome *result)
+{
+        assert(ppm != NULL && result != NULL);
+        unsigned width = 0, height = 0;
+        sscanf(ppm, "P6 %u %u", &width, &height);
+
+        int failed = 0;
+        for (unsigned s = 0; s < NUM_PADDED_OPTIONS; s++) {
+                const struct codec_options *options = &PADDED_OPTIONS[s];
+                size_t compressed_length, decompressed_length;
+                char *compressed = run_codec(ppm, length, options, true, 0,
+                                             &compressed_length);
+                char *decompressed = run_codec(compressed,
+                                               compressed_length, options,
+                                               false, 0, &decompressed_length);
+
+                unsigned got_width = 0, got_height = 0;
+                sscanf(decompressed, "P6 %u %u", &got_width, &got_height);
+                if (got_width != width || got_height != height) {
+                        mismatch(result, -1, -1, "block %u, tile %u, "
+                                 "decompressed to %ux%u", 
+                                 options->block_size, options->tile_size,
+                                 got_width, got_height);
+                        failed++;
+                } else {
+                        size_t expected_length, actual_length;
+                        char *expected = crop_ppm(decompressed, width / 2,
+                                                  height / 2, width, height,
+                                                  &expected_length);
+                        char *actual = decode_region(compressed,
+                                                     compressed_length,
+                                                     width / 2, height / 2,
+                                                     width, height,
+                                                     &actual_length);
+                        failed += !compare_streams(expected, expected_length,
+                                        actual, actual_length, true, result,
+                                        "block %u, tile %u, region", 
+                                        options->block_size,
+                                        options->tile_size);
+                        free(actual);
+                        free(expected);
+                }
+                free(decompressed);
+                free(compressed);
+        }
+        note_difference(result, failed);
+}
+
+/********** decode_region ********
+ *
+ * Purpose: Decompresses one rectangle of a compressed stream held in 
+ *          memory
+ *
+ * Parameters:
+ *     - compressed, length: the stream
+ *     - col, row: the rectangle's top left pixel
+ *     - width, height: the rectangle's size, which may run past the image
+ *     - output_length: where to store the output's length
+ *
+ * Return: the rectangle as a PPM, which the caller frees with free()
+ *
+ * Expects: none
+ *
+ * CRE: compressed or output_length is null, or memory can't be allocated
+ */
+static char *decode_region(const char *compressed, size_t length, 
+                           unsigned col, unsigned row, unsigned width,
+                           unsigned height, size_t *output_length)
+{
+        assert(compressed != NULL && output_length != NULL);
+
+        FILE *in = fmemopen((void *)compressed, length, "rb");
+        assert(in != NULL);
+        char *output = NULL;
+        FILE *out = open_memstream(&output, output_length);
+        assert(out != NULL);
+        decompress40_region(in, out, col, row, width, height);
+        fclose(out);
+        fclose(in);
+        return output;
+}
+
+/********** crop_ppm ********
+ *
+ * Purpose: Crops a decompressed image held in memory, as 40image -r 
+ *          would
+ *
+ * Parameters:
+ *     - ppm: the image, a binary PPM with one byte a sample
+ *     - col, row: the crop's top left pixel, inside the image
+ *     - width, height: the crop's size, clipped to the image
+ *     - output_length: where to store the output's length
+ *
+ * Return: the crop as a PPM, with the image's maxval, which the caller 
+ *         frees with free()
+ *
+ * Expects: none
+ *
+ * CRE: ppm or output_length is null, the header can't be read, or the 
+ *      samples take two bytes
+ */
+static char *crop_ppm(const char *ppm, unsigned col, unsigned row, 
+                      unsigned width, unsigned height, 
+                      size_t *output_length)
+{
+        assert(ppm != NULL && output_length != NULL);
+        unsigned image_width, image_height, maxval;
+        int header = 0;
+        int read = sscanf(ppm, "P6 %u %u %u%n", &image_width, &image_height,
+                          &maxval, &header);
+        assert(read == 3 && maxval < 256);
+        assert(col < image_width && row < image_height);
+        const char *pixels = ppm + header + 1;
+
+        if (width > image_width - col) {
+                width = image_width - col;
+        }
+        if (height > image_height - row) {
+                height = image_height - row;
+        }
+
+        char *output = NULL;
+        FILE *out = open_memstream(&output, output_length);
+        assert(out != NULL);
+        fprintf(out, "P6\n%u %u\n%u\n", width, height, maxval);
+        for (unsigned r = row; r < row + height; r++) {
+                fwrite(pixels + 3 * ((size_t)r * image_width + col), 3, 
+                       width, out);
+        }
+        fclose(out);
+        return output;
+}
+
+/********** check_verify ********
+ *
+ * Purpose: Checks the RMSD compress40_verify() gives against the RMSD of
+ *          the image decompressed from what it wrote
+ *
+ * Parameters:
+ *     - ppm, length: the image, as a PPM
+ *     - result: where mismatches are recorded
+ *
+ * Return: none
+ *
+ * Expects: none
+ *
+ * CRE: any argument is null, or memory can't be allocated
+ *
+ * Notes:
+ *     - An image trimmed to no pixels has nothing to decompress, and its
+ *       RMSD must be 0, not NaN
+ *     - The difference noted is how far apart the two RMSDs are
+ */
+static void check_verify(const char *ppm, size_t length, outcome *result)
+{
+        assert(ppm != NULL && result != NULL);
+        const struct codec_options plain = CODEC_DEFAULTS;
+        A2Methods_T methods = uarray2_methods_plain;
+
+        FILE *in = fmemopen((void *)ppm, length, "rb");
+        assert(in != NULL);
+        char *compressed = NULL;
+        size_t compressed_length;
+        FILE *out = open_memstream(&compressed, &compressed_length);
+        assert(out != NULL);
+        double error = compress40_verify(in, out, &plain);
+        fclose(out);
+        fclose(in);
+
+        Pnm_ppm original = read_ppm(ppm, length, methods);
+        double expected = 0.0;
+        if (original->width > 0 && original->height > 0) {
+                size_t decompressed_length;
+                char *decompressed = run_codec(compressed, 
+                                               compressed_length, &plain,
+                                               false, 0, 
+                                               &decompressed_length);
+                Pnm_ppm decoded = read_ppm(decompressed, 
+                                           decompressed_length, methods);
+                expected = image_rmsd(original, decoded);
+                Pnm_ppmfree(&decoded);
+                free(decompressed);
+        }
+        Pnm_ppmfree(&original);
+        free(compressed);
+
+        if (!isfinite(error)) {
+                mismatch(result, -1, -1, "verify gave %f, decompressing "
+                         "gives %.6f", error, expected);
+                return;
+        }
+        double difference = fabs(error - expected);
+        note_difference(result, difference);
+        if (difference > VERIFY_BOUND) {
+                mismatch(result, -1, -1, "verify gave %.9f, decompressing "
+                         "gives %.9f", error, expected);
+        }
+}
+
+/********** image_rmsd ********
+ *
+ * Purpose: Computes the RMSD between two images of the same size, as 
+ *          ppmdiff does
+ *
+ * Parameters:
+ *     - original, decoded: the images
+ *
+ * Return: the root of the mean squared difference of each red, green, 
+ *         and blue value as a fraction of its image's denominator
+ *
+ * Expects: none
+ *
+ * CRE: either image is null, the sizes differ, or the images are empty
+ */
+static double image_rmsd(Pnm_ppm original, Pnm_ppm decoded)
+{
+        assert(original != NULL && decoded != NULL);
+        assert(original->width == decoded->width && 
+               original->height == decoded->height);
+        assert(original->width > 0 && original->height > 0);
+
+        double scale1 = 1.0 / original->denominator;
+        double scale2 = 1.0 / decoded->denominator;
+        double total = 0.0;
+        for (unsigned row = 0; row < original->height; row++) {
+                for (unsigned col = 0; col < original->width; col++) {
+                        Pnm_rgb a = original->methods->at(original->pixels,
+                                                          col, row);
+                        Pnm_rgb b = decoded->methods->at(decoded->pixels, 
+                                                         col, row);
+                        double red = a->red * scale1 - b->red * scale2;
+                        double green = a->green * scale1 - 
+                                       b->green * scale2;
+                        double blue = a->blue * scale1 - b->blue * scale2;
+                        total += red * red + green * green + blue * blue;
+                }
+        }
+        return sqrt(total / (3.0 * original->width * original->height));
+}
+
+/********** usage ********
+ *
+ * Purpose: Prints how to run equivalence and exits
+ *
+ * Parameters:
+ *     - progname: the name equivalence was run as
+ *
+ * Return: none (exits with EXIT_FAILURE)
+ *
+ * Expects: none
+ */
+static void usage(const char *progname)
+{
+        fprintf(stderr, "Usage: %s [-n images] [-s seed] [-o dir]\n",
+                progname);
+        exit(EXIT_FAILURE);
+}
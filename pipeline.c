@@ -0,0 +1,626 @@
+/**************************************************************
+ *
+ *                     pipeline.c
+ *
+ *     Assignment: Arith
+ *     Authors:  Marielle Cibella (mcibel01), Erica Huang (ehuang02)
+ *     Date:     4/27/25
+ *
+ *     Summary:
+ *
+ *     pipeline.c implements the pipelined codec declared in pipeline.h.
+ *     One image is split into bands of BAND_ROWS pixel rows that flow
+ *     through a ring of slots, each holding one band's input and output:
+ *
+ *         reader thread --> worker threads --> calling thread (writer)
+ *
+ *     The three stages are joined by counters instead of locks. The reader
+ *     is the only thread that advances "read", the number of bands filled;
+ *     workers take the next band by atomically incrementing "claimed" and
+ *     wait until it has been read. A worker marks its slot done when the
+ *     band is encoded, in whatever order workers finish, and the writer
+ *     waits for each slot's band in turn, so bands are written in order.
+ *     The writer advances "written", which hands slots back to the
+ *     reader, so at most one ring of bands is in memory however large the
+ *     image. A thread with nothing to do spins briefly and then sleeps on
+ *     the counter it waits for with futex(2).
+ *
+ *     Workers run the same word.h and ry_conversion.h functions as the
+ *     whole-image codec, on band-sized arrays from their own pools, so the
+ *     output doesn't depend on the band size or number of threads.
+ *
+ *
+ **************************************************************/
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <limits.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include "assert.h"
+#include "mem.h"
+#include "pipeline.h"
+#include "ry_conversion.h"
+#include "word.h"
+#include "pool.h"
+#include "a2pool.h"
+#include "trace.h"
+
+/* times a waiting thread checks its counter before sleeping on it */
+static const int WAIT_SPINS = 256;
+
+/*
+ * struct band_slot is one slot of the ring. For compression the reader
+ * fills pixels, a BAND_ROWS tall array of the band's RGB pixels, and a
+ * worker writes the band's words to output as big-endian bytes. For
+ * decompression the reader fills input with the band's word bytes and a
+ * worker writes its pixels to output as PPM samples. rows is the number
+ * of pixel rows in the band (fewer for the last one), and done is the
+ * band's number plus one once output is ready to write.
+ */
+typedef struct band_slot {
+        A2Methods_UArray2 pixels;
+        unsigned char *input;
+        unsigned char *output;
+        long output_bytes;
+        unsigned rows;
+        uint32_t done;
+} band_slot;
+
+/*
+ * struct pipeline is shared by the reader, workers, and writer of one
+ * image. width and height are in pixels, after trimming to even sizes;
+ * ppm reads the PPM being compressed (see read_write.h), and denominator
+ * is its denominator or the one to decompress to. Band b is kept in
+ * slots[b % nslots]. read, claimed, and written count bands the reader
+ * has filled, workers have taken, and the writer has written.
+ */
+typedef struct pipeline {
+        bool compress;
+        FILE *input;
+        ppm_reader ppm;
+        unsigned denominator;
+        unsigned width, height;
+        unsigned nbands;
+        unsigned nslots;
+        band_slot *slots;
+        uint32_t read;
+        uint32_t claimed;
+        uint32_t written;
+} pipeline;
+
+/* helper functions */
+static void run_pipeline(pipeline *p, FILE *output, int nthreads);
+static void *reader_thread(void *cl);
+static void *worker_thread(void *cl);
+static void write_bands(pipeline *p, FILE *output);
+static void read_pixel_rows(pipeline *p, band_slot *slot);
+static void encode_band(band_slot *slot, unsigned width,
+                        unsigned denominator);
+static void decode_band(band_slot *slot, unsigned width,
+                        unsigned denominator);
+static void wait_for(uint32_t *counter, uint32_t value);
+static void advance(uint32_t *counter, uint32_t value);
+
+
+/********** pipeline_compress ********
+ *
+ * Purpose: Compresses a PPM image to "COMP40 Compressed image format 2",
+ *          a band at a time across threads
+ *
+ * Parameters:
+ *      - input: the PPM image, positioned at its start
+ *      - output: the stream the compressed image is written to
+ *      - nthreads: the number of worker threads, or 0 or less to use one
+ *                  per online processor
+ *      - width, height: where to store the size of the image compressed,
+ *                       in pixels, after trimming
+ *
+ * Return: none
+ *
+ * Expects:
+ *      - input holds a "P6" (raw) or "P3" (plain) PPM image
+ *      - the calling thread's pool (pool.h) was just reset; the ring's
+ *        pixel arrays are drawn from it
+ *
+ * CRE: any pointer is null, a thread can't be created, or memory can't
+ *      be allocated
+ *
+ * Notes:
+ *      - Writes what compress40_with() writes with CODEC_DEFAULTS: an odd
+ *        last column or row is dropped, and the trimmed row isn't read
+ *      - The image is read with ppm_read_header() and ppm_read_row(), so 
+ *        it raises Pnm_Badformat where the whole-image codec does
+ */
+void pipeline_compress(FILE *input, FILE *output, int nthreads,
+                       unsigned *width, unsigned *height)
+{
+        assert(input != NULL && output != NULL);
+        assert(width != NULL && height != NULL);
+
+        pipeline p = { .compress = true, .input = input };
+        ppm_read_header(input, &p.ppm);
+        p.denominator = p.ppm.denominator;
+        p.width = p.ppm.width - p.ppm.width % 2;
+        p.height = p.ppm.height - p.ppm.height % 2;
+        *width = p.width;
+        *height = p.height;
+
+        print_compressed_header(p.width / 2, p.height / 2, output);
+        run_pipeline(&p, output, nthreads);
+        ppm_reader_free(&p.ppm);
+}
+
+/********** pipeline_decompress ********
+ *
+ * Purpose: Decompresses a "COMP40 Compressed image format 2" image to a
+ *          PPM, a band at a time across threads
+ *
+ * Parameters:
+ *      - input: the compressed image, positioned after its header
+ *      - header: the image's header, from read_compressed_header()
+ *      - output: the stream the PPM is written to
+ *      - denominator: the PPM's denominator
+ *      - nthreads: the number of worker threads, or 0 or less to use one
+ *                  per online processor
+ *
+ * Return: none
+ *
+ * Expects: none
+ *
+ * CRE: any pointer is null, the header isn't format 2, denominator isn't
+ *      1 to 255, the file ends early, a thread can't be created, or
+ *      memory can't be allocated
+ *
+ * Notes:
+ *      - Writes what decompress40_stream() writes; the PPM header is the
+ *        one Pnm_ppmwrite() writes, and every sample is one byte
+ */
+void pipeline_decompress(FILE *input, const comp40_header *header,
+                         FILE *output, int denominator, int nthreads)
+{
+        assert(input != NULL && header != NULL && output != NULL);
+        assert(header->format == 2);
+        assert(denominator > 0 && denominator < 256);
+
+        pipeline p = { .compress = false, .input = input };
+        p.denominator = denominator;
+        p.width = 2 * header->width;
+        p.height = 2 * header->height;
+
+        fprintf(output, "P6\n%u %u\n%u\n", p.width, p.height,
+                p.denominator);
+        run_pipeline(&p, output, nthreads);
+}
+
+
+/**************************/
+/*    Helper functions    */
+/**************************/
+
+
+/********** run_pipeline ********
+ *
+ * Purpose: Reads, codes, and writes every band of an image
+ *
+ * Parameters:
+ *      - p: the pipeline, with its image's sizes and input set
+ *      - output: the stream the bands are written to
+ *      - nthreads: the number of worker threads, or 0 or less to use one
+ *                  per online processor
+ *
+ * Return: none
+ *
+ * Expects:
+ *      - the header of output has been written
+ *
+ * CRE: a thread can't be created, or memory can't be allocated
+ *
+ * Notes:
+ *      - Starts the reader and the workers, writes on the calling thread,
+ *        and returns once every band is written and every thread joined
+ *      - There are never more workers than bands, and the ring holds two
+ *        bands per worker and two more, so the reader can stay ahead of
+ *        the workers while the writer catches up
+ */
+static void run_pipeline(pipeline *p, FILE *output, int nthreads)
+{
+        assert(p != NULL && output != NULL);
+
+        p->nbands = p->width == 0 ? 0 :
+                    (p->height + BAND_ROWS - 1) / BAND_ROWS;
+        if (p->nbands == 0) {
+                return;
+        }
+        if (nthreads <= 0) {
+                nthreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+        }
+        if (nthreads < 1) {
+                nthreads = 1;
+        }
+        if ((unsigned)nthreads > p->nbands) {
+                nthreads = p->nbands;
+        }
+        p->nslots = 2 * nthreads + 2;
+        if (p->nslots > p->nbands) {
+                p->nslots = p->nbands;
+        }
+
+        /* each slot's buffers, big enough for a full band */
+        A2Methods_T methods = uarray2_methods_pool;
+        long words = (long)p->width / 2 * (BAND_ROWS / 2);
+        long samples = 3L * p->width * BAND_ROWS;
+        p->slots = CALLOC(p->nslots, sizeof(band_slot));
+        for (unsigned s = 0; s < p->nslots; s++) {
+                band_slot *slot = &p->slots[s];
+                if (p->compress) {
+                        slot->pixels = methods->new(p->width, BAND_ROWS,
+                                                    sizeof(struct Pnm_rgb));
+                        slot->output = ALLOC(words * sizeof(uint32_t));
+                } else {
+                        slot->input = ALLOC(words * sizeof(uint32_t));
+                        slot->output = ALLOC(samples);
+                }
+        }
+
+        pthread_t reader;
+        pthread_t *workers = ALLOC(nthreads * (long)sizeof(pthread_t));
+        int rc = pthread_create(&reader, NULL, reader_thread, p);
+        assert(rc == 0);
+        for (int i = 0; i < nthreads; i++) {
+                rc = pthread_create(&workers[i], NULL, worker_thread, p);
+                assert(rc == 0);
+        }
+
+        write_bands(p, output);
+
+        pthread_join(reader, NULL);
+        for (int i = 0; i < nthreads; i++) {
+                pthread_join(workers[i], NULL);
+        }
+        FREE(workers);
+
+        /* the pixel arrays go back when the caller's pool is reset */
+        for (unsigned s = 0; s < p->nslots; s++) {
+                band_slot *slot = &p->slots[s];
+                if (slot->pixels != NULL) {
+                        methods->free(&slot->pixels);
+                }
+                if (slot->input != NULL) {
+                        FREE(slot->input);
+                }
+                FREE(slot->output);
+        }
+        FREE(p->slots);
+}
+
+/********** reader_thread ********
+ *
+ * Purpose: Thread body of the reader: fills each band's slot from the
+ *          input, in order
+ *
+ * Parameters:
+ *      - cl: the pipeline
+ *
+ * Return: NULL
+ *
+ * Expects: none
+ *
+ * CRE: cl is null, the file ends early or holds a malformed sample, or
+ *      memory can't be allocated
+ *
+ * Notes:
+ *      - Band b reuses the slot of band b - nslots, so it waits until the
+ *        writer has written that band
+ */
+static void *reader_thread(void *cl)
+{
+        pipeline *p = cl;
+        assert(p != NULL);
+        Trace_thread_name("pipeline reader");
+
+        for (unsigned band = 0; band < p->nbands; band++) {
+                if (band >= p->nslots) {
+                        wait_for(&p->written, band + 1 - p->nslots);
+                }
+                band_slot *slot = &p->slots[band % p->nslots];
+                slot->rows = p->height - band * BAND_ROWS;
+                if (slot->rows > BAND_ROWS) {
+                        slot->rows = BAND_ROWS;
+                }
+
+                Trace_begin("read band", "pipeline");
+                if (p->compress) {
+                        read_pixel_rows(p, slot);
+                } else {
+                        long nwords = (long)p->width / 2 * (slot->rows / 2);
+                        size_t got = fread(slot->input, sizeof(uint32_t),
+                                           nwords, p->input);
+                        assert(got == (size_t)nwords);
+                }
+                Trace_end("read band", "pipeline");
+                advance(&p->read, band + 1);
+        }
+
+        return NULL;
+}
+
+/********** worker_thread ********
+ *
+ * Purpose: Thread body of a worker: encodes or decodes bands until none
+ *          are left
+ *
+ * Parameters:
+ *      - cl: the pipeline
+ *
+ * Return: NULL
+ *
+ * Expects: none
+ *
+ * CRE: cl is null, or memory can't be allocated
+ *
+ * Notes:
+ *      - Bands are taken in order, one at a time, so a worker waiting for
+ *        its band to be read never holds up an earlier one
+ *      - The worker's pool is reset for each band, so after the first
+ *        band its arrays take no new memory
+ */
+static void *worker_thread(void *cl)
+{
+        pipeline *p = cl;
+        assert(p != NULL);
+
+        Pool_T pool = Pool_new(0);
+        Pool_use(pool);
+        Trace_thread_name("pipeline worker");
+
+        uint32_t band;
+        while ((band = __atomic_fetch_add(&p->claimed, 1,
+                                          __ATOMIC_RELAXED)) < p->nbands) {
+                wait_for(&p->read, band + 1);
+                band_slot *slot = &p->slots[band % p->nslots];
+
+                Pool_reset(pool);
+                if (p->compress) {
+                        Trace_begin("encode band", "pipeline");
+                        encode_band(slot, p->width, p->denominator);
+                        Trace_end("encode band", "pipeline");
+                } else {
+                        Trace_begin("decode band", "pipeline");
+                        decode_band(slot, p->width, p->denominator);
+                        Trace_end("decode band", "pipeline");
+                }
+                advance(&slot->done, band + 1);
+        }
+
+        Pool_use(NULL);
+        Pool_free(&pool);
+        return NULL;
+}
+
+/********** write_bands ********
+ *
+ * Purpose: Writes every band, in order, as workers finish them
+ *
+ * Parameters:
+ *      - p: the pipeline
+ *      - output: the stream to write to
+ *
+ * Return: none
+ *
+ * Expects:
+ *      - called on one thread only (the writer)
+ *
+ * CRE: p or output is null
+ */
+static void write_bands(pipeline *p, FILE *output)
+{
+        assert(p != NULL && output != NULL);
+
+        for (unsigned band = 0; band < p->nbands; band++) {
+                band_slot *slot = &p->slots[band % p->nslots];
+                wait_for(&slot->done, band + 1);
+
+                Trace_begin("write band", "pipeline");
+                fwrite(slot->output, 1, slot->output_bytes, output);
+                Trace_end("write band", "pipeline");
+                advance(&p->written, band + 1);
+        }
+}
+
+/********** read_pixel_rows ********
+ *
+ * Purpose: Reads the next rows of the PPM being compressed into a slot's
+ *          pixels
+ *
+ * Parameters:
+ *      - p: the pipeline
+ *      - slot: the slot, with rows set
+ *
+ * Return: none
+ *
+ * Expects:
+ *      - the file is positioned at the first of the rows
+ *
+ * CRE: none
+ *
+ * Notes:
+ *      - Raises Pnm_Badformat if the file ends early or holds a malformed
+ *        sample (see ppm_read_row()); the pixels past the trimmed width 
+ *        are read and dropped
+ */
+static void read_pixel_rows(pipeline *p, band_slot *slot)
+{
+        A2Methods_T methods = uarray2_methods_pool;
+
+        for (unsigned r = 0; r < slot->rows; r++) {
+                ppm_read_row(&p->ppm, methods->at(slot->pixels, 0, r), 
+                             p->width);
+        }
+}
+
+/********** encode_band ********
+ *
+ * Purpose: Turns a slot's pixels into the big-endian bytes of its words
+ *
+ * Parameters:
+ *      - slot: the slot, read by the reader
+ *      - width: the band's width, in pixels
+ *      - denominator: the PPM's denominator
+ *
+ * Return: none
+ *
+ * Expects:
+ *      - the calling thread's pool was reset for this band
+ *
+ * CRE: memory can't be allocated
+ *
+ * Notes:
+ *      - Steps 2 to 4 of compress_image() (compress40.c), on one band
+ */
+static void encode_band(band_slot *slot, unsigned width,
+                        unsigned denominator)
+{
+        A2Methods_T methods = uarray2_methods_pool;
+        struct Pnm_ppm band = { .width = width, .height = slot->rows,
+                                .denominator = denominator,
+                                .pixels = slot->pixels, .methods = methods };
+
+        A2Methods_UArray2 ypbpr_pixels = rgb_to_ypbpr(&band);
+        A2Methods_UArray2 word_structs = make_word_array(ypbpr_pixels,
+                                                         methods);
+        A2Methods_UArray2 word_bits = pack_word(word_structs, methods);
+        assert(word_bits != NULL);
+
+        unsigned words_wide = width / 2;
+        unsigned word_rows = slot->rows / 2;
+        for (unsigned r = 0; r < word_rows; r++) {
+                words_to_bytes(methods->at(word_bits, 0, r),
+                               slot->output + 4L * words_wide * r,
+                               words_wide);
+        }
+        slot->output_bytes = 4L * words_wide * word_rows;
+
+        methods->free(&ypbpr_pixels);
+        methods->free(&word_structs);
+        methods->free(&word_bits);
+}
+
+/********** decode_band ********
+ *
+ * Purpose: Turns the bytes of a slot's words into PPM samples
+ *
+ * Parameters:
+ *      - slot: the slot, read by the reader
+ *      - width: the band's width, in pixels
+ *      - denominator: the PPM's denominator, under 256
+ *
+ * Return: none
+ *
+ * Expects:
+ *      - the calling thread's pool was reset for this band
+ *
+ * CRE: memory can't be allocated
+ *
+ * Notes:
+ *      - Steps 3 to 6 of decompress40_stream() (compress40.c), on one
+ *        band, with each sample written as one byte as Pnm_ppmwrite()
+ *        writes it
+ */
+static void decode_band(band_slot *slot, unsigned width,
+                        unsigned denominator)
+{
+        A2Methods_T methods = uarray2_methods_pool;
+        unsigned words_wide = width / 2;
+        unsigned word_rows = slot->rows / 2;
+
+        A2Methods_UArray2 word_bits = methods->new(words_wide, word_rows,
+                                                   sizeof(uint32_t));
+        for (unsigned r = 0; r < word_rows; r++) {
+                bytes_to_words(slot->input + 4L * words_wide * r,
+                               methods->at(word_bits, 0, r), words_wide);
+        }
+        A2Methods_UArray2 word_structs = unpack_word(word_bits, methods);
+        A2Methods_UArray2 ypbpr_pixels = decompress_words(word_structs,
+                                                          methods);
+        A2Methods_UArray2 pixels = ypbpr_to_rgb(ypbpr_pixels, methods,
+                                                denominator);
+        assert(pixels != NULL);
+
+        unsigned char *bytes = slot->output;
+        for (unsigned r = 0; r < slot->rows; r++) {
+                const struct Pnm_rgb *row = methods->at(pixels, 0, r);
+                for (unsigned col = 0; col < width; col++) {
+                        *bytes++ = row[col].red;
+                        *bytes++ = row[col].green;
+                        *bytes++ = row[col].blue;
+                }
+        }
+        slot->output_bytes = bytes - slot->output;
+
+        methods->free(&word_bits);
+        methods->free(&word_structs);
+        methods->free(&ypbpr_pixels);
+        methods->free(&pixels);
+}
+
+/********** wait_for ********
+ *
+ * Purpose: Waits until a pipeline counter reaches a value
+ *
+ * Parameters:
+ *      - counter: the counter, only ever increased with advance()
+ *      - value: the value to wait for
+ *
+ * Return: none
+ *
+ * Expects: none
+ *
+ * CRE: none
+ *
+ * Notes:
+ *      - Everything the advancing thread wrote before advance() is
+ *        visible once this returns (acquire ordering)
+ *      - Checks WAIT_SPINS times, then sleeps in the kernel until the
+ *        counter changes from what was last seen, so an idle stage takes
+ *        no processor time
+ */
+static void wait_for(uint32_t *counter, uint32_t value)
+{
+        for (int spin = 0; spin < WAIT_SPINS; spin++) {
+                if (__atomic_load_n(counter, __ATOMIC_ACQUIRE) >= value) {
+                        return;
+                }
+        }
+
+        uint32_t seen;
+        while ((seen = __atomic_load_n(counter, __ATOMIC_ACQUIRE)) < value) {
+                syscall(SYS_futex, counter, FUTEX_WAIT_PRIVATE, seen, NULL,
+                        NULL, 0);
+        }
+}
+
+/********** advance ********
+ *
+ * Purpose: Raises a pipeline counter and wakes the threads waiting on it
+ *
+ * Parameters:
+ *      - counter: the counter
+ *      - value: its new value, above the old one
+ *
+ * Return: none
+ *
+ * Expects:
+ *      - only one thread advances a counter at a time
+ *
+ * CRE: none
+ */
+static void advance(uint32_t *counter, uint32_t value)
+{
+        __atomic_store_n(counter, value, __ATOMIC_RELEASE);
+        syscall(SYS_futex, counter, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL,
+                0);
+}
@@ -0,0 +1,43 @@
+/**************************************************************
+ *
+ *                     pipeline.h
+ *
+ *     Assignment: Arith
+ *     Authors:  Marielle Cibella (mcibel01), Erica Huang (ehuang02)
+ *     Date:     4/27/25
+ *
+ *     Summary:
+ *
+ *     This header file declares the pipelined codec behind 40image -j for a
+ *     single image. The image goes through in bands of BAND_ROWS pixel
+ *     rows: a reader thread parses each band from the input into a ring of
+ *     band buffers, worker threads encode (or decode) bands as they
+ *     arrive, and the calling thread writes finished bands in order, so
+ *     reading, computing, and writing overlap instead of following each
+ *     other. The output is byte for byte what compress40_with() and
+ *     decompress40_stream() write.
+ *
+ *     Only "COMP40 Compressed image format 2" is pipelined: its words are
+ *     stored row by row with no directory in front, so a band can be
+ *     written as soon as it is done. compress40_pipelined() and
+ *     decompress40_pipelined() (codec.h) fall back to the whole-image
+ *     codec for anything else.
+ *
+ *
+ **************************************************************/
+
+#ifndef PIPELINE
+#define PIPELINE
+
+#include <stdio.h>
+#include "read_write.h"
+
+/* pixel rows in a band (even, so a band is whole 2x2 blocks) */
+#define BAND_ROWS 16
+
+void pipeline_compress(FILE *input, FILE *output, int nthreads,
+                       unsigned *width, unsigned *height);
+void pipeline_decompress(FILE *input, const comp40_header *header,
+                         FILE *output, int denominator, int nthreads);
+
+#endif
@@ -0,0 +1,468 @@
+/**************************************************************
+ *
+ *                     pool.c
+ *
+ *     Assignment: Arith
+ *     Authors:  Marielle Cibella (mcibel01), Erica Huang (ehuang02)
+ *     Date:     4/14/25
+ *
+ *     Summary:
+ *
+ *     pool.c implements the arena allocator declared in pool.h. A pool is a
+ *     list of chunks; allocation bumps a pointer through the newest chunk
+ *     and only asks the system for memory when that chunk runs out.
+ *     Resetting a pool keeps its memory, merging several chunks into one
+ *     big enough for everything that was allocated, so a run of same-sized
+ *     images settles into a single chunk and no system allocations at all.
+ *
+ *
+ **************************************************************/
+
+#include "assert.h"
+#include "mem.h"
+#include "pool.h"
+
+/*
+ * struct chunk is the header at the start of each block of memory a pool
+ * gets from the system. Allocations are carved out of the bytes after it,
+ * from avail up to limit.
+ */
+struct chunk {
+        struct chunk *prev;
+        char *avail;
+        char *limit;
+};
+
+/*
+ * struct Pool_T holds the chunk list (newest first) and the running
+ * statistics reported by Pool_stats()
+ */
+struct Pool_T {
+        struct chunk *head;
+        struct Pool_stats stats;
+};
+
+/*
+ * Every allocation is rounded up to ALIGN bytes, the alignment malloc
+ * guarantees, so any element type is correctly aligned. HEADER_SIZE keeps
+ * the first allocation in a chunk aligned too.
+ */
+#define ALIGN 16
+#define HEADER_SIZE \
+        ((long)((sizeof(struct chunk) + ALIGN - 1) / ALIGN * ALIGN))
+
+/* smallest chunk a pool asks the system for */
+static const long MIN_CHUNK = 64 * 1024;
+
+/* the pool each thread's codec buffers come from */
+static __thread Pool_T current = NULL;
+
+/* helper functions */
+static void add_chunk(Pool_T pool, long nbytes);
+static void free_chunks(Pool_T pool);
+static long round_up(long nbytes);
+
+
+/**************************/
+/*  Creation/destruction  */
+/**************************/
+
+
+/********** Pool_new ********
+ *
+ * Purpose: Creates a new, empty pool
+ *
+ * Parameters:
+ *      - capacity: the number of bytes to set aside up front; 0 to wait
+ *                  until the first allocation
+ *
+ * Return: the new pool
+ *
+ * Expects: none
+ *
+ * CRE: capacity is negative, or memory can't be allocated
+ *
+ * Notes:
+ *      - The caller frees the pool with Pool_free()
+ */
+Pool_T Pool_new(long capacity)
+{
+        assert(capacity >= 0);
+
+        Pool_T pool;
+        NEW(pool);
+        assert(pool != NULL);
+
+        pool->head = NULL;
+        pool->stats.in_use = 0;
+        pool->stats.high_water = 0;
+        pool->stats.capacity = 0;
+        pool->stats.allocations = 0;
+        pool->stats.chunks = 0;
+        pool->stats.resets = 0;
+
+        if (capacity > 0) {
+                add_chunk(pool, capacity);
+        }
+
+        return pool;
+}
+
+/********** Pool_free ********
+ *
+ * Purpose: Frees a pool and every chunk it holds
+ *
+ * Parameters:
+ *      - pool: a pointer to the pool to free
+ *
+ * Return: none
+ *
+ * Expects: nothing allocated from the pool is used afterwards
+ *
+ * CRE: pool is null, or *pool is null
+ *
+ * Notes:
+ *      - sets *pool to NULL
+ *      - if the pool is some thread's current pool, that thread must
+ *        install another one with Pool_use() before allocating again
+ */
+void Pool_free(Pool_T *pool)
+{
+        assert(pool != NULL);
+        assert(*pool != NULL);
+
+        if (current == *pool) {
+                current = NULL;
+        }
+
+        free_chunks(*pool);
+        FREE(*pool);
+}
+
+
+/**************************/
+/*       Allocation       */
+/**************************/
+
+
+/********** Pool_alloc ********
+ *
+ * Purpose: Allocates nbytes from a pool
+ *
+ * Parameters:
+ *      - pool: the pool to allocate from
+ *      - nbytes: the number of bytes needed
+ *
+ * Return: a pointer to nbytes of uninitialized memory, aligned to ALIGN
+ *
+ * Expects: none
+ *
+ * CRE: pool is null, nbytes is negative, or memory can't be allocated
+ *
+ * Notes:
+ *      - The memory stays valid until the next Pool_reset() or Pool_free()
+ *      - Only reaches the system allocator when the newest chunk is full
+ */
+void *Pool_alloc(Pool_T pool, long nbytes)
+{
+        assert(pool != NULL);
+        assert(nbytes >= 0);
+
+        nbytes = round_up(nbytes);
+
+        /* get a new chunk if the newest one can't hold this allocation */
+        if (pool->head == NULL ||
+            pool->head->limit - pool->head->avail < nbytes) {
+                add_chunk(pool, nbytes);
+        }
+
+        char *ptr = pool->head->avail;
+        pool->head->avail += nbytes;
+
+        /* update statistics */
+        pool->stats.allocations++;
+        pool->stats.in_use += nbytes;
+        if (pool->stats.in_use > pool->stats.high_water) {
+                pool->stats.high_water = pool->stats.in_use;
+        }
+
+        return ptr;
+}
+
+/********** Pool_reserve ********
+ *
+ * Purpose: Makes sure the next nbytes of allocations from a pool can be
+ *          served without going back to the system
+ *
+ * Parameters:
+ *      - pool: the pool to reserve space in
+ *      - nbytes: the total number of bytes about to be allocated
+ *
+ * Return: none
+ *
+ * Expects: none
+ *
+ * CRE: pool is null, nbytes is negative, or memory can't be allocated
+ *
+ * Notes:
+ *      - Used once an image header has been read, so that every buffer
+ *        for the image comes from one chunk
+ *      - Leaves the pool alone if the newest chunk already has room
+ */
+void Pool_reserve(Pool_T pool, long nbytes)
+{
+        assert(pool != NULL);
+        assert(nbytes >= 0);
+
+        nbytes = round_up(nbytes);
+
+        if (pool->head != NULL &&
+            pool->head->limit - pool->head->avail >= nbytes) {
+                return;
+        }
+
+        add_chunk(pool, nbytes);
+}
+
+/********** Pool_reset ********
+ *
+ * Purpose: Gives back everything allocated from a pool at once, keeping
+ *          its memory for the next round of allocations
+ *
+ * Parameters:
+ *      - pool: the pool to reset
+ *
+ * Return: none
+ *
+ * Expects: nothing allocated from the pool is used afterwards
+ *
+ * CRE: pool is null, or memory can't be allocated
+ *
+ * Notes:
+ *      - If the pool grew to several chunks they are replaced by a single
+ *        chunk as large as all of them, so the next image of the same
+ *        size fits without growing again
+ */
+void Pool_reset(Pool_T pool)
+{
+        assert(pool != NULL);
+
+        pool->stats.in_use = 0;
+        pool->stats.resets++;
+
+        if (pool->head == NULL) {
+                return;
+        }
+
+        /* merge several chunks into one */
+        if (pool->head->prev != NULL) {
+                long capacity = pool->stats.capacity;
+                free_chunks(pool);
+                add_chunk(pool, capacity);
+                return;
+        }
+
+        pool->head->avail = (char *)pool->head + HEADER_SIZE;
+}
+
+
+/**************************/
+/*       Statistics       */
+/**************************/
+
+
+/********** Pool_stats ********
+ *
+ * Purpose: Reports how a pool has been used
+ *
+ * Parameters:
+ *      - pool: the pool to report on
+ *
+ * Return: a copy of the pool's statistics
+ *
+ * Expects: none
+ *
+ * CRE: pool is null
+ */
+struct Pool_stats Pool_stats(Pool_T pool)
+{
+        assert(pool != NULL);
+        return pool->stats;
+}
+
+/********** Pool_print_stats ********
+ *
+ * Purpose: Prints a pool's statistics in a human-readable form
+ *
+ * Parameters:
+ *      - pool: the pool to report on
+ *      - output: where to print the statistics
+ *
+ * Return: none
+ *
+ * Expects: none
+ *
+ * CRE: pool is null, or output is null
+ */
+void Pool_print_stats(Pool_T pool, FILE *output)
+{
+        assert(pool != NULL);
+        assert(output != NULL);
+
+        struct Pool_stats stats = pool->stats;
+        fprintf(output, "pool: %ld bytes in use, %ld high water, "
+                "%ld capacity\n", stats.in_use, stats.high_water,
+                stats.capacity);
+        fprintf(output, "pool: %ld allocations, %ld chunks, %ld resets\n",
+                stats.allocations, stats.chunks, stats.resets);
+}
+
+
+/**************************/
+/*  Per-thread pool       */
+/**************************/
+
+
+/********** Pool_current ********
+ *
+ * Purpose: Returns the calling thread's current pool
+ *
+ * Parameters: none
+ *
+ * Return: the pool installed with Pool_use(), or a pool created the first
+ *         time this thread asks for one
+ *
+ * Expects: none
+ *
+ * CRE: memory can't be allocated
+ *
+ * Notes:
+ *      - A pool created here lives as long as the thread. Threads that come
+ *        and go should install and free their own pools instead
+ */
+Pool_T Pool_current(void)
+{
+        if (current == NULL) {
+                current = Pool_new(0);
+        }
+        return current;
+}
+
+/********** Pool_use ********
+ *
+ * Purpose: Installs the calling thread's current pool
+ *
+ * Parameters:
+ *      - pool: the pool to use, or NULL to go back to a lazily created one
+ *
+ * Return: none
+ *
+ * Expects: none
+ *
+ * CRE: none
+ */
+void Pool_use(Pool_T pool)
+{
+        current = pool;
+}
+
+
+/**************************/
+/*    Helper functions    */
+/**************************/
+
+
+/********** add_chunk ********
+ *
+ * Purpose: Gets a new chunk from the system and makes it the newest chunk
+ *          of a pool
+ *
+ * Parameters:
+ *      - pool: the pool to grow
+ *      - nbytes: the number of usable bytes the chunk needs at least
+ *
+ * Return: none
+ *
+ * Expects: nbytes is already rounded up to ALIGN
+ *
+ * CRE: pool is null, or memory can't be allocated
+ *
+ * Notes:
+ *      - If the newest chunk has nothing allocated from it, it is replaced
+ *        rather than kept around unused
+ *      - Chunks at least double the pool's capacity so that growing to a
+ *        large image takes few system allocations
+ */
+static void add_chunk(Pool_T pool, long nbytes)
+{
+        assert(pool != NULL);
+
+        /* drop an empty newest chunk instead of stranding it */
+        struct chunk *head = pool->head;
+        if (head != NULL && head->avail == (char *)head + HEADER_SIZE) {
+                pool->head = head->prev;
+                pool->stats.capacity -= head->limit - head->avail;
+                FREE(head);
+        }
+
+        long size = nbytes;
+        if (size < pool->stats.capacity) {
+                size = pool->stats.capacity;
+        }
+        if (size < MIN_CHUNK) {
+                size = MIN_CHUNK;
+        }
+
+        struct chunk *new_chunk = ALLOC(HEADER_SIZE + size);
+        assert(new_chunk != NULL);
+        new_chunk->prev = pool->head;
+        new_chunk->avail = (char *)new_chunk + HEADER_SIZE;
+        new_chunk->limit = new_chunk->avail + size;
+
+        pool->head = new_chunk;
+        pool->stats.capacity += size;
+        pool->stats.chunks++;
+}
+
+/********** free_chunks ********
+ *
+ * Purpose: Frees every chunk a pool holds
+ *
+ * Parameters:
+ *      - pool: the pool whose chunks to free
+ *
+ * Return: none
+ *
+ * Expects: none
+ *
+ * CRE: pool is null
+ */
+static void free_chunks(Pool_T pool)
+{
+        assert(pool != NULL);
+
+        while (pool->head != NULL) {
+                struct chunk *prev = pool->head->prev;
+                FREE(pool->head);
+                pool->head = prev;
+        }
+        pool->stats.capacity = 0;
+}
+
+/********** round_up ********
+ *
+ * Purpose: Rounds a byte count up to a multiple of ALIGN
+ *
+ * Parameters:
+ *      - nbytes: the byte count
+ *
+ * Return: the rounded byte count
+ *
+ * Expects: nbytes is not negative
+ *
+ * CRE: none
+ */
+static long round_up(long nbytes)
+{
+        return (nbytes + ALIGN - 1) / ALIGN * ALIGN;
+}
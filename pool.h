@@ -0,0 +1,59 @@
+/**************************************************************
+ *
+ *                     pool.h
+ *
+ *     Assignment: Arith 
+ *     Authors:  Marielle Cibella (mcibel01), Erica Huang (ehuang02)
+ *     Date:     4/14/25
+ *
+ *     Summary:
+ * 
+ *     This header file declares an arena ("pool") allocator for the codec's 
+ *     per-image buffers. Memory is handed out by bumping a pointer through 
+ *     large chunks and is only given back all at once by Pool_reset(), which 
+ *     keeps the chunks around for the next image. Each thread has a current 
+ *     pool that the pool-backed A2Methods (a2pool.h) allocate from.
+ *     
+ *
+ **************************************************************/
+
+#ifndef POOL
+#define POOL
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/* structs */
+typedef struct Pool_T *Pool_T;
+
+/* 
+ * struct Pool_stats reports how a pool has been used. Byte counts include
+ * alignment padding.
+ */
+struct Pool_stats {
+        long in_use;            /* bytes handed out since the last reset */
+        long high_water;        /* most bytes ever in use at once */
+        long capacity;          /* bytes currently held in chunks */
+        long allocations;       /* number of Pool_alloc() calls */
+        long chunks;            /* number of chunks taken from the system */
+        long resets;            /* number of Pool_reset() calls */
+};
+
+/* creation and destruction */
+Pool_T Pool_new(long capacity);
+void Pool_free(Pool_T *pool);
+
+/* allocation */
+void *Pool_alloc(Pool_T pool, long nbytes);
+void Pool_reserve(Pool_T pool, long nbytes);
+void Pool_reset(Pool_T pool);
+
+/* statistics */
+struct Pool_stats Pool_stats(Pool_T pool);
+void Pool_print_stats(Pool_T pool, FILE *output);
+
+/* per-thread current pool */
+Pool_T Pool_current(void);
+void Pool_use(Pool_T pool);
+
+#endif
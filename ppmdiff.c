@@ -7,49 +7,177 @@
  *     Date:     2/21/25
  *
  *     Summary:
- * 
+ *
  *     This file compares two PPM images by computing the Root Mean 
  *     Square Difference (RMSD) between their pixel values. It ensures 
  *     the images are within an allowable size difference before calculating 
  *     color differences. The program outputs a numerical RMSD value, 
  *     indicating the level of difference between the two images
- *     
+ *
+ *     The images are streamed rather than loaded: a file is mapped with
+ *     mmap() and its rows decoded where they lie, and a pipe is read one
+ *     row at a time, so only a row of each image is held in memory. Each
+ *     row's samples are compared as one run of integers, four at a time
+ *     with GCC vector extensions (compiled for each instruction set in 
+ *     cpu.h and picked at startup), and the rows of mapped images are 
+ *     shared out among worker threads. With -t limit, the comparison stops as 
+ *     soon as the error summed so far proves the RMSD is over the limit.
+ *     With -m, the same pass also gathers the PSNR, each channel's RMSD,
+ *     the largest difference, and the SSIM, printed as JSON.
+ *
  *
  **************************************************************/
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <ctype.h>
 #include "assert.h"
-#include <except.h>
-#include <a2methods.h>
-#include <pnm.h>
-#include <a2blocked.h>
-#include "uarray2b.h"
-#include "uarray2.h"
 #include <math.h>
 #include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "cpu.h"
+
+/* the rows a worker compares each time it takes work */
+#define ROW_CHUNK 64
+
+/* samples (red, green, and blue values) in one vector */
+#define LANES 4
+
+/* the width and height of the blocks SSIM is computed over */
+#define SSIM_BLOCK 8
+
+typedef uint32_t samples __attribute__((vector_size(LANES *
+                                                   sizeof(uint32_t))));
+typedef uint64_t wide_sums __attribute__((vector_size(LANES *
+                                                      sizeof(uint64_t))));
+typedef double scaled __attribute__((vector_size(LANES * sizeof(double))));
+typedef int64_t scaled_mask __attribute__((vector_size(LANES *
+                                                       sizeof(int64_t))));
+
+/* the metrics -m can ask for */
+enum metric {
+        METRIC_RMSD = 1,      /* root mean square difference */
+        METRIC_PSNR = 2,      /* peak signal-to-noise ratio, in dB */
+        METRIC_CHANNELS = 4,  /* the RMSD of red, green, and blue */
+        METRIC_MAX = 8,       /* the largest difference of any sample */
+        METRIC_SSIM = 16      /* mean structural similarity of the luma */
+};
+
+static const char *const metric_names[] = {
+        "rmsd", "psnr", "channels", "max", "ssim"
+};
+#define NMETRICS 5
 
-/* Struct to hold RGB values as floating points for conversion */
-typedef struct {
-        float red, green, blue;
-} floatRGB;
+/*
+ * struct ppm_stream is one image being read a row at a time. A raw 
+ * ("P6") image in a regular file is mapped, so any row can be decoded 
+ * from map, data being the offset of its first row. Anything else (a 
+ * pipe, or a plain "P3" image) is read from file in order, next_row being
+ * the row it is up to, with bytes holding one raw row.
+ */
+typedef struct ppm_stream {
+        FILE *file;
+        bool plain;
+        unsigned width, height, denominator;
+        unsigned sample_bytes;    /* 1, or 2 if denominator > 255 */
+
+        const unsigned char *map;
+        size_t map_length;
+        size_t data;
+
+        unsigned next_row;
+        unsigned char *bytes;
+} ppm_stream;
+
+/*
+ * struct diff_stats is what one pass over the images gathers, every 
+ * sample scaled by its denominator to [0, 1]: for red, green, and blue, 
+ * the sum of the squared differences and the largest squared difference,
+ * and the sum and count of the SSIM of each block of luma
+ */
+typedef struct diff_stats {
+        double squares[3];
+        double largest[3];
+        double ssim_sum;
+        long ssim_blocks;
+} diff_stats;
+
+/*
+ * struct diff_job is one comparison, shared by its worker threads: the
+ * two images, the metrics wanted, the next row no worker has taken, and
+ * the stats gathered so far. bound is the total squared difference that
+ * proves the RMSD is over the -t limit (INFINITY without one); once the 
+ * total passes it, exceeded is set and the workers stop taking rows.
+ */
+typedef struct diff_job {
+        ppm_stream *image1, *image2;
+        unsigned width, height;
+        unsigned metrics;
+        double bound;
+
+        int next_row;
+        pthread_mutex_t lock;
+        diff_stats stats;
+        bool exceeded;
+} diff_job;
 
 /* helper function declerations */
-double rmsd(A2Methods_UArray2 pixels1, A2Methods_UArray2 pixels2,
-        A2Methods_T methods, int width, int height, int denom1, int denom2);
-double summation_helper(A2Methods_UArray2 pixels1, A2Methods_UArray2 pixels2,
-        A2Methods_T methods, int col, int row, int denom1, int denom2);
+bool compare(ppm_stream *image1, ppm_stream *image2, int width, int height,
+             unsigned metrics, double limit, int nthreads, 
+             diff_stats *stats);
+static void *diff_worker(void *cl);
+static void rows_stats(const diff_job *job, int first, int last,
+                       unsigned *samples1, unsigned *samples2, 
+                       double *ssim_sums, diff_stats *stats);
+CPU_KERNEL void row_stats_kernel(const unsigned *samples1, 
+                                 const unsigned *samples2, long nsamples,
+                                 double denom, diff_stats *stats);
+CPU_DECLARE_VARIANTS(row_stats, (const unsigned *samples1, 
+                                 const unsigned *samples2, long nsamples,
+                                 double denom, diff_stats *stats));
+CPU_KERNEL void row_stats_scaled_kernel(const unsigned *samples1,
+                                        const unsigned *samples2, 
+                                        long nsamples, double scale1, 
+                                        double scale2, diff_stats *stats);
+CPU_DECLARE_VARIANTS(row_stats_scaled, (const unsigned *samples1,
+                                        const unsigned *samples2, 
+                                        long nsamples, double scale1, 
+                                        double scale2, diff_stats *stats));
+static void ssim_row(const unsigned *samples1, const unsigned *samples2,
+                     unsigned width, double scale1, double scale2,
+                     double *ssim_sums);
+static void ssim_blocks(double *ssim_sums, unsigned width, unsigned rows,
+                        diff_stats *stats);
+static unsigned parse_metrics(const char *list);
+static void print_json(const diff_stats *stats, unsigned width, 
+                       unsigned height, unsigned metrics, double limit, 
+                       bool exceeded);
+static void stream_open(ppm_stream *image, FILE *file);
+static void stream_row(ppm_stream *image, unsigned row, unsigned *samples);
+static void stream_release(ppm_stream *image, unsigned first, unsigned last);
+static void stream_close(ppm_stream *image);
+static unsigned read_header_number(FILE *file);
+static void usage(const char *progname);
 
 /********** main ********
- * 
+ *
  * Purpose: Reads two PPM image files, validates their dimensions, and computes 
  *          the Root Mean Square Difference (RMSD) between them
  *
  * Parameters:
  *     - argc: The number of command-line arguments
  *     - argv: An array of command-line arguments, where:
+ *           ppmdiff [-j threads] [-t limit] [-m metrics] image1 image2
+ *       and either image may be "-" for stdin
  *
  * Return:
- *     - Returns EXIT_SUCCESS (0) if successful
+ *     - Returns EXIT_SUCCESS (0) if successful, or with -t if the RMSD is
+ *       at most the limit
+ *     - Returns EXIT_FAILURE (1) with -t if the RMSD is over the limit
  *     - Terminates with an error message if the images differ in size by 
  *       more than 1 pixel
  *
@@ -59,33 +187,65 @@ double summation_helper(A2Methods_UArray2 pixels1, A2Methods_UArray2 pixels2,
  *     - Both files are in the correct PPM format
  *
  * Notes:
- *     - Uses Pnm_ppmread() to read images into A2Methods_UArray2
+ *     - Reads only the images' headers up front; the pixels are streamed
+ *       (see struct ppm_stream), so memory doesn't grow with height
  *     - Compares images based on the smaller of their dimensions
- *     - Outputs the RMSD value with four decimal places
+ *     - Outputs the RMSD value with four decimal places, or with -t and an
+ *       image over the limit, ">" and the limit (the exact RMSD isn't
+ *       known, since the comparison stopped early)
+ *     - -m takes a comma-separated list of metrics (see parse_metrics())
+ *       and prints them as one JSON object instead (see print_json())
+ *     - -j sets the worker threads, one per processor by default
  */
 int main(int argc, char *argv[]) 
 {
-        assert(argc == 3);
-        
+        int nthreads = 0;
+        double limit = INFINITY;
+        unsigned metrics = 0;
+
+        int i = 1;
+        for (; i < argc && argv[i][0] == '-' && argv[i][1] != '\0'; i++) {
+                if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+                        nthreads = atoi(argv[++i]);
+                } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+                        limit = atof(argv[++i]);
+                        if (!(limit >= 0)) {
+                                usage(argv[0]);
+                        }
+                } else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+                        metrics = parse_metrics(argv[++i]);
+                        if (metrics == 0) {
+                                usage(argv[0]);
+                        }
+                } else {
+                        usage(argv[0]);
+                }
+        }
+        if (argc - i != 2) {
+                usage(argv[0]);
+        }
+        char **names = &argv[i];
+
         FILE *file1;
         FILE *file2;
 
         /* make sure both aren't "-" */
-        assert(!((strcmp(argv[1], "-") == 0) && (strcmp(argv[2], "-") == 0)));
+        assert(!((strcmp(names[0], "-") == 0) &&
+                 (strcmp(names[1], "-") == 0)));
 
-        for(int i = 1; i < 3; i++){
-                if(strcmp(argv[i], "-") == 0){
-                        if(i == 1){
+        for(int i = 0; i < 2; i++){
+                if(strcmp(names[i], "-") == 0){
+                        if(i == 0){
                                 file1 = stdin;
                         } else {
                                 file2 = stdin;
                         }
 
                 } else{
-                        if(i == 1){
-                                file1 = fopen(argv[i], "rb");
+                        if(i == 0){
+                                file1 = fopen(names[i], "rb");
                         } else {
-                                file2 = fopen(argv[i], "rb");
+                                file2 = fopen(names[i], "rb");
                         }
                 }
         }
@@ -93,16 +253,13 @@ int main(int argc, char *argv[])
         assert(file1 != NULL);
         assert(file2 != NULL);
 
-        A2Methods_T methods = uarray2_methods_blocked;
-        Pnm_ppm ppm1 = Pnm_ppmread(file1, methods);
-        Pnm_ppm ppm2 = Pnm_ppmread(file2, methods);
-
-        assert(ppm1 != NULL);
-        assert(ppm2 != NULL);
+        ppm_stream image1, image2;
+        stream_open(&image1, file1);
+        stream_open(&image2, file2);
 
         /* Calculate the width/height difference between the two images */
-        int width_diff = abs((int)ppm1->width - (int)ppm2->width);
-        int height_diff = abs((int)ppm1->height - (int)ppm2->height);
+        int width_diff = abs((int)image1.width - (int)image2.width);
+        int height_diff = abs((int)image1.height - (int)image2.height);
 
         if (width_diff > 1 || height_diff > 1) {
                 fprintf(stderr, 
@@ -111,114 +268,876 @@ int main(int argc, char *argv[])
         }
 
         /* determine smaller image */
-        unsigned width = ppm1->width; 
-        if (ppm2->width < width){
-                width = ppm2->width;
+        unsigned width = image1.width; 
+        if (image2.width < width){
+                width = image2.width;
         }
-        unsigned height = ppm1->height; 
-        if (ppm2->height < height){
-                height = ppm2->height;
+        unsigned height = image1.height; 
+        if (image2.height < height){
+                height = image2.height;
         }
 
-        /* Calculate the Root Mean Square Difference */
-        double E = rmsd(ppm1->pixels, ppm2->pixels, methods, width, height, 
-                          ppm1->denominator, ppm2->denominator);
+        /* Compare the images in one pass */
+        diff_stats stats;
+        bool exceeded = compare(&image1, &image2, width, height, metrics,
+                                limit, nthreads, &stats);
 
         /* print */
-        printf("%.4f\n", E);
+        if (metrics != 0) {
+                print_json(&stats, width, height, metrics, limit, exceeded);
+        } else if (exceeded) {
+                printf(">%.4f\n", limit);
+        } else {
+                double total = stats.squares[0] + stats.squares[1] + 
+                               stats.squares[2];
+                printf("%.4f\n", sqrt(total / (3.0 * width * height)));
+        }
 
         /*clean up*/
-        Pnm_ppmfree(&ppm1);
-        Pnm_ppmfree(&ppm2);
+        stream_close(&image1);
+        stream_close(&image2);
         fclose(file1);
         fclose(file2);
-        return EXIT_SUCCESS; 
+        return exceeded ? EXIT_FAILURE : EXIT_SUCCESS;
 }
 
-/********** rmsd ********
- * 
- * Purpose: Computes the Root Mean Square Difference (RMSD) between two images
+/********** compare ********
+ *
+ * Purpose: Gathers the stats of the differences between two images in one
+ *          pass over their rows
  *
  * Parameters:
- *     - pixels1: pixel data for image 1
- *     - pixels2: pixel data for image 2
- *     - methods: A2Methods_T function for handling UArray2
+ *     - image1: image 1, opened with stream_open()
+ *     - image2: image 2, opened with stream_open()
  *     - width: The common width of both images (after trimming if needed)
  *     - height: The common height of both images (after trimming if needed)
- *     - denom1: The denominator used for scaling color values in image 1
- *     - denom2: The denominator used for scaling color values in image 2
+ *     - metrics: the enum metric flags wanted (SSIM costs a second, 
+ *                scalar look at each row, so it is only done if asked)
+ *     - limit: the largest RMSD of interest, or INFINITY
+ *     - nthreads: the worker threads to use, or 0 for one per processor
+ *     - stats: where to store the stats
  *
- * Return: The computed RMSD value as a double
+ * Return: whether the RMSD was found to be over limit, in which case stats
+ *         only covers the rows compared before that was known
  *
  * Expects:
- *     - pixels1 and pixels2 are not NULL
+ *     - image1 and image2 are not NULL and no rows have been read
  *     - width and height are greater than zero
- *     - denom1 and denom2 are valid positive integers
  *
  * Notes:
- *     - Uses helper function, summation_helper, to compute color differences
+ *     - Workers take ROW_CHUNK rows at a time and compare them with
+ *       rows_stats(), adding each chunk's stats to the shared ones
+ *     - Only mapped images can have their rows read out of order, so an
+ *       image read from a pipe gets one worker
+ *     - The squared differences only grow, so once their total passes the
+ *       total a limit RMSD would have, the RMSD is over the limit whatever
+ *       the rest of the rows hold
  */
-double rmsd(A2Methods_UArray2 pixels1, A2Methods_UArray2 pixels2,
-            A2Methods_T methods, int width, int height, int denom1, int denom2)
+bool compare(ppm_stream *image1, ppm_stream *image2, int width, int height,
+             unsigned metrics, double limit, int nthreads, diff_stats *stats)
 {
-        double total = 0.0;
-       
-        for (int rowy = 0; rowy < height; rowy++){
-                for(int colx = 0; colx < width; colx++){
-                        total += summation_helper(pixels1, pixels2, methods, 
-                                colx, rowy, denom1, denom2);
+        assert(image1 != NULL && image2 != NULL);
+        assert(stats != NULL);
+        assert((width * height) != 0);
+
+        double count = 3.0 * width * height;
+        diff_job job;
+        memset(&job, 0, sizeof(job));
+        job.image1 = image1;
+        job.image2 = image2;
+        job.width = width;
+        job.height = height;
+        job.metrics = metrics;
+        job.bound = limit * limit * count;
+        pthread_mutex_init(&job.lock, NULL);
+
+        /* one worker per processor, but never more workers than chunks */
+        int nchunks = (height + ROW_CHUNK - 1) / ROW_CHUNK;
+        if (nthreads <= 0) {
+                nthreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+        }
+        if (nthreads > nchunks) {
+                nthreads = nchunks;
+        }
+        if (image1->map == NULL || image2->map == NULL) {
+                nthreads = 1;
+        }
+        if (nthreads <= 1) {
+                diff_worker(&job);
+        } else {
+                pthread_t *threads = malloc(nthreads * sizeof(pthread_t));
+                assert(threads != NULL);
+                for (int i = 0; i < nthreads; i++) {
+                        int rc = pthread_create(&threads[i], NULL,
+                                                diff_worker, &job);
+                        assert(rc == 0);
+                }
+                for (int i = 0; i < nthreads; i++) {
+                        pthread_join(threads[i], NULL);
                 }
+                free(threads);
         }
+        pthread_mutex_destroy(&job.lock);
 
-        assert((width * height) != 0);
-        
-        double quotient = total / (3.0 * width * height);
+        *stats = job.stats;
+        return job.exceeded;
+}
+
+/********** diff_worker ********
+ *
+ * Purpose: Compares chunks of rows of a diff_job until none are left or
+ *          the job's limit is exceeded
+ *
+ * Parameters:
+ *     - cl: the diff_job
+ *
+ * Return: NULL
+ *
+ * Expects:
+ *     - cl is a diff_job shared by every worker of the comparison
+ *
+ * Notes:
+ *     - Rows are taken with an atomic add, as batch.c takes files, and
+ *       each chunk's stats are added to the job's under its lock
+ *     - Each worker decodes rows into its own two rows of samples, and
+ *       sums the luma of its SSIM blocks in its own row of sums. ROW_CHUNK
+ *       is a multiple of SSIM_BLOCK, so no block spans two chunks
+ */
+static void *diff_worker(void *cl)
+{
+        diff_job *job = cl;
+        assert(job != NULL);
+
+        unsigned *samples1 = malloc(3L * job->image1->width * 
+                                    sizeof(unsigned) + 1);
+        unsigned *samples2 = malloc(3L * job->image2->width * 
+                                    sizeof(unsigned) + 1);
+        long nblocks = (job->width + SSIM_BLOCK - 1) / SSIM_BLOCK;
+        double *ssim_sums = calloc(5 * nblocks, sizeof(double));
+        assert(samples1 != NULL && samples2 != NULL && ssim_sums != NULL);
+
+        while (!job->exceeded) {
+                int first = __sync_fetch_and_add(&job->next_row, ROW_CHUNK);
+                if (first >= (int)job->height) {
+                        break;
+                }
+                int last = first + ROW_CHUNK;
+                if (last > (int)job->height) {
+                        last = job->height;
+                }
+
+                diff_stats chunk;
+                memset(&chunk, 0, sizeof(chunk));
+                rows_stats(job, first, last, samples1, samples2, ssim_sums,
+                           &chunk);
 
-        return sqrt(quotient);
+                pthread_mutex_lock(&job->lock);
+                diff_stats *stats = &job->stats;
+                for (int c = 0; c < 3; c++) {
+                        stats->squares[c] += chunk.squares[c];
+                        if (chunk.largest[c] > stats->largest[c]) {
+                                stats->largest[c] = chunk.largest[c];
+                        }
+                }
+                stats->ssim_sum += chunk.ssim_sum;
+                stats->ssim_blocks += chunk.ssim_blocks;
+                if (stats->squares[0] + stats->squares[1] + 
+                    stats->squares[2] > job->bound) {
+                        job->exceeded = true;
+                }
+                pthread_mutex_unlock(&job->lock);
+        }
+
+        free(samples1);
+        free(samples2);
+        free(ssim_sums);
+        return NULL;
 }
 
-/********** summation_helper ********
- * 
- * Purpose: Computes the squared difference of RGB values for a single pixel
+/********** rows_stats ********
+ *
+ * Purpose: Gathers the stats of the differences of some rows of a 
+ *          diff_job's images
  *
  * Parameters:
- *     - pixels1: pixel data for image 1
- *     - pixels2: pixel data for image 2
- *     - methods: A2Methods_T function for handling UArray2
- *     - width: The common width of both images (after trimming if needed)
- *     - height: The common height of both images (after trimming if needed)
- *     - denom1: The denominator used for scaling color values in image 1
- *     - denom2: The denominator used for scaling color values in image 2
+ *     - job: the comparison
+ *     - first: the first row to compare
+ *     - last: one past the last row to compare
+ *     - samples1, samples2: room for a row of each image's samples
+ *     - ssim_sums: the worker's zeroed sums for a row of SSIM blocks
+ *     - stats: the zeroed stats to add the rows' to
  *
- * Return: The squared difference of RGB values for the given pixel
+ * Return: none
  *
  * Expects:
- *     - pixels1 and pixels2 contain valid pixel data
- *     - methods is a valid function table
- *     - col and row indices are within bounds
- *     - denom1 and denom2 are positive integers
+ *     - an image that isn't mapped has read exactly first rows
+ *     - first is a multiple of SSIM_BLOCK
+ *
+ * Notes:
+ *     - A row of width pixels is 3 * width unsigned samples. When both
+ *       images have the same denominator the differences are summed as
+ *       exact integers and divided by the denominator squared once per
+ *       row, instead of six divisions per pixel
+ *     - Leaves ssim_sums zeroed again
  */
-double summation_helper(A2Methods_UArray2 pixels1, A2Methods_UArray2 pixels2,
-                        A2Methods_T methods, int col, int row, int denom1, 
-                        int denom2)
+static void rows_stats(const diff_job *job, int first, int last,
+                       unsigned *samples1, unsigned *samples2, 
+                       double *ssim_sums, diff_stats *stats)
 {
-        Pnm_rgb pixel1 = methods->at(pixels1, col, row);
-        Pnm_rgb pixel2 = methods->at(pixels2, col, row);
-        
-        double red1 = pixel1->red / ((double)denom1);
-        double green1 = pixel1->green / ((double)denom1);
-        double blue1 = pixel1->blue / ((double)denom1);
+        long nsamples = 3L * job->width;
+        unsigned denom1 = job->image1->denominator;
+        unsigned denom2 = job->image2->denominator;
 
-        double red2 = pixel2->red / ((double)denom2);
-        double green2 = pixel2->green / ((double)denom2);
-        double blue2 = pixel2->blue / ((double)denom2);
+        for (int row = first; row < last; row++) {
+                stream_row(job->image1, row, samples1);
+                stream_row(job->image2, row, samples2);
+                if (denom1 == denom2) {
+                        CPU_DISPATCH(row_stats)(samples1, samples2, 
+                                                nsamples, denom1, stats);
+                } else {
+                        CPU_DISPATCH(row_stats_scaled)(samples1, samples2,
+                                                       nsamples, 
+                                                       1.0 / denom1, 
+                                                       1.0 / denom2, stats);
+                }
 
-        double rDiff = red1 - red2;
-        double bDiff = blue1 - blue2;
-        double gDiff = green1 - green2;
+                if ((job->metrics & METRIC_SSIM) == 0) {
+                        continue;
+                }
+                ssim_row(samples1, samples2, job->width, 1.0 / denom1,
+                         1.0 / denom2, ssim_sums);
+                if ((row + 1) % SSIM_BLOCK == 0 || 
+                    row + 1 == (int)job->height) {
+                        ssim_blocks(ssim_sums, job->width, 
+                                    row % SSIM_BLOCK + 1, stats);
+                }
+        }
 
-        double total = (rDiff * rDiff) + (gDiff * gDiff) + (bDiff * bDiff);
+        stream_release(job->image1, first, last);
+        stream_release(job->image2, first, last);
+}
 
-        return total;
+/********** row_stats_kernel ********
+ *
+ * Purpose: Adds the squared differences of two runs of samples with the 
+ *          same denominator to stats, per channel, along with the largest
+ *
+ * Parameters:
+ *     - samples1: the samples of image 1
+ *     - samples2: the samples of image 2
+ *     - nsamples: how many samples each run has
+ *     - denom: the images' denominator
+ *     - stats: where to add the row's squares and largest squares
+ *
+ * Return: none
+ *
+ * Expects:
+ *     - every sample is at most 65535 (the largest PPM denominator)
+ *     - nsamples is a multiple of 3 (whole pixels)
+ *
+ * Notes:
+ *     - A difference squared is less than 2^32, so LANES of them are
+ *       squared in unsigned 32-bit lanes (where a negative difference
+ *       wraps around but its square comes out right) and widened to 64
+ *       bits to be summed
+ *     - Three vectors (LANES pixels) are taken at a time so that each
+ *       lane always holds the same channel, and the lanes are only sorted
+ *       into red, green, and blue once, after the loop
+ *     - Called as CPU_DISPATCH(row_stats) (cpu.h)
+ */
+CPU_KERNEL void row_stats_kernel(const unsigned *samples1, 
+                                 const unsigned *samples2, long nsamples,
+                                 double denom, diff_stats *stats)
+{
+        wide_sums sums[3] = { { 0, 0, 0, 0 }, { 0, 0, 0, 0 }, 
+                              { 0, 0, 0, 0 } };
+        samples largest[3] = { { 0, 0, 0, 0 }, { 0, 0, 0, 0 }, 
+                               { 0, 0, 0, 0 } };
+        long i = 0;
+        for (; i + 3 * LANES <= nsamples; i += 3 * LANES) {
+                for (int k = 0; k < 3; k++) {
+                        samples a, b;
+                        memcpy(&a, samples1 + i + k * LANES, sizeof(a));
+                        memcpy(&b, samples2 + i + k * LANES, sizeof(b));
+                        samples diff = a - b;
+                        samples square = diff * diff;
+                        sums[k] += __builtin_convertvector(square, 
+                                                           wide_sums);
+                        samples bigger = (samples)(square > largest[k]);
+                        largest[k] = (square & bigger) | 
+                                     (largest[k] & ~bigger);
+                }
+        }
+
+        /* lane j of vector k holds channel (k * LANES + j) % 3 */
+        uint64_t total[3] = { 0, 0, 0 };
+        uint32_t most[3] = { 0, 0, 0 };
+        for (int k = 0; k < 3; k++) {
+                for (int j = 0; j < LANES; j++) {
+                        int c = (k * LANES + j) % 3;
+                        total[c] += sums[k][j];
+                        if (largest[k][j] > most[c]) {
+                                most[c] = largest[k][j];
+                        }
+                }
+        }
+        for (; i < nsamples; i++) {
+                int64_t diff = (int64_t)samples1[i] - samples2[i];
+                uint32_t square = diff * diff;
+                total[i % 3] += square;
+                if (square > most[i % 3]) {
+                        most[i % 3] = square;
+                }
+        }
+
+        double denom_squared = denom * denom;
+        for (int c = 0; c < 3; c++) {
+                stats->squares[c] += total[c] / denom_squared;
+                if (most[c] / denom_squared > stats->largest[c]) {
+                        stats->largest[c] = most[c] / denom_squared;
+                }
+        }
 }
 
+/* row_stats_kernel() for each level of cpu.h */
+CPU_VARIANTS(row_stats, (const unsigned *samples1, const unsigned *samples2,
+                         long nsamples, double denom, diff_stats *stats),
+             (samples1, samples2, nsamples, denom, stats));
+
+/********** row_stats_scaled_kernel ********
+ *
+ * Purpose: Adds the squared differences of two runs of samples with 
+ *          different denominators to stats, as row_stats_kernel() does
+ *
+ * Parameters:
+ *     - samples1: the samples of image 1
+ *     - samples2: the samples of image 2
+ *     - nsamples: how many samples each run has
+ *     - scale1: 1 / the denominator of image 1
+ *     - scale2: 1 / the denominator of image 2
+ *     - stats: where to add the row's squares and largest squares
+ *
+ * Return: none
+ *
+ * Expects:
+ *     - nsamples is a multiple of 3 (whole pixels)
+ *
+ * Notes:
+ *     - Called as CPU_DISPATCH(row_stats_scaled) (cpu.h)
+ */
+CPU_KERNEL void row_stats_scaled_kernel(const unsigned *samples1,
+                                        const unsigned *samples2, 
+                                        long nsamples, double scale1, 
+                                        double scale2, diff_stats *stats)
+{
+        scaled sums[3] = { { 0, 0, 0, 0 }, { 0, 0, 0, 0 }, 
+                           { 0, 0, 0, 0 } };
+        scaled largest[3] = { { 0, 0, 0, 0 }, { 0, 0, 0, 0 }, 
+                              { 0, 0, 0, 0 } };
+        long i = 0;
+        for (; i + 3 * LANES <= nsamples; i += 3 * LANES) {
+                for (int k = 0; k < 3; k++) {
+                        samples a, b;
+                        memcpy(&a, samples1 + i + k * LANES, sizeof(a));
+                        memcpy(&b, samples2 + i + k * LANES, sizeof(b));
+                        scaled diff = 
+                                __builtin_convertvector(a, scaled) * scale1 -
+                                __builtin_convertvector(b, scaled) * scale2;
+                        scaled square = diff * diff;
+                        sums[k] += square;
+                        scaled_mask bigger = square > largest[k];
+                        largest[k] = (scaled)(((scaled_mask)square & bigger) |
+                                              ((scaled_mask)largest[k] & 
+                                               ~bigger));
+                }
+        }
+
+        /* lane j of vector k holds channel (k * LANES + j) % 3 */
+        double total[3] = { 0, 0, 0 };
+        double most[3] = { 0, 0, 0 };
+        for (int k = 0; k < 3; k++) {
+                for (int j = 0; j < LANES; j++) {
+                        int c = (k * LANES + j) % 3;
+                        total[c] += sums[k][j];
+                        if (largest[k][j] > most[c]) {
+                                most[c] = largest[k][j];
+                        }
+                }
+        }
+        for (; i < nsamples; i++) {
+                double diff = samples1[i] * scale1 - samples2[i] * scale2;
+                total[i % 3] += diff * diff;
+                if (diff * diff > most[i % 3]) {
+                        most[i % 3] = diff * diff;
+                }
+        }
+
+        for (int c = 0; c < 3; c++) {
+                stats->squares[c] += total[c];
+                if (most[c] > stats->largest[c]) {
+                        stats->largest[c] = most[c];
+                }
+        }
+}
+
+/* row_stats_scaled_kernel() for each level of cpu.h */
+CPU_VARIANTS(row_stats_scaled, (const unsigned *samples1,
+                                const unsigned *samples2, long nsamples,
+                                double scale1, double scale2,
+                                diff_stats *stats),
+             (samples1, samples2, nsamples, scale1, scale2, stats));
+
+/********** ssim_row ********
+ *
+ * Purpose: Adds one row's luma to the sums of its SSIM blocks
+ *
+ * Parameters:
+ *     - samples1: the samples of image 1
+ *     - samples2: the samples of image 2
+ *     - width: the pixels in the row
+ *     - scale1: 1 / the denominator of image 1
+ *     - scale2: 1 / the denominator of image 2
+ *     - ssim_sums: five sums per block of SSIM_BLOCK columns: of image 1's
+ *                  luma, image 2's, their squares, and their product
+ *
+ * Return: none
+ *
+ * Expects: none
+ *
+ * Notes:
+ *     - Luma is Y of ry_conversion.c's Y/Pb/Pr, in [0, 1]
+ */
+static void ssim_row(const unsigned *samples1, const unsigned *samples2,
+                     unsigned width, double scale1, double scale2,
+                     double *ssim_sums)
+{
+        for (unsigned x = 0; x < width; x++) {
+                const unsigned *rgb1 = samples1 + 3 * x;
+                const unsigned *rgb2 = samples2 + 3 * x;
+                double y1 = (0.299 * rgb1[0] + 0.587 * rgb1[1] + 
+                             0.114 * rgb1[2]) * scale1;
+                double y2 = (0.299 * rgb2[0] + 0.587 * rgb2[1] + 
+                             0.114 * rgb2[2]) * scale2;
+
+                double *sums = ssim_sums + 5 * (x / SSIM_BLOCK);
+                sums[0] += y1;
+                sums[1] += y2;
+                sums[2] += y1 * y1;
+                sums[3] += y2 * y2;
+                sums[4] += y1 * y2;
+        }
+}
+
+/********** ssim_blocks ********
+ *
+ * Purpose: Finishes a row of SSIM blocks, adding each block's SSIM to stats
+ *
+ * Parameters:
+ *     - ssim_sums: the blocks' sums, filled by ssim_row()
+ *     - width: the pixels in a row
+ *     - rows: the rows in the blocks (less than SSIM_BLOCK at the bottom)
+ *     - stats: where to add the blocks' SSIM
+ *
+ * Return: none
+ *
+ * Expects: none
+ *
+ * Notes:
+ *     - Uses the usual constants, C1 = (0.01 L)^2 and C2 = (0.03 L)^2 for
+ *       a range L of 1. Zeroes ssim_sums for the next row of blocks
+ */
+static void ssim_blocks(double *ssim_sums, unsigned width, unsigned rows,
+                        diff_stats *stats)
+{
+        const double c1 = 0.01 * 0.01;
+        const double c2 = 0.03 * 0.03;
+
+        for (unsigned x = 0; x < width; x += SSIM_BLOCK) {
+                double *sums = ssim_sums + 5 * (x / SSIM_BLOCK);
+                unsigned columns = width - x < SSIM_BLOCK ? width - x 
+                                                          : SSIM_BLOCK;
+                double n = (double)columns * rows;
+
+                double mean1 = sums[0] / n;
+                double mean2 = sums[1] / n;
+                double var1 = sums[2] / n - mean1 * mean1;
+                double var2 = sums[3] / n - mean2 * mean2;
+                double covar = sums[4] / n - mean1 * mean2;
+
+                stats->ssim_sum += (2 * mean1 * mean2 + c1) * 
+                                   (2 * covar + c2) /
+                                   ((mean1 * mean1 + mean2 * mean2 + c1) *
+                                    (var1 + var2 + c2));
+                stats->ssim_blocks++;
+                memset(sums, 0, 5 * sizeof(double));
+        }
+}
+
+/********** parse_metrics ********
+ *
+ * Purpose: Reads the list of metrics given with -m
+ *
+ * Parameters:
+ *     - list: names from metric_names, or "all", separated by commas
+ *
+ * Return: the enum metric flags named, or 0 if any name is unknown
+ *
+ * Expects:
+ *     - list is not NULL
+ */
+static unsigned parse_metrics(const char *list)
+{
+        assert(list != NULL);
+
+        unsigned metrics = 0;
+        while (*list != '\0') {
+                size_t length = strcspn(list, ",");
+                unsigned metric = 0;
+                if (length == 3 && strncmp(list, "all", 3) == 0) {
+                        metric = (1u << NMETRICS) - 1;
+                }
+                for (int m = 0; m < NMETRICS; m++) {
+                        if (strlen(metric_names[m]) == length &&
+                            strncmp(list, metric_names[m], length) == 0) {
+                                metric = 1u << m;
+                        }
+                }
+                if (metric == 0) {
+                        return 0;
+                }
+                metrics |= metric;
+
+                list += length;
+                if (*list == ',') {
+                        list++;
+                }
+        }
+        return metrics;
+}
+
+/********** print_json ********
+ *
+ * Purpose: Prints the metrics asked for with -m as one line of JSON
+ *
+ * Parameters:
+ *     - stats: the comparison's stats
+ *     - width, height: the size compared
+ *     - metrics: the enum metric flags to print
+ *     - limit: the -t limit, or INFINITY
+ *     - exceeded: whether the RMSD was found to be over limit
+ *
+ * Return: none
+ *
+ * Expects:
+ *     - stats is not NULL
+ *
+ * Notes:
+ *     - Every field but width and height is optional: "rmsd", "psnr" (in
+ *       dB, null for identical images), "channels" (an object of red, 
+ *       green, and blue RMSD), "max" (the largest difference of any one
+ *       sample, as a fraction of the denominator), and "ssim". With -t,
+ *       "limit" and "exceeded" are added, and an image over the limit gets
+ *       no metrics, since the comparison stopped early
+ */
+static void print_json(const diff_stats *stats, unsigned width, 
+                       unsigned height, unsigned metrics, double limit, 
+                       bool exceeded)
+{
+        assert(stats != NULL);
+
+        double pixels = (double)width * height;
+        double total = stats->squares[0] + stats->squares[1] + 
+                       stats->squares[2];
+        double mse = total / (3.0 * pixels);
+
+        printf("{\"width\":%u,\"height\":%u", width, height);
+        if (limit != INFINITY) {
+                printf(",\"limit\":%.6f,\"exceeded\":%s", limit, 
+                       exceeded ? "true" : "false");
+        }
+        if (exceeded) {
+                metrics = 0;
+        }
+        if (metrics & METRIC_RMSD) {
+                printf(",\"rmsd\":%.6f", sqrt(mse));
+        }
+        if (metrics & METRIC_PSNR) {
+                if (mse > 0) {
+                        printf(",\"psnr\":%.6f", -10 * log10(mse));
+                } else {
+                        printf(",\"psnr\":null");
+                }
+        }
+        if (metrics & METRIC_CHANNELS) {
+                printf(",\"channels\":{\"red\":%.6f,\"green\":%.6f,"
+                       "\"blue\":%.6f}", sqrt(stats->squares[0] / pixels),
+                       sqrt(stats->squares[1] / pixels),
+                       sqrt(stats->squares[2] / pixels));
+        }
+        if (metrics & METRIC_MAX) {
+                double largest = fmax(stats->largest[0], 
+                                      fmax(stats->largest[1], 
+                                           stats->largest[2]));
+                printf(",\"max\":%.6f", sqrt(largest));
+        }
+        if (metrics & METRIC_SSIM) {
+                printf(",\"ssim\":%.6f", 
+                       stats->ssim_sum / stats->ssim_blocks);
+        }
+        printf("}\n");
+}
+
+/********** stream_open ********
+ *
+ * Purpose: Reads the header of a PPM image and gets ready to stream its
+ *          rows
+ *
+ * Parameters:
+ *     - image: the stream to set up
+ *     - file: the image, positioned at its start
+ *
+ * Return: none
+ *
+ * Expects:
+ *     - file holds a "P6" (raw) or "P3" (plain) PPM image
+ *
+ * CRE: the header is malformed, the denominator isn't 1 to 65535, or
+ *      memory can't be allocated
+ *
+ * Notes:
+ *     - A raw image in a regular file (including a redirected stdin) is
+ *       mapped whole with mmap(); the kernel pages it in as rows are
+ *       touched, and stream_release() gives the pages back once their 
+ *       rows are compared. Other images get a one-row byte buffer
+ */
+static void stream_open(ppm_stream *image, FILE *file)
+{
+        assert(image != NULL && file != NULL);
+
+        int magic1 = getc(file);
+        int magic2 = getc(file);
+        assert(magic1 == 'P' && (magic2 == '6' || magic2 == '3'));
+
+        image->file = file;
+        image->plain = magic2 == '3';
+        image->width = read_header_number(file);
+        image->height = read_header_number(file);
+        image->denominator = read_header_number(file);
+        assert(image->denominator > 0 && image->denominator <= 65535);
+        image->sample_bytes = image->denominator > 255 ? 2 : 1;
+        image->map = NULL;
+        image->map_length = 0;
+        image->next_row = 0;
+        image->bytes = NULL;
+
+        if (image->plain) {
+                return;
+        }
+
+        /* one whitespace character ends the header of a raw image */
+        int c = getc(file);
+        assert(c != EOF && isspace(c));
+
+        size_t row_bytes = 3L * image->width * image->sample_bytes;
+        struct stat info;
+        if (fstat(fileno(file), &info) == 0 && S_ISREG(info.st_mode) &&
+            info.st_size > 0) {
+                void *map = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE,
+                                 fileno(file), 0);
+                if (map != MAP_FAILED) {
+                        madvise(map, info.st_size, MADV_SEQUENTIAL);
+                        image->map = map;
+                        image->map_length = info.st_size;
+                        image->data = ftell(file);
+                        assert(image->data + row_bytes * image->height <=
+                               image->map_length);
+                        return;
+                }
+        }
+
+        image->bytes = malloc(row_bytes + 1);
+        assert(image->bytes != NULL);
+}
+
+/********** stream_row ********
+ *
+ * Purpose: Decodes one row of an image into samples
+ *
+ * Parameters:
+ *     - image: the image
+ *     - row: the row to decode
+ *     - samples: where to store the row's 3 * width samples, red, green,
+ *                and blue for each pixel
+ *
+ * Return: none
+ *
+ * Expects:
+ *     - row is less than the image's height
+ *
+ * CRE: image isn't mapped and row isn't the next row in the file, or the
+ *      file ends early or holds a malformed sample
+ *
+ * Notes:
+ *     - Safe for several threads at once on a mapped image
+ */
+static void stream_row(ppm_stream *image, unsigned row, unsigned *samples)
+{
+        assert(image != NULL && samples != NULL);
+        assert(row < image->height);
+
+        long nsamples = 3L * image->width;
+        const unsigned char *bytes;
+        if (image->map != NULL) {
+                bytes = image->map + image->data + 
+                        row * nsamples * image->sample_bytes;
+        } else {
+                assert(row == image->next_row);
+                image->next_row++;
+                if (image->plain) {
+                        for (long i = 0; i < nsamples; i++) {
+                                int got = fscanf(image->file, "%u", 
+                                                 &samples[i]);
+                                assert(got == 1);
+                                assert(samples[i] <= image->denominator);
+                        }
+                        return;
+                }
+                size_t got = fread(image->bytes, image->sample_bytes, 
+                                   nsamples, image->file);
+                assert(got == (size_t)nsamples);
+                bytes = image->bytes;
+        }
+
+        if (image->sample_bytes == 1) {
+                for (long i = 0; i < nsamples; i++) {
+                        samples[i] = bytes[i];
+                }
+        } else {
+                for (long i = 0; i < nsamples; i++) {
+                        samples[i] = bytes[2 * i] << 8 | bytes[2 * i + 1];
+                }
+        }
+}
+
+/********** stream_release ********
+ *
+ * Purpose: Says that some rows of an image won't be read again
+ *
+ * Parameters:
+ *     - image: the image
+ *     - first: the first row done with
+ *     - last: one past the last row done with
+ *
+ * Return: none
+ *
+ * Expects: none
+ *
+ * Notes:
+ *     - For a mapped image the whole pages within the rows are dropped 
+ *       with madvise(), so the pages of a large image don't pile up as 
+ *       it is compared. Does nothing for an image that isn't mapped
+ */
+static void stream_release(ppm_stream *image, unsigned first, unsigned last)
+{
+        assert(image != NULL);
+        if (image->map == NULL) {
+                return;
+        }
+
+        size_t page = sysconf(_SC_PAGESIZE);
+        size_t row_bytes = 3L * image->width * image->sample_bytes;
+        size_t start = image->data + first * row_bytes;
+        size_t end = image->data + last * row_bytes;
+        start = (start + page - 1) / page * page;
+        end = end / page * page;
+        if (end > start) {
+                madvise((void *)(image->map + start), end - start, 
+                        MADV_DONTNEED);
+        }
+}
+
+/********** stream_close ********
+ *
+ * Purpose: Releases what stream_open() set up for an image
+ *
+ * Parameters:
+ *     - image: the image
+ *
+ * Return: none
+ *
+ * Expects: none
+ *
+ * Notes:
+ *     - The file itself is left open for the caller to close
+ */
+static void stream_close(ppm_stream *image)
+{
+        assert(image != NULL);
+
+        if (image->map != NULL) {
+                munmap((void *)image->map, image->map_length);
+        }
+        free(image->bytes);
+}
+
+/********** read_header_number ********
+ *
+ * Purpose: Reads the next number of a PPM header
+ *
+ * Parameters:
+ *     - file: the image, positioned before the number
+ *
+ * Return: the number
+ *
+ * Expects: none
+ *
+ * CRE: the header ends or has something other than whitespace, comments,
+ *      and digits before the number
+ *
+ * Notes:
+ *     - Skips whitespace and "#" comments, which run to the end of the 
+ *       line. Leaves file positioned just after the number's last digit
+ */
+static unsigned read_header_number(FILE *file)
+{
+        int c = getc(file);
+        while (c == '#' || isspace(c)) {
+                if (c == '#') {
+                        while (c != '\n' && c != EOF) {
+                                c = getc(file);
+                        }
+                }
+                c = getc(file);
+        }
+        assert(isdigit(c));
+
+        unsigned number = 0;
+        while (isdigit(c)) {
+                number = number * 10 + (c - '0');
+                c = getc(file);
+        }
+        ungetc(c, file);
+        return number;
+}
+
+/********** usage ********
+ *
+ * Purpose: Prints how to run ppmdiff and exits
+ *
+ * Parameters:
+ *     - progname: the name ppmdiff was run as
+ *
+ * Return: none (exits with EXIT_FAILURE)
+ *
+ * Expects: none
+ */
+static void usage(const char *progname)
+{
+        fprintf(stderr, "Usage: %s [-j threads] [-t limit] [-m metrics] "
+                "image1 image2\n"
+                "       (either image may be - for stdin; metrics are a "
+                "comma-separated\n"
+                "       list of rmsd, psnr, channels, max, ssim, or all)\n",
+                progname);
+        exit(EXIT_FAILURE);
+}
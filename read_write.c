@@ -13,11 +13,25 @@
  *     storing packed words, and reconstructing images from compressed data. 
  *     The file ensures correct formatting, efficient memory usage, and proper 
  *     handling of pixel and word data during compression and decompression.
+ *
+ *     Rows of 32-bit words are turned to and from their big-endian bytes
+ *     by kernels compiled for each instruction set in cpu.h.
  *     
  *
  **************************************************************/
 
+#include <stdbool.h>
+#include <ctype.h>
+#include <limits.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
 #include "read_write.h"
+#include "word.h"
+#include "entropy.h"
+#include "block.h"
+#include "a2pool.h"
+#include "cpu.h"
 
 /* 
  * struct trimmed_pixels_closure stores information needed for trimming an 
@@ -33,12 +47,323 @@ typedef struct {
         int trim_height;
 } trimmed_pixels_closure;
 
+/*
+ * struct source reads the part of a compressed image after its header. 
+ * Offsets are from start, the file position where that part begins. 
+ * Regular files are read with pread(); other streams are read in order, 
+ * and pos is the offset of the next byte the stream will give.
+ */
+typedef struct source {
+        FILE *file;
+        int fd;
+        bool seekable;
+        off_t start;
+        off_t pos;
+} source;
+
+/* 
+ * struct byte_buffer is a growable array of bytes, used to build a tiled 
+ * image's tiles before the directory describing them can be written
+ */
+typedef struct byte_buffer {
+        unsigned char *data;
+        long length;
+        long capacity;
+} byte_buffer;
+
+/* bytes in a tile directory entry: 8-byte offset, length, and checksum */
+#define TILE_ENTRY_SIZE 16
+
+/* longest line allowed in a format 3 header */
+#define HEADER_LINE_MAX 128
+
+/* Adler-32 modulus, and the most bytes summed before reducing */
+static const uint32_t ADLER_MOD = 65521;
+static const long ADLER_BLOCK = 5552;
+
+/* helper functions */
+static unsigned read_ppm_number(FILE *file);
+static void read_header_fields(FILE *file, comp40_header *header);
+static void read_header_lines(FILE *file, comp40_header *header);
+static void read_tile_directory(FILE *file, comp40_header *header);
+static void read_untiled_region(source *src, const comp40_header *header,
+                                unsigned col, unsigned row, 
+                                A2Methods_UArray2 packed_words, 
+                                A2Methods_T methods);
+static void read_tiled_region(source *src, const comp40_header *header,
+                              unsigned col, unsigned row, 
+                              A2Methods_UArray2 packed_words, 
+                              A2Methods_T methods);
+static void copy_tile_overlap(const uint32_t *tile, unsigned tile_col, 
+                              unsigned tile_row, unsigned width, 
+                              unsigned height, unsigned col, unsigned row,
+                              A2Methods_UArray2 packed_words, 
+                              A2Methods_T methods);
+static void encode_tile(enum codec_coding coding, 
+                        const struct word_layout *layout, 
+                        const uint32_t *tile, long nwords, byte_buffer *out);
+static bool decode_tile(enum codec_coding coding, 
+                        const struct word_layout *layout, 
+                        const unsigned char *bytes, long length, 
+                        uint32_t *tile, long nwords);
+static unsigned raw_word_bytes(const struct word_layout *layout);
+static uint32_t checksum(const unsigned char *bytes, long length);
+static void source_init(source *src, FILE *file);
+static bool source_read(source *src, off_t offset, void *bytes, long length);
+static bool skip_bytes(FILE *file, long nbytes);
+static long bytes_after(FILE *file);
+static long tile_bound(const comp40_header *header);
+static long least_bytes(const comp40_header *header);
+static void byte_buffer_reserve(byte_buffer *buffer, long nbytes);
+CPU_KERNEL uint32_t get_be32(const unsigned char *bytes);
+CPU_KERNEL void put_be32(unsigned char *bytes, uint32_t value);
+CPU_KERNEL void words_to_be_kernel(const uint32_t *words, 
+                                   unsigned char *bytes, long nwords);
+CPU_KERNEL void be_to_words_kernel(const unsigned char *bytes, 
+                                   uint32_t *words, long nwords);
+CPU_DECLARE_VARIANTS(words_to_be, (const uint32_t *words, 
+                                    unsigned char *bytes, long nwords));
+CPU_DECLARE_VARIANTS(be_to_words, (const unsigned char *bytes, 
+                                    uint32_t *words, long nwords));
+
 
 /**************************/
 /*       Compression      */
 /**************************/
 
 
+/********** ppm_read_header ********
+ *
+ * Purpose: Reads the header of a PPM image, to read its pixels a row at a
+ *          time with ppm_read_row()
+ *
+ * Parameters:
+ *      - input: the image, positioned at its start
+ *      - reader: where to store what the header says
+ *
+ * Return: none
+ *
+ * Expects: none
+ *
+ * CRE: input or reader is null, or memory can't be allocated
+ *
+ * Notes:
+ *      - Raises Pnm_Badformat, as Pnm_ppmread() does, if the magic number
+ *        isn't "P6" or "P3", the header is malformed, the width, height, 
+ *        or denominator is 0, or the denominator is over 65535
+ *      - Leaves input positioned at the first sample. Free the reader with
+ *        ppm_reader_free() once its rows are read
+ */
+void ppm_read_header(FILE *input, ppm_reader *reader)
+{
+        assert(input != NULL);
+        assert(reader != NULL);
+
+        int magic1 = getc(input);
+        int magic2 = getc(input);
+        if (magic1 != 'P' || (magic2 != '6' && magic2 != '3')) {
+                RAISE(Pnm_Badformat);
+        }
+
+        reader->input = input;
+        reader->plain = magic2 == '3';
+        reader->width = read_ppm_number(input);
+        reader->height = read_ppm_number(input);
+        reader->denominator = read_ppm_number(input);
+        if (reader->width == 0 || reader->height == 0 ||
+            reader->denominator == 0 || reader->denominator > 65535) {
+                RAISE(Pnm_Badformat);
+        }
+        reader->sample_bytes = reader->denominator > 255 ? 2 : 1;
+        reader->row_bytes = NULL;
+
+        /* one whitespace character ends the header of a raw image */
+        if (!reader->plain) {
+                int c = getc(input);
+                if (c == EOF || !isspace(c)) {
+                        RAISE(Pnm_Badformat);
+                }
+                reader->row_bytes = ALLOC(3L * reader->width * 
+                                          reader->sample_bytes);
+        }
+}
+
+/********** ppm_read_row ********
+ *
+ * Purpose: Reads the next row of a PPM image's pixels
+ *
+ * Parameters:
+ *      - reader: the reader, from ppm_read_header()
+ *      - row: where to store the row's first ncols pixels
+ *      - ncols: the number of pixels to store
+ *
+ * Return: none
+ *
+ * Expects:
+ *      - fewer than height rows have been read
+ *
+ * CRE: reader or row is null, or ncols is over the image's width
+ *
+ * Notes:
+ *      - Raises Pnm_Badformat if the file ends early, a plain sample is 
+ *        malformed, or a sample is over the denominator
+ *      - The pixels past ncols are read, checked, and dropped. Samples are
+ *        kept as they are, as Pnm_ppmread() keeps them
+ */
+void ppm_read_row(ppm_reader *reader, struct Pnm_rgb *row, unsigned ncols)
+{
+        assert(reader != NULL);
+        assert(row != NULL);
+        assert(ncols <= reader->width);
+
+        unsigned denominator = reader->denominator;
+        unsigned sample[3];
+
+        if (reader->plain) {
+                for (unsigned col = 0; col < reader->width; col++) {
+                        for (int k = 0; k < 3; k++) {
+                                sample[k] = read_ppm_number(reader->input);
+                                if (sample[k] > denominator) {
+                                        RAISE(Pnm_Badformat);
+                                }
+                        }
+                        if (col < ncols) {
+                                row[col].red = sample[0];
+                                row[col].green = sample[1];
+                                row[col].blue = sample[2];
+                        }
+                }
+                return;
+        }
+
+        long nsamples = 3L * reader->width;
+        size_t got = fread(reader->row_bytes, reader->sample_bytes, nsamples,
+                           reader->input);
+        if (got != (size_t)nsamples) {
+                RAISE(Pnm_Badformat);
+        }
+
+        const unsigned char *bytes = reader->row_bytes;
+        for (unsigned col = 0; col < reader->width; col++) {
+                for (int k = 0; k < 3; k++) {
+                        if (reader->sample_bytes == 1) {
+                                sample[k] = *bytes++;
+                        } else {
+                                sample[k] = bytes[0] << 8 | bytes[1];
+                                bytes += 2;
+                        }
+                        if (sample[k] > denominator) {
+                                RAISE(Pnm_Badformat);
+                        }
+                }
+                if (col < ncols) {
+                        row[col].red = sample[0];
+                        row[col].green = sample[1];
+                        row[col].blue = sample[2];
+                }
+        }
+}
+
+/********** ppm_reader_free ********
+ *
+ * Purpose: Frees what a PPM reader holds
+ *
+ * Parameters:
+ *      - reader: the reader, from ppm_read_header()
+ *
+ * Return: none
+ *
+ * Expects: none
+ *
+ * CRE: reader is null
+ *
+ * Notes:
+ *      - Doesn't close the reader's file
+ */
+void ppm_reader_free(ppm_reader *reader)
+{
+        assert(reader != NULL);
+
+        if (reader->row_bytes != NULL) {
+                FREE(reader->row_bytes);
+        }
+}
+
+/********** read_checked_ppm ********
+ *
+ * Purpose: Reads a whole PPM image, with the checks of ppm_read_header()
+ *          and ppm_read_row()
+ *
+ * Parameters:
+ *      - input: the image, positioned at its start
+ *      - methods: the methods used to create the image's pixel array
+ *
+ * Return: the image, to free with Pnm_ppmfree()
+ *
+ * Expects: none
+ *
+ * CRE: input or methods is null, or memory can't be allocated
+ *
+ * Notes:
+ *      - Takes the place of Pnm_ppmread(), which doesn't check samples 
+ *        against the denominator; raises Pnm_Badformat where it would, 
+ *        and when a sample is over the denominator
+ *      - Rows are read straight into the array when its rows are 
+ *        contiguous (see a2pool.h)
+ */
+Pnm_ppm read_checked_ppm(FILE *input, A2Methods_T methods)
+{
+        assert(input != NULL);
+        assert(methods != NULL);
+
+        ppm_reader reader;
+        ppm_read_header(input, &reader);
+
+        Pnm_ppm ppm;
+        NEW(ppm);
+        ppm->width = reader.width;
+        ppm->height = reader.height;
+        ppm->denominator = reader.denominator;
+        ppm->methods = methods;
+        ppm->pixels = methods->new(reader.width, reader.height, 
+                                   sizeof(struct Pnm_rgb));
+
+        bool contiguous = uarray2_rows_contiguous(methods);
+        struct Pnm_rgb *row = NULL;
+        if (!contiguous) {
+                row = ALLOC(reader.width * sizeof(struct Pnm_rgb));
+        }
+
+        TRY
+                for (unsigned r = 0; r < reader.height; r++) {
+                        if (contiguous) {
+                                ppm_read_row(&reader, 
+                                             methods->at(ppm->pixels, 0, r),
+                                             reader.width);
+                                continue;
+                        }
+                        ppm_read_row(&reader, row, reader.width);
+                        for (unsigned c = 0; c < reader.width; c++) {
+                                *(struct Pnm_rgb *)methods->at(ppm->pixels, 
+                                                               c, r) = row[c];
+                        }
+                }
+        ELSE
+                Pnm_ppmfree(&ppm);
+                ppm_reader_free(&reader);
+                if (row != NULL) {
+                        FREE(row);
+                }
+                RERAISE;
+        END_TRY;
+
+        ppm_reader_free(&reader);
+        if (row != NULL) {
+                FREE(row);
+        }
+        return ppm;
+}
+
 /********** read_and_trim_ppm ********
  * 
  * Reads a PPM image from a file and trims it to ensure its width 
@@ -46,6 +371,7 @@ typedef struct {
  *
  * Parameters:
  *      - input: A pointer to an open file containing a PPM image
+ *      - methods: the methods used to create the image's pixel arrays
  *
  * Return:
  *      - A Pnm_ppm struct containing the image data, with trimmed 
@@ -64,16 +390,13 @@ typedef struct {
  *      - Information is lost here if width or height is odd because we remove
  *              part of the image to get even dimensions
  */
-Pnm_ppm read_and_trim_ppm(FILE *input)
+Pnm_ppm read_and_trim_ppm(FILE *input, A2Methods_T methods)
 {
         assert(input != NULL);
-
-        /* Initialize the method for handling UArray2 operations */
-        A2Methods_T methods = uarray2_methods_plain; 
         assert(methods != NULL);
 
         /* Read the ppm image onto a Pnm_ppm struct */
-        Pnm_ppm ppm = Pnm_ppmread(input, methods);
+        Pnm_ppm ppm = read_checked_ppm(input, methods);
         assert(ppm != NULL);
 
         /* Check the OG width and height - update if odd */
@@ -197,10 +520,10 @@ void update_ppm_trimmed(Pnm_ppm *ppm, A2Methods_T methods,
  *      or methods from closure is null 
  *
  * Notes:
- *    - The function skips pixels on the rightmost and bottom edges if the
- *      width or height needs to be trimmed
- *    - The function assumes that trimming is only necessary if the original
- *      width or height is odd
+ *    - The function skips pixels past the right and bottom edges of the
+ *      trimmed array if the width or height needs to be trimmed
+ *    - Trimming is one column or row (an odd width or height); images of
+ *      larger blocks are padded instead (see update_ppm_padded())
  *    - Uses A2Methods_T function pointers to access and modify pixels in the
  *      UArray2 
  *    - Information is lost here if width or height is odd because we remove
@@ -227,12 +550,12 @@ void trimmed_pixels_apply(int colx, int rowy, A2Methods_UArray2 old_pixels,
         int trim_width = PaM->trim_width;
         int trim_height = PaM->trim_height;
 
-        /* Skip pixels on the right edge if width was trimmed */
-        if ((trim_width != 0) && (colx == (methods->width(old_pixels) - 1))) {
+        /* Skip pixels past the right edge if width was trimmed */
+        if ((trim_width != 0) && (colx >= methods->width(*new_pixels))) {
                 return;
         }
-        /* Skip pixels on the bottom edge if height was trimmed*/
-        if((trim_height != 0) && (rowy == (methods->height(old_pixels) - 1))) {
+        /* Skip pixels past the bottom edge if height was trimmed*/
+        if((trim_height != 0) && (rowy >= methods->height(*new_pixels))) {
                 return;
         }
 
@@ -244,60 +567,326 @@ void trimmed_pixels_apply(int colx, int rowy, A2Methods_UArray2 old_pixels,
         new_val->blue = og_val->blue;
 }
 
+/********** update_ppm_padded ********
+ *
+ * Purpose:
+ *    Updates the ppm struct to hold a new pixel array padded out to a 
+ *    larger width and height
+ *
+ * Parameters:
+ *    - ppm: A pointer to a Pnm_ppm struct that holds the image data
+ *    - methods: The methods object for handling UArray2 operations
+ *    - width: The new width, at least the old one
+ *    - height: The new height, at least the old one
+ *
+ * Return: None 
+ *
+ * Expects: none
+ *     
+ * CRE: ppm is null, *ppm is null, pixels of ppm is null, methods is null,
+ *      the image is empty, width or height is less than the image's, or 
+ *      new_pixels is null
+ *
+ * Notes:
+ *    - Each new column repeats the image's last column and each new row 
+ *      its last row, so a block that crosses the edge is as smooth as the 
+ *      edge itself and costs the fewest bits. The decoder crops them off
+ *      again (see read_compressed_header())
+ *    - The old pixel array is freed
+ */
+void update_ppm_padded(Pnm_ppm *ppm, A2Methods_T methods, 
+                       unsigned width, unsigned height)
+{
+        assert(ppm != NULL);
+        assert(*ppm != NULL);
+        assert((*ppm)->pixels != NULL);
+        assert(methods != NULL);
+        unsigned old_width = (*ppm)->width;
+        unsigned old_height = (*ppm)->height;
+        assert(old_width > 0 && old_height > 0);
+        assert(width >= old_width && height >= old_height);
+
+        A2Methods_UArray2 new_pixels = methods->new(width, height, 
+                methods->size((*ppm)->pixels));
+        assert(new_pixels != NULL);
+
+        /* each pixel copies the nearest one inside the old edges */
+        for (unsigned row = 0; row < height; row++) {
+                unsigned from_row = row < old_height ? row : old_height - 1;
+                for (unsigned col = 0; col < width; col++) {
+                        unsigned from_col = col < old_width ? col : 
+                                                              old_width - 1;
+                        struct Pnm_rgb *from = (*ppm)->methods->at(
+                                (*ppm)->pixels, from_col, from_row);
+                        struct Pnm_rgb *to = methods->at(new_pixels, col, 
+                                                         row);
+                        *to = *from;
+                }
+        }
+
+        A2Methods_UArray2 old_pixels = (*ppm)->pixels;
+        (*ppm)->methods->free(&old_pixels);
+
+        (*ppm)->width = width;
+        (*ppm)->height = height;
+        (*ppm)->pixels = new_pixels;
+        (*ppm)->methods = methods;
+}
+
 /********** print_compressed ********
  * 
- * Purpose: Writes a compressed image to standard output in binary format, 
+ * Purpose: Writes a compressed image to a stream in binary format, 
  *          including a header and 32-bit packed words
  *
  * Parameters:
  *     - words: A 2D array containing 32-bit packed words
  *     - methods: Function pointers for handling UArray2 operations
+ *     - output: the stream to write to (stdout for 40image)
  *
  * Return: None 
  *
  * Expects:
  *     - words is not NULL and contains valid packed words
  *     - methods is a valid A2Methods_T
+ *     - output is open for writing
  *
- * CRE: words is null, methods is null, or any word inside words is null
+ * CRE: words is null, methods is null, output is null, or any word inside 
+ *      words is null
  *
  * Notes:
  *     - Prints the header in human-readable format
  *     - Writes each 32-bit word as four bytes in Big-Endian order
  *     - Uses Bitpack_getu() to extract 8-bit segments from each word
  */
-void print_compressed(A2Methods_UArray2 words, A2Methods_T methods)
+void print_compressed(A2Methods_UArray2 words, A2Methods_T methods, 
+                      FILE *output)
 {
         assert(words != NULL);
         assert(methods != NULL);
+        assert(output != NULL);
 
         /* get dimensions of the compressed word array */
         int width = methods->width(words);
         int height = methods->height(words);
 
         /* print the compressed image header */
-        printf("COMP40 Compressed image format 2\n%u %u", width, height);
-        printf("\n");
+        print_compressed_header(width, height, output);
 
         /* Iterate through the 2D array of 32-bit words in row-major */
+        if (width == 0 || height == 0) {
+                return;
+        }
+        unsigned char *bytes = ALLOC((long)width * 4);
+        bool contiguous = uarray2_rows_contiguous(methods);
         for(int row = 0; row < height; row++){
-                for(int col = 0; col < width; col++){
-                        
-                        /* get the 32-bit compressed word */
-                        uint32_t *word = methods->at(words, col, row);
-                        assert(word != NULL);
-
-                        /* extract and print each byte in big-endian order*/
-                        for(int lsb = 24; lsb >= 0; lsb = lsb - 8){
-                                uint64_t byte = Bitpack_getu(*word, 8, lsb);
-                                
-                                /* output byte as a char */
-                                putchar(byte);
+                /* each word's bytes in big-endian order, a row at a time */
+                if (contiguous) {
+                        CPU_DISPATCH(words_to_be)(methods->at(words, 0, row),
+                                                  bytes, width);
+                } else {
+                        for(int col = 0; col < width; col++){
+                                uint32_t *word = methods->at(words, col, 
+                                                             row);
+                                assert(word != NULL);
+                                put_be32(bytes + 4 * col, *word);
                         }
                 }
+                fwrite(bytes, 4, width, output);
         }
+        FREE(bytes);
+}
+
+/********** print_compressed_header ********
+ * 
+ * Purpose: Writes the header of a "COMP40 Compressed image format 2" image
+ *
+ * Parameters:
+ *     - width: the image's width, in words
+ *     - height: the image's height, in words
+ *     - output: the stream to write to
+ *
+ * Return: None 
+ *
+ * Expects: none
+ *
+ * CRE: output is null
+ *
+ * Notes:
+ *     - The words follow in row-major order, each as four big-endian 
+ *       bytes (see words_to_bytes()). Lets writers that make the words a 
+ *       band at a time (pipeline.h) write the same image print_compressed()
+ *       does
+ */
+void print_compressed_header(unsigned width, unsigned height, FILE *output)
+{
+        assert(output != NULL);
+        fprintf(output, "COMP40 Compressed image format 2\n%u %u", width, 
+                height);
+        fprintf(output, "\n");
 }
 
+/********** print_compressed_tiled ********
+ * 
+ * Purpose: Writes a compressed image to a stream in the tiled format
+ *          ("COMP40 Compressed image format 3")
+ *
+ * Parameters:
+ *     - words: A 2D array containing 32-bit packed words
+ *     - methods: Function pointers for handling UArray2 operations
+ *     - tile_width: the width of a tile, in words
+ *     - tile_height: the height of a tile, in words
+ *     - coding: how each tile's words are coded
+ *     - predict: how each tile's words are predicted before coding
+ *     - block_size: the pixels in a block's width and height (see block.h)
+ *     - image_width, image_height: the image's size in pixels, which may 
+ *       fall short of the blocks' by less than a block
+ *     - layout: the layout of the words of 2x2 blocks (see codec.h)
+ *     - output: the stream to write to (stdout for 40image)
+ *
+ * Return: None 
+ *
+ * Expects:
+ *     - words contains valid packed words
+ *
+ * CRE: words is null, methods is null, layout is null, output is null, a
+ *      tile dimension is 0, the image's size doesn't fit the blocks, or 
+ *      memory can't be allocated
+ *
+ * Notes:
+ *     - The header is format 2's, with the format number changed to 3, 
+ *       followed by "KEY value" lines ending with "END":
+ *
+ *           COMP40 Compressed image format 3
+ *           width height
+ *           TILE tile_width tile_height
+ *           CODING raw|huffman|rle
+ *           PREDICT left|above|median     (only if predicted)
+ *           BLOCK 4|8                     (only if not 2x2 blocks)
+ *           IMAGE width height            (only if not whole blocks)
+ *           LAYOUT wa wb wc wd wpb wpr    (only if not the default)
+ *           QUANT bcd_max bcd_scale       (only if not the default)
+ *           END
+ *
+ *     - Then comes the tile directory: one TILE_ENTRY_SIZE entry per tile,
+ *       tiles in row-major order, giving each tile's offset from the end 
+ *       of the directory, its length, and its Adler-32 checksum. The tiles
+ *       follow, each holding its words in row-major order. Tiles on the 
+ *       right and bottom edges are cut short by the image's edge
+ *     - Prediction (see predict_words() in word.c) only looks within the 
+ *       tile, so tiles stay independent
+ *     - Every tile can be found, checked, and decoded on its own
+ *     - IMAGE gives the size of an image padded out to whole blocks (see
+ *       update_ppm_padded()), which the decoder crops back to
+ */
+void print_compressed_tiled(A2Methods_UArray2 words, A2Methods_T methods, 
+                            unsigned tile_width, unsigned tile_height, 
+                            enum codec_coding coding, 
+                            enum codec_predict predict, 
+                            unsigned block_size, unsigned image_width,
+                            unsigned image_height, 
+                            const struct word_layout *layout, FILE *output)
+{
+        assert(words != NULL);
+        assert(methods != NULL);
+        assert(layout != NULL);
+        assert(output != NULL);
+        assert(tile_width > 0 && tile_height > 0);
+
+        unsigned width = methods->width(words);
+        unsigned height = methods->height(words);
+        unsigned blocks_width = width / (block_size == 2 ? 
+                                         layout_words(layout) : 
+                                         block_words(block_size)) * 
+                                block_size;
+        unsigned blocks_height = height * block_size;
+        assert(image_width <= blocks_width && 
+               image_width + block_size > blocks_width);
+        assert(image_height <= blocks_height && 
+               image_height + block_size > blocks_height);
+        unsigned tiles_wide = (width + tile_width - 1) / tile_width;
+        unsigned tiles_high = (height + tile_height - 1) / tile_height;
+        long ntiles = (long)tiles_wide * tiles_high;
+
+        /* encode every tile first, since the directory comes before them */
+        byte_buffer data = { NULL, 0, 0 };
+        unsigned char *directory = ALLOC(ntiles * TILE_ENTRY_SIZE + 1);
+        uint32_t *tile = ALLOC((long)tile_width * tile_height * 
+                               (long)sizeof(uint32_t));
+        assert(directory != NULL && tile != NULL);
+
+        for (unsigned ty = 0; ty < tiles_high; ty++) {
+                for (unsigned tx = 0; tx < tiles_wide; tx++) {
+                        unsigned tile_col = tx * tile_width;
+                        unsigned tile_row = ty * tile_height;
+                        unsigned tw = tile_col + tile_width > width ? 
+                                      width - tile_col : tile_width;
+                        unsigned th = tile_row + tile_height > height ? 
+                                      height - tile_row : tile_height;
+
+                        /* gather the tile's words, row-major */
+                        for (unsigned y = 0; y < th; y++) {
+                                for (unsigned x = 0; x < tw; x++) {
+                                        uint32_t *word = methods->at(words, 
+                                                tile_col + x, tile_row + y);
+                                        assert(word != NULL);
+                                        tile[y * tw + x] = *word;
+                                }
+                        }
+
+                        predict_words(tile, tw, th, predict, layout);
+                        long offset = data.length;
+                        encode_tile(coding, layout, tile, (long)tw * th, 
+                                    &data);
+                        long length = data.length - offset;
+
+                        unsigned char *entry = directory + 
+                                ((long)ty * tiles_wide + tx) * 
+                                TILE_ENTRY_SIZE;
+                        put_be32(entry, (uint64_t)offset >> 32);
+                        put_be32(entry + 4, offset);
+                        put_be32(entry + 8, length);
+                        put_be32(entry + 12, checksum(data.data + offset, 
+                                                      length));
+                }
+        }
+
+        fprintf(output, "COMP40 Compressed image format 3\n%u %u\n", width,
+                height);
+        fprintf(output, "TILE %u %u\n", tile_width, tile_height);
+        fprintf(output, "CODING %s\n", 
+                coding == CODING_HUFFMAN ? "huffman" : 
+                coding == CODING_RLE ? "rle" : "raw");
+        if (predict != PREDICT_NONE) {
+                fprintf(output, "PREDICT %s\n", 
+                        predict == PREDICT_LEFT ? "left" : 
+                        predict == PREDICT_ABOVE ? "above" : "median");
+        }
+        if (block_size != 2) {
+                fprintf(output, "BLOCK %u\n", block_size);
+        }
+        if (image_width != blocks_width || image_height != blocks_height) {
+                fprintf(output, "IMAGE %u %u\n", image_width, image_height);
+        }
+        if (!layout_is_default(layout)) {
+                fprintf(output, "LAYOUT %u %u %u %u %u %u\n", 
+                        layout->width[0], layout->width[1], 
+                        layout->width[2], layout->width[3], 
+                        layout->width[4], layout->width[5]);
+                fprintf(output, "QUANT %.9g %.9g\n", layout->bcd_max, 
+                        layout->bcd_scale);
+        }
+        fprintf(output, "END\n");
+        fwrite(directory, TILE_ENTRY_SIZE, ntiles, output);
+        if (data.length > 0) {
+                fwrite(data.data, 1, data.length, output);
+        }
+
+        if (data.data != NULL) {
+                FREE(data.data);
+        }
+        FREE(directory);
+        FREE(tile);
+}
 
 /****************************/
 /*       Decompression      */
@@ -306,12 +895,13 @@ void print_compressed(A2Methods_UArray2 words, A2Methods_T methods)
 
 /********** print_decompressed ********
  * 
- * Purpose: Outputs an uncompressed PPM image to standard output
+ * Purpose: Outputs an uncompressed PPM image to a stream
  *
  * Parameters:
  *     - pixels: A 2D array containing the RGB pixel data
  *     - methods: A function table for handling UArray2 operations
  *     - denominator: The maximum color value for scaling pixels
+ *     - output: the stream to write to (stdout for 40image)
  *
  * Return: None 
  *
@@ -319,9 +909,10 @@ void print_compressed(A2Methods_UArray2 words, A2Methods_T methods)
  *     - pixels is not NULL and contains valid pixel data
  *     - methods is a valid A2Methods_T
  *     - denominator is a positive integer
+ *     - output is open for writing
  *
  * CRE: pixels is null, methods is null, denominator is less than or equal to 0,
- *      or the final_image is null
+ *      output is null, or the final_image is null
  *
  * Notes:
  *     - Creates a temporary Pnm_ppm struct for printing
@@ -329,11 +920,12 @@ void print_compressed(A2Methods_UArray2 words, A2Methods_T methods)
  *     - The final_image struct is dynamically allocated and freed properly
  */
 void print_decompressed(A2Methods_UArray2 pixels, A2Methods_T methods, 
-                        int denominator)
+                        int denominator, FILE *output)
 {
         assert(pixels != NULL);
         assert(methods != NULL); 
         assert(denominator > 0);
+        assert(output != NULL);
         
         /*create a ppm from the pixels*/
         Pnm_ppm final_image;
@@ -348,7 +940,7 @@ void print_decompressed(A2Methods_UArray2 pixels, A2Methods_T methods,
         final_image->methods = methods; 
 
         /* Output the image */
-        Pnm_ppmwrite(stdout, final_image);
+        Pnm_ppmwrite(output, final_image);
 
         /* so don't free "pixels" in decmopress40() in compress40.c*/
         Pnm_ppmfree(&final_image);
@@ -361,68 +953,1395 @@ void print_decompressed(A2Methods_UArray2 pixels, A2Methods_T methods,
  *
  * Parameters:
  *     - file: A pointer to the FILE stream containing the compressed image
+ *     - methods: the methods used to create the 2D array of words
  *
  * Return:
  *     - A newly allocated A2Methods_UArray2 containing 32-bit packed words
  *
  * Expects:
  *     - file is a valid, open file pointer (not NULL)
- *     - The file follows the "COMP40 Compressed image format 2" format
- *     - Width and height are properly specified in the header
+ *     - The file follows the "COMP40 Compressed image format 2" or 
+ *       "COMP40 Compressed image format 3" format
  *
- * CRE: input is null, methods is null, or ppm is null
+ * CRE: file is null or methods is null. More in the helper functions
  *
  * Notes:
- *     - Reads the header to extract image dimensions
- *     - Allocates a 2D array to store packed words
- *     - Reads 4-byte words in Big-Endian order and stores them in the array
- *     - Uses getc() for reading individual bytes
- *     - Calls shift_left() to assemble 32-bit words correctly
+ *     - Uses read_compressed_header() and read_compressed_words()
  */
-A2Methods_UArray2 read_compressed_to_words(FILE *file)
+A2Methods_UArray2 read_compressed_to_words(FILE *file, A2Methods_T methods)
 {
         assert(file != NULL);
-
-        A2Methods_T methods = uarray2_methods_plain;
         assert(methods != NULL); 
 
-       /* Step 1: read header*/
-        unsigned height, width;
-        int read = fscanf(file, "COMP40 Compressed image format 2\n%u %u", 
-                          &width, &height);
-        assert(read == 2);
-        /*make sure last charac*/
-        int c = getc(file);
-        assert(c == '\n');
+        comp40_header header;
+        read_compressed_header(file, &header);
 
-        /* Step 2: Allocate UArrray2 for packed words */
-        A2Methods_UArray2 packed_words = methods->new(width, height, 
-                                                      sizeof(uint32_t));
-        assert(packed_words != NULL);
+        A2Methods_UArray2 words = read_compressed_words(file, &header, 
+                                                        methods);
+        free_compressed_header(&header);
+        return words;
+}
 
-        /* Step 3: read and store words */
-        for (unsigned row = 0; row < height; row++) {
-                for (unsigned col = 0; col < width; col++) {
-                        uint32_t word = 0; 
-                        
-                        /* Step 4: build word (4 bytes) (Big-Endian Order) */
-                        for (int i = 0; i < 4; i++){
-                                uint64_t byte = getc(file);
-                                
-                                /* check for end of file */
-                                assert((int64_t)byte != EOF);
-
-                                word = shift_left(word, 8);
-                                word = (word | byte);
-                        }
-                        
-                        /* store the packed word in UArray2 */
-                        uint32_t *word_ptr = methods->at(packed_words, 
-                                                        col, row);
-                        assert(word_ptr != NULL); 
-                        *word_ptr = word;
-                }
+/********** read_compressed_header ********
+ * 
+ * Purpose: Reads the header of a compressed image file, and for a tiled 
+ *          image its tile directory
+ *
+ * Parameters:
+ *     - file: A pointer to the FILE stream containing the compressed image
+ *     - header: where to store what the header says
+ *
+ * Return: none
+ *
+ * Expects:
+ *     - file is a valid, open file pointer (not NULL)
+ *     - The file follows the "COMP40 Compressed image format 2" or 
+ *       "COMP40 Compressed image format 3" format
+ *
+ * CRE: file is null, header is null, the header can't be read, the format
+ *      isn't 2 or 3, a format 3 header has an unknown or malformed line, 
+ *      blocks larger than 2x2 are predicted or Huffman coded or have a 
+ *      layout, a layout fails check_layout(), a layout of two words is 
+ *      predicted or a layout huffman_supports() rejects is Huffman coded,
+ *      blocks don't fill the rows, or the tile directory is cut short
+ *
+ * Notes:
+ *     - Leaves file positioned at the first word (format 2) or the first 
+ *       byte of the first tile (format 3), so callers can size their 
+ *       buffers before reading the words
+ *     - A format 2 image is treated as a single tile covering the image
+ *     - The caller frees the header with free_compressed_header()
+ */
+void read_compressed_header(FILE *file, comp40_header *header)
+{
+        assert(file != NULL);
+        assert(header != NULL);
+
+        read_header_fields(file, header);
+        if (header->format == 3) {
+                read_tile_directory(file, header);
         }
+}
 
-        return packed_words;
-}
\ No newline at end of file
+/********** compressed_fits ********
+ * 
+ * Purpose: Says whether a compressed image could fit in the bytes it was 
+ *          sent in, before anything is allocated for its words
+ *
+ * Parameters:
+ *     - file: the compressed image, positioned at its start
+ *     - available: the number of bytes from file's position on
+ *
+ * Return: true if the image's words and tile directory can be coded in 
+ *         the bytes left after its header
+ *
+ * Expects: none
+ *
+ * CRE: file is null, available is negative, file can't seek, or the 
+ *      header is malformed (as for read_compressed_header())
+ *
+ * Notes:
+ *     - Reads only the header, not the tile directory, and leaves file 
+ *       where it was, so a caller can check untrusted input and then 
+ *       decompress it
+ *     - Compares against least_bytes(), a lower bound, so an image that 
+ *       fits may still be damaged; one that doesn't fit can't be whole
+ */
+bool compressed_fits(FILE *file, long available)
+{
+        assert(file != NULL);
+        assert(available >= 0);
+
+        off_t start = ftello(file);
+        assert(start >= 0);
+        comp40_header header;
+        read_header_fields(file, &header);
+        off_t end = ftello(file);
+        assert(end >= start);
+
+        bool fits = end - start <= available && 
+                    least_bytes(&header) <= available - (end - start);
+        int seek = fseeko(file, start, SEEK_SET);
+        assert(seek == 0);
+        return fits;
+}
+
+/********** free_compressed_header ********
+ * 
+ * Purpose: Frees what read_compressed_header() allocated for a header
+ *
+ * Parameters:
+ *     - header: the header to free
+ *
+ * Return: none
+ *
+ * Expects: none
+ *
+ * CRE: header is null
+ */
+void free_compressed_header(comp40_header *header)
+{
+        assert(header != NULL);
+
+        if (header->tiles != NULL) {
+                FREE(header->tiles);
+        }
+}
+
+/********** words_per_block ********
+ * 
+ * Purpose: Gives the number of words one block of a compressed image takes
+ *
+ * Parameters:
+ *     - header: the image's header
+ *
+ * Return: block_words() of the block size for blocks larger than 2x2, 
+ *         otherwise layout_words() of the layout
+ *
+ * Expects: none
+ *
+ * CRE: header is null
+ *
+ * Notes:
+ *     - The header's width is in words, so an image is 
+ *       width / words_per_block() blocks wide
+ */
+unsigned words_per_block(const comp40_header *header)
+{
+        assert(header != NULL);
+        if (header->block_size != 2) {
+                return block_words(header->block_size);
+        }
+        return layout_words(&header->layout);
+}
+
+/********** read_compressed_words ********
+ * 
+ * Purpose: Reads every packed 32-bit word of a compressed image, after its
+ *          header, into a 2D array
+ *
+ * Parameters:
+ *     - file: A pointer to the FILE stream, positioned after the header
+ *     - header: the image's header, from read_compressed_header()
+ *     - methods: the methods used to create the 2D array of words
+ *
+ * Return:
+ *     - A newly allocated A2Methods_UArray2 containing 32-bit packed words
+ *
+ * Expects:
+ *     - The header has already been read with read_compressed_header()
+ *
+ * CRE: file is null, header is null, methods is null, or the file ends 
+ *      before all the words are read
+ *
+ * Notes:
+ *     - Reads the whole image as one region (see read_compressed_region())
+ */
+A2Methods_UArray2 read_compressed_words(FILE *file, 
+                                        const comp40_header *header, 
+                                        A2Methods_T methods)
+{
+        assert(file != NULL);
+        assert(header != NULL);
+        assert(methods != NULL); 
+
+        if (header->width == 0 || header->height == 0) {
+                return methods->new(header->width, header->height, 
+                                    sizeof(uint32_t));
+        }
+
+        return read_compressed_region(file, header, 0, 0, header->width, 
+                                      header->height, methods);
+}
+
+/********** read_compressed_region ********
+ * 
+ * Purpose: Reads only the packed 32-bit words of a rectangle of blocks 
+ *          from a compressed image, after its header
+ *
+ * Parameters:
+ *     - file: A pointer to the FILE stream, positioned after the header
+ *     - header: the image's header, from read_compressed_header()
+ *     - col: the column of the rectangle's first word
+ *     - row: the row of the rectangle's first word
+ *     - ncols: the width of the rectangle, in words
+ *     - nrows: the height of the rectangle, in words
+ *     - methods: the methods used to create the 2D array of words
+ *
+ * Return:
+ *     - A newly allocated ncols by nrows A2Methods_UArray2 of 32-bit packed 
+ *       words
+ *
+ * Expects:
+ *     - The header has already been read with read_compressed_header()
+ *
+ * CRE: file is null, header is null, methods is null, the rectangle is 
+ *      empty or doesn't fit in the image, or the file ends before the 
+ *      rectangle's last word
+ *
+ * Notes:
+ *     - Format 2 words are a fixed 4 bytes in row-major order, so the bytes
+ *       of each row of the rectangle are found by arithmetic. In format 3
+ *       only the tiles overlapping the rectangle are read, found through 
+ *       the tile directory
+ *     - A regular file is read with pread() and nothing outside the 
+ *       rectangle is read. Anything else (a pipe on stdin) is read through,
+ *       skipping the bytes outside the rectangle, and reading stops after 
+ *       its last byte
+ *     - When pread() is used the stream's position is left unchanged
+ */
+A2Methods_UArray2 read_compressed_region(FILE *file, 
+                                         const comp40_header *header, 
+                                         unsigned col, unsigned row, 
+                                         unsigned ncols, unsigned nrows, 
+                                         A2Methods_T methods)
+{
+        assert(file != NULL);
+        assert(header != NULL);
+        assert(methods != NULL);
+        assert(ncols > 0 && nrows > 0);
+        assert(col + ncols <= header->width && row + nrows <= header->height);
+
+        A2Methods_UArray2 packed_words = methods->new(ncols, nrows, 
+                                                      sizeof(uint32_t));
+        assert(packed_words != NULL);
+
+        source src;
+        source_init(&src, file);
+
+        if (header->format == 2) {
+                read_untiled_region(&src, header, col, row, packed_words, 
+                                    methods);
+        } else {
+                read_tiled_region(&src, header, col, row, packed_words, 
+                                  methods);
+        }
+
+        return packed_words;
+}
+
+/********** crop_pixels ********
+ * 
+ * Purpose: Copies a rectangle of pixels into a new 2D array
+ *
+ * Parameters:
+ *     - pixels: the 2D array of Pnm_rgb pixels to copy from
+ *     - methods: the methods used for both 2D arrays
+ *     - col: the column of the rectangle's top left pixel
+ *     - row: the row of the rectangle's top left pixel
+ *     - width: the width of the rectangle
+ *     - height: the height of the rectangle
+ *
+ * Return: a newly allocated width by height 2D array of Pnm_rgb pixels
+ *
+ * Expects: none
+ *
+ * CRE: pixels is null, methods is null, the rectangle is empty or doesn't
+ *      fit in pixels
+ */
+A2Methods_UArray2 crop_pixels(A2Methods_UArray2 pixels, A2Methods_T methods,
+                              int col, int row, int width, int height)
+{
+        assert(pixels != NULL);
+        assert(methods != NULL);
+        assert(col >= 0 && row >= 0 && width > 0 && height > 0);
+        assert(col + width <= methods->width(pixels));
+        assert(row + height <= methods->height(pixels));
+
+        A2Methods_UArray2 cropped = methods->new(width, height, 
+                                                 sizeof(struct Pnm_rgb));
+        assert(cropped != NULL);
+
+        for (int r = 0; r < height; r++) {
+                for (int c = 0; c < width; c++) {
+                        struct Pnm_rgb *from = methods->at(pixels, col + c,
+                                                           row + r);
+                        struct Pnm_rgb *to = methods->at(cropped, c, r);
+                        *to = *from;
+                }
+        }
+
+        return cropped;
+}
+
+/********** words_to_bytes ********
+ * 
+ * Purpose: Writes a run of 32-bit words as the big-endian bytes of a 
+ *          compressed image
+ *
+ * Parameters:
+ *     - words: the words
+ *     - bytes: where to write their 4 * nwords bytes
+ *     - nwords: the number of words
+ *
+ * Return: none
+ *
+ * Expects: bytes and words don't overlap
+ *
+ * CRE: words or bytes is null, or nwords is negative
+ *
+ * Notes:
+ *     - Runs the words_to_be kernel for the level of cpu.h in use
+ */
+void words_to_bytes(const uint32_t *words, unsigned char *bytes, 
+                    long nwords)
+{
+        assert(words != NULL && bytes != NULL);
+        assert(nwords >= 0);
+        CPU_DISPATCH(words_to_be)(words, bytes, nwords);
+}
+
+/********** bytes_to_words ********
+ * 
+ * Purpose: Reads a run of 32-bit words from the big-endian bytes of a 
+ *          compressed image
+ *
+ * Parameters:
+ *     - bytes: the words' 4 * nwords bytes
+ *     - words: where to store the words
+ *     - nwords: the number of words
+ *
+ * Return: none
+ *
+ * Expects: bytes and words don't overlap
+ *
+ * CRE: bytes or words is null, or nwords is negative
+ *
+ * Notes:
+ *     - Runs the be_to_words kernel for the level of cpu.h in use
+ */
+void bytes_to_words(const unsigned char *bytes, uint32_t *words, 
+                    long nwords)
+{
+        assert(bytes != NULL && words != NULL);
+        assert(nwords >= 0);
+        CPU_DISPATCH(be_to_words)(bytes, words, nwords);
+}
+
+
+/**************************/
+/*    Helper functions    */
+/**************************/
+
+
+/********** read_ppm_number ********
+ *
+ * Purpose: Reads the next number of a PPM header, or of a plain PPM's
+ *          samples
+ *
+ * Parameters:
+ *      - file: the image, positioned before the number
+ *
+ * Return: the number
+ *
+ * Expects: none
+ *
+ * CRE: file is null
+ *
+ * Notes:
+ *      - Skips whitespace and "#" comments, which run to the end of the
+ *        line, and leaves file positioned just after the number's last 
+ *        digit
+ *      - Raises Pnm_Badformat if the file ends, or has something other 
+ *        than whitespace, comments, and digits before the number
+ */
+static unsigned read_ppm_number(FILE *file)
+{
+        assert(file != NULL);
+
+        int c = getc(file);
+        while (c == '#' || isspace(c)) {
+                if (c == '#') {
+                        while (c != '\n' && c != EOF) {
+                                c = getc(file);
+                        }
+                }
+                c = getc(file);
+        }
+        if (!isdigit(c)) {
+                RAISE(Pnm_Badformat);
+        }
+
+        unsigned number = 0;
+        while (isdigit(c)) {
+                number = number * 10 + (c - '0');
+                c = getc(file);
+        }
+        ungetc(c, file);
+        return number;
+}
+
+/********** read_header_fields ********
+ * 
+ * Purpose: Reads the header of a compressed image file, up to its tile 
+ *          directory
+ *
+ * Parameters:
+ *     - file: the compressed image, positioned at its start
+ *     - header: where to store what the header says
+ *
+ * Return: none
+ *
+ * Expects: none
+ *
+ * CRE: as for read_compressed_header(), apart from the tile directory
+ *
+ * Notes:
+ *     - Sets header->tiles to NULL; read_tile_directory() fills it in
+ */
+static void read_header_fields(FILE *file, comp40_header *header)
+{
+        assert(file != NULL);
+        assert(header != NULL);
+
+        int read = fscanf(file, "COMP40 Compressed image format %d\n%u %u", 
+                          &header->format, &header->width, &header->height);
+        assert(read == 3);
+        assert(header->format == 2 || header->format == 3);
+        /*make sure last charac*/
+        int c = getc(file);
+        assert(c == '\n');
+
+        header->tile_width = header->width;
+        header->tile_height = header->height;
+        header->coding = CODING_RAW;
+        header->predict = PREDICT_NONE;
+        header->block_size = 2;
+        header->image_width = 0;
+        header->image_height = 0;
+        header->layout = default_layout;
+        header->tiles = NULL;
+
+        if (header->format == 3) {
+                read_header_lines(file, header);
+
+                /* larger blocks aren't laid out as packed words are */
+                if (header->block_size != 2) {
+                        assert(header->coding != CODING_HUFFMAN);
+                        assert(header->predict == PREDICT_NONE);
+                        assert(layout_is_default(&header->layout));
+                }
+
+                /* and neither are layouts of more than one word */
+                check_layout(&header->layout);
+                if (header->coding == CODING_HUFFMAN) {
+                        assert(huffman_supports(&header->layout));
+                }
+                if (header->predict != PREDICT_NONE) {
+                        assert(layout_words(&header->layout) == 1);
+                }
+                assert(header->width % words_per_block(header) == 0);
+        }
+
+        /* an image is whole blocks unless IMAGE said otherwise */
+        unsigned n = header->block_size;
+        unsigned blocks_width = header->width / words_per_block(header) * n;
+        unsigned blocks_height = header->height * n;
+        if (header->image_width == 0 && header->image_height == 0) {
+                header->image_width = blocks_width;
+                header->image_height = blocks_height;
+        }
+        assert(header->image_width <= blocks_width && 
+               header->image_width + n > blocks_width);
+        assert(header->image_height <= blocks_height && 
+               header->image_height + n > blocks_height);
+
+        header->tiles_wide = header->width == 0 ? 0 : 
+                (header->width + header->tile_width - 1) / header->tile_width;
+        header->tiles_high = header->height == 0 ? 0 : 
+                (header->height + header->tile_height - 1) / 
+                header->tile_height;
+}
+
+/********** read_header_lines ********
+ * 
+ * Purpose: Reads the key/value lines of a format 3 header, up to and 
+ *          including its "END" line
+ *
+ * Parameters:
+ *     - file: the stream, positioned after the width and height line
+ *     - header: the header to fill in
+ *
+ * Return: none
+ *
+ * Expects: none
+ *
+ * CRE: file or header is null, the header ends early, a line is too long,
+ *      a key is unknown, or a value is malformed
+ *
+ * Notes:
+ *     - Unknown keys are errors rather than ignored, so an image written 
+ *       with a feature this reader lacks fails loudly
+ */
+static void read_header_lines(FILE *file, comp40_header *header)
+{
+        assert(file != NULL);
+        assert(header != NULL);
+
+        char line[HEADER_LINE_MAX];
+        while (true) {
+                char *got = fgets(line, sizeof(line), file);
+                assert(got != NULL);
+                assert(strchr(line, '\n') != NULL);
+
+                char end;
+                if (strcmp(line, "END\n") == 0) {
+                        return;
+                } else if (strcmp(line, "CODING raw\n") == 0) {
+                        header->coding = CODING_RAW;
+                } else if (strcmp(line, "CODING huffman\n") == 0) {
+                        header->coding = CODING_HUFFMAN;
+                } else if (strcmp(line, "CODING rle\n") == 0) {
+                        header->coding = CODING_RLE;
+                } else if (strcmp(line, "PREDICT none\n") == 0) {
+                        header->predict = PREDICT_NONE;
+                } else if (strcmp(line, "PREDICT left\n") == 0) {
+                        header->predict = PREDICT_LEFT;
+                } else if (strcmp(line, "PREDICT above\n") == 0) {
+                        header->predict = PREDICT_ABOVE;
+                } else if (strcmp(line, "PREDICT median\n") == 0) {
+                        header->predict = PREDICT_MEDIAN;
+                } else if (sscanf(line, "BLOCK %u%c", &header->block_size,
+                                  &end) == 2) {
+                        assert(end == '\n');
+                        assert(header->block_size == 2 || 
+                               header->block_size == 4 ||
+                               header->block_size == 8);
+                } else if (sscanf(line, "IMAGE %u %u%c", 
+                                  &header->image_width, 
+                                  &header->image_height, &end) == 3) {
+                        assert(end == '\n');
+                        assert(header->image_width > 0);
+                        assert(header->image_height > 0);
+                } else if (sscanf(line, "LAYOUT %u %u %u %u %u %u%c", 
+                                  &header->layout.width[0], 
+                                  &header->layout.width[1],
+                                  &header->layout.width[2], 
+                                  &header->layout.width[3],
+                                  &header->layout.width[4], 
+                                  &header->layout.width[5], &end) == 7) {
+                        assert(end == '\n');
+                } else if (sscanf(line, "QUANT %f %f%c", 
+                                  &header->layout.bcd_max,
+                                  &header->layout.bcd_scale, &end) == 3) {
+                        assert(end == '\n');
+                } else if (sscanf(line, "TILE %u %u%c", &header->tile_width,
+                                  &header->tile_height, &end) == 3) {
+                        assert(end == '\n');
+                        assert(header->tile_width > 0);
+                        assert(header->tile_height > 0);
+                } else {
+                        assert(!"unknown line in compressed image header");
+                }
+        }
+}
+
+/********** read_tile_directory ********
+ * 
+ * Purpose: Reads the tile directory that follows a format 3 header
+ *
+ * Parameters:
+ *     - file: the stream, positioned after the header's "END" line
+ *     - header: the header, with its tile counts filled in
+ *
+ * Return: none
+ *
+ * Expects: none
+ *
+ * CRE: file or header is null, or memory can't be allocated
+ *
+ * Notes:
+ *     - Each entry is TILE_ENTRY_SIZE bytes, big-endian: the tile's 8-byte 
+ *       offset from the first byte after the directory, then its 4-byte 
+ *       length and 4-byte checksum
+ *     - An entry is marked damaged if the file ends before it, if it is 
+ *       longer than tile_bound(), or if its bytes run past the end of a 
+ *       regular file (or, in a stream, past the total length of the 
+ *       tiles); read_tiled_region() leaves such a tile blank
+ */
+static void read_tile_directory(FILE *file, comp40_header *header)
+{
+        assert(file != NULL);
+        assert(header != NULL);
+
+        long ntiles = (long)header->tiles_wide * header->tiles_high;
+        if (ntiles == 0) {
+                return;
+        }
+        header->tiles = ALLOC(ntiles * (long)sizeof(tile_entry));
+        assert(header->tiles != NULL);
+
+        long bound = tile_bound(header);
+        bool cut_off = false;
+        for (long i = 0; i < ntiles; i++) {
+                unsigned char entry[TILE_ENTRY_SIZE] = { 0 };
+                if (!cut_off) {
+                        size_t got = fread(entry, 1, TILE_ENTRY_SIZE, file);
+                        cut_off = got != TILE_ENTRY_SIZE;
+                }
+
+                tile_entry *tile = &header->tiles[i];
+                tile->offset = (uint64_t)get_be32(entry) << 32 | 
+                               get_be32(entry + 4);
+                tile->length = get_be32(entry + 8);
+                tile->checksum = get_be32(entry + 12);
+                tile->damaged = cut_off || tile->length > bound;
+        }
+
+        /* 
+         * the tiles' bytes must fit in what's left of a regular file; in 
+         * a stream, whose size isn't known, in the bytes of all the tiles,
+         * which are written one after another (tile_bound() for each 
+         * damaged one)
+         */
+        long remaining = cut_off ? -1 : bytes_after(file);
+        if (remaining < 0) {
+                remaining = 0;
+                for (long i = 0; i < ntiles; i++) {
+                        remaining += header->tiles[i].damaged ? 
+                                     bound : header->tiles[i].length;
+                }
+        }
+        for (long i = 0; i < ntiles; i++) {
+                tile_entry *tile = &header->tiles[i];
+                if (tile->offset > (uint64_t)remaining || 
+                    tile->length > remaining - tile->offset) {
+                        tile->damaged = true;
+                }
+        }
+}
+
+/********** read_untiled_region ********
+ * 
+ * Purpose: Reads a rectangle of words from a format 2 image
+ *
+ * Parameters:
+ *     - src: the source the words are read from
+ *     - header: the image's header
+ *     - col, row: the rectangle's first word
+ *     - packed_words: the array to fill; its size is the rectangle's size
+ *     - methods: the methods for packed_words
+ *
+ * Return: none
+ *
+ * Expects: the rectangle fits in the image
+ *
+ * CRE: src, header, packed_words, or methods is null, or the file ends 
+ *      before the rectangle's last word
+ */
+static void read_untiled_region(source *src, const comp40_header *header,
+                                unsigned col, unsigned row, 
+                                A2Methods_UArray2 packed_words, 
+                                A2Methods_T methods)
+{
+        assert(src != NULL);
+        assert(header != NULL);
+        assert(packed_words != NULL);
+        assert(methods != NULL);
+
+        unsigned ncols = methods->width(packed_words);
+        unsigned nrows = methods->height(packed_words);
+
+        long row_bytes = (long)ncols * 4;
+        unsigned char *bytes = ALLOC(row_bytes);
+        assert(bytes != NULL);
+
+        for (unsigned r = 0; r < nrows; r++) {
+                off_t offset = ((off_t)(row + r) * header->width + col) * 4;
+                bool read = source_read(src, offset, bytes, row_bytes);
+                assert(read);
+
+                /* build each word (Big-Endian Order) */
+                if (ncols > 0 && uarray2_rows_contiguous(methods)) {
+                        CPU_DISPATCH(be_to_words)(bytes, 
+                                                  methods->at(packed_words,
+                                                              0, r), 
+                                                  ncols);
+                        continue;
+                }
+                for (unsigned c = 0; c < ncols; c++) {
+                        uint32_t *word_ptr = methods->at(packed_words, 
+                                                         c, r);
+                        assert(word_ptr != NULL);
+                        *word_ptr = get_be32(bytes + 4 * c);
+                }
+        }
+
+        FREE(bytes);
+}
+
+/********** read_tiled_region ********
+ * 
+ * Purpose: Reads a rectangle of words from a format 3 image, one 
+ *          overlapping tile at a time
+ *
+ * Parameters:
+ *     - src: the source the tiles are read from
+ *     - header: the image's header, with its tile directory
+ *     - col, row: the rectangle's first word
+ *     - packed_words: the array to fill; its size is the rectangle's size
+ *     - methods: the methods for packed_words
+ *
+ * Return: none
+ *
+ * Expects: the rectangle fits in the image
+ *
+ * CRE: src, header, packed_words, or methods is null, or memory can't be 
+ *      allocated
+ *
+ * Notes:
+ *     - A tile whose directory entry is damaged, whose bytes can't all be
+ *       read, whose checksum doesn't match, or that doesn't decode, is 
+ *       reported on stderr and filled with blank_word(), so one damaged
+ *       tile doesn't stop the rest of the image from being read
+ */
+static void read_tiled_region(source *src, const comp40_header *header,
+                              unsigned col, unsigned row, 
+                              A2Methods_UArray2 packed_words, 
+                              A2Methods_T methods)
+{
+        assert(src != NULL);
+        assert(header != NULL);
+        assert(packed_words != NULL);
+        assert(methods != NULL);
+
+        unsigned ncols = methods->width(packed_words);
+        unsigned nrows = methods->height(packed_words);
+        unsigned tw = header->tile_width;
+        unsigned th = header->tile_height;
+
+        /* one tile's worth of bytes and words, reused for every tile */
+        long max_length = 0;
+        for (unsigned ty = row / th; ty <= (row + nrows - 1) / th; ty++) {
+                for (unsigned tx = col / tw; tx <= (col + ncols - 1) / tw; 
+                     tx++) {
+                        tile_entry *entry = 
+                                &header->tiles[ty * header->tiles_wide + tx];
+                        if (!entry->damaged && 
+                            (long)entry->length > max_length) {
+                                max_length = entry->length;
+                        }
+                }
+        }
+        unsigned char *bytes = ALLOC(max_length > 0 ? max_length : 1);
+        uint32_t *tile = ALLOC((long)tw * th * (long)sizeof(uint32_t));
+        assert(bytes != NULL && tile != NULL);
+
+        for (unsigned ty = row / th; ty <= (row + nrows - 1) / th; ty++) {
+                for (unsigned tx = col / tw; tx <= (col + ncols - 1) / tw; 
+                     tx++) {
+                        /* this tile's place and size in the image */
+                        unsigned tile_col = tx * tw;
+                        unsigned tile_row = ty * th;
+                        unsigned width = tile_col + tw > header->width ? 
+                                         header->width - tile_col : tw;
+                        unsigned height = tile_row + th > header->height ? 
+                                          header->height - tile_row : th;
+
+                        tile_entry *entry = 
+                                &header->tiles[ty * header->tiles_wide + tx];
+                        if (entry->damaged || 
+                            !source_read(src, entry->offset, bytes, 
+                                         entry->length) ||
+                            checksum(bytes, entry->length) != 
+                            entry->checksum || 
+                            !decode_tile(header->coding, &header->layout, 
+                                         bytes, entry->length, tile, 
+                                         (long)width * height)) {
+                                fprintf(stderr, "COMP40: tile %u,%u is "
+                                        "corrupt and was left blank\n", tx,
+                                        ty);
+                                uint32_t blank = blank_word();
+                                for (long i = 0; i < (long)width * height;
+                                     i++) {
+                                        tile[i] = blank;
+                                }
+                        } else {
+                                unpredict_words(tile, width, height, 
+                                                header->predict, 
+                                                &header->layout);
+                        }
+
+                        copy_tile_overlap(tile, tile_col, tile_row, width,
+                                          height, col, row, packed_words,
+                                          methods);
+                }
+        }
+
+        FREE(bytes);
+        FREE(tile);
+}
+
+/********** copy_tile_overlap ********
+ * 
+ * Purpose: Copies the words of a decoded tile that fall inside a rectangle
+ *          into the rectangle's array
+ *
+ * Parameters:
+ *     - tile: the tile's words, row-major
+ *     - tile_col, tile_row: the tile's first word in the image
+ *     - width, height: the tile's size, in words
+ *     - col, row: the rectangle's first word in the image
+ *     - packed_words: the rectangle's array
+ *     - methods: the methods for packed_words
+ *
+ * Return: none
+ *
+ * Expects: none
+ *
+ * CRE: tile, packed_words, or methods is null
+ */
+static void copy_tile_overlap(const uint32_t *tile, unsigned tile_col, 
+                              unsigned tile_row, unsigned width, 
+                              unsigned height, unsigned col, unsigned row,
+                              A2Methods_UArray2 packed_words, 
+                              A2Methods_T methods)
+{
+        assert(tile != NULL);
+        assert(packed_words != NULL);
+        assert(methods != NULL);
+
+        /* the overlap, in image coordinates */
+        unsigned left = tile_col > col ? tile_col : col;
+        unsigned top = tile_row > row ? tile_row : row;
+        unsigned right = tile_col + width;
+        unsigned bottom = tile_row + height;
+        if (right > col + (unsigned)methods->width(packed_words)) {
+                right = col + methods->width(packed_words);
+        }
+        if (bottom > row + (unsigned)methods->height(packed_words)) {
+                bottom = row + methods->height(packed_words);
+        }
+
+        for (unsigned y = top; y < bottom; y++) {
+                for (unsigned x = left; x < right; x++) {
+                        uint32_t *word_ptr = methods->at(packed_words, 
+                                                         x - col, y - row);
+                        *word_ptr = tile[(y - tile_row) * width + 
+                                         (x - tile_col)];
+                }
+        }
+}
+
+/********** encode_tile ********
+ * 
+ * Purpose: Appends the bytes of one tile to a byte buffer
+ *
+ * Parameters:
+ *     - coding: how the tile is coded
+ *     - layout: the layout of the words
+ *     - tile: the tile's words, row-major
+ *     - nwords: the number of words in the tile
+ *     - out: the buffer to append to
+ *
+ * Return: none
+ *
+ * Expects: none
+ *
+ * CRE: tile or out is null, or memory can't be allocated
+ *
+ * Notes:
+ *     - Raw tiles hold their words as 4 bytes each, big-endian, like 
+ *       format 2, except that words of a layout narrower than 32 bits
+ *       take only the bytes they need (see raw_word_bytes()). Huffman and
+ *       run-length tiles are described in entropy.c
+ */
+static void encode_tile(enum codec_coding coding, 
+                        const struct word_layout *layout, 
+                        const uint32_t *tile, long nwords, byte_buffer *out)
+{
+        assert(tile != NULL);
+        assert(out != NULL);
+
+        switch (coding) {
+        case CODING_RAW: {
+                unsigned nbytes = raw_word_bytes(layout);
+                byte_buffer_reserve(out, nwords * 4);
+                if (nbytes == 4) {
+                        CPU_DISPATCH(words_to_be)(tile, 
+                                                  out->data + out->length,
+                                                  nwords);
+                        out->length += nwords * 4;
+                        break;
+                }
+                for (long i = 0; i < nwords; i++) {
+                        unsigned char bytes[4];
+                        put_be32(bytes, tile[i]);
+                        memcpy(out->data + out->length, 
+                               bytes + 4 - nbytes, nbytes);
+                        out->length += nbytes;
+                }
+                break;
+        }
+        case CODING_HUFFMAN:
+                byte_buffer_reserve(out, huffman_bound(nwords, layout));
+                out->length += huffman_encode(tile, nwords, 
+                                              out->data + out->length, 
+                                              layout);
+                break;
+        case CODING_RLE:
+                byte_buffer_reserve(out, rle_bound(nwords));
+                out->length += rle_encode(tile, nwords, 
+                                          out->data + out->length);
+                break;
+        }
+}
+
+/********** decode_tile ********
+ * 
+ * Purpose: Turns the bytes of one tile back into its words
+ *
+ * Parameters:
+ *     - coding: how the tile is coded
+ *     - layout: the layout of the words
+ *     - bytes: the tile's bytes
+ *     - length: the number of bytes
+ *     - tile: where to store the tile's words, row-major
+ *     - nwords: the number of words in the tile
+ *
+ * Return: true if the bytes were a valid tile, false otherwise
+ *
+ * Expects: none
+ *
+ * CRE: bytes or tile is null
+ */
+static bool decode_tile(enum codec_coding coding, 
+                        const struct word_layout *layout, 
+                        const unsigned char *bytes, long length, 
+                        uint32_t *tile, long nwords)
+{
+        assert(bytes != NULL);
+        assert(tile != NULL);
+
+        switch (coding) {
+        case CODING_RAW: {
+                unsigned nbytes = raw_word_bytes(layout);
+                if (length != nwords * nbytes) {
+                        return false;
+                }
+                if (nbytes == 4) {
+                        CPU_DISPATCH(be_to_words)(bytes, tile, nwords);
+                        return true;
+                }
+                for (long i = 0; i < nwords; i++) {
+                        uint32_t word = 0;
+                        for (unsigned k = 0; k < nbytes; k++) {
+                                word = word << 8 | *bytes++;
+                        }
+                        tile[i] = word;
+                }
+                return true;
+        }
+        case CODING_HUFFMAN:
+                return huffman_decode(bytes, length, tile, nwords, layout);
+        case CODING_RLE:
+                return rle_decode(bytes, length, tile, nwords);
+        }
+        return false;
+}
+
+/********** raw_word_bytes ********
+ * 
+ * Purpose: Gives the number of bytes a word takes in a raw tile
+ *
+ * Parameters:
+ *     - layout: the layout of the words
+ *
+ * Return: the fewest whole bytes that hold a one-word layout, otherwise 4
+ *
+ * Expects: none
+ *
+ * CRE: layout is null
+ *
+ * Notes:
+ *     - So a 16-bit layout really does halve a raw image. Each word of a
+ *       two-word layout is 4 bytes
+ */
+static unsigned raw_word_bytes(const struct word_layout *layout)
+{
+        assert(layout != NULL);
+        unsigned bits = layout_bits(layout);
+        return bits <= 32 ? (bits + 7) / 8 : 4;
+}
+
+/********** checksum ********
+ * 
+ * Purpose: Computes the Adler-32 checksum of a block of bytes
+ *
+ * Parameters:
+ *     - bytes: the bytes to check
+ *     - length: the number of bytes
+ *
+ * Return: the checksum
+ *
+ * Expects: none
+ *
+ * CRE: bytes is null
+ *
+ * Notes:
+ *     - The sums are reduced every ADLER_BLOCK bytes, the most that can 
+ *       be added without overflowing 32 bits
+ */
+static uint32_t checksum(const unsigned char *bytes, long length)
+{
+        assert(bytes != NULL);
+
+        uint32_t a = 1, b = 0;
+        while (length > 0) {
+                long n = length < ADLER_BLOCK ? length : ADLER_BLOCK;
+                length -= n;
+                while (n-- > 0) {
+                        a += *bytes++;
+                        b += a;
+                }
+                a %= ADLER_MOD;
+                b %= ADLER_MOD;
+        }
+        return b << 16 | a;
+}
+
+/********** source_init ********
+ * 
+ * Purpose: Sets up a source for reading the part of a file that starts at
+ *          the stream's current position
+ *
+ * Parameters:
+ *     - src: the source to set up
+ *     - file: the stream to read from
+ *
+ * Return: none
+ *
+ * Expects: none
+ *
+ * CRE: src or file is null
+ *
+ * Notes:
+ *     - Only regular files can be read at arbitrary offsets. Anything else
+ *       must be read in order of increasing offset
+ */
+static void source_init(source *src, FILE *file)
+{
+        assert(src != NULL);
+        assert(file != NULL);
+
+        struct stat info;
+        src->file = file;
+        src->fd = fileno(file);
+        src->start = ftello(file);
+        src->seekable = src->fd >= 0 && src->start >= 0 && 
+                        fstat(src->fd, &info) == 0 && S_ISREG(info.st_mode);
+        src->pos = 0;
+}
+
+/********** source_read ********
+ * 
+ * Purpose: Reads bytes at an offset from a source
+ *
+ * Parameters:
+ *     - src: the source to read from
+ *     - offset: the offset of the first byte, from the source's start
+ *     - bytes: where to store the bytes
+ *     - length: the number of bytes to read
+ *
+ * Return: true if all length bytes were read; false if the file ends 
+ *         first, or the source is a stream and offset is before bytes 
+ *         already read
+ *
+ * Expects: none
+ *
+ * CRE: src or bytes is null
+ *
+ * Notes:
+ *     - After a failed read of a stream, its position is unknown and 
+ *       every later read fails too
+ */
+static bool source_read(source *src, off_t offset, void *bytes, long length)
+{
+        assert(src != NULL);
+        assert(bytes != NULL);
+
+        if (src->seekable) {
+                ssize_t got = pread(src->fd, bytes, length, 
+                                    src->start + offset);
+                return got == length;
+        }
+
+        if (offset < src->pos || !skip_bytes(src->file, offset - src->pos)) {
+                return false;
+        }
+        size_t got = fread(bytes, 1, length, src->file);
+        if ((long)got != length) {
+                src->pos = LONG_MAX;
+                return false;
+        }
+        src->pos = offset + length;
+        return true;
+}
+
+/********** skip_bytes ********
+ * 
+ * Purpose: Reads and discards bytes from a stream that can't seek
+ *
+ * Parameters:
+ *     - file: the stream to read from
+ *     - nbytes: the number of bytes to skip
+ *
+ * Return: true if nbytes were skipped, false if the file ended first
+ *
+ * Expects: none
+ *
+ * CRE: file is null
+ */
+static bool skip_bytes(FILE *file, long nbytes)
+{
+        assert(file != NULL);
+
+        char scratch[4096];
+        while (nbytes > 0) {
+                long chunk = nbytes < (long)sizeof(scratch) ? 
+                             nbytes : (long)sizeof(scratch);
+                size_t got = fread(scratch, 1, chunk, file);
+                if ((long)got != chunk) {
+                        return false;
+                }
+                nbytes -= chunk;
+        }
+        return true;
+}
+
+/********** bytes_after ********
+ * 
+ * Purpose: Gives the number of bytes left in a regular file after its 
+ *          current position
+ *
+ * Parameters:
+ *     - file: the stream
+ *
+ * Return: the number of bytes, or -1 if file isn't a regular file or its
+ *         size or position isn't known
+ *
+ * Expects: none
+ *
+ * CRE: file is null
+ */
+static long bytes_after(FILE *file)
+{
+        assert(file != NULL);
+
+        struct stat info;
+        int fd = fileno(file);
+        off_t position = ftello(file);
+        if (fd < 0 || position < 0 || fstat(fd, &info) != 0 || 
+            !S_ISREG(info.st_mode) || info.st_size < position) {
+                return -1;
+        }
+        return info.st_size - position;
+}
+
+/********** tile_bound ********
+ * 
+ * Purpose: Gives the most bytes a full tile of an image can take
+ *
+ * Parameters:
+ *     - header: the image's header
+ *
+ * Return: the size of the largest tile encode_tile() can write with the
+ *         header's coding and layout
+ *
+ * Expects: none
+ *
+ * CRE: header is null
+ */
+static long tile_bound(const comp40_header *header)
+{
+        assert(header != NULL);
+
+        long nwords = (long)header->tile_width * header->tile_height;
+        switch (header->coding) {
+        case CODING_HUFFMAN:
+                return huffman_bound(nwords, &header->layout);
+        case CODING_RLE:
+                return rle_bound(nwords);
+        default:
+                return nwords * raw_word_bytes(&header->layout);
+        }
+}
+
+/********** least_bytes ********
+ * 
+ * Purpose: Gives the fewest bytes an image's words and tile directory can
+ *          take
+ *
+ * Parameters:
+ *     - header: the image's header
+ *
+ * Return: a lower bound on the bytes after the header of any whole image
+ *         with this header, or LONG_MAX if the image is too large to count
+ *
+ * Expects: none
+ *
+ * CRE: header is null
+ *
+ * Notes:
+ *     - Sums over the whole image rather than tile by tile, which can 
+ *       only make the bound smaller
+ */
+static long least_bytes(const comp40_header *header)
+{
+        assert(header != NULL);
+
+        /* no file holds this many words, and the sums below would wrap */
+        uint64_t total = (uint64_t)header->width * header->height;
+        if (total > LONG_MAX / 32) {
+                return LONG_MAX;
+        }
+        long nwords = total;
+        if (header->format == 2) {
+                return nwords * 4;
+        }
+
+        long directory = (long)header->tiles_wide * header->tiles_high * 
+                         TILE_ENTRY_SIZE;
+        switch (header->coding) {
+        case CODING_HUFFMAN:
+                return directory + huffman_least(nwords);
+        case CODING_RLE:
+                return directory + rle_least(nwords);
+        default:
+                return directory + nwords * raw_word_bytes(&header->layout);
+        }
+}
+
+/********** byte_buffer_reserve ********
+ * 
+ * Purpose: Makes room for nbytes more bytes at the end of a byte buffer
+ *
+ * Parameters:
+ *     - buffer: the buffer to grow
+ *     - nbytes: the number of bytes about to be appended
+ *
+ * Return: none
+ *
+ * Expects: none
+ *
+ * CRE: buffer is null, or memory can't be allocated
+ */
+static void byte_buffer_reserve(byte_buffer *buffer, long nbytes)
+{
+        assert(buffer != NULL);
+
+        if (buffer->length + nbytes <= buffer->capacity) {
+                return;
+        }
+        long capacity = buffer->capacity > 0 ? buffer->capacity : 4096;
+        while (capacity < buffer->length + nbytes) {
+                capacity *= 2;
+        }
+        if (buffer->data == NULL) {
+                buffer->data = ALLOC(capacity);
+        } else {
+                RESIZE(buffer->data, capacity);
+        }
+        buffer->capacity = capacity;
+}
+
+/********** get_be32 ********
+ * 
+ * Purpose: Reads a 32-bit big-endian integer
+ *
+ * Parameters:
+ *     - bytes: the integer's four bytes
+ *
+ * Return: the integer
+ *
+ * Expects: bytes points at four readable bytes
+ *
+ * CRE: none
+ */
+CPU_KERNEL uint32_t get_be32(const unsigned char *bytes)
+{
+        return (uint32_t)bytes[0] << 24 | (uint32_t)bytes[1] << 16 | 
+               (uint32_t)bytes[2] << 8 | bytes[3];
+}
+
+/********** put_be32 ********
+ * 
+ * Purpose: Writes a 32-bit big-endian integer
+ *
+ * Parameters:
+ *     - bytes: where to write the integer's four bytes
+ *     - value: the integer
+ *
+ * Return: none
+ *
+ * Expects: bytes points at four writable bytes
+ *
+ * CRE: none
+ */
+CPU_KERNEL void put_be32(unsigned char *bytes, uint32_t value)
+{
+        bytes[0] = value >> 24;
+        bytes[1] = value >> 16;
+        bytes[2] = value >> 8;
+        bytes[3] = value;
+}
+
+/********** words_to_be_kernel ********
+ * 
+ * Purpose: Writes a run of 32-bit words as big-endian bytes
+ *
+ * Parameters:
+ *     - words: the words
+ *     - bytes: where to write their 4 * nwords bytes
+ *     - nwords: the number of words
+ *
+ * Return: none
+ *
+ * Expects: bytes and words don't overlap
+ *
+ * CRE: none (this is the writers' inner loop)
+ *
+ * Notes:
+ *     - Called as CPU_DISPATCH(words_to_be) (cpu.h)
+ */
+CPU_KERNEL void words_to_be_kernel(const uint32_t *words, 
+                                   unsigned char *bytes, long nwords)
+{
+        for (long i = 0; i < nwords; i++) {
+                put_be32(bytes + 4 * i, words[i]);
+        }
+}
+
+/* words_to_be_kernel() for each level of cpu.h */
+CPU_VARIANTS(words_to_be, (const uint32_t *words, unsigned char *bytes, 
+                           long nwords), (words, bytes, nwords));
+
+/********** be_to_words_kernel ********
+ * 
+ * Purpose: Reads a run of 32-bit words from big-endian bytes
+ *
+ * Parameters:
+ *     - bytes: the words' 4 * nwords bytes
+ *     - words: where to store the words
+ *     - nwords: the number of words
+ *
+ * Return: none
+ *
+ * Expects: bytes and words don't overlap
+ *
+ * CRE: none (this is the readers' inner loop)
+ *
+ * Notes:
+ *     - Called as CPU_DISPATCH(be_to_words) (cpu.h)
+ */
+CPU_KERNEL void be_to_words_kernel(const unsigned char *bytes, 
+                                   uint32_t *words, long nwords)
+{
+        for (long i = 0; i < nwords; i++) {
+                words[i] = get_be32(bytes + 4 * i);
+        }
+}
+
+/* be_to_words_kernel() for each level of cpu.h */
+CPU_VARIANTS(be_to_words, (const unsigned char *bytes, uint32_t *words, 
+                           long nwords), (bytes, words, nwords));
@@ -21,6 +21,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdbool.h>
 #include "assert.h"
 #include "mem.h"
 #include <except.h>
@@ -32,19 +33,105 @@
 #include "uarray2b.h"
 #include "uarray2.h"
 #include "bitpack.h"
+#include "codec.h"
+
+/* 
+ * struct tile_entry is one entry of a tiled image's tile directory: where 
+ * the tile's bytes start (counted from the end of the directory), how many
+ * there are, and their Adler-32 checksum. damaged is set when the entry 
+ * can't be right (it is cut off, runs past the end of the file, or is 
+ * longer than any coding of the tile), so the tile is left blank
+ */
+typedef struct tile_entry {
+        uint64_t offset;
+        uint32_t length;
+        uint32_t checksum;
+        bool damaged;
+} tile_entry;
+
+/* 
+ * struct comp40_header holds what a compressed image's header says. Sizes 
+ * are in words; a block of block_size x block_size pixels takes 
+ * words_per_block() words side by side: block_words(block_size) for the 
+ * larger blocks of block.h, and layout_words(&layout) (see word.h) for 
+ * 2x2 blocks, one word in the default layout. A format 2 image is one raw
+ * tile the size of the image and has no directory (tiles is NULL). 
+ * image_width and image_height are the image's size in pixels: the 
+ * blocks' size, or less when the last row and column of blocks were 
+ * padded out.
+ */
+typedef struct comp40_header {
+        int format;
+        unsigned width, height;
+        unsigned image_width, image_height;
+        unsigned tile_width, tile_height;
+        unsigned tiles_wide, tiles_high;
+        enum codec_coding coding;
+        enum codec_predict predict;
+        unsigned block_size;
+        struct word_layout layout;
+        tile_entry *tiles;
+} comp40_header;
+
+/*
+ * struct ppm_reader reads a PPM image ("P6" raw or "P3" plain) a row at a
+ * time: ppm_read_header() fills in the image's size and denominator, and 
+ * each call to ppm_read_row() reads the next row. A raw image's samples 
+ * take sample_bytes bytes each, and row_bytes holds one raw row.
+ */
+typedef struct ppm_reader {
+        FILE *input;
+        bool plain;
+        unsigned width, height, denominator;
+        unsigned sample_bytes;
+        unsigned char *row_bytes;
+} ppm_reader;
 
 /* compression */
-Pnm_ppm read_and_trim_ppm(FILE *input); 
+void ppm_read_header(FILE *input, ppm_reader *reader);
+void ppm_read_row(ppm_reader *reader, struct Pnm_rgb *row, unsigned ncols);
+void ppm_reader_free(ppm_reader *reader);
+Pnm_ppm read_checked_ppm(FILE *input, A2Methods_T methods);
+Pnm_ppm read_and_trim_ppm(FILE *input, A2Methods_T methods); 
 void update_ppm_trimmed(Pnm_ppm *ppm, A2Methods_T methods, 
                         int width, int height);
 void trimmed_pixels_apply(int colx, int rowy, A2Methods_UArray2 old_pixels, 
                         void *elem, void *cl);
-void print_compressed(A2Methods_UArray2 words, A2Methods_T methods);
+void update_ppm_padded(Pnm_ppm *ppm, A2Methods_T methods, 
+                       unsigned width, unsigned height);
+void print_compressed(A2Methods_UArray2 words, A2Methods_T methods, 
+                      FILE *output);
+void print_compressed_header(unsigned width, unsigned height, FILE *output);
+void words_to_bytes(const uint32_t *words, unsigned char *bytes, 
+                    long nwords);
+void print_compressed_tiled(A2Methods_UArray2 words, A2Methods_T methods, 
+                            unsigned tile_width, unsigned tile_height, 
+                            enum codec_coding coding, 
+                            enum codec_predict predict, 
+                            unsigned block_size, unsigned image_width,
+                            unsigned image_height, 
+                            const struct word_layout *layout, FILE *output);
 
 /* decompression */
 void print_decompressed(A2Methods_UArray2 pixels, A2Methods_T methods, 
-                        int denominator); 
-A2Methods_UArray2 read_compressed_to_words(FILE *file);
+                        int denominator, FILE *output); 
+A2Methods_UArray2 read_compressed_to_words(FILE *file, A2Methods_T methods);
+void read_compressed_header(FILE *file, comp40_header *header);
+bool compressed_fits(FILE *file, long available);
+void free_compressed_header(comp40_header *header);
+unsigned words_per_block(const comp40_header *header);
+A2Methods_UArray2 read_compressed_words(FILE *file, 
+                                        const comp40_header *header, 
+                                        A2Methods_T methods);
+A2Methods_UArray2 read_compressed_region(FILE *file, 
+                                         const comp40_header *header, 
+                                         unsigned col, unsigned row, 
+                                         unsigned ncols, unsigned nrows, 
+                                         A2Methods_T methods);
+A2Methods_UArray2 crop_pixels(A2Methods_UArray2 pixels, A2Methods_T methods,
+                              int col, int row, int width, int height);
+void bytes_to_words(const unsigned char *bytes, uint32_t *words, 
+                    long nwords);
 
 /* bitpack.c shift */
 uint64_t shift_left(uint64_t word, unsigned shift);
@@ -12,34 +12,66 @@
  *     color spaces, used in image compression and decompression. The file
  *     ensures proper scaling and normalization of color values while 
  *     handling floating-point inofrmation loss during conversion.
+ *
+ *     Images whose rows are stored contiguously are converted to Y/Pb/Pr
+ *     a row at a time by a kernel compiled for each instruction set in 
+ *     cpu.h; other images go pixel by pixel through to_ypbpr_apply().
+ *     Both give the same values.
  *     
  *
  **************************************************************/
 
+#include <math.h>
 #include "ry_conversion.h"
+#include "a2pool.h"
+#include "cpu.h"
 
 /* 
  * struct closure stores information needed for image processing, including 
  * a pointer to a 2D array of pixels, a set of methods for handling the array, 
  * and a denominator for scaling pixel values. It is used in applu functions 
  * that modify images to ensure easy access to pixel data and processing tools.
+ * When converting back to RGB, it also remembers the last pixel converted
+ * and its result, so a run of equal pixels is converted only once.
  */
 struct closure{
         A2Methods_UArray2 *pixels;
         A2Methods_T methods;
         int denominator;
+        Y_Pb_Pr last_ypbpr;
+        Pnm_rgb last_rgb;
 };
 
 /* 
  * struct Y_Pb_Pr represents a pixel in the YPbPr color space, where Y 
  * controls brightness, and Pb and Pr represent chroma components. 
- * All values are stored as floating-point numbers, and this struct is used 
- * for color conversion between RGB and YPbPr.
+ * Values are stored as 16-bit fixed-point numbers (scaled by FIXED_SCALE) 
+ * so a full image of them takes 6 bytes per pixel instead of 12. Callers 
+ * still see floats through the getters and setters.
  */
 struct Y_Pb_Pr{
-        float Y, Pb, Pr; 
+        int16_t Y, Pb, Pr; 
 }; 
 
+/* 
+ * Fixed-point scale for struct Y_Pb_Pr: 14 fractional bits gives a step of
+ * about 0.00006 (well below the 1/511 step of the a coefficient) and a range 
+ * of [-2, 2). Decompressed Y values are at most a + |b| + |c| + |d| = 1.9, 
+ * so every value the codec produces fits.
+ */
+static const float FIXED_SCALE = 16384.0;
+static const float FIXED_MAX = 32767.0;
+static const float FIXED_MIN = -32768.0;
+
+CPU_KERNEL int16_t to_fixed(float val);
+static inline float from_fixed(int16_t val);
+CPU_KERNEL void rgb_row_to_ypbpr_kernel(const struct Pnm_rgb *rgb, 
+                                        struct Y_Pb_Pr *ypbpr, int width,
+                                        int denominator);
+CPU_DECLARE_VARIANTS(rgb_row_to_ypbpr, (const struct Pnm_rgb *rgb, 
+                                        struct Y_Pb_Pr *ypbpr, int width,
+                                        int denominator));
+
 /**************************/
 /*       Compression      */
 /**************************/
@@ -65,7 +97,9 @@ struct Y_Pb_Pr{
  * Notes:
  *      - This function creates a new A2Methods_UArray2 to store the Y/Pb/Pr 
  *        pixel values
- *      - It applies the to_ypbpr_apply function to each pixel in the image
+ *      - It applies the to_ypbpr_apply function to each pixel in the image,
+ *        or, when the methods store rows contiguously, the dispatched
+ *        rgb_row_to_ypbpr_kernel() to each row
  *      - Uses the image's denominator for normalization of RGB values
  *      - Information is lost here due to floating point arithmetic in
  *              helper function to_ypbpr_apply().
@@ -84,8 +118,21 @@ A2Methods_UArray2 rgb_to_ypbpr (Pnm_ppm ppm)
                                                         sizeof(struct Y_Pb_Pr));
         assert(ypbpr_pixels != NULL);
 
+        /* rows stored as C arrays are converted a row at a time */
+        if (uarray2_rows_contiguous(methods) && ppm->width > 0) {
+                assert(ppm->denominator > 0);
+                for (unsigned row = 0; row < ppm->height; row++) {
+                        CPU_DISPATCH(rgb_row_to_ypbpr)(
+                                methods->at(ppm->pixels, 0, row),
+                                methods->at(ypbpr_pixels, 0, row),
+                                ppm->width, ppm->denominator);
+                }
+                return ypbpr_pixels;
+        }
+
         /* create closure struct */
-        closure cl = {&ypbpr_pixels, methods, ppm->denominator};
+        closure cl = {&ypbpr_pixels, methods, ppm->denominator, NULL, 
+                      NULL};
 
         /* Apply function */
         A2Methods_mapfun *map = methods->map_default; 
@@ -166,9 +213,9 @@ void to_ypbpr_apply(int col, int row, A2Methods_UArray2 array2, void *elem,
         
         /* convert RGB to Y/Pb/Pr using the formula from the spec */
         /* info is lost here due to floats */
-        ypbpr->Y = 0.299 * r + 0.587 * g + 0.114 * b;
-        ypbpr->Pb = -0.168736 * r - 0.331264 * g + 0.5 * b;
-        ypbpr->Pr = 0.5 * r - 0.418688 * g - 0.081312 * b;
+        ypbpr->Y = to_fixed(0.299 * r + 0.587 * g + 0.114 * b);
+        ypbpr->Pb = to_fixed(-0.168736 * r - 0.331264 * g + 0.5 * b);
+        ypbpr->Pr = to_fixed(0.5 * r - 0.418688 * g - 0.081312 * b);
 }
 
 
@@ -223,7 +270,7 @@ A2Methods_UArray2 ypbpr_to_rgb(A2Methods_UArray2 ypbpr_pixels,
         assert(rgb_pixels != NULL);
 
         /* create closure struct */
-        closure cl = {&rgb_pixels, methods, denominator};
+        closure cl = {&rgb_pixels, methods, denominator, NULL, NULL};
 
         /* mapping and apply function */
         A2Methods_mapfun *map = methods->map_default; 
@@ -261,7 +308,8 @@ A2Methods_UArray2 ypbpr_to_rgb(A2Methods_UArray2 ypbpr_pixels,
  *      the denominator from the closure is null, ypbpr is null, or rgb is null
  *
  * Notes:
- *      - Uses convert_ypbpr_to_rgb to perform the conversion
+ *      - Uses convert_ypbpr_to_rgb to perform the conversion, unless the
+ *        pixel equals the last one converted, whose result is copied
  *      - Ensures that all RGB values are within the valid range
  *      - Information can be lost here due to floating point arithmetic in
  *              helper function convert_ypbpr_to_rgb().
@@ -297,8 +345,19 @@ void to_rgb_apply(int col, int row, A2Methods_UArray2 array2, void *elem,
         Pnm_rgb rgb = methods->at(*rgb_pixels, col, row);
         assert(rgb != NULL);
     
-        /* Perform the conversion using helper */
-        convert_ypbpr_to_rgb(ypbpr, denominator, rgb);
+        /* 
+         * Perform the conversion using helper, or copy the last result if
+         * the last pixel was the same
+         */
+        Y_Pb_Pr last = info->last_ypbpr;
+        if (last != NULL && last->Y == ypbpr->Y && last->Pb == ypbpr->Pb &&
+            last->Pr == ypbpr->Pr) {
+                *rgb = *info->last_rgb;
+        } else {
+                convert_ypbpr_to_rgb(ypbpr, denominator, rgb);
+        }
+        info->last_ypbpr = ypbpr;
+        info->last_rgb = rgb;
 }
 
 /********** convert_ypbpr_to_rgb ********
@@ -332,9 +391,9 @@ void convert_ypbpr_to_rgb(Y_Pb_Pr ypbpr, int denominator, Pnm_rgb rgb)
         assert(denominator > 0);
 
         /* Extract Y, Pb, Pr values from the Y_Pb_Pr struct */
-        float y = ypbpr->Y;
-        float pb = ypbpr->Pb;
-        float pr = ypbpr->Pr;
+        float y = from_fixed(ypbpr->Y);
+        float pb = from_fixed(ypbpr->Pb);
+        float pr = from_fixed(ypbpr->Pr);
 
         /* Convert Y/Pb/Pr to RGB using the spec formula */
         /*information lost here due to rounding*/
@@ -400,9 +459,9 @@ Y_Pb_Pr new_Y_Pb_Pr(float Y, float Pb, float Pr)
         assert(ypbpr != NULL);
 
         /* Assign provided Y Pb Pr values */
-        ypbpr->Y = Y;
-        ypbpr->Pb = Pb;
-        ypbpr->Pr = Pr;
+        ypbpr->Y = to_fixed(Y);
+        ypbpr->Pb = to_fixed(Pb);
+        ypbpr->Pr = to_fixed(Pr);
 
         return ypbpr;
 }
@@ -423,6 +482,7 @@ Y_Pb_Pr new_Y_Pb_Pr(float Y, float Pb, float Pr)
  * Notes:
  *      - This function is useful when dynamically allocating memory 
  *        for Y_Pb_Pr structures
+ *      - The struct holds three 16-bit fixed-point values (6 bytes)
  */
 int Y_Pb_Pr_size()
 {
@@ -448,7 +508,7 @@ int Y_Pb_Pr_size()
 float getY(Y_Pb_Pr ypbpr)
 {
         assert(ypbpr != NULL);
-        return ypbpr->Y;
+        return from_fixed(ypbpr->Y);
 }
 
 /********** getPb ********
@@ -470,7 +530,7 @@ float getY(Y_Pb_Pr ypbpr)
 float getPb(Y_Pb_Pr ypbpr)
 {
         assert(ypbpr != NULL);
-        return ypbpr->Pb;
+        return from_fixed(ypbpr->Pb);
 }
 
 /********** getPr ********
@@ -492,7 +552,7 @@ float getPb(Y_Pb_Pr ypbpr)
 float getPr(Y_Pb_Pr ypbpr)
 {
         assert(ypbpr != NULL);
-        return ypbpr->Pr;
+        return from_fixed(ypbpr->Pr);
 }
 
 /********** setY ********
@@ -517,7 +577,7 @@ float getPr(Y_Pb_Pr ypbpr)
 void setY(Y_Pb_Pr ypbpr, float Y)
 {
         assert(ypbpr != NULL);
-        ypbpr->Y = Y;
+        ypbpr->Y = to_fixed(Y);
 }
 
 /********** setPb ********
@@ -542,7 +602,7 @@ void setY(Y_Pb_Pr ypbpr, float Y)
 void setPb(Y_Pb_Pr ypbpr, float Pb)
 {
         assert(ypbpr != NULL);
-        ypbpr->Pb = Pb;
+        ypbpr->Pb = to_fixed(Pb);
 }
 
 /********** setPr ********
@@ -567,5 +627,106 @@ void setPb(Y_Pb_Pr ypbpr, float Pb)
 void setPr(Y_Pb_Pr ypbpr, float Pr)
 {
         assert(ypbpr != NULL);
-        ypbpr->Pr = Pr;
-}
\ No newline at end of file
+        ypbpr->Pr = to_fixed(Pr);
+}
+
+
+/**********************************/
+/*       fixed-point helpers      */
+/**********************************/
+
+
+/********** to_fixed ********
+ * 
+ * Purpose: Converts a float into the 16-bit fixed-point representation used 
+ *          inside struct Y_Pb_Pr
+ *
+ * Parameters:
+ *      - val: the value to convert
+ *
+ * Return: val scaled by FIXED_SCALE, rounded to the nearest integer
+ *
+ * Expects: none
+ *
+ * CRE: none
+ *
+ * Notes:
+ *      - Values outside the representable range [-2, 2) are clamped
+ *      - Information is lost here due to rounding
+ */
+CPU_KERNEL int16_t to_fixed(float val)
+{
+        /* scaling by a power of two is exact in float and double alike */
+        double scaled = (double)val * FIXED_SCALE;
+
+        /* round half away from zero (no branch, so rows can vectorize) */
+        scaled += copysign(0.5, scaled);
+
+        /* clamp to the range of an int16_t */
+        scaled = scaled >= FIXED_MAX ? FIXED_MAX : 
+                 scaled <= FIXED_MIN ? FIXED_MIN : scaled;
+
+        return (int16_t)scaled;
+}
+
+/********** from_fixed ********
+ * 
+ * Purpose: Converts a 16-bit fixed-point value from struct Y_Pb_Pr back into 
+ *          a float
+ *
+ * Parameters:
+ *      - val: the fixed-point value
+ *
+ * Return: val divided by FIXED_SCALE
+ *
+ * Expects: none
+ *
+ * CRE: none
+ */
+static inline float from_fixed(int16_t val)
+{
+        return val / FIXED_SCALE;
+}
+
+/********** rgb_row_to_ypbpr_kernel ********
+ * 
+ * Purpose: Converts a row of RGB pixels to Y/Pb/Pr pixels
+ *
+ * Parameters:
+ *      - rgb: the row's RGB pixels
+ *      - ypbpr: where to store its Y/Pb/Pr pixels
+ *      - width: the number of pixels
+ *      - denominator: the image's maxval
+ *
+ * Return: none
+ *
+ * Expects: denominator is positive
+ *
+ * CRE: none (this is the conversion's inner loop)
+ *
+ * Notes:
+ *      - The same arithmetic as to_ypbpr_apply(), so the results are 
+ *        identical
+ *      - Called as CPU_DISPATCH(rgb_row_to_ypbpr) (cpu.h)
+ */
+CPU_KERNEL void rgb_row_to_ypbpr_kernel(const struct Pnm_rgb *rgb, 
+                                        struct Y_Pb_Pr *ypbpr, int width,
+                                        int denominator)
+{
+        for (int i = 0; i < width; i++) {
+                float r = (float)rgb[i].red / denominator;
+                float g = (float)rgb[i].green / denominator;
+                float b = (float)rgb[i].blue / denominator;
+                ypbpr[i].Y = to_fixed(0.299 * r + 0.587 * g + 0.114 * b);
+                ypbpr[i].Pb = to_fixed(-0.168736 * r - 0.331264 * g + 
+                                       0.5 * b);
+                ypbpr[i].Pr = to_fixed(0.5 * r - 0.418688 * g - 
+                                       0.081312 * b);
+        }
+}
+
+/* rgb_row_to_ypbpr_kernel() for each level of cpu.h */
+CPU_VARIANTS(rgb_row_to_ypbpr, (const struct Pnm_rgb *rgb, 
+                                struct Y_Pb_Pr *ypbpr, int width,
+                                int denominator), 
+             (rgb, ypbpr, width, denominator));
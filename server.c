@@ -0,0 +1,817 @@
+/**************************************************************
+ *
+ *                     server.c
+ *
+ *     Assignment: Arith
+ *     Authors:  Marielle Cibella (mcibel01), Erica Huang (ehuang02)
+ *     Date:     4/18/25
+ *
+ *     Summary:
+ *
+ *     server.c implements 40image's server mode (protocol in server.h).
+ *     The main thread accepts connections on a Unix domain socket and
+ *     queues them; a fixed pool of worker threads takes connections off
+ *     the queue and answers their requests with compress40_stream() and
+ *     decompress40_stream(), using in-memory streams for the payloads.
+ *     Every request's latency is recorded in a per-operation histogram
+ *     with power-of-two buckets, which clients can ask for and which is
+ *     printed to stderr when the server is stopped with SIGINT or SIGTERM.
+ *
+ *
+ **************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "assert.h"
+#include "except.h"
+#include "mem.h"
+#include "server.h"
+#include "codec.h"
+#include "read_write.h"
+#include "pool.h"
+#include "trace.h"
+
+/* number of accepted connections that can wait for a worker */
+#define QUEUE_SIZE 64
+
+/* histogram bucket i counts requests that took less than 2^i microseconds */
+#define NUM_BUCKETS 32
+
+/* length of a request or response header: op or status, then a length */
+#define HEADER_SIZE 9
+
+/* largest payload the server will read into memory (256 MiB) */
+static const uint64_t MAX_PAYLOAD = (uint64_t)1 << 28;
+
+/* the operations whose latencies are recorded */
+enum { COMPRESS, DECOMPRESS, NUM_OPS };
+
+/*
+ * struct latency_histogram records how long one kind of request took,
+ * in microseconds
+ */
+typedef struct latency_histogram {
+        const char *name;
+        long count;
+        double total_us;
+        double max_us;
+        long buckets[NUM_BUCKETS];
+} latency_histogram;
+
+/*
+ * struct server_state is shared by the accepting thread and the workers:
+ * a bounded queue of accepted connections and the latency histograms,
+ * each protected by its own lock
+ */
+typedef struct server_state {
+        int fds[QUEUE_SIZE];
+        int head;
+        int count;
+        bool closed;
+        pthread_mutex_t queue_lock;
+        pthread_cond_t not_empty;
+        pthread_cond_t not_full;
+
+        latency_histogram histograms[NUM_OPS];
+        pthread_mutex_t stats_lock;
+} server_state;
+
+/* set by the signal handler to stop accepting connections */
+static volatile sig_atomic_t stopping = 0;
+
+/* helper functions */
+static void *server_worker(void *cl);
+static void serve_connection(server_state *state, int fd);
+static bool serve_codec_request(server_state *state, int fd, char op,
+                                uint64_t length, int passed_fd);
+static bool read_request(int fd, char *op, uint64_t *length, int *passed_fd);
+static bool send_response(int fd, int status, const char *body,
+                          uint64_t length);
+static long input_size(FILE *input, uint64_t length);
+static bool read_fully(int fd, void *buffer, size_t nbytes);
+static bool write_fully(int fd, const void *buffer, size_t nbytes);
+static void queue_push(server_state *state, int fd);
+static int queue_pop(server_state *state);
+static void record_latency(server_state *state, int op, double us);
+static void print_stats(server_state *state, FILE *output);
+static void handle_signal(int signal);
+
+
+/********** run_server ********
+ *
+ * Purpose: Runs 40image's server mode until it receives SIGINT or SIGTERM
+ *
+ * Parameters:
+ *      - path: the file system path of the Unix domain socket to listen on
+ *      - nthreads: the number of worker threads, or 0 or less to use one
+ *                  per online processor
+ *
+ * Return: 0 if the server ran and was stopped, 1 if the socket couldn't
+ *         be set up
+ *
+ * Expects: none
+ *
+ * CRE: path is null, or a thread can't be created
+ *
+ * Notes:
+ *      - Any existing file at path is removed first, and the socket is
+ *        removed again when the server stops
+ *      - Stopping abandons requests still in progress and prints the
+ *        latency statistics to stderr
+ *      - A malformed image fails only its own request (status 1), and
+ *        the worker goes on serving
+ */
+int run_server(const char *path, int nthreads)
+{
+        assert(path != NULL);
+
+        struct sockaddr_un address;
+        if (strlen(path) >= sizeof(address.sun_path)) {
+                fprintf(stderr, "40image: socket path '%s' is too long\n",
+                        path);
+                return 1;
+        }
+        memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        strcpy(address.sun_path, path);
+
+        /* step 1 - set up the listening socket */
+        int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listener < 0) {
+                perror("40image: socket");
+                return 1;
+        }
+        unlink(path);
+        if (bind(listener, (struct sockaddr *)&address,
+                 sizeof(address)) < 0 || listen(listener, QUEUE_SIZE) < 0) {
+                perror("40image: bind");
+                close(listener);
+                return 1;
+        }
+
+        /* step 2 - signals stop the accept loop; dead clients don't */
+        struct sigaction action;
+        memset(&action, 0, sizeof(action));
+        action.sa_handler = handle_signal;
+        sigaction(SIGINT, &action, NULL);
+        sigaction(SIGTERM, &action, NULL);
+        signal(SIGPIPE, SIG_IGN);
+
+        /* step 3 - start the workers */
+        server_state *state;
+        NEW0(state);
+        assert(state != NULL);
+        pthread_mutex_init(&state->queue_lock, NULL);
+        pthread_cond_init(&state->not_empty, NULL);
+        pthread_cond_init(&state->not_full, NULL);
+        pthread_mutex_init(&state->stats_lock, NULL);
+        state->histograms[COMPRESS].name = "compress";
+        state->histograms[DECOMPRESS].name = "decompress";
+
+        if (nthreads <= 0) {
+                nthreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+        }
+        if (nthreads <= 0) {
+                nthreads = 1;
+        }
+        for (int i = 0; i < nthreads; i++) {
+                pthread_t thread;
+                int rc = pthread_create(&thread, NULL, server_worker, state);
+                assert(rc == 0);
+                pthread_detach(thread);
+        }
+
+        /* step 4 - hand connections to the workers until stopped */
+        while (!stopping) {
+                int fd = accept(listener, NULL, NULL);
+                if (fd < 0) {
+                        if (errno != EINTR) {
+                                perror("40image: accept");
+                        }
+                        continue;
+                }
+                queue_push(state, fd);
+        }
+
+        /* step 5 - report and clean up; workers die with the process */
+        close(listener);
+        unlink(path);
+        pthread_mutex_lock(&state->queue_lock);
+        state->closed = true;
+        pthread_cond_broadcast(&state->not_empty);
+        pthread_mutex_unlock(&state->queue_lock);
+        print_stats(state, stderr);
+
+        return 0;
+}
+
+
+/**************************/
+/*    Request handling    */
+/**************************/
+
+
+/********** server_worker ********
+ *
+ * Purpose: Thread body for the server's workers: serves connections from
+ *          the queue until the queue is closed
+ *
+ * Parameters:
+ *      - cl: the server_state shared by every worker
+ *
+ * Return: NULL
+ *
+ * Expects: none
+ *
+ * CRE: cl is null
+ *
+ * Notes:
+ *      - Each worker has its own buffer pool, reused across requests
+ */
+static void *server_worker(void *cl)
+{
+        server_state *state = cl;
+        assert(state != NULL);
+
+        Pool_T pool = Pool_new(0);
+        Pool_use(pool);
+        Trace_thread_name("server worker");
+
+        int fd;
+        while ((fd = queue_pop(state)) >= 0) {
+                serve_connection(state, fd);
+                close(fd);
+        }
+
+        Pool_use(NULL);
+        Pool_free(&pool);
+        return NULL;
+}
+
+/********** serve_connection ********
+ *
+ * Purpose: Answers requests on one connection until the client closes it
+ *          or sends something the server can't recover from
+ *
+ * Parameters:
+ *      - state: the server's shared state
+ *      - fd: the connected socket
+ *
+ * Return: none
+ *
+ * Expects: none
+ *
+ * CRE: state is null
+ */
+static void serve_connection(server_state *state, int fd)
+{
+        assert(state != NULL);
+
+        char op;
+        uint64_t length;
+        int passed_fd;
+        while (read_request(fd, &op, &length, &passed_fd)) {
+                if (op == 'c' || op == 'd') {
+                        if (!serve_codec_request(state, fd, op, length,
+                                                 passed_fd)) {
+                                return;
+                        }
+                        continue;
+                }
+
+                /* anything else carries no input */
+                if (passed_fd >= 0) {
+                        close(passed_fd);
+                }
+                if (op != 's' || length != 0) {
+                        const char *error = "unknown request";
+                        send_response(fd, 1, error, strlen(error));
+                        return;
+                }
+
+                char *report = NULL;
+                size_t report_size = 0;
+                FILE *output = open_memstream(&report, &report_size);
+                assert(output != NULL);
+                print_stats(state, output);
+                fclose(output);
+                bool sent = send_response(fd, 0, report, report_size);
+                free(report);
+                if (!sent) {
+                        return;
+                }
+        }
+}
+
+/********** serve_codec_request ********
+ *
+ * Purpose: Answers one compress or decompress request
+ *
+ * Parameters:
+ *      - state: the server's shared state
+ *      - fd: the connected socket, positioned at the request's payload
+ *      - op: 'c' to compress or 'd' to decompress
+ *      - length: the length of the inline payload, or 0
+ *      - passed_fd: a file descriptor sent with the request, or -1
+ *
+ * Return: true if the connection can carry more requests
+ *
+ * Expects: none
+ *
+ * CRE: state is null, or memory for the payload can't be allocated
+ *
+ * Notes:
+ *      - The latency recorded runs from the input being available to the
+ *        output being complete, and doesn't include socket transfers
+ *      - A payload over MAX_PAYLOAD is refused before anything is
+ *        allocated, and the connection is closed, since its bytes were
+ *        never read
+ *      - The header of an image to decompress is checked against the
+ *        size of its input (inline, or a passed regular file) with 
+ *        compressed_fits() before the codec allocates anything for it, 
+ *        so a few bytes can't ask for gigabytes; a passed pipe can't be
+ *        checked ahead, and its image is decoded as read
+ *      - Any exception the codec raises (a malformed image fails an
+ *        assertion or raises Pnm_Badformat) is caught here: the request gets
+ *        status 1 with the exception's reason, and only failed requests
+ *        go unrecorded in the histograms
+ */
+static bool serve_codec_request(server_state *state, int fd, char op,
+                                uint64_t length, int passed_fd)
+{
+        assert(state != NULL);
+
+        /* step 1 - open the input, inline or passed as a descriptor */
+        char *payload = NULL;
+        FILE *input = NULL;
+        if (length > 0) {
+                if (passed_fd >= 0) {
+                        close(passed_fd);
+                }
+                if (length > MAX_PAYLOAD) {
+                        const char *error = "payload too large";
+                        send_response(fd, 1, error, strlen(error));
+                        return false;
+                }
+                payload = ALLOC(length);
+                Trace_begin("read payload", "io");
+                bool complete = read_fully(fd, payload, length);
+                Trace_end("read payload", "io");
+                if (!complete) {
+                        FREE(payload);
+                        return false;
+                }
+                input = fmemopen(payload, length, "rb");
+        } else if (passed_fd >= 0) {
+                input = fdopen(passed_fd, "rb");
+        } else {
+                const char *error = "no input";
+                return send_response(fd, 1, error, strlen(error));
+        }
+        assert(input != NULL);
+
+        /* step 2 - run the codec into memory, timing it */
+        char *result = NULL;
+        size_t result_size = 0;
+        FILE *output = open_memstream(&result, &result_size);
+        assert(output != NULL);
+
+        struct timespec start, end;
+        const char *volatile failure = NULL;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        long available = input_size(input, length);
+        TRY
+                if (op == 'c') {
+                        compress40_stream(input, output);
+                } else if (available >= 0 && 
+                           !compressed_fits(input, available)) {
+                        failure = "compressed image is larger than its input";
+                } else {
+                        decompress40_stream(input, output);
+                }
+        ELSE
+                failure = Except_frame.exception->reason;
+        END_TRY;
+        fclose(output);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        fclose(input);
+        if (payload != NULL) {
+                FREE(payload);
+        }
+
+        if (failure != NULL) {
+                free(result);
+                return send_response(fd, 1, failure, strlen(failure));
+        }
+
+        double us = (end.tv_sec - start.tv_sec) * 1e6 +
+                    (end.tv_nsec - start.tv_nsec) / 1e3;
+        record_latency(state, op == 'c' ? COMPRESS : DECOMPRESS, us);
+        Trace_complete(op == 'c' ? "compress request" : 
+                       "decompress request", "server", &start, &end);
+
+        /* step 3 - send the result back */
+        Trace_begin("send response", "io");
+        bool sent = send_response(fd, 0, result, result_size);
+        Trace_end("send response", "io");
+        free(result);
+        return sent;
+}
+
+/********** read_request ********
+ *
+ * Purpose: Reads a request header, and any descriptor sent with it
+ *
+ * Parameters:
+ *      - fd: the connected socket
+ *      - op: where to store the request's op
+ *      - length: where to store the request's payload length
+ *      - passed_fd: where to store a descriptor sent with the request, or
+ *                   -1 if there was none
+ *
+ * Return: true if a whole header was read, false at end of file or error
+ *
+ * Expects: none
+ *
+ * CRE: op, length, or passed_fd is null
+ */
+static bool read_request(int fd, char *op, uint64_t *length, int *passed_fd)
+{
+        assert(op != NULL);
+        assert(length != NULL);
+        assert(passed_fd != NULL);
+        *passed_fd = -1;
+
+        /* the first byte carries any SCM_RIGHTS descriptor */
+        unsigned char header[HEADER_SIZE];
+        struct iovec iov = { header, 1 };
+        union {
+                char buffer[CMSG_SPACE(sizeof(int))];
+                struct cmsghdr align;
+        } control;
+        struct msghdr message;
+        memset(&message, 0, sizeof(message));
+        message.msg_iov = &iov;
+        message.msg_iovlen = 1;
+        message.msg_control = control.buffer;
+        message.msg_controllen = sizeof(control.buffer);
+
+        ssize_t n;
+        do {
+                n = recvmsg(fd, &message, 0);
+        } while (n < 0 && errno == EINTR);
+        if (n <= 0) {
+                return false;
+        }
+
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&message);
+        if (cmsg != NULL && cmsg->cmsg_level == SOL_SOCKET &&
+            cmsg->cmsg_type == SCM_RIGHTS) {
+                memcpy(passed_fd, CMSG_DATA(cmsg), sizeof(int));
+        }
+
+        /* the rest of the header is the big-endian length */
+        if (!read_fully(fd, header + 1, HEADER_SIZE - 1)) {
+                if (*passed_fd >= 0) {
+                        close(*passed_fd);
+                }
+                return false;
+        }
+        *op = header[0];
+        *length = 0;
+        for (int i = 1; i < HEADER_SIZE; i++) {
+                *length = (*length << 8) | header[i];
+        }
+
+        return true;
+}
+
+/********** send_response ********
+ *
+ * Purpose: Sends a response header and body
+ *
+ * Parameters:
+ *      - fd: the connected socket
+ *      - status: 0 for success, 1 for a bad request
+ *      - body: the body of the response
+ *      - length: the number of bytes in body
+ *
+ * Return: true if the whole response was sent
+ *
+ * Expects: body has length bytes (it may be null if length is 0)
+ *
+ * CRE: none
+ */
+static bool send_response(int fd, int status, const char *body,
+                          uint64_t length)
+{
+        unsigned char header[HEADER_SIZE];
+        header[0] = status;
+        uint64_t remaining = length;
+        for (int i = HEADER_SIZE - 1; i >= 1; i--) {
+                header[i] = remaining & 0xff;
+                remaining >>= 8;
+        }
+
+        return write_fully(fd, header, HEADER_SIZE) &&
+               (length == 0 || write_fully(fd, body, length));
+}
+
+/********** input_size ********
+ *
+ * Purpose: Gives the number of bytes a request's input holds
+ *
+ * Parameters:
+ *      - input: the input, opened on the payload or the passed descriptor
+ *      - length: the length of the inline payload, or 0
+ *
+ * Return: length for an inline payload, the bytes left in a passed 
+ *         regular file, or -1 if the size isn't known (a pipe or socket)
+ *
+ * Expects: none
+ *
+ * CRE: input is null
+ */
+static long input_size(FILE *input, uint64_t length)
+{
+        assert(input != NULL);
+        if (length > 0) {
+                return length;
+        }
+
+        struct stat info;
+        off_t position = ftello(input);
+        if (position < 0 || fstat(fileno(input), &info) != 0 || 
+            !S_ISREG(info.st_mode) || info.st_size < position) {
+                return -1;
+        }
+        return info.st_size - position;
+}
+
+/********** read_fully ********
+ *
+ * Purpose: Reads exactly nbytes from a descriptor
+ *
+ * Parameters:
+ *      - fd: the descriptor to read from
+ *      - buffer: where to store the bytes
+ *      - nbytes: the number of bytes to read
+ *
+ * Return: true if all nbytes were read, false at end of file or error
+ *
+ * Expects: buffer has room for nbytes
+ *
+ * CRE: none
+ */
+static bool read_fully(int fd, void *buffer, size_t nbytes)
+{
+        char *next = buffer;
+        while (nbytes > 0) {
+                ssize_t n = read(fd, next, nbytes);
+                if (n < 0 && errno == EINTR) {
+                        continue;
+                }
+                if (n <= 0) {
+                        return false;
+                }
+                next += n;
+                nbytes -= n;
+        }
+        return true;
+}
+
+/********** write_fully ********
+ *
+ * Purpose: Writes exactly nbytes to a descriptor
+ *
+ * Parameters:
+ *      - fd: the descriptor to write to
+ *      - buffer: the bytes to write
+ *      - nbytes: the number of bytes to write
+ *
+ * Return: true if all nbytes were written
+ *
+ * Expects: none
+ *
+ * CRE: none
+ */
+static bool write_fully(int fd, const void *buffer, size_t nbytes)
+{
+        const char *next = buffer;
+        while (nbytes > 0) {
+                ssize_t n = write(fd, next, nbytes);
+                if (n < 0 && errno == EINTR) {
+                        continue;
+                }
+                if (n <= 0) {
+                        return false;
+                }
+                next += n;
+                nbytes -= n;
+        }
+        return true;
+}
+
+
+/**************************/
+/*   Connection queue     */
+/**************************/
+
+
+/********** queue_push ********
+ *
+ * Purpose: Adds an accepted connection to the queue, waiting for room
+ *
+ * Parameters:
+ *      - state: the server's shared state
+ *      - fd: the connected socket
+ *
+ * Return: none
+ *
+ * Expects: none
+ *
+ * CRE: state is null
+ */
+static void queue_push(server_state *state, int fd)
+{
+        assert(state != NULL);
+
+        pthread_mutex_lock(&state->queue_lock);
+        while (state->count == QUEUE_SIZE) {
+                pthread_cond_wait(&state->not_full, &state->queue_lock);
+        }
+        state->fds[(state->head + state->count) % QUEUE_SIZE] = fd;
+        state->count++;
+        pthread_cond_signal(&state->not_empty);
+        pthread_mutex_unlock(&state->queue_lock);
+}
+
+/********** queue_pop ********
+ *
+ * Purpose: Takes the oldest connection off the queue, waiting for one
+ *
+ * Parameters:
+ *      - state: the server's shared state
+ *
+ * Return: the connected socket, or -1 once the queue is closed
+ *
+ * Expects: none
+ *
+ * CRE: state is null
+ */
+static int queue_pop(server_state *state)
+{
+        assert(state != NULL);
+
+        pthread_mutex_lock(&state->queue_lock);
+        while (state->count == 0 && !state->closed) {
+                pthread_cond_wait(&state->not_empty, &state->queue_lock);
+        }
+        int fd = -1;
+        if (state->count > 0) {
+                fd = state->fds[state->head];
+                state->head = (state->head + 1) % QUEUE_SIZE;
+                state->count--;
+                pthread_cond_signal(&state->not_full);
+        }
+        pthread_mutex_unlock(&state->queue_lock);
+
+        return fd;
+}
+
+
+/**************************/
+/*   Latency statistics   */
+/**************************/
+
+
+/********** record_latency ********
+ *
+ * Purpose: Adds one request's latency to its operation's histogram
+ *
+ * Parameters:
+ *      - state: the server's shared state
+ *      - op: COMPRESS or DECOMPRESS
+ *      - us: how long the request took, in microseconds
+ *
+ * Return: none
+ *
+ * Expects: none
+ *
+ * CRE: state is null, or op is out of range
+ */
+static void record_latency(server_state *state, int op, double us)
+{
+        assert(state != NULL);
+        assert(op >= 0 && op < NUM_OPS);
+
+        /* find the first bucket whose limit is above us */
+        int bucket = 0;
+        while (bucket < NUM_BUCKETS - 1 && us >= (double)(1L << bucket)) {
+                bucket++;
+        }
+
+        pthread_mutex_lock(&state->stats_lock);
+        latency_histogram *histogram = &state->histograms[op];
+        histogram->count++;
+        histogram->total_us += us;
+        if (us > histogram->max_us) {
+                histogram->max_us = us;
+        }
+        histogram->buckets[bucket]++;
+        pthread_mutex_unlock(&state->stats_lock);
+}
+
+/********** print_stats ********
+ *
+ * Purpose: Prints every operation's latency histogram
+ *
+ * Parameters:
+ *      - state: the server's shared state
+ *      - output: where to print the statistics
+ *
+ * Return: none
+ *
+ * Expects: none
+ *
+ * CRE: state is null, or output is null
+ *
+ * Notes:
+ *      - Percentiles are the upper limit of the bucket they fall in, so
+ *        they overestimate by at most a factor of two
+ */
+static void print_stats(server_state *state, FILE *output)
+{
+        assert(state != NULL);
+        assert(output != NULL);
+
+        static const double percentiles[] = { 0.50, 0.90, 0.99 };
+
+        pthread_mutex_lock(&state->stats_lock);
+        for (int op = 0; op < NUM_OPS; op++) {
+                latency_histogram *histogram = &state->histograms[op];
+                fprintf(output, "%s: %ld requests", histogram->name,
+                        histogram->count);
+                if (histogram->count == 0) {
+                        fprintf(output, "\n");
+                        continue;
+                }
+                fprintf(output, ", mean %.0f us, max %.0f us",
+                        histogram->total_us / histogram->count,
+                        histogram->max_us);
+
+                /* percentiles from the cumulative bucket counts */
+                for (int p = 0; p < 3; p++) {
+                        long seen = 0;
+                        int bucket = 0;
+                        while (seen + histogram->buckets[bucket] <
+                               percentiles[p] * histogram->count) {
+                                seen += histogram->buckets[bucket];
+                                bucket++;
+                        }
+                        fprintf(output, ", p%.0f < %ld us",
+                                percentiles[p] * 100, 1L << bucket);
+                }
+                fprintf(output, "\n");
+
+                for (int bucket = 0; bucket < NUM_BUCKETS; bucket++) {
+                        if (histogram->buckets[bucket] != 0) {
+                                fprintf(output, "  < %10ld us: %ld\n",
+                                        1L << bucket,
+                                        histogram->buckets[bucket]);
+                        }
+                }
+        }
+        pthread_mutex_unlock(&state->stats_lock);
+}
+
+/********** handle_signal ********
+ *
+ * Purpose: Signal handler for SIGINT and SIGTERM: stops the accept loop
+ *
+ * Parameters:
+ *      - signal: the signal received
+ *
+ * Return: none
+ *
+ * Expects: none
+ *
+ * CRE: none
+ */
+static void handle_signal(int signal)
+{
+        (void)signal;
+        stopping = 1;
+}
@@ -0,0 +1,42 @@
+/**************************************************************
+ *
+ *                     server.h
+ *
+ *     Assignment: Arith
+ *     Authors:  Marielle Cibella (mcibel01), Erica Huang (ehuang02)
+ *     Date:     4/18/25
+ *
+ *     Summary:
+ *
+ *     This header file declares 40image's server mode: a long-running
+ *     process that listens on a Unix domain socket and compresses or
+ *     decompresses images for its clients on a fixed pool of worker
+ *     threads.
+ *
+ *     Protocol (all integers big-endian). A connection carries any number
+ *     of requests, one after another:
+ *
+ *         request:  1 byte op, 8 byte payload length N, N payload bytes
+ *         response: 1 byte status, 8 byte length M, M bytes
+ *
+ *     op is 'c' (compress), 'd' (decompress) or 's' (report latency
+ *     statistics). For 'c' and 'd' the payload is the input image; if N
+ *     is 0 the input is instead read from a file descriptor sent with
+ *     SCM_RIGHTS along with the request's first byte. status is 0 on
+ *     success, with the output image (or statistics text) as the body,
+ *     and 1 on a bad request, with an error message as the body. A bad
+ *     image fails only its own request, and an image to decompress 
+ *     whose header promises more than its input holds is refused before
+ *     anything is allocated for it. A payload over 256 MiB is
+ *     refused and the connection closed; larger images can still be
+ *     passed as a descriptor.
+ *
+ *
+ **************************************************************/
+
+#ifndef SERVER
+#define SERVER
+
+int run_server(const char *path, int nthreads);
+
+#endif
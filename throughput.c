@@ -0,0 +1,637 @@
+/**************************************************************
+ *
+ *                     throughput.c
+ *
+ *     Assignment: Arith
+ *     Authors:  Marielle Cibella (mcibel01), Erica Huang (ehuang02)
+ *     Date:     4/24/25
+ *
+ *     Summary:
+ *
+ *     throughput.c measures the whole codec at production sizes. For
+ *     each size and class of content (smooth gradients, noise, flat
+ *     regions, and photo-like texture) it generates a synthetic PPM in
+ *     memory, then runs compress40_stream() and decompress40_stream() on
+ *     it in-process, through memory streams, so no disk is involved. It
+ *     prints the megapixels per second of each direction (the median of
+ *     several round trips), the peak resident memory of a round trip, the
+ *     bits per pixel of the compressed image, and the RMSD of the round
+ *     trip, computed as ppmdiff does. Every image is a function of its
+ *     class, size, and pixel position only, so runs are repeatable.
+ *
+ *     Usage: throughput [-r runs] [-k class,...] [size...]
+ *            a size is N (for NxN) or WxH, from 64 to 16384
+ *
+ *
+ **************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <time.h>
+#include <sys/resource.h>
+#include "assert.h"
+#include "codec.h"
+
+/* the sizes run when none are given (16384x16384 must be asked for) */
+static const unsigned DEFAULT_SIZES[] = { 64, 256, 1024, 4096 };
+#define NUM_DEFAULT_SIZES 4
+
+/* the classes of synthetic content */
+enum synth_class {
+        SYNTH_GRADIENT,   /* smooth ramps in each channel */
+        SYNTH_NOISE,      /* every sample independent */
+        SYNTH_FLAT,       /* large flat rectangles of a few colours */
+        SYNTH_PHOTO,      /* waves, edges, and grain, like a photograph */
+        NUM_CLASSES
+};
+
+static const char *const CLASS_NAMES[NUM_CLASSES] = {
+        "gradient", "noise", "flat", "photo"
+};
+
+/*
+ * struct round_trip is what one image's round trips measured: the median
+ * seconds of each direction, the peak resident bytes of a round trip, the
+ * compressed bytes, and the RMSD of the decompressed image
+ */
+typedef struct round_trip {
+        double compress_seconds;
+        double decompress_seconds;
+        long peak_bytes;
+        size_t compressed_bytes;
+        double rmsd;
+} round_trip;
+
+/* helper functions */
+static void run_image(enum synth_class class, unsigned width,
+                      unsigned height, int runs, round_trip *result);
+static char *synth_ppm(enum synth_class class, unsigned width,
+                       unsigned height, size_t *length);
+static void synth_pixel(enum synth_class class, unsigned col, unsigned row,
+                        unsigned width, unsigned height,
+                        unsigned char *rgb);
+static uint32_t hash(uint32_t x, uint32_t y, uint32_t salt);
+static double ppm_rmsd(const char *ppm, size_t length,
+                       enum synth_class class, unsigned width,
+                       unsigned height);
+static const char *ppm_header(const char *ppm, size_t length,
+                              unsigned *fields);
+static void reset_peak(void);
+static long peak_bytes(void);
+static double now_seconds(void);
+static int compare_doubles(const void *a, const void *b);
+static int compare_sizes(const void *a, const void *b);
+static void usage(const char *progname);
+
+/********** main ********
+ *
+ * Purpose: Runs the round trips for each size and class asked for and
+ *          prints a line for each
+ *
+ * Parameters:
+ *     - argc: the number of command-line arguments
+ *     - argv: throughput [-r runs] [-k class,...] [size...]
+ *
+ * Return: EXIT_SUCCESS, or EXIT_FAILURE for bad arguments
+ *
+ * Expects: none
+ *
+ * Notes:
+ *     - 3 runs of every class at 64, 256, 1024, and 4096 square by
+ *       default. Sizes run smallest first, so memory kept by the codec's
+ *       pool (pool.h) for one size never shows up in a smaller one's peak
+ */
+int main(int argc, char *argv[])
+{
+        int runs = 3;
+        bool classes[NUM_CLASSES] = { true, true, true, true };
+
+        int i = 1;
+        for (; i < argc && argv[i][0] == '-'; i++) {
+                if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+                        runs = atoi(argv[++i]);
+                } else if (strcmp(argv[i], "-k") == 0 && i + 1 < argc) {
+                        const char *list = argv[++i];
+                        memset(classes, 0, sizeof(classes));
+                        while (*list != '\0') {
+                                size_t length = strcspn(list, ",");
+                                int c = 0;
+                                while (c < NUM_CLASSES &&
+                                       (strlen(CLASS_NAMES[c]) != length ||
+                                        strncmp(list, CLASS_NAMES[c],
+                                                length) != 0)) {
+                                        c++;
+                                }
+                                if (c == NUM_CLASSES) {
+                                        usage(argv[0]);
+                                }
+                                classes[c] = true;
+                                list += length + (list[length] == ',');
+                        }
+                } else {
+                        usage(argv[0]);
+                }
+        }
+        if (runs <= 0) {
+                usage(argv[0]);
+        }
+
+        int nsizes = argc - i;
+        unsigned (*sizes)[2] = malloc((nsizes + NUM_DEFAULT_SIZES) *
+                                      sizeof(*sizes));
+        assert(sizes != NULL);
+        for (int s = 0; s < nsizes; s++) {
+                int got = sscanf(argv[i + s], "%ux%u", &sizes[s][0],
+                                 &sizes[s][1]);
+                if (got == 1) {
+                        sizes[s][1] = sizes[s][0];
+                }
+                if (got < 1 || sizes[s][0] < 64 || sizes[s][1] < 64 ||
+                    sizes[s][0] > 16384 || sizes[s][1] > 16384) {
+                        usage(argv[0]);
+                }
+        }
+        if (nsizes == 0) {
+                for (int s = 0; s < NUM_DEFAULT_SIZES; s++) {
+                        sizes[s][0] = sizes[s][1] = DEFAULT_SIZES[s];
+                }
+                nsizes = NUM_DEFAULT_SIZES;
+        }
+        qsort(sizes, nsizes, sizeof(*sizes), compare_sizes);
+
+        printf("%-9s %11s %12s %12s %9s %7s %7s\n", "class", "size",
+               "comp MP/s", "decomp MP/s", "peak MB", "bpp", "rmsd");
+        for (int s = 0; s < nsizes; s++) {
+                for (int c = 0; c < NUM_CLASSES; c++) {
+                        if (!classes[c]) {
+                                continue;
+                        }
+                        unsigned width = sizes[s][0];
+                        unsigned height = sizes[s][1];
+                        round_trip result;
+                        run_image(c, width, height, runs, &result);
+
+                        double megapixels = width * (double)height / 1e6;
+                        char size[32];
+                        snprintf(size, sizeof(size), "%ux%u", width,
+                                 height);
+                        printf("%-9s %11s %12.2f %12.2f %9.1f %7.3f "
+                               "%7.4f\n", CLASS_NAMES[c], size,
+                               megapixels / result.compress_seconds,
+                               megapixels / result.decompress_seconds,
+                               result.peak_bytes / 1048576.0,
+                               result.compressed_bytes * 8.0 /
+                               (megapixels * 1e6), result.rmsd);
+                        fflush(stdout);
+                }
+        }
+
+        free(sizes);
+        return EXIT_SUCCESS;
+}
+
+/**************************/
+/*    Helper functions    */
+/**************************/
+
+
+/********** run_image ********
+ *
+ * Purpose: Generates one image and measures its round trips
+ *
+ * Parameters:
+ *     - class: the content
+ *     - width, height: the size
+ *     - runs: the round trips to time
+ *     - result: where to store the measurements
+ *
+ * Return: none
+ *
+ * Expects: none
+ *
+ * CRE: result is null, a memory stream can't be opened, or memory can't
+ *      be allocated
+ *
+ * Notes:
+ *     - The peak covers the generated image too, since it is resident for
+ *       the whole round trip, as an input file's pages would be
+ */
+static void run_image(enum synth_class class, unsigned width,
+                      unsigned height, int runs, round_trip *result)
+{
+        assert(result != NULL);
+
+        size_t length;
+        char *ppm = synth_ppm(class, width, height, &length);
+
+        double *compress = malloc(runs * sizeof(double));
+        double *decompress = malloc(runs * sizeof(double));
+        assert(compress != NULL && decompress != NULL);
+        result->peak_bytes = 0;
+
+        for (int r = 0; r < runs; r++) {
+                reset_peak();
+
+                char *compressed = NULL;
+                size_t compressed_length = 0;
+                FILE *input = fmemopen(ppm, length, "rb");
+                FILE *output = open_memstream(&compressed,
+                                              &compressed_length);
+                assert(input != NULL && output != NULL);
+                double start = now_seconds();
+                compress40_stream(input, output);
+                fclose(output);
+                compress[r] = now_seconds() - start;
+                fclose(input);
+
+                char *decompressed = NULL;
+                size_t decompressed_length = 0;
+                input = fmemopen(compressed, compressed_length, "rb");
+                output = open_memstream(&decompressed,
+                                        &decompressed_length);
+                assert(input != NULL && output != NULL);
+                start = now_seconds();
+                decompress40_stream(input, output);
+                fclose(output);
+                decompress[r] = now_seconds() - start;
+                fclose(input);
+
+                long peak = peak_bytes();
+                if (peak > result->peak_bytes) {
+                        result->peak_bytes = peak;
+                }
+                if (r == 0) {
+                        result->compressed_bytes = compressed_length;
+                        result->rmsd = ppm_rmsd(decompressed,
+                                                decompressed_length, class,
+                                                width, height);
+                }
+                free(compressed);
+                free(decompressed);
+        }
+
+        qsort(compress, runs, sizeof(double), compare_doubles);
+        qsort(decompress, runs, sizeof(double), compare_doubles);
+        result->compress_seconds = compress[runs / 2];
+        result->decompress_seconds = decompress[runs / 2];
+
+        free(compress);
+        free(decompress);
+        free(ppm);
+}
+
+/********** synth_ppm ********
+ *
+ * Purpose: Writes a synthetic image as a raw ("P6") PPM in memory
+ *
+ * Parameters:
+ *     - class: the content
+ *     - width, height: the size
+ *     - length: where to store the PPM's length in bytes
+ *
+ * Return: the PPM, which the caller frees with free()
+ *
+ * Expects: none
+ *
+ * CRE: length is null, or memory can't be allocated
+ */
+static char *synth_ppm(enum synth_class class, unsigned width,
+                       unsigned height, size_t *length)
+{
+        assert(length != NULL);
+
+        char header[64];
+        int header_length = snprintf(header, sizeof(header),
+                                     "P6\n%u %u\n255\n", width, height);
+        *length = header_length + 3 * (size_t)width * height;
+        char *ppm = malloc(*length);
+        assert(ppm != NULL);
+        memcpy(ppm, header, header_length);
+
+        unsigned char *rgb = (unsigned char *)ppm + header_length;
+        for (unsigned row = 0; row < height; row++) {
+                for (unsigned col = 0; col < width; col++) {
+                        synth_pixel(class, col, row, width, height, rgb);
+                        rgb += 3;
+                }
+        }
+        return ppm;
+}
+
+/********** synth_pixel ********
+ *
+ * Purpose: Gives one pixel of a synthetic image
+ *
+ * Parameters:
+ *     - class: the content
+ *     - col, row: the pixel
+ *     - width, height: the image's size
+ *     - rgb: where to store the red, green, and blue values, 0 to 255
+ *
+ * Return: none
+ *
+ * Expects: none
+ *
+ * Notes:
+ *     - Features are sized in proportion to the image, so every size of
+ *       a class is the same picture at a different resolution, apart from
+ *       the noise and grain, which are per pixel
+ */
+static void synth_pixel(enum synth_class class, unsigned col, unsigned row,
+                        unsigned width, unsigned height,
+                        unsigned char *rgb)
+{
+        double x = (col + 0.5) / width;
+        double y = (row + 0.5) / height;
+        uint32_t noise = hash(col, row, class);
+
+        switch (class) {
+        case SYNTH_GRADIENT:
+                rgb[0] = 255 * x;
+                rgb[1] = 255 * y;
+                rgb[2] = 255 * (1 - (x + y) / 2);
+                break;
+        case SYNTH_NOISE:
+                rgb[0] = noise;
+                rgb[1] = noise >> 8;
+                rgb[2] = noise >> 16;
+                break;
+        case SYNTH_FLAT: {
+                /* a few colours in an 8x8 grid of rectangles */
+                uint32_t cell = hash(x * 8, y * 8, NUM_CLASSES) % 4;
+                static const unsigned char colours[4][3] = {
+                        { 240, 240, 235 }, { 30, 60, 120 },
+                        { 200, 40, 40 }, { 90, 160, 70 }
+                };
+                memcpy(rgb, colours[cell], 3);
+                break;
+        }
+        default: {
+                /* soft waves, a hard-edged disc, and a little grain */
+                double wave = 0.5 + 0.25 * sin(x * 13.0 + y * 5.0) +
+                              0.15 * sin(x * 41.0 - y * 29.0);
+                double dx = x - 0.6, dy = y - 0.4;
+                bool disc = dx * dx + dy * dy < 0.04;
+                double grain = ((int)(noise & 31) - 16) / 255.0;
+                double shade[3] = { wave, wave * 0.8 + 0.1 * y,
+                                    0.6 - wave * 0.4 };
+                for (int c = 0; c < 3; c++) {
+                        double value = (disc ? 1 - shade[c] : shade[c]) +
+                                       grain;
+                        value = value < 0 ? 0 : value > 1 ? 1 : value;
+                        rgb[c] = 255 * value;
+                }
+                break;
+        }
+        }
+}
+
+/********** hash ********
+ *
+ * Purpose: Mixes a position into pseudo-random bits
+ *
+ * Parameters:
+ *     - x, y: the position
+ *     - salt: makes different uses give different bits
+ *
+ * Return: 32 bits that look random and depend only on the arguments
+ *
+ * Expects: none
+ */
+static uint32_t hash(uint32_t x, uint32_t y, uint32_t salt)
+{
+        uint32_t h = x * 0x9E3779B1u ^ y * 0x85EBCA77u ^ salt * 0xC2B2AE3Du;
+        h ^= h >> 15;
+        h *= 0x2C1B3C6Du;
+        h ^= h >> 12;
+        h *= 0x297A2D39u;
+        h ^= h >> 15;
+        return h;
+}
+
+/********** ppm_rmsd ********
+ *
+ * Purpose: Computes the RMSD of a decompressed image against the
+ *          synthetic image it came from, as ppmdiff does
+ *
+ * Parameters:
+ *     - ppm, length: the decompressed image, a raw PPM
+ *     - class, width, height: the synthetic image
+ *
+ * Return: the RMSD over the decompressed image's pixels
+ *
+ * Expects: none
+ *
+ * CRE: the decompressed image isn't a raw PPM with 1-byte samples, is
+ *      larger than the synthetic image, or ends early
+ *
+ * Notes:
+ *     - The original pixels are generated again rather than kept
+ */
+static double ppm_rmsd(const char *ppm, size_t length,
+                       enum synth_class class, unsigned width,
+                       unsigned height)
+{
+        unsigned fields[3];
+        const char *data = ppm_header(ppm, length, fields);
+        unsigned out_width = fields[0], out_height = fields[1];
+        double denominator = fields[2];
+        assert(denominator > 0 && denominator <= 255);
+        assert(out_width <= width && out_height <= height);
+        assert((size_t)(data - ppm) + 3 * (size_t)out_width * out_height <=
+               length);
+
+        const unsigned char *decoded = (const unsigned char *)data;
+        double total = 0.0;
+        for (unsigned row = 0; row < out_height; row++) {
+                for (unsigned col = 0; col < out_width; col++) {
+                        unsigned char rgb[3];
+                        synth_pixel(class, col, row, width, height, rgb);
+                        for (int c = 0; c < 3; c++) {
+                                double diff = rgb[c] / 255.0 -
+                                              *decoded++ / denominator;
+                                total += diff * diff;
+                        }
+                }
+        }
+        return sqrt(total / (3.0 * out_width * out_height));
+}
+
+/********** ppm_header ********
+ *
+ * Purpose: Reads the header of a raw PPM in memory
+ *
+ * Parameters:
+ *     - ppm, length: the image
+ *     - fields: where to store the width, height, and denominator
+ *
+ * Return: the first byte of the pixels
+ *
+ * Expects: none
+ *
+ * CRE: the header is malformed or runs past length
+ */
+static const char *ppm_header(const char *ppm, size_t length,
+                              unsigned *fields)
+{
+        assert(length > 2 && ppm[0] == 'P' && ppm[1] == '6');
+        const char *end = ppm + length;
+        const char *p = ppm + 2;
+        for (int f = 0; f < 3; f++) {
+                while (p < end && (isspace((unsigned char)*p) ||
+                                   *p == '#')) {
+                        if (*p == '#') {
+                                while (p < end && *p != '\n') {
+                                        p++;
+                                }
+                        } else {
+                                p++;
+                        }
+                }
+                assert(p < end && isdigit((unsigned char)*p));
+                fields[f] = 0;
+                while (p < end && isdigit((unsigned char)*p)) {
+                        fields[f] = fields[f] * 10 + (*p++ - '0');
+                }
+        }
+        assert(p < end && isspace((unsigned char)*p));
+        return p + 1;
+}
+
+/********** reset_peak ********
+ *
+ * Purpose: Starts measuring peak resident memory again from now
+ *
+ * Parameters: none
+ *
+ * Return: none
+ *
+ * Expects: none
+ *
+ * Notes:
+ *     - Writing 5 to /proc/self/clear_refs resets the kernel's high-water
+ *       mark (Linux 4.0 and later). Where that fails, peak_bytes() falls
+ *       back to the peak of the whole process
+ */
+static void reset_peak(void)
+{
+        FILE *file = fopen("/proc/self/clear_refs", "w");
+        if (file != NULL) {
+                fputs("5", file);
+                fclose(file);
+        }
+}
+
+/********** peak_bytes ********
+ *
+ * Purpose: Gives the peak resident memory since reset_peak()
+ *
+ * Parameters: none
+ *
+ * Return: the peak, in bytes
+ *
+ * Expects: none
+ *
+ * Notes:
+ *     - Read from VmHWM in /proc/self/status, or if that can't be read,
+ *       from getrusage(), which never resets
+ */
+static long peak_bytes(void)
+{
+        FILE *file = fopen("/proc/self/status", "r");
+        if (file != NULL) {
+                char line[256];
+                long kilobytes;
+                while (fgets(line, sizeof(line), file) != NULL) {
+                        if (sscanf(line, "VmHWM: %ld kB", &kilobytes) == 1) {
+                                fclose(file);
+                                return kilobytes * 1024;
+                        }
+                }
+                fclose(file);
+        }
+
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return usage.ru_maxrss * 1024L;
+}
+
+/********** now_seconds ********
+ *
+ * Purpose: Reads the monotonic clock
+ *
+ * Parameters: none
+ *
+ * Return: the time in seconds
+ *
+ * Expects: none
+ */
+static double now_seconds(void)
+{
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/********** compare_doubles ********
+ *
+ * Purpose: Orders doubles for qsort()
+ *
+ * Parameters:
+ *     - a, b: the doubles
+ *
+ * Return: negative, zero, or positive as *a is less than, equal to, or
+ *         more than *b
+ *
+ * Expects: none
+ */
+static int compare_doubles(const void *a, const void *b)
+{
+        double x = *(const double *)a;
+        double y = *(const double *)b;
+        return (x > y) - (x < y);
+}
+
+/********** compare_sizes ********
+ *
+ * Purpose: Orders sizes by their number of pixels for qsort()
+ *
+ * Parameters:
+ *     - a, b: the sizes, each a width and a height
+ *
+ * Return: negative, zero, or positive as *a has fewer, as many, or more
+ *         pixels than *b
+ *
+ * Expects: none
+ */
+static int compare_sizes(const void *a, const void *b)
+{
+        const unsigned *x = a;
+        const unsigned *y = b;
+        uint64_t x_pixels = (uint64_t)x[0] * x[1];
+        uint64_t y_pixels = (uint64_t)y[0] * y[1];
+        return (x_pixels > y_pixels) - (x_pixels < y_pixels);
+}
+
+/********** usage ********
+ *
+ * Purpose: Prints how to run throughput and exits
+ *
+ * Parameters:
+ *     - progname: the name throughput was run as
+ *
+ * Return: none (exits with EXIT_FAILURE)
+ *
+ * Expects: none
+ */
+static void usage(const char *progname)
+{
+        fprintf(stderr, "Usage: %s [-r runs] [-k class,...] [size...]\n"
+                "       classes: gradient, noise, flat, photo\n"
+                "       a size is N or WxH, from 64 to 16384\n", progname);
+        exit(EXIT_FAILURE);
+}
@@ -0,0 +1,568 @@
+/**************************************************************
+ *
+ *                     timing.c
+ *
+ *     Assignment: Arith
+ *     Authors:  Marielle Cibella (mcibel01), Erica Huang (ehuang02)
+ *     Date:     4/24/25
+ *
+ *     Summary:
+ *
+ *     timing.c implements the per-step timing declared in timing.h. A
+ *     Timing_T remembers when the last step ended, so each Timing_step()
+ *     reads the clock once. The report is built in memory and written in
+ *     one go, so the reports of batch and server workers timing images at
+ *     the same time don't interleave. COMP40_STATS set to nothing, "1", or
+ *     "-" reports to stderr; anything else is a file the reports are 
+ *     appended to.
+ *
+ *     Each step also gets hardware counts (cycles, instructions, last-level
+ *     cache misses, and branch misses) from a perf_event_open() group on 
+ *     the calling thread, read once per step. Where the counters can't be
+ *     opened (not Linux, perf_event_paranoid, a container, a virtual 
+ *     machine without a PMU), the report says so and shows "-" instead.
+ *
+ *     Each step's memory is reported too: the bytes and allocations it
+ *     took from the thread's buffer pool (pool.h), where every per-image
+ *     array comes from, and how much the pool held when it ended. Those
+ *     are the thread's own and exact, since the pool never frees within
+ *     an image. Allocations made straight from malloc() (CII's Mem, 
+ *     netpbm, the pool's own chunks) are not counted per step. The only
+ *     heap figure is a sample of the whole process's malloc() heap, taken
+ *     as each step ends: it includes every other thread's memory, and a
+ *     buffer malloc()ed and freed inside a step never shows. The
+ *     operation's line gives the pool's peak and the largest sample.
+ *
+ *     With COMP40_TRACE set (trace.h), each step and each operation is
+ *     also recorded on the calling thread's timeline, from the same clock
+ *     readings. Tracing alone doesn't report, open counters, or sample
+ *     the heap.
+ *
+ *
+ **************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <malloc.h>
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+#include "assert.h"
+#include "mem.h"
+#include "pool.h"
+#include "timing.h"
+#include "trace.h"
+
+/* the most steps one operation reports */
+#define MAX_STEPS 12
+
+/* steps quicker than this, in seconds, get no pixels per second */
+#define MIN_RATED 1e-5
+
+/* the hardware counters each step reads */
+enum counter { 
+        CYCLES, INSTRUCTIONS, LLC_MISSES, BRANCH_MISSES, NUM_COUNTERS 
+};
+
+/*
+ * one timed step: its name, seconds, bytes in and out (-1 unknown), 
+ * hardware counts (-1 unknown), the bytes and allocations it took from
+ * the pool, the bytes the pool held when it ended, and the process's 
+ * malloc() heap sampled then (-1 unknown)
+ */
+struct step {
+        const char *name;
+        double seconds;
+        long bytes_in, bytes_out;
+        double counts[NUM_COUNTERS];
+        long pool_bytes, pool_allocations;
+        long pool_held, process_heap;
+};
+
+/*
+ * struct Timing_T is one operation being timed: its name, when it started
+ * and when its last step ended, and the steps so far. group is the 
+ * counter group's leader (-1 without counters); slot[c] is counter c's 
+ * place in a read of the group (-1 if it couldn't be opened), and last 
+ * the counts when the last step ended. pool is the pool's statistics 
+ * when the last step ended. report is whether COMP40_STATS asked for a
+ * report, rather than only COMP40_TRACE for a trace.
+ */
+struct Timing_T {
+        const char *operation;
+        struct timespec start, last;
+        struct step steps[MAX_STEPS];
+        int nsteps;
+        struct Pool_stats pool;
+        bool report;
+
+        int group;
+        int fds[NUM_COUNTERS];
+        int slot[NUM_COUNTERS];
+        double last_counts[NUM_COUNTERS];
+};
+
+/* helper functions */
+static double seconds_between(const struct timespec *from, 
+                              const struct timespec *to);
+static void print_bytes(FILE *output, const char *label, long bytes);
+static void print_count(FILE *output, double count);
+static void open_counters(Timing_T timing);
+static bool read_counters(Timing_T timing, double *counts);
+static void close_counters(Timing_T timing);
+static long process_heap_in_use(void);
+
+/********** Timing_start ********
+ *
+ * Purpose: Starts timing an operation, if COMP40_STATS or COMP40_TRACE is
+ *          set
+ *
+ * Parameters:
+ *      - operation: the operation's name, such as "compress"
+ *
+ * Return: a new Timing_T, or NULL if neither is set
+ *
+ * Expects: 
+ *      - operation outlives the Timing_T
+ *
+ * CRE: memory can't be allocated
+ *
+ * Notes:
+ *      - The caller ends the timing with Timing_finish(), which frees it
+ */
+Timing_T Timing_start(const char *operation)
+{
+        bool report = getenv("COMP40_STATS") != NULL;
+        if (!report && !Trace_enabled()) {
+                return NULL;
+        }
+
+        Timing_T timing;
+        NEW(timing);
+        timing->operation = operation;
+        timing->nsteps = 0;
+        timing->pool = Pool_stats(Pool_current());
+        timing->report = report;
+        timing->group = -1;
+        if (report) {
+                open_counters(timing);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &timing->start);
+        timing->last = timing->start;
+        return timing;
+}
+
+/********** Timing_step ********
+ *
+ * Purpose: Records that a step has just ended
+ *
+ * Parameters:
+ *      - timing: the operation, or NULL
+ *      - step: the step's name, such as "1 read ppm"
+ *      - bytes_in: the bytes the step read, or -1 if unknown
+ *      - bytes_out: the bytes the step wrote, or -1 if unknown
+ *
+ * Return: none
+ *
+ * Expects: 
+ *      - step outlives timing
+ *
+ * CRE: more than MAX_STEPS steps
+ *
+ * Notes:
+ *      - Does nothing if timing is NULL. The step's time runs from the
+ *        end of the previous step, or from Timing_start()
+ *      - The step is traced with the operation as its category
+ */
+void Timing_step(Timing_T timing, const char *step, long bytes_in, 
+                 long bytes_out)
+{
+        if (timing == NULL) {
+                return;
+        }
+        assert(timing->nsteps < MAX_STEPS);
+
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        struct step *s = &timing->steps[timing->nsteps++];
+        s->name = step;
+        s->seconds = seconds_between(&timing->last, &now);
+        s->bytes_in = bytes_in;
+        s->bytes_out = bytes_out;
+        Trace_complete(step, timing->operation, &timing->last, &now);
+        timing->last = now;
+        if (!timing->report) {
+                return;
+        }
+
+        /* a reset in the step gives back everything held before it */
+        struct Pool_stats pool = Pool_stats(Pool_current());
+        s->pool_bytes = pool.in_use;
+        if (pool.resets == timing->pool.resets) {
+                s->pool_bytes -= timing->pool.in_use;
+        }
+        s->pool_allocations = pool.allocations - timing->pool.allocations;
+        s->pool_held = pool.in_use;
+        s->process_heap = process_heap_in_use();
+        timing->pool = pool;
+
+        double counts[NUM_COUNTERS];
+        bool counted = read_counters(timing, counts);
+        for (int c = 0; c < NUM_COUNTERS; c++) {
+                if (counted && timing->slot[c] >= 0) {
+                        s->counts[c] = counts[c] - timing->last_counts[c];
+                        timing->last_counts[c] = counts[c];
+                } else {
+                        s->counts[c] = -1;
+                }
+        }
+}
+
+/********** Timing_finish ********
+ *
+ * Purpose: Reports an operation's steps and frees its Timing_T
+ *
+ * Parameters:
+ *      - timing: a pointer to the operation, or to NULL
+ *      - width, height: the size of the image, in pixels
+ *
+ * Return: none
+ *
+ * Expects: none
+ *
+ * CRE: timing is null, or memory can't be allocated
+ *
+ * Notes:
+ *      - Does nothing if *timing is NULL. Sets *timing to NULL
+ *      - A report that can't be written (a bad COMP40_STATS path) is 
+ *        dropped rather than failing the image
+ *      - The whole operation is traced, in the "image" category
+ */
+void Timing_finish(Timing_T *timing, unsigned width, unsigned height)
+{
+        assert(timing != NULL);
+        if (*timing == NULL) {
+                return;
+        }
+        Timing_T t = *timing;
+        Trace_complete(t->operation, "image", &t->start, &t->last);
+        if (!t->report) {
+                FREE(*timing);
+                return;
+        }
+
+        double pixels = (double)width * height;
+        double total = seconds_between(&t->start, &t->last);
+
+        char *report = NULL;
+        size_t length = 0;
+        FILE *output = open_memstream(&report, &length);
+        assert(output != NULL);
+        long pool_peak = 0, heap_peak = -1, allocations = 0;
+        for (int i = 0; i < t->nsteps; i++) {
+                struct step *s = &t->steps[i];
+                allocations += s->pool_allocations;
+                if (s->pool_held > pool_peak) {
+                        pool_peak = s->pool_held;
+                }
+                if (s->process_heap > heap_peak) {
+                        heap_peak = s->process_heap;
+                }
+        }
+        fprintf(output, "%s %ux%u: %.3f ms, %.2f MP/s, pool peak %ld B in "
+                "%ld pool allocations, process heap at step ends up to ", 
+                t->operation, width, height, total * 1e3, 
+                pixels / total / 1e6, pool_peak, allocations);
+        if (heap_peak < 0) {
+                fprintf(output, "-");
+        } else {
+                fprintf(output, "%ld B", heap_peak);
+        }
+        fprintf(output, "%s\n", t->group < 0 ? 
+                " (hardware counters unavailable)" : "");
+        for (int i = 0; i < t->nsteps; i++) {
+                struct step *s = &t->steps[i];
+                fprintf(output, "%s   step %-22s %10.3f ms", 
+                        t->operation, s->name, s->seconds * 1e3);
+                if (s->seconds >= MIN_RATED) {
+                        fprintf(output, " %10.2f MP/s", 
+                                pixels / s->seconds / 1e6);
+                } else {
+                        fprintf(output, " %10s MP/s", "-");
+                }
+                print_bytes(output, "in", s->bytes_in);
+                print_bytes(output, "out", s->bytes_out);
+                fprintf(output, "  pool +%ld B %ld allocs held %ld B", 
+                        s->pool_bytes, s->pool_allocations, s->pool_held);
+                print_bytes(output, "process heap", s->process_heap);
+                if (t->group >= 0) {
+                        fprintf(output, "  cyc");
+                        print_count(output, s->counts[CYCLES]);
+                        fprintf(output, " ins");
+                        print_count(output, s->counts[INSTRUCTIONS]);
+                        if (s->counts[CYCLES] > 0 && 
+                            s->counts[INSTRUCTIONS] >= 0) {
+                                fprintf(output, " ipc %5.2f", 
+                                        s->counts[INSTRUCTIONS] / 
+                                        s->counts[CYCLES]);
+                        } else {
+                                fprintf(output, " ipc %5s", "-");
+                        }
+                        fprintf(output, " llc-miss");
+                        print_count(output, s->counts[LLC_MISSES]);
+                        fprintf(output, " br-miss");
+                        print_count(output, s->counts[BRANCH_MISSES]);
+                }
+                fprintf(output, "\n");
+        }
+        fclose(output);
+
+        const char *path = getenv("COMP40_STATS");
+        if (path == NULL || *path == '\0' || strcmp(path, "1") == 0 || 
+            strcmp(path, "-") == 0) {
+                fwrite(report, 1, length, stderr);
+        } else {
+                FILE *file = fopen(path, "a");
+                if (file != NULL) {
+                        fwrite(report, 1, length, file);
+                        fclose(file);
+                }
+        }
+
+        free(report);
+        close_counters(t);
+        FREE(*timing);
+}
+
+
+/**************************/
+/*    Helper functions    */
+/**************************/
+
+
+/********** seconds_between ********
+ *
+ * Purpose: Gives the seconds between two readings of the clock
+ *
+ * Parameters:
+ *      - from, to: the readings
+ *
+ * Return: to - from, in seconds
+ *
+ * Expects: none
+ */
+static double seconds_between(const struct timespec *from, 
+                              const struct timespec *to)
+{
+        return (to->tv_sec - from->tv_sec) + 
+               (to->tv_nsec - from->tv_nsec) / 1e9;
+}
+
+/********** print_bytes ********
+ *
+ * Purpose: Prints a step's bytes in or out
+ *
+ * Parameters:
+ *      - output: where to print
+ *      - label: "in" or "out"
+ *      - bytes: the bytes, or -1 if unknown
+ *
+ * Return: none
+ *
+ * Expects: none
+ */
+static void print_bytes(FILE *output, const char *label, long bytes)
+{
+        if (bytes < 0) {
+                fprintf(output, " %12s B %s", "-", label);
+        } else {
+                fprintf(output, " %12ld B %s", bytes, label);
+        }
+}
+
+/********** print_count ********
+ *
+ * Purpose: Prints a step's hardware count
+ *
+ * Parameters:
+ *      - output: where to print
+ *      - count: the count, or -1 if unknown
+ *
+ * Return: none
+ *
+ * Expects: none
+ */
+static void print_count(FILE *output, double count)
+{
+        if (count < 0) {
+                fprintf(output, " %12s", "-");
+        } else {
+                fprintf(output, " %12.0f", count);
+        }
+}
+
+/********** open_counters ********
+ *
+ * Purpose: Opens and starts the hardware counters for the calling thread
+ *
+ * Parameters:
+ *      - timing: the operation
+ *
+ * Return: none
+ *
+ * Expects: none
+ *
+ * Notes:
+ *      - The counters are one group, so they are scheduled on the PMU 
+ *        together and read with one read(). Only user-space events are 
+ *        counted, which perf_event_paranoid 2 (the usual default) allows
+ *      - If the cycles counter (the group's leader) can't be opened there
+ *        are no counters; if another can't, only that one is missing
+ */
+static void open_counters(Timing_T timing)
+{
+        timing->group = -1;
+        for (int c = 0; c < NUM_COUNTERS; c++) {
+                timing->fds[c] = -1;
+                timing->slot[c] = -1;
+                timing->last_counts[c] = 0;
+        }
+#ifdef __linux__
+        static const uint32_t types[NUM_COUNTERS] = {
+                PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, 
+                PERF_TYPE_HW_CACHE, PERF_TYPE_HARDWARE
+        };
+        static const uint64_t configs[NUM_COUNTERS] = {
+                PERF_COUNT_HW_CPU_CYCLES,
+                PERF_COUNT_HW_INSTRUCTIONS,
+                PERF_COUNT_HW_CACHE_LL | 
+                        (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                        (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+                PERF_COUNT_HW_BRANCH_MISSES
+        };
+
+        int nslots = 0;
+        for (int c = 0; c < NUM_COUNTERS; c++) {
+                struct perf_event_attr attr;
+                memset(&attr, 0, sizeof(attr));
+                attr.size = sizeof(attr);
+                attr.type = types[c];
+                attr.config = configs[c];
+                attr.disabled = timing->group < 0;
+                attr.exclude_kernel = 1;
+                attr.exclude_hv = 1;
+                attr.read_format = PERF_FORMAT_GROUP | 
+                                   PERF_FORMAT_TOTAL_TIME_ENABLED |
+                                   PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+                int fd = syscall(SYS_perf_event_open, &attr, 0, -1, 
+                                 timing->group, PERF_FLAG_FD_CLOEXEC);
+                if (fd < 0) {
+                        if (c == CYCLES) {
+                                return;
+                        }
+                        continue;
+                }
+                if (timing->group < 0) {
+                        timing->group = fd;
+                }
+                timing->fds[c] = fd;
+                timing->slot[c] = nslots++;
+        }
+
+        ioctl(timing->group, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(timing->group, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#endif
+}
+
+/********** read_counters ********
+ *
+ * Purpose: Reads the hardware counters' totals since open_counters()
+ *
+ * Parameters:
+ *      - timing: the operation
+ *      - counts: where to store each counter's total, by enum counter
+ *
+ * Return: true if the counters were read, false if there are none or the
+ *         read failed
+ *
+ * Expects: none
+ *
+ * Notes:
+ *      - If the kernel had to share the PMU with other groups, the totals
+ *        are scaled up by the time the group was enabled over the time it
+ *        was actually counting, as perf stat does
+ */
+static bool read_counters(Timing_T timing, double *counts)
+{
+        if (timing->group < 0) {
+                return false;
+        }
+        uint64_t values[3 + NUM_COUNTERS];
+        ssize_t got = read(timing->group, values, sizeof(values));
+        if (got < (ssize_t)(3 * sizeof(uint64_t)) || values[2] == 0) {
+                return false;
+        }
+
+        double scale = (double)values[1] / values[2];
+        for (int c = 0; c < NUM_COUNTERS; c++) {
+                int slot = timing->slot[c];
+                counts[c] = slot >= 0 && (uint64_t)slot < values[0] ? 
+                            values[3 + slot] * scale : 0;
+        }
+        return true;
+}
+
+/********** close_counters ********
+ *
+ * Purpose: Closes the hardware counters
+ *
+ * Parameters:
+ *      - timing: the operation
+ *
+ * Return: none
+ *
+ * Expects: none
+ */
+static void close_counters(Timing_T timing)
+{
+        for (int c = 0; c < NUM_COUNTERS; c++) {
+                if (timing->fds[c] >= 0) {
+                        close(timing->fds[c]);
+                }
+        }
+}
+
+/********** process_heap_in_use ********
+ *
+ * Purpose: Gives the bytes malloc() has handed out and not had back, 
+ *          across the whole process
+ *
+ * Parameters: none
+ *
+ * Return: the bytes, or -1 where the C library can't say
+ *
+ * Expects: none
+ *
+ * Notes:
+ *      - Uses glibc's mallinfo2() (2.33 and later): bytes in use in the 
+ *        main and thread arenas plus large blocks mapped on their own
+ *      - Every thread's allocations are included, so with batch or server
+ *        workers running it isn't one image's memory
+ */
+static long process_heap_in_use(void)
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+        struct mallinfo2 info = mallinfo2();
+        return info.uordblks + info.hblkhd;
+#else
+        return -1;
+#endif
+}
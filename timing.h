@@ -0,0 +1,33 @@
+/**************************************************************
+ *
+ *                     timing.h
+ *
+ *     Assignment: Arith
+ *     Authors:  Marielle Cibella (mcibel01), Erica Huang (ehuang02)
+ *     Date:     4/24/25
+ *
+ *     Summary:
+ *
+ *     This header file declares the codec's opt-in per-step timing. When
+ *     the COMP40_STATS environment variable is set, compress40_with() and
+ *     decompress40_stream() time each of their numbered steps with 
+ *     CLOCK_MONOTONIC and report each step's wall time, pixels per second,
+ *     bytes in and out, and where the kernel allows, hardware counts, 
+ *     once the image is done. Otherwise 
+ *     Timing_start() returns NULL and every other call does nothing.
+ *
+ *
+ **************************************************************/
+
+#ifndef TIMING
+#define TIMING
+
+/* structs */
+typedef struct Timing_T *Timing_T;
+
+Timing_T Timing_start(const char *operation);
+void Timing_step(Timing_T timing, const char *step, long bytes_in, 
+                 long bytes_out);
+void Timing_finish(Timing_T *timing, unsigned width, unsigned height);
+
+#endif
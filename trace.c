@@ -0,0 +1,500 @@
+/**************************************************************
+ *
+ *                     trace.c
+ *
+ *     Assignment: Arith
+ *     Authors:  Marielle Cibella (mcibel01), Erica Huang (ehuang02)
+ *     Date:     4/25/25
+ *
+ *     Summary:
+ *
+ *     trace.c implements the timeline tracing declared in trace.h. Each
+ *     thread appends its events to its own buffer, a list of fixed-size
+ *     chunks, so recording an event takes no lock and touches no memory
+ *     another thread writes. A thread's buffer is pushed onto a global
+ *     list with one compare-and-swap the first time it records, and is
+ *     kept (with its events) after the thread exits. An event is written
+ *     before its chunk's count is published with a release store, so the
+ *     dump at exit, which reads counts with acquire loads, only sees
+ *     whole events, even from a thread that is still running.
+ *
+ *     Timestamps are CLOCK_MONOTONIC, in microseconds since tracing
+ *     started. The buffers are never freed; they hold what the dump
+ *     writes, and the dump runs as the process exits.
+ *
+ *
+ **************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+#include "assert.h"
+#include "mem.h"
+#include "trace.h"
+
+/* the events in one chunk of a thread's buffer */
+#define CHUNK_EVENTS 1024
+
+/*
+ * one event: its name and category, its Chrome phase ('X' complete, 'B'
+ * begin, 'E' end), when it started, and for 'X', how long it took, both
+ * in nanoseconds since tracing started
+ */
+struct event {
+        const char *name;
+        const char *category;
+        char phase;
+        int64_t start, duration;
+};
+
+/*
+ * a chunk of a thread's events: count of them are written, and next is
+ * the chunk after it, or NULL. The owning thread stores count and next
+ * with release stores; the dump loads them with acquire loads
+ */
+struct chunk {
+        struct chunk *next;
+        long count;
+        struct event events[CHUNK_EVENTS];
+};
+
+/*
+ * a thread's buffer: its thread id and name, its chunks (last is the one
+ * being filled, only used by the owner), and the next buffer in the
+ * global list
+ */
+struct buffer {
+        struct buffer *next;
+        long tid;
+        const char *name;
+        struct chunk *first, *last;
+};
+
+/* the trace file, or NULL if tracing is off, and when tracing started */
+static pthread_once_t trace_once = PTHREAD_ONCE_INIT;
+static const char *trace_path = NULL;
+static struct timespec trace_epoch;
+
+/* every thread's buffer, newest first, and the calling thread's */
+static struct buffer *buffers = NULL;
+static __thread struct buffer *thread_buffer = NULL;
+
+/* helper functions */
+static void trace_init(void);
+static struct buffer *current_buffer(void);
+static void record(const char *name, const char *category, char phase,
+                   const struct timespec *start, const struct timespec *end);
+static int64_t since_epoch(const struct timespec *time);
+static long thread_id(void);
+static void dump(void);
+static void print_string(FILE *output, const char *string);
+
+/********** Trace_enabled ********
+ *
+ * Purpose: Tells whether COMP40_TRACE has turned tracing on
+ *
+ * Parameters: none
+ *
+ * Return: true if events are being recorded
+ *
+ * Expects: none
+ *
+ * CRE: none
+ *
+ * Notes:
+ *      - The environment is read once, by the first call to any Trace_
+ *        function, which also arranges for the dump at exit
+ */
+bool Trace_enabled(void)
+{
+        pthread_once(&trace_once, trace_init);
+        return trace_path != NULL;
+}
+
+/********** Trace_thread_name ********
+ *
+ * Purpose: Names the calling thread's row of the timeline
+ *
+ * Parameters:
+ *      - name: the name, such as "batch worker"
+ *
+ * Return: none
+ *
+ * Expects:
+ *      - name lives until the program exits
+ *
+ * CRE: name is null, or memory can't be allocated
+ *
+ * Notes:
+ *      - Does nothing if tracing is off. Threads that aren't named are
+ *        "main" or "thread"
+ */
+void Trace_thread_name(const char *name)
+{
+        assert(name != NULL);
+        if (!Trace_enabled()) {
+                return;
+        }
+        __atomic_store_n(&current_buffer()->name, name, __ATOMIC_RELEASE);
+}
+
+/********** Trace_begin ********
+ *
+ * Purpose: Records that the calling thread has started something
+ *
+ * Parameters:
+ *      - name: what it started, such as "file"
+ *      - category: what kind of thing it is, such as "batch"
+ *
+ * Return: none
+ *
+ * Expects:
+ *      - a matching Trace_end() on the same thread; begins and ends nest
+ *      - name and category live until the program exits
+ *
+ * CRE: name or category is null, or memory can't be allocated
+ *
+ * Notes:
+ *      - Does nothing if tracing is off
+ */
+void Trace_begin(const char *name, const char *category)
+{
+        assert(name != NULL && category != NULL);
+        if (!Trace_enabled()) {
+                return;
+        }
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        record(name, category, 'B', &now, &now);
+}
+
+/********** Trace_end ********
+ *
+ * Purpose: Records that the calling thread has finished something
+ *
+ * Parameters:
+ *      - name, category: as given to the matching Trace_begin()
+ *
+ * Return: none
+ *
+ * Expects:
+ *      - name and category live until the program exits
+ *
+ * CRE: name or category is null, or memory can't be allocated
+ *
+ * Notes:
+ *      - Does nothing if tracing is off
+ */
+void Trace_end(const char *name, const char *category)
+{
+        assert(name != NULL && category != NULL);
+        if (!Trace_enabled()) {
+                return;
+        }
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        record(name, category, 'E', &now, &now);
+}
+
+/********** Trace_complete ********
+ *
+ * Purpose: Records something the calling thread did between two readings
+ *          of CLOCK_MONOTONIC
+ *
+ * Parameters:
+ *      - name, category: as for Trace_begin()
+ *      - start, end: when it started and ended
+ *
+ * Return: none
+ *
+ * Expects:
+ *      - start is no later than end
+ *      - name and category live until the program exits
+ *
+ * CRE: any argument is null, or memory can't be allocated
+ *
+ * Notes:
+ *      - Does nothing if tracing is off. For callers that already read the
+ *        clock, such as the per-step timing (timing.h)
+ */
+void Trace_complete(const char *name, const char *category,
+                    const struct timespec *start, const struct timespec *end)
+{
+        assert(name != NULL && category != NULL);
+        assert(start != NULL && end != NULL);
+        if (!Trace_enabled()) {
+                return;
+        }
+        record(name, category, 'X', start, end);
+}
+
+
+/**************************/
+/*    Helper functions    */
+/**************************/
+
+
+/********** trace_init ********
+ *
+ * Purpose: Reads COMP40_TRACE and, if it names a file, starts tracing
+ *
+ * Parameters: none
+ *
+ * Return: none
+ *
+ * Expects:
+ *      - called once, through pthread_once()
+ *
+ * CRE: none
+ */
+static void trace_init(void)
+{
+        const char *path = getenv("COMP40_TRACE");
+        if (path == NULL || *path == '\0') {
+                return;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &trace_epoch);
+        trace_path = path;
+        atexit(dump);
+}
+
+/********** current_buffer ********
+ *
+ * Purpose: Gives the calling thread's buffer, making it on first use
+ *
+ * Parameters: none
+ *
+ * Return: the buffer
+ *
+ * Expects:
+ *      - tracing is on
+ *
+ * CRE: memory can't be allocated
+ *
+ * Notes:
+ *      - A new buffer is published on the global list with a
+ *        compare-and-swap, after it is fully set up
+ */
+static struct buffer *current_buffer(void)
+{
+        if (thread_buffer != NULL) {
+                return thread_buffer;
+        }
+
+        struct buffer *buffer;
+        NEW(buffer);
+        buffer->tid = thread_id();
+        buffer->name = buffer->tid == (long)getpid() ? "main" : "thread";
+        NEW(buffer->first);
+        buffer->first->next = NULL;
+        buffer->first->count = 0;
+        buffer->last = buffer->first;
+
+        buffer->next = __atomic_load_n(&buffers, __ATOMIC_RELAXED);
+        while (!__atomic_compare_exchange_n(&buffers, &buffer->next, buffer,
+                                            true, __ATOMIC_RELEASE,
+                                            __ATOMIC_RELAXED)) {
+        }
+        thread_buffer = buffer;
+        return buffer;
+}
+
+/********** record ********
+ *
+ * Purpose: Appends an event to the calling thread's buffer
+ *
+ * Parameters:
+ *      - name, category, phase: the event
+ *      - start, end: when it started and ended
+ *
+ * Return: none
+ *
+ * Expects:
+ *      - tracing is on
+ *
+ * CRE: memory can't be allocated
+ *
+ * Notes:
+ *      - Only the owning thread writes to a buffer, so the event and the
+ *        count need no lock; the release store of the count is what
+ *        makes the event visible to the dump
+ */
+static void record(const char *name, const char *category, char phase,
+                   const struct timespec *start, const struct timespec *end)
+{
+        struct buffer *buffer = current_buffer();
+        struct chunk *chunk = buffer->last;
+        if (chunk->count == CHUNK_EVENTS) {
+                struct chunk *next;
+                NEW(next);
+                next->next = NULL;
+                next->count = 0;
+                __atomic_store_n(&chunk->next, next, __ATOMIC_RELEASE);
+                buffer->last = chunk = next;
+        }
+
+        struct event *event = &chunk->events[chunk->count];
+        event->name = name;
+        event->category = category;
+        event->phase = phase;
+        event->start = since_epoch(start);
+        event->duration = since_epoch(end) - event->start;
+        __atomic_store_n(&chunk->count, chunk->count + 1, __ATOMIC_RELEASE);
+}
+
+/********** since_epoch ********
+ *
+ * Purpose: Gives the nanoseconds from the start of tracing to a reading
+ *          of CLOCK_MONOTONIC
+ *
+ * Parameters:
+ *      - time: the reading
+ *
+ * Return: the nanoseconds, negative for a reading before tracing started
+ *
+ * Expects: none
+ *
+ * CRE: none
+ */
+static int64_t since_epoch(const struct timespec *time)
+{
+        return (int64_t)(time->tv_sec - trace_epoch.tv_sec) * 1000000000 +
+               (time->tv_nsec - trace_epoch.tv_nsec);
+}
+
+/********** thread_id ********
+ *
+ * Purpose: Gives an id for the calling thread
+ *
+ * Parameters: none
+ *
+ * Return: the kernel's thread id on Linux, so the timeline matches tools
+ *         such as perf and top; elsewhere, a count of traced threads,
+ *         with the first one (normally the main thread) the process id
+ *
+ * Expects: none
+ *
+ * CRE: none
+ */
+static long thread_id(void)
+{
+#ifdef __linux__
+        return (long)syscall(SYS_gettid);
+#else
+        static long threads = 0;
+        return (long)getpid() + __atomic_fetch_add(&threads, 1,
+                                                   __ATOMIC_RELAXED);
+#endif
+}
+
+/********** dump ********
+ *
+ * Purpose: Writes every thread's events to the COMP40_TRACE file as
+ *          Chrome trace-event JSON
+ *
+ * Parameters: none
+ *
+ * Return: none
+ *
+ * Expects:
+ *      - called at exit, through atexit()
+ *
+ * CRE: none
+ *
+ * Notes:
+ *      - A trace file that can't be written is reported on stderr; the
+ *        program's exit status doesn't change
+ *      - Each thread gets a "thread_name" metadata event, then its events
+ *        in the order it recorded them
+ */
+static void dump(void)
+{
+        FILE *output = fopen(trace_path, "w");
+        if (output == NULL) {
+                fprintf(stderr, "40image: cannot write trace '%s'\n",
+                        trace_path);
+                return;
+        }
+
+        long pid = (long)getpid();
+        const char *separator = "\n";
+        fprintf(output, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+        struct buffer *buffer = __atomic_load_n(&buffers, __ATOMIC_ACQUIRE);
+        for (; buffer != NULL; buffer = buffer->next) {
+                fprintf(output, "%s{\"name\":\"thread_name\",\"ph\":\"M\","
+                        "\"pid\":%ld,\"tid\":%ld,\"args\":{\"name\":",
+                        separator, pid, buffer->tid);
+                print_string(output, __atomic_load_n(&buffer->name,
+                                                     __ATOMIC_ACQUIRE));
+                fprintf(output, "}}");
+                separator = ",\n";
+
+                struct chunk *chunk = buffer->first;
+                while (chunk != NULL) {
+                        long count = __atomic_load_n(&chunk->count,
+                                                     __ATOMIC_ACQUIRE);
+                        for (long i = 0; i < count; i++) {
+                                struct event *e = &chunk->events[i];
+                                fprintf(output, ",\n{\"name\":");
+                                print_string(output, e->name);
+                                fprintf(output, ",\"cat\":");
+                                print_string(output, e->category);
+                                fprintf(output, ",\"ph\":\"%c\",\"ts\":%.3f",
+                                        e->phase, e->start / 1e3);
+                                if (e->phase == 'X') {
+                                        fprintf(output, ",\"dur\":%.3f",
+                                                e->duration / 1e3);
+                                }
+                                fprintf(output, ",\"pid\":%ld,\"tid\":%ld}",
+                                        pid, buffer->tid);
+                        }
+                        chunk = __atomic_load_n(&chunk->next,
+                                                __ATOMIC_ACQUIRE);
+                }
+        }
+        fprintf(output, "\n]}\n");
+
+        if (ferror(output) | fclose(output)) {
+                fprintf(stderr, "40image: error writing trace '%s'\n",
+                        trace_path);
+        }
+}
+
+/********** print_string ********
+ *
+ * Purpose: Prints a string as a quoted JSON string
+ *
+ * Parameters:
+ *      - output: where to print it
+ *      - string: the string
+ *
+ * Return: none
+ *
+ * Expects: none
+ *
+ * CRE: none
+ *
+ * Notes:
+ *      - Quotes, backslashes, and control characters are escaped
+ */
+static void print_string(FILE *output, const char *string)
+{
+        fputc('"', output);
+        for (const unsigned char *c = (const unsigned char *)string;
+             *c != '\0'; c++) {
+                if (*c == '"' || *c == '\\') {
+                        fprintf(output, "\\%c", *c);
+                } else if (*c < 0x20) {
+                        fprintf(output, "\\u%04x", *c);
+                } else {
+                        fputc(*c, output);
+                }
+        }
+        fputc('"', output);
+}
@@ -0,0 +1,38 @@
+/**************************************************************
+ *
+ *                     trace.h
+ *
+ *     Assignment: Arith
+ *     Authors:  Marielle Cibella (mcibel01), Erica Huang (ehuang02)
+ *     Date:     4/25/25
+ *
+ *     Summary:
+ *
+ *     This header file declares the codec's opt-in timeline tracing. When
+ *     the COMP40_TRACE environment variable names a file, each thread
+ *     records the start and end of what it works on (images, their
+ *     numbered steps, batch files, server requests) into its own buffer,
+ *     and at exit every thread's events are written to that file as
+ *     Chrome trace-event JSON, which chrome://tracing or Perfetto show as
+ *     one timeline row per thread. Otherwise every call does nothing.
+ *
+ *     Names and categories are kept by pointer, so they must be string
+ *     literals or otherwise live until the program exits.
+ *
+ *
+ **************************************************************/
+
+#ifndef TRACE
+#define TRACE
+
+#include <stdbool.h>
+#include <time.h>
+
+bool Trace_enabled(void);
+void Trace_thread_name(const char *name);
+void Trace_begin(const char *name, const char *category);
+void Trace_end(const char *name, const char *category);
+void Trace_complete(const char *name, const char *category,
+                    const struct timespec *start, const struct timespec *end);
+
+#endif
@@ -16,31 +16,39 @@
  *
  **************************************************************/
 
+#include <string.h>
 #include "word.h"
 
 /* 
  * struct word stores compressed image data, including averaged chroma values 
  * (Pb and Pr) and brightness values (a, b, c, d). Pb_avg and Pr_avg 
  * are 4-bit unsigned values, a is a 9-bit unsigned value, and b, c, and d are 
- * 5-bit signed values.
+ * 5-bit signed values. Each field uses the smallest integer type that holds 
+ * it, so the whole struct is 8 bytes instead of 24.
  */
 struct word{
+        /* a is 9 bits */
+        uint16_t a;
+
         /* Pb and Pr avg are 4 bits */
-        unsigned int Pb_avg, Pr_avg;
+        uint8_t Pb_avg, Pr_avg;
         
-        /* bcd are 5 bits, a is 9 */
-        unsigned int a;
-        signed int b, c, d;
+        /* bcd are 5 bits */
+        int8_t b, c, d;
 };
 
 /* 
  * struct word_closure holds information needed for processing words in an 
  * image, including a pointer to a 2D array of words and a set of methods 
- * for handling UArray2 operations.
+ * for handling UArray2 operations. When decompressing, it also remembers
+ * the last word converted and the four pixels it became, so a run of 
+ * equal words (a flat region) is converted only once.
  */
 struct word_closure{
         A2Methods_UArray2 *pixels;
         A2Methods_T methods;
+        word last_word;
+        Y_Pb_Pr last_block[4];
 };
 
 /* Constant least significant bit values */
@@ -51,6 +59,35 @@ const unsigned d_lsb = 8;
 const unsigned pb_avg_lsb = 4;
 const unsigned pr_avg_lsb = 0;
 
+/* The same layout as a struct word_layout, for the generic functions */
+const struct word_layout default_layout = WORD_LAYOUT_DEFAULTS;
+
+/* the fields prediction applies to: a, Pb_avg, and Pr_avg */
+#define PREDICTED_FIELDS 3
+static const int predicted_field[PREDICTED_FIELDS] = { 0, 4, 5 };
+
+/* helper functions */
+static uint32_t predict_word(const uint32_t *words, unsigned width, 
+                             unsigned col, unsigned row, 
+                             enum codec_predict predict, 
+                             const unsigned *field_width, 
+                             const unsigned *lsb);
+static uint32_t median_field(uint32_t left, uint32_t above, 
+                             uint32_t above_left);
+static uint32_t add_fields(uint32_t word, uint32_t prediction, int sign,
+                           const unsigned *field_width, const unsigned *lsb);
+static uint64_t pack_block(const struct word_layout *layout, 
+                           const unsigned *lsb, Y_Pb_Pr ypbpr[4]);
+static void unpack_block(const struct word_layout *layout, 
+                         const unsigned *lsb, uint64_t code, 
+                         Y_Pb_Pr ypbpr[4]);
+static int64_t quantize_field(const struct word_layout *layout, 
+                              unsigned width, float value);
+static uint64_t chroma_index(unsigned width, float chroma);
+static float chroma_value(unsigned width, uint64_t index);
+static uint64_t get_code(A2Methods_UArray2 word_bits, A2Methods_T methods,
+                         unsigned nwords, int col, int row);
+
 
 /**************************/
 /*       Compression      */
@@ -102,7 +139,7 @@ A2Methods_UArray2 make_word_array(A2Methods_UArray2 pixels, A2Methods_T methods)
         assert(map != NULL);
 
         /* create a closure struct */
-        word_closure cl = {&words, methods}; 
+        word_closure cl = {&words, methods, NULL, {NULL}}; 
 
         /* apply the mapping function to convert pixels into words */
         map(pixels, word_apply, &cl);
@@ -222,11 +259,12 @@ void ypbpr_to_word(word w, Y_Pb_Pr ypbpr1, Y_Pb_Pr ypbpr2, Y_Pb_Pr ypbpr3,
         float d_float = (Y4 - Y3 - Y2 + Y1) / 4.0;
 
         /* Scale and quantize DCT */
-        w->a = (unsigned int)(a_float * 511);
+        unsigned int a = (unsigned int)(a_float * 511);
         /* If more than 9 bits bring back to 9 bits */
-        if (w->a > 511) {
-                w->a = 511;
+        if (a > 511) {
+                a = 511;
         }
+        w->a = a;
         
         w->b = quantize_bcd(b_float); 
         w->c = quantize_bcd(c_float);
@@ -310,7 +348,7 @@ A2Methods_UArray2 pack_word(A2Methods_UArray2 word_structs, A2Methods_T methods)
         assert(word_bits != NULL);
 
         /* Create closure for storing word array */
-        word_closure cl = {&word_bits, methods};
+        word_closure cl = {&word_bits, methods, NULL, {NULL}};
 
         /* Apply packing function to eqch word struct */
         A2Methods_mapfun *map = methods->map_default;
@@ -477,7 +515,7 @@ A2Methods_UArray2 decompress_words(A2Methods_UArray2 words, A2Methods_T methods)
         assert(map != NULL);
 
         /* create closure */
-        word_closure cl = {&ypbpr_pixels, methods}; 
+        word_closure cl = {&ypbpr_pixels, methods, NULL, {NULL}}; 
 
         /* apply the decompression function to each compressed word */
         map(words, ypbpr_apply, &cl);
@@ -512,6 +550,8 @@ A2Methods_UArray2 decompress_words(A2Methods_UArray2 words, A2Methods_T methods)
  * Notes:
  *     - Uses word_to_ypbpr() to extract Y_Pb_Pr values and distribute them
  *     - Expands each compressed word into a 2x2 block of pixel
+ *     - A word equal to the one before it is copied from that word's 
+ *       pixels instead of being converted again
  *     - Information is lost here due to floating point arithmetic in 
  *              helper function word_to_ypbpr()
  */
@@ -548,8 +588,29 @@ void ypbpr_apply(int col, int row, A2Methods_UArray2 array2, void *elem,
         Y_Pb_Pr ypbpr_val4 = methods->at(*ypbpr_pixels, ypbpr_col + 1, ypbpr_row 
                                          + 1);
 
-        /* Convert the word back into four Y/Pb/Pr pixels */
-        word_to_ypbpr(w, ypbpr_val1, ypbpr_val2, ypbpr_val3, ypbpr_val4);
+        /* 
+         * Convert the word back into four Y/Pb/Pr pixels, or copy them if
+         * the last word was the same
+         */
+        word last = closure->last_word;
+        if (last != NULL && last->a == w->a && last->b == w->b && 
+            last->c == w->c && last->d == w->d && 
+            last->Pb_avg == w->Pb_avg && last->Pr_avg == w->Pr_avg) {
+                int size = Y_Pb_Pr_size();
+                memcpy(ypbpr_val1, closure->last_block[0], size);
+                memcpy(ypbpr_val2, closure->last_block[1], size);
+                memcpy(ypbpr_val3, closure->last_block[2], size);
+                memcpy(ypbpr_val4, closure->last_block[3], size);
+        } else {
+                word_to_ypbpr(w, ypbpr_val1, ypbpr_val2, ypbpr_val3, 
+                              ypbpr_val4);
+        }
+
+        closure->last_word = w;
+        closure->last_block[0] = ypbpr_val1;
+        closure->last_block[1] = ypbpr_val2;
+        closure->last_block[2] = ypbpr_val3;
+        closure->last_block[3] = ypbpr_val4;
 }
 
 /********** word_to_ypbpr ********
@@ -610,6 +671,101 @@ void word_to_ypbpr(word w, Y_Pb_Pr ypbpr1, Y_Pb_Pr ypbpr2, Y_Pb_Pr ypbpr3,
         set_ypbpr(ypbpr4, Y4, Pb_avg, Pr_avg);
 }
 
+/********** preview_words ********
+ * 
+ * Purpose: Converts a 2D array of packed 32-bit words into a half-resolution
+ *          2D array of Y_Pb_Pr pixels, one pixel per word
+ *
+ * Parameters:
+ *     - word_bits: A 2D array containing packed 32-bit words
+ *     - methods: Function table for handling UArray2 operations
+ *
+ * Return: A new 2D array of Y_Pb_Pr pixels the same size as word_bits
+ *
+ * Expects:
+ *     - word_bits is not NULL and contains valid packed words
+ *
+ * CREs: word_bits is null, methods is null, ypbpr_pixels is null, or map is 
+ *      null
+ *
+ * Notes:
+ *     - a is the mean luma of a word's 2x2 block and Pb_avg and Pr_avg are
+ *       its mean chroma, so each pixel is exactly the block average. b, c, 
+ *       and d are never looked at, and no word structs are made
+ */
+A2Methods_UArray2 preview_words(A2Methods_UArray2 word_bits, 
+                                A2Methods_T methods)
+{
+        assert(word_bits != NULL);
+        assert(methods != NULL);
+
+        int width = methods->width(word_bits);
+        int height = methods->height(word_bits);
+
+        /* one Y/Pb/Pr pixel per word */
+        A2Methods_UArray2 ypbpr_pixels = methods->new(width, height, 
+                                                      Y_Pb_Pr_size());
+        assert(ypbpr_pixels != NULL);
+
+        A2Methods_mapfun *map = methods->map_default; 
+        assert(map != NULL);
+
+        word_closure cl = {&ypbpr_pixels, methods, NULL, {NULL}}; 
+        map(word_bits, preview_apply, &cl);
+
+        return ypbpr_pixels;
+}
+
+/********** preview_apply ********
+ * 
+ * Purpose: Sets the preview pixel of one packed word to its block's 
+ *          average Y, Pb, and Pr
+ *
+ * Parameters:
+ *     - col: The column index of the word in the words array
+ *     - row: The row index of the word in the words array
+ *     - array2: The 2D array of packed words
+ *     - elem: A pointer to the packed 32-bit word being processed
+ *     - cl: A closure containing the output pixel array and methods
+ *
+ * Return: None 
+ *
+ * Expects:
+ *     - cl is a valid pointer to a word_closure struct
+ *
+ * CREs: closure is null, pixels from closure is null, pointer to pixels is 
+ *      null, methods from closure is null, current element is null, or the 
+ *      output pixel is null
+ */
+void preview_apply(int col, int row, A2Methods_UArray2 array2, void *elem, 
+                   void *cl)
+{
+        (void)array2; 
+
+        word_closure *closure = (word_closure *)cl; 
+        assert(closure != NULL);
+        A2Methods_UArray2 *ypbpr_pixels = closure->pixels;
+        assert(ypbpr_pixels != NULL);
+        assert(*ypbpr_pixels != NULL);
+        A2Methods_T methods = closure->methods;
+        assert(methods != NULL);
+
+        uint32_t *bit_word = elem;
+        assert(bit_word != NULL);
+
+        Y_Pb_Pr ypbpr = methods->at(*ypbpr_pixels, col, row);
+        assert(ypbpr != NULL);
+
+        /* only the DC coefficient and the chroma averages are needed */
+        float a = Bitpack_getu(*bit_word, 9, a_lsb) / 511.0;
+        float Pb_avg = Arith40_chroma_of_index(
+                               Bitpack_getu(*bit_word, 4, pb_avg_lsb));
+        float Pr_avg = Arith40_chroma_of_index(
+                               Bitpack_getu(*bit_word, 4, pr_avg_lsb));
+
+        set_ypbpr(ypbpr, a, Pb_avg, Pr_avg);
+}
+
 /********** unpack_word ********
  * 
  * Purpose: Converts a 2D array of 32-bit packed words into a 2D array of 
@@ -649,7 +805,7 @@ A2Methods_UArray2 unpack_word(A2Methods_UArray2 word_bits, A2Methods_T methods)
         assert(word_structs != NULL);
 
         /* create closure for mapping function */
-        word_closure cl = {&word_structs, methods};
+        word_closure cl = {&word_structs, methods, NULL, {NULL}};
 
         
         A2Methods_mapfun *map = methods->map_default;
@@ -787,4 +943,811 @@ void set_ypbpr(Y_Pb_Pr ypbpr, float Y, float Pb, float Pr)
         setY(ypbpr, Y);
         setPb(ypbpr, Pb);
         setPr(ypbpr, Pr);
-}
\ No newline at end of file
+}
+
+/********** word_size ********
+ * 
+ * Purpose: Returns the size in bytes of the word struct
+ *
+ * Parameters: None
+ *
+ * Return: An integer representing the size of the word struct
+ *
+ * Expects: none
+ *
+ * CRE: none
+ *
+ * Notes:
+ *      - Lets other modules size buffers of word structs without seeing 
+ *        the struct definition
+ */
+int word_size()
+{
+        return sizeof(struct word);
+}
+
+/********** blank_word ********
+ * 
+ * Purpose: Returns the packed word of a flat, mid-grey 2x2 block
+ *
+ * Parameters: None
+ *
+ * Return: the 32-bit packed word with a at half scale, b, c, and d zero, 
+ *         and both chroma averages at the index of 0
+ *
+ * Expects: none
+ *
+ * CRE: none
+ *
+ * Notes:
+ *      - Used to fill parts of an image that can't be decoded, such as a 
+ *        corrupted tile of a tiled compressed image
+ */
+uint32_t blank_word()
+{
+        struct word w = { 511 / 2, Arith40_index_of_chroma(0.0), 
+                          Arith40_index_of_chroma(0.0), 0, 0, 0 };
+        return pack_single_word(&w);
+}
+
+/********** predict_words ********
+ * 
+ * Purpose: Replaces the a, Pb_avg, and Pr_avg fields of a block of packed
+ *          words with their differences from a prediction made from the 
+ *          words to their left and above
+ *
+ * Parameters:
+ *      - words: the words, row-major
+ *      - width: the number of words in a row
+ *      - height: the number of rows
+ *      - predict: which neighbours predict each word
+ *      - layout: the layout of the words
+ *
+ * Return: None (words is changed in place)
+ *
+ * Expects: 
+ *      - words holds width * height words
+ *
+ * CRE: words or layout is null, or a predicted layout takes more than 
+ *      one word
+ *
+ * Notes:
+ *      - Each difference wraps around modulo its field's range, so it 
+ *        fits the field and unpredict_words() undoes it exactly. On 
+ *        smooth images most differences are near 0, which the Huffman 
+ *        coding (see entropy.c) turns into short codes
+ *      - The words are visited last to first, so every prediction is made
+ *        from neighbours that haven't been replaced yet
+ *      - b, c, and d are left alone; they already describe differences
+ *        within a block
+ */
+void predict_words(uint32_t *words, unsigned width, unsigned height, 
+                   enum codec_predict predict, 
+                   const struct word_layout *layout)
+{
+        assert(words != NULL);
+        assert(layout != NULL);
+        if (predict == PREDICT_NONE) {
+                return;
+        }
+        assert(layout_words(layout) == 1);
+
+        unsigned lsb[WORD_FIELDS];
+        layout_lsbs(layout, lsb);
+
+        for (long i = (long)width * height - 1; i >= 0; i--) {
+                uint32_t prediction = predict_word(words, width, i % width,
+                                                   i / width, predict,
+                                                   layout->width, lsb);
+                words[i] = add_fields(words[i], prediction, -1, 
+                                      layout->width, lsb);
+        }
+}
+
+/********** unpredict_words ********
+ * 
+ * Purpose: Undoes predict_words()
+ *
+ * Parameters:
+ *      - words: the words, row-major, as predict_words() left them
+ *      - width: the number of words in a row
+ *      - height: the number of rows
+ *      - predict: the neighbours predict_words() used
+ *      - layout: the layout of the words
+ *
+ * Return: None (words is changed in place)
+ *
+ * Expects: 
+ *      - words holds width * height words
+ *
+ * CRE: words or layout is null, or a predicted layout takes more than 
+ *      one word
+ *
+ * Notes:
+ *      - The words are visited first to last, so a word's neighbours are 
+ *        restored before it is. Only the row above is needed, so the 
+ *        words could be restored as they are streamed in
+ */
+void unpredict_words(uint32_t *words, unsigned width, unsigned height, 
+                     enum codec_predict predict, 
+                     const struct word_layout *layout)
+{
+        assert(words != NULL);
+        assert(layout != NULL);
+        if (predict == PREDICT_NONE) {
+                return;
+        }
+        assert(layout_words(layout) == 1);
+
+        unsigned lsb[WORD_FIELDS];
+        layout_lsbs(layout, lsb);
+
+        long nwords = (long)width * height;
+        for (long i = 0; i < nwords; i++) {
+                uint32_t prediction = predict_word(words, width, i % width,
+                                                   i / width, predict,
+                                                   layout->width, lsb);
+                words[i] = add_fields(words[i], prediction, 1, 
+                                      layout->width, lsb);
+        }
+}
+
+
+/**************************/
+/*  Configurable layouts  */
+/**************************/
+
+
+/********** check_layout ********
+ * 
+ * Purpose: Checks that a word layout can be packed and unpacked
+ *
+ * Parameters:
+ *      - layout: the layout
+ *
+ * Return: None
+ *
+ * Expects: none
+ *
+ * CRE: layout is null, a is not 1 to 16 bits, b, c, or d is not 2 to 16
+ *      bits, Pb_avg or Pr_avg is not 1 to 16 bits, the fields take more 
+ *      than 64 bits, or bcd_max or bcd_scale is not positive
+ */
+void check_layout(const struct word_layout *layout)
+{
+        assert(layout != NULL);
+        for (int f = 0; f < WORD_FIELDS; f++) {
+                bool signed_field = f >= 1 && f <= 3;
+                assert(layout->width[f] >= (signed_field ? 2u : 1u));
+                assert(layout->width[f] <= 16);
+        }
+        assert(layout_bits(layout) <= 64);
+        assert(layout->bcd_max > 0);
+        assert(layout->bcd_scale > 0);
+}
+
+/********** layout_is_default ********
+ * 
+ * Purpose: Says whether a layout is the one of format 2, which the 
+ *          specialized functions (pack_word(), unpack_word(), ...) use
+ *
+ * Parameters:
+ *      - layout: the layout
+ *
+ * Return: true if every field width and the quantization match 
+ *         default_layout
+ *
+ * Expects: none
+ *
+ * CRE: layout is null
+ */
+bool layout_is_default(const struct word_layout *layout)
+{
+        assert(layout != NULL);
+        for (int f = 0; f < WORD_FIELDS; f++) {
+                if (layout->width[f] != default_layout.width[f]) {
+                        return false;
+                }
+        }
+        return layout->bcd_max == default_layout.bcd_max &&
+               layout->bcd_scale == default_layout.bcd_scale;
+}
+
+/********** layout_bits ********
+ * 
+ * Purpose: Gives the number of bits the fields of a layout take together
+ *
+ * Parameters:
+ *      - layout: the layout
+ *
+ * Return: the sum of the field widths
+ *
+ * Expects: none
+ *
+ * CRE: layout is null
+ */
+unsigned layout_bits(const struct word_layout *layout)
+{
+        assert(layout != NULL);
+        unsigned bits = 0;
+        for (int f = 0; f < WORD_FIELDS; f++) {
+                bits += layout->width[f];
+        }
+        return bits;
+}
+
+/********** layout_words ********
+ * 
+ * Purpose: Gives the number of 32-bit words a 2x2 block takes in a layout
+ *
+ * Parameters:
+ *      - layout: the layout
+ *
+ * Return: 1 for a layout of up to 32 bits, otherwise 2
+ *
+ * Expects: none
+ *
+ * CRE: layout is null
+ *
+ * Notes:
+ *      - The two words of a block are stored next to each other in a row,
+ *        most significant half first, as block.c stores the words of a 
+ *        larger block
+ */
+unsigned layout_words(const struct word_layout *layout)
+{
+        return layout_bits(layout) <= 32 ? 1 : 2;
+}
+
+/********** layout_lsbs ********
+ * 
+ * Purpose: Gives the least significant bit of each field of a layout
+ *
+ * Parameters:
+ *      - layout: the layout
+ *      - lsb: filled with WORD_FIELDS bit positions, a through Pr_avg
+ *
+ * Return: None
+ *
+ * Expects: none
+ *
+ * CRE: layout or lsb is null
+ *
+ * Notes:
+ *      - The fields are packed from bit layout_bits() - 1 down to bit 0, 
+ *        so for the default layout these are a_lsb through pr_avg_lsb
+ */
+void layout_lsbs(const struct word_layout *layout, unsigned *lsb)
+{
+        assert(lsb != NULL);
+        unsigned next = layout_bits(layout);
+        for (int f = 0; f < WORD_FIELDS; f++) {
+                next -= layout->width[f];
+                lsb[f] = next;
+        }
+}
+
+/********** pack_words_with ********
+ * 
+ * Purpose: Packs a 2D array of Y/Pb/Pr pixels into words laid out as a 
+ *          layout says; make_word_array() and pack_word() for any layout
+ *
+ * Parameters:
+ *      - ypbpr_pixels: the pixels, with even width and height
+ *      - methods: the methods for both arrays
+ *      - layout: the layout of the words
+ *
+ * Return: a 2D array of 32-bit words, layout_words() per 2x2 block, 
+ *         (width / 2 * layout_words()) by (height / 2)
+ *
+ * Expects: 
+ *      - the element type of ypbpr_pixels is Y_Pb_Pr
+ *
+ * CRE: ypbpr_pixels or methods is null, or layout fails check_layout()
+ *
+ * Notes:
+ *      - With the default layout the words are the same as pack_word()'s,
+ *        but the specialized functions are faster
+ */
+A2Methods_UArray2 pack_words_with(A2Methods_UArray2 ypbpr_pixels, 
+                                  A2Methods_T methods,
+                                  const struct word_layout *layout)
+{
+        assert(ypbpr_pixels != NULL);
+        assert(methods != NULL);
+        check_layout(layout);
+
+        int width = methods->width(ypbpr_pixels) / 2;
+        int height = methods->height(ypbpr_pixels) / 2;
+        unsigned nwords = layout_words(layout);
+        unsigned lsb[WORD_FIELDS];
+        layout_lsbs(layout, lsb);
+
+        A2Methods_UArray2 word_bits = methods->new(width * nwords, height, 
+                                                   sizeof(uint32_t));
+        assert(word_bits != NULL);
+
+        for (int row = 0; row < height; row++) {
+                for (int col = 0; col < width; col++) {
+                        Y_Pb_Pr block[4] = {
+                                methods->at(ypbpr_pixels, 2 * col, 2 * row),
+                                methods->at(ypbpr_pixels, 2 * col + 1, 
+                                            2 * row),
+                                methods->at(ypbpr_pixels, 2 * col, 
+                                            2 * row + 1),
+                                methods->at(ypbpr_pixels, 2 * col + 1, 
+                                            2 * row + 1)
+                        };
+                        uint64_t code = pack_block(layout, lsb, block);
+                        for (unsigned k = 0; k < nwords; k++) {
+                                uint32_t *word = methods->at(word_bits, 
+                                                        col * nwords + k, 
+                                                        row);
+                                *word = code >> 32 * (nwords - 1 - k);
+                        }
+                }
+        }
+        return word_bits;
+}
+
+/********** unpack_words_with ********
+ * 
+ * Purpose: Unpacks words laid out as a layout says into a 2D array of 
+ *          Y/Pb/Pr pixels; unpack_word() and decompress_words() for any 
+ *          layout
+ *
+ * Parameters:
+ *      - word_bits: the words, as pack_words_with() made them
+ *      - methods: the methods for both arrays
+ *      - layout: the layout of the words
+ *
+ * Return: a 2D array of Y_Pb_Pr pixels, two per word (per block) each way
+ *
+ * Expects: 
+ *      - the width of word_bits is a multiple of layout_words()
+ *
+ * CRE: word_bits or methods is null, or layout fails check_layout()
+ */
+A2Methods_UArray2 unpack_words_with(A2Methods_UArray2 word_bits, 
+                                    A2Methods_T methods,
+                                    const struct word_layout *layout)
+{
+        assert(word_bits != NULL);
+        assert(methods != NULL);
+        check_layout(layout);
+
+        unsigned nwords = layout_words(layout);
+        int width = methods->width(word_bits) / nwords;
+        int height = methods->height(word_bits);
+        unsigned lsb[WORD_FIELDS];
+        layout_lsbs(layout, lsb);
+
+        A2Methods_UArray2 ypbpr_pixels = methods->new(2 * width, 2 * height,
+                                                      Y_Pb_Pr_size());
+        assert(ypbpr_pixels != NULL);
+
+        for (int row = 0; row < height; row++) {
+                for (int col = 0; col < width; col++) {
+                        Y_Pb_Pr block[4] = {
+                                methods->at(ypbpr_pixels, 2 * col, 2 * row),
+                                methods->at(ypbpr_pixels, 2 * col + 1, 
+                                            2 * row),
+                                methods->at(ypbpr_pixels, 2 * col, 
+                                            2 * row + 1),
+                                methods->at(ypbpr_pixels, 2 * col + 1, 
+                                            2 * row + 1)
+                        };
+                        uint64_t code = get_code(word_bits, methods, nwords,
+                                                 col, row);
+                        unpack_block(layout, lsb, code, block);
+                }
+        }
+        return ypbpr_pixels;
+}
+
+/********** preview_words_with ********
+ * 
+ * Purpose: preview_words() for words laid out as a layout says: one 
+ *          pixel per 2x2 block, its average Y, Pb, and Pr
+ *
+ * Parameters:
+ *      - word_bits: the words, as pack_words_with() made them
+ *      - methods: the methods for both arrays
+ *      - layout: the layout of the words
+ *
+ * Return: a 2D array of Y_Pb_Pr pixels, one per block
+ *
+ * Expects: 
+ *      - the width of word_bits is a multiple of layout_words()
+ *
+ * CRE: word_bits or methods is null, or layout fails check_layout()
+ */
+A2Methods_UArray2 preview_words_with(A2Methods_UArray2 word_bits, 
+                                     A2Methods_T methods,
+                                     const struct word_layout *layout)
+{
+        assert(word_bits != NULL);
+        assert(methods != NULL);
+        check_layout(layout);
+
+        unsigned nwords = layout_words(layout);
+        int width = methods->width(word_bits) / nwords;
+        int height = methods->height(word_bits);
+        unsigned lsb[WORD_FIELDS];
+        layout_lsbs(layout, lsb);
+        const unsigned *field_width = layout->width;
+        double a_max = (1u << field_width[0]) - 1;
+
+        A2Methods_UArray2 ypbpr_pixels = methods->new(width, height, 
+                                                      Y_Pb_Pr_size());
+        assert(ypbpr_pixels != NULL);
+
+        for (int row = 0; row < height; row++) {
+                for (int col = 0; col < width; col++) {
+                        uint64_t code = get_code(word_bits, methods, nwords,
+                                                 col, row);
+                        float a = Bitpack_getu(code, field_width[0], 
+                                               lsb[0]) / a_max;
+                        float Pb_avg = chroma_value(field_width[4], 
+                                       Bitpack_getu(code, field_width[4], 
+                                                    lsb[4]));
+                        float Pr_avg = chroma_value(field_width[5], 
+                                       Bitpack_getu(code, field_width[5], 
+                                                    lsb[5]));
+                        set_ypbpr(methods->at(ypbpr_pixels, col, row), a, 
+                                  Pb_avg, Pr_avg);
+                }
+        }
+        return ypbpr_pixels;
+}
+
+/**************************/
+/*    Helper functions    */
+/**************************/
+
+
+/********** predict_word ********
+ * 
+ * Purpose: Predicts the a, Pb_avg, and Pr_avg fields of a word from its 
+ *          neighbours
+ *
+ * Parameters:
+ *      - words: the words, row-major
+ *      - width: the number of words in a row
+ *      - col, row: the word to predict
+ *      - predict: which neighbours to use
+ *      - field_width, lsb: the width and least significant bit of each 
+ *        field
+ *
+ * Return: a word holding the predicted fields (other fields are 0)
+ *
+ * Expects: 
+ *      - the neighbours to the left and above hold their original words
+ *
+ * CRE: none
+ *
+ * Notes:
+ *      - The first row can only use the word to the left, and the first 
+ *        column the word above. The first word is predicted as all zeros
+ *      - The median predictor (from LOCO-I) picks the left or above 
+ *        neighbour, or left + above - above_left, whichever is the median
+ *        of the three, so it follows both horizontal and vertical edges
+ */
+static uint32_t predict_word(const uint32_t *words, unsigned width, 
+                             unsigned col, unsigned row, 
+                             enum codec_predict predict, 
+                             const unsigned *field_width, 
+                             const unsigned *lsb)
+{
+        const uint32_t *here = words + (long)row * width + col;
+        if (row == 0) {
+                return col == 0 ? 0 : here[-1];
+        } else if (col == 0) {
+                return here[-(long)width];
+        }
+
+        switch (predict) {
+        case PREDICT_LEFT:
+                return here[-1];
+        case PREDICT_ABOVE:
+                return here[-(long)width];
+        case PREDICT_MEDIAN:
+                break;
+        case PREDICT_NONE:
+                return 0;
+        }
+
+        uint32_t left = here[-1];
+        uint32_t above = here[-(long)width];
+        uint32_t above_left = here[-(long)width - 1];
+        uint32_t prediction = 0;
+        for (int k = 0; k < PREDICTED_FIELDS; k++) {
+                int f = predicted_field[k];
+                uint32_t mask = (1u << field_width[f]) - 1;
+                uint32_t median = median_field((left >> lsb[f]) & mask, 
+                                               (above >> lsb[f]) & mask,
+                                               (above_left >> lsb[f]) & mask);
+                prediction |= (median & mask) << lsb[f];
+        }
+        return prediction;
+}
+
+/********** median_field ********
+ * 
+ * Purpose: Gives the median predictor's guess for one field
+ *
+ * Parameters:
+ *      - left, above, above_left: the field in the three neighbours
+ *
+ * Return: the guess, within the range of the neighbours
+ *
+ * Expects: none
+ *
+ * CRE: none
+ */
+static uint32_t median_field(uint32_t left, uint32_t above, 
+                             uint32_t above_left)
+{
+        uint32_t low = left < above ? left : above;
+        uint32_t high = left < above ? above : left;
+        if (above_left >= high) {
+                return low;
+        } else if (above_left <= low) {
+                return high;
+        }
+        return left + above - above_left;
+}
+
+/********** add_fields ********
+ * 
+ * Purpose: Adds or subtracts a prediction from the a, Pb_avg, and Pr_avg
+ *          fields of a word
+ *
+ * Parameters:
+ *      - word: the word
+ *      - prediction: the predicted fields
+ *      - sign: 1 to add the prediction, -1 to subtract it
+ *      - field_width, lsb: the width and least significant bit of each 
+ *        field
+ *
+ * Return: the word with each predicted field changed, modulo its range
+ *
+ * Expects: none
+ *
+ * CRE: none
+ */
+static uint32_t add_fields(uint32_t word, uint32_t prediction, int sign,
+                           const unsigned *field_width, const unsigned *lsb)
+{
+        for (int k = 0; k < PREDICTED_FIELDS; k++) {
+                int f = predicted_field[k];
+                uint32_t mask = (1u << field_width[f]) - 1;
+                uint32_t field = (word >> lsb[f]) + sign * 
+                                 ((prediction >> lsb[f]) & mask);
+                word = (word & ~(mask << lsb[f])) | (field & mask) << lsb[f];
+        }
+        return word;
+}
+
+/********** pack_block ********
+ * 
+ * Purpose: Packs one 2x2 block of pixels into a code laid out as a layout
+ *          says; ypbpr_to_word() and pack_single_word() for any layout
+ *
+ * Parameters:
+ *      - layout: the layout
+ *      - lsb: the least significant bit of each field (see layout_lsbs())
+ *      - ypbpr: the top-left, top-right, bottom-left, and bottom-right 
+ *        pixels of the block
+ *
+ * Return: the code, in the low layout_bits() bits
+ *
+ * Expects: 
+ *      - layout has passed check_layout()
+ *
+ * CRE: none
+ *
+ * Notes:
+ *      - a is scaled to the full range of its field and b, c, and d are
+ *        quantized by quantize_field(), so the default layout gives the 
+ *        same code as ypbpr_to_word() and pack_single_word()
+ */
+static uint64_t pack_block(const struct word_layout *layout, 
+                           const unsigned *lsb, Y_Pb_Pr ypbpr[4])
+{
+        const unsigned *width = layout->width;
+        float Pb_avg = (getPb(ypbpr[0]) + getPb(ypbpr[1]) + 
+                        getPb(ypbpr[2]) + getPb(ypbpr[3])) / 4.0;
+        float Pr_avg = (getPr(ypbpr[0]) + getPr(ypbpr[1]) + 
+                        getPr(ypbpr[2]) + getPr(ypbpr[3])) / 4.0;
+
+        float Y1 = getY(ypbpr[0]);
+        float Y2 = getY(ypbpr[1]);
+        float Y3 = getY(ypbpr[2]);
+        float Y4 = getY(ypbpr[3]);
+        float coefficient[4] = {
+                (Y4 + Y3 + Y2 + Y1) / 4.0,
+                (Y4 + Y3 - Y2 - Y1) / 4.0,
+                (Y4 - Y3 + Y2 - Y1) / 4.0,
+                (Y4 - Y3 - Y2 + Y1) / 4.0
+        };
+
+        uint64_t a_max = ((uint64_t)1 << width[0]) - 1;
+        uint64_t a = (uint64_t)(coefficient[0] * a_max);
+        if (a > a_max) {
+                a = a_max;
+        }
+
+        uint64_t code = Bitpack_newu(0, width[0], lsb[0], a);
+        for (int f = 1; f <= 3; f++) {
+                code = Bitpack_news(code, width[f], lsb[f], 
+                                    quantize_field(layout, width[f], 
+                                                   coefficient[f]));
+        }
+        code = Bitpack_newu(code, width[4], lsb[4], 
+                            chroma_index(width[4], Pb_avg));
+        return Bitpack_newu(code, width[5], lsb[5], 
+                            chroma_index(width[5], Pr_avg));
+}
+
+/********** unpack_block ********
+ * 
+ * Purpose: Unpacks a code laid out as a layout says into one 2x2 block of
+ *          pixels; unpack_single_word() and word_to_ypbpr() for any layout
+ *
+ * Parameters:
+ *      - layout: the layout
+ *      - lsb: the least significant bit of each field (see layout_lsbs())
+ *      - code: the code, in the low layout_bits() bits
+ *      - ypbpr: the top-left, top-right, bottom-left, and bottom-right 
+ *        pixels of the block, to be set
+ *
+ * Return: None
+ *
+ * Expects: 
+ *      - layout has passed check_layout()
+ *
+ * CRE: none
+ */
+static void unpack_block(const struct word_layout *layout, 
+                         const unsigned *lsb, uint64_t code, 
+                         Y_Pb_Pr ypbpr[4])
+{
+        const unsigned *width = layout->width;
+        float Pb_avg = chroma_value(width[4], 
+                                    Bitpack_getu(code, width[4], lsb[4]));
+        float Pr_avg = chroma_value(width[5], 
+                                    Bitpack_getu(code, width[5], lsb[5]));
+
+        double a_max = ((uint64_t)1 << width[0]) - 1;
+        double scale = layout->bcd_scale;
+        float a = Bitpack_getu(code, width[0], lsb[0]) / a_max;
+        float b = Bitpack_gets(code, width[1], lsb[1]) / scale;
+        float c = Bitpack_gets(code, width[2], lsb[2]) / scale;
+        float d = Bitpack_gets(code, width[3], lsb[3]) / scale;
+
+        set_ypbpr(ypbpr[0], a - b - c + d, Pb_avg, Pr_avg);
+        set_ypbpr(ypbpr[1], a - b + c - d, Pb_avg, Pr_avg);
+        set_ypbpr(ypbpr[2], a + b - c - d, Pb_avg, Pr_avg);
+        set_ypbpr(ypbpr[3], a + b + c + d, Pb_avg, Pr_avg);
+}
+
+/********** quantize_field ********
+ * 
+ * Purpose: quantize_bcd() for any layout: quantizes b, c, or d to a 
+ *          signed field
+ *
+ * Parameters:
+ *      - layout: the layout, for bcd_max and bcd_scale
+ *      - width: the width of the field
+ *      - value: the coefficient
+ *
+ * Return: value clamped to [-bcd_max, bcd_max], multiplied by bcd_scale,
+ *         rounded toward 0, and clamped to what width signed bits hold
+ *
+ * Expects: none
+ *
+ * CRE: none
+ */
+static int64_t quantize_field(const struct word_layout *layout, 
+                              unsigned width, float value)
+{
+        if (value < -layout->bcd_max) {
+                value = -layout->bcd_max;
+        }
+        if (value > layout->bcd_max) {
+                value = layout->bcd_max;
+        }
+
+        int64_t limit = ((int64_t)1 << (width - 1)) - 1;
+        int64_t bucket = value * layout->bcd_scale;
+        if (bucket > limit) {
+                bucket = limit;
+        } else if (bucket < -limit) {
+                bucket = -limit;
+        }
+        return bucket;
+}
+
+/********** chroma_index ********
+ * 
+ * Purpose: Quantizes an average chroma value to a field of some width
+ *
+ * Parameters:
+ *      - width: the width of the field
+ *      - chroma: the value, in [-0.5, 0.5]
+ *
+ * Return: the index
+ *
+ * Expects: none
+ *
+ * CRE: none
+ *
+ * Notes:
+ *      - A 4-bit field uses Arith40_index_of_chroma(), whose levels are 
+ *        closer together near 0, so the default layout is unchanged. Any
+ *        other width divides [-0.5, 0.5] into 2^width evenly spaced levels
+ */
+static uint64_t chroma_index(unsigned width, float chroma)
+{
+        if (width == 4) {
+                return Arith40_index_of_chroma(chroma);
+        }
+
+        uint64_t levels = ((uint64_t)1 << width) - 1;
+        float scaled = (chroma + 0.5) * levels + 0.5;
+        if (scaled <= 0) {
+                return 0;
+        }
+        return scaled >= levels ? levels : (uint64_t)scaled;
+}
+
+/********** chroma_value ********
+ * 
+ * Purpose: Undoes chroma_index()
+ *
+ * Parameters:
+ *      - width: the width of the field
+ *      - index: the index in the field
+ *
+ * Return: the chroma value the index stands for
+ *
+ * Expects: none
+ *
+ * CRE: none
+ */
+static float chroma_value(unsigned width, uint64_t index)
+{
+        if (width == 4) {
+                return Arith40_chroma_of_index(index);
+        }
+        return (float)index / (((uint64_t)1 << width) - 1) - 0.5;
+}
+
+/********** get_code ********
+ * 
+ * Purpose: Gets the code of one 2x2 block from its words
+ *
+ * Parameters:
+ *      - word_bits: the words
+ *      - methods: the methods for word_bits
+ *      - nwords: the number of words per block (1 or 2)
+ *      - col, row: the block
+ *
+ * Return: the code, most significant word first
+ *
+ * Expects: none
+ *
+ * CRE: none
+ */
+static uint64_t get_code(A2Methods_UArray2 word_bits, A2Methods_T methods,
+                         unsigned nwords, int col, int row)
+{
+        uint64_t code = 0;
+        for (unsigned k = 0; k < nwords; k++) {
+                uint32_t *word = methods->at(word_bits, col * nwords + k, 
+                                             row);
+                code = code << 32 | *word;
+        }
+        return code;
+}
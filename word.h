@@ -21,6 +21,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdbool.h>
 #include "assert.h"
 #include "mem.h"
 #include <except.h>
@@ -34,6 +35,10 @@
 #include "arith40.h"
 #include "ry_conversion.h"
 #include "bitpack.h"
+#include "codec.h"
+
+/* the layout the specialized 32-bit functions below are written for */
+extern const struct word_layout default_layout;
 
 /*structs*/
 typedef struct word *word;
@@ -64,10 +69,42 @@ void ypbpr_apply(int col, int row, A2Methods_UArray2 array2, void *elem,
 void word_to_ypbpr(word w, Y_Pb_Pr ypbpr1, Y_Pb_Pr ypbpr2, Y_Pb_Pr ypbpr3, 
                         Y_Pb_Pr ypbpr4);
 void set_ypbpr(Y_Pb_Pr ypbpr, float Y, float Pb, float Pr);
+A2Methods_UArray2 preview_words(A2Methods_UArray2 word_bits, 
+                                A2Methods_T methods);
+void preview_apply(int col, int row, A2Methods_UArray2 array2, void *elem, 
+                   void *cl);
 
 A2Methods_UArray2 unpack_word(A2Methods_UArray2 word_bits, A2Methods_T methods);
 void unpack_word_apply(int col, int row, A2Methods_UArray2 array2, void *elem, 
                        void *cl);
 void unpack_single_word(word w, uint32_t packed_word);
 
+/*size and filler*/
+int word_size();
+uint32_t blank_word();
+
+/*prediction of a, Pb_avg, and Pr_avg from neighbouring words*/
+void predict_words(uint32_t *words, unsigned width, unsigned height, 
+                   enum codec_predict predict, 
+                   const struct word_layout *layout);
+void unpredict_words(uint32_t *words, unsigned width, unsigned height, 
+                     enum codec_predict predict, 
+                     const struct word_layout *layout);
+
+/*layouts other than the default (any layout works, but slower)*/
+void check_layout(const struct word_layout *layout);
+bool layout_is_default(const struct word_layout *layout);
+unsigned layout_bits(const struct word_layout *layout);
+unsigned layout_words(const struct word_layout *layout);
+void layout_lsbs(const struct word_layout *layout, unsigned *lsb);
+A2Methods_UArray2 pack_words_with(A2Methods_UArray2 ypbpr_pixels, 
+                                  A2Methods_T methods,
+                                  const struct word_layout *layout);
+A2Methods_UArray2 unpack_words_with(A2Methods_UArray2 word_bits, 
+                                    A2Methods_T methods,
+                                    const struct word_layout *layout);
+A2Methods_UArray2 preview_words_with(A2Methods_UArray2 word_bits, 
+                                     A2Methods_T methods,
+                                     const struct word_layout *layout);
+
 #endif
\ No newline at end of file